@@ -51,6 +51,7 @@ static int can_rx_offload_napi_poll(struct napi_struct *napi, int quota)
 	struct net_device *dev = offload->dev;
 	struct net_device_stats *stats = &dev->stats;
 	struct sk_buff *skb;
+	LIST_HEAD(rx_list);
 	int work_done = 0;
 
 	while ((work_done < quota) &&
@@ -60,9 +61,12 @@ static int can_rx_offload_napi_poll(struct napi_struct *napi, int quota)
 		work_done++;
 		stats->rx_packets++;
 		stats->rx_bytes += cf->can_dlc;
-		netif_receive_skb(skb);
+		list_add_tail(&skb->list, &rx_list);
 	}
 
+	/* hand the whole batch to the stack at once */
+	netif_receive_skb_list(&rx_list);
+
 	if (work_done < quota) {
 		napi_complete_done(napi, work_done);
 
@@ -3213,6 +3213,8 @@ static int i40e_configure_rx_ring(struct i40e_ring *ring)
 						 &ring->zca);
 		if (ret)
 			return ret;
+		if (ring->q_vector)
+			ring->xdp_rxq.napi_id = ring->q_vector->napi.napi_id;
 		dev_info(&vsi->back->pdev->dev,
 			 "Registered XDP mem model MEM_TYPE_ZERO_COPY on Rx ring %d\n",
 			 ring->queue_index);
@@ -21,6 +21,8 @@
 
 #include <linux/module.h>
 #include <linux/timer.h>
+#include <linux/hrtimer.h>
+#include <linux/random.h>
 #include <linux/platform_device.h>
 #include <linux/rtnetlink.h>
 #include <linux/netdevice.h>
@@ -34,6 +36,14 @@
 MODULE_DESCRIPTION("Software simulator of IEEE 802.15.4 radio(s) for mac802154");
 MODULE_LICENSE("GPL");
 
+static bool airtime;
+module_param(airtime, bool, 0444);
+MODULE_PARM_DESC(airtime, "Emulate CSMA-CA backoff and frame airtime");
+
+static int tx_queue_depth;
+module_param(tx_queue_depth, int, 0444);
+MODULE_PARM_DESC(tx_queue_depth, "Frames queued while the radio is busy");
+
 static LIST_HEAD(hwsim_phys);
 static DEFINE_MUTEX(hwsim_phys_lock);
 
@@ -82,6 +92,10 @@ struct hwsim_phy {
 	bool suspended;
 	struct list_head edges;
 
+	/* frame on the air, with airtime emulation */
+	struct hrtimer tx_timer;
+	struct sk_buff *tx_skb;
+
 	struct list_head list;
 };
 
@@ -114,15 +128,12 @@ static int hwsim_hw_channel(struct ieee802154_hw *hw, u8 page, u8 channel)
 	return 0;
 }
 
-static int hwsim_hw_xmit(struct ieee802154_hw *hw, struct sk_buff *skb)
+static void hwsim_deliver(struct hwsim_phy *current_phy, struct sk_buff *skb)
 {
-	struct hwsim_phy *current_phy = hw->priv;
 	struct hwsim_pib *current_pib, *endpoint_pib;
 	struct hwsim_edge_info *einfo;
 	struct hwsim_edge *e;
 
-	WARN_ON(current_phy->suspended);
-
 	rcu_read_lock();
 	current_pib = rcu_dereference(current_phy->pib);
 	list_for_each_entry_rcu(e, &current_phy->edges, list) {
@@ -146,7 +157,57 @@ static int hwsim_hw_xmit(struct ieee802154_hw *hw, struct sk_buff *skb)
 		}
 	}
 	rcu_read_unlock();
+}
+
+#define HWSIM_UNIT_BACKOFF_PERIOD	20	/* symbols */
+#define HWSIM_CCA_PERIOD		8	/* symbols */
+#define HWSIM_SHR_PHR_LEN		6	/* octets, O-QPSK */
+
+/* Time from handing over the frame until its last symbol is sent: the
+ * unslotted CSMA-CA initial backoff of random(2^macMinBE - 1) unit
+ * backoff periods and one CCA, then the SHR, PHR and PSDU at 2 symbols
+ * per octet. The default macMinBE of 3 is used.
+ */
+static u64 hwsim_airtime_ns(struct ieee802154_hw *hw, struct sk_buff *skb)
+{
+	const u32 symbol_ns = hw->phy->symbol_duration * NSEC_PER_USEC;
+	u32 symbols;
+
+	symbols = prandom_u32_max(1 << 3) * HWSIM_UNIT_BACKOFF_PERIOD;
+	symbols += HWSIM_CCA_PERIOD;
+	symbols += (HWSIM_SHR_PHR_LEN + skb->len) * 2;
+
+	return (u64)symbols * symbol_ns;
+}
+
+static enum hrtimer_restart hwsim_tx_timer(struct hrtimer *timer)
+{
+	struct hwsim_phy *phy = container_of(timer, struct hwsim_phy,
+					     tx_timer);
+	struct sk_buff *skb = phy->tx_skb;
+
+	phy->tx_skb = NULL;
+	hwsim_deliver(phy, skb);
+	ieee802154_xmit_complete(phy->hw, skb, true);
+
+	return HRTIMER_NORESTART;
+}
+
+static int hwsim_hw_xmit(struct ieee802154_hw *hw, struct sk_buff *skb)
+{
+	struct hwsim_phy *current_phy = hw->priv;
 
+	WARN_ON(current_phy->suspended);
+
+	if (airtime) {
+		current_phy->tx_skb = skb;
+		hrtimer_start(&current_phy->tx_timer,
+			      ns_to_ktime(hwsim_airtime_ns(hw, skb)),
+			      HRTIMER_MODE_REL);
+		return 0;
+	}
+
+	hwsim_deliver(current_phy, skb);
 	ieee802154_xmit_complete(hw, skb, false);
 	return 0;
 }
@@ -164,6 +225,11 @@ static void hwsim_hw_stop(struct ieee802154_hw *hw)
 	struct hwsim_phy *phy = hw->priv;
 
 	phy->suspended = true;
+
+	if (hrtimer_cancel(&phy->tx_timer)) {
+		dev_kfree_skb_any(phy->tx_skb);
+		phy->tx_skb = NULL;
+	}
 }
 
 static int
@@ -791,6 +857,8 @@ static int hwsim_add_one(struct genl_info *info, struct device *dev,
 
 	/* hwsim phy channel 13 as default */
 	hw->phy->current_channel = 13;
+	/* 2.4 GHz O-QPSK, 62.5 ksymbol/s */
+	hw->phy->symbol_duration = 16;
 	pib = kzalloc(sizeof(*pib), GFP_KERNEL);
 	if (!pib) {
 		err = -ENOMEM;
@@ -801,8 +869,12 @@ static int hwsim_add_one(struct genl_info *info, struct device *dev,
 	phy->idx = idx;
 	INIT_LIST_HEAD(&phy->edges);
 
+	hrtimer_init(&phy->tx_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	phy->tx_timer.function = hwsim_tx_timer;
+
 	hw->flags = IEEE802154_HW_PROMISCUOUS;
 	hw->parent = dev;
+	hw->tx_queue_depth = clamp_t(int, tx_queue_depth, 0, U8_MAX);
 
 	err = ieee802154_register_hw(hw);
 	if (err)
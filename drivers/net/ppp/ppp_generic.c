@@ -1324,6 +1324,30 @@ ppp_get_stats64(struct net_device *dev, struct rtnl_link_stats64 *stats64)
 	stats64->rx_length_errors = dev->stats.rx_length_errors;
 }
 
+static int ppp_get_encap(const struct net_device *dev,
+			 struct net_device_encap *encap)
+{
+	struct ppp *ppp = netdev_priv(dev);
+	struct ppp_channel *chan;
+	struct channel *pch;
+	int err = -ENODEV;
+
+	ppp_xmit_lock(ppp);
+	if (ppp->n_channels != 1 || (ppp->flags & SC_MULTILINK))
+		goto out;
+
+	pch = list_first_entry(&ppp->channels, struct channel, clist);
+	spin_lock(&pch->downl);
+	chan = pch->chan;
+	if (chan && chan->ops->get_encap)
+		err = chan->ops->get_encap(chan, encap);
+	spin_unlock(&pch->downl);
+out:
+	ppp_xmit_unlock(ppp);
+
+	return err;
+}
+
 static int ppp_dev_init(struct net_device *dev)
 {
 	struct ppp *ppp;
@@ -1374,6 +1398,7 @@ static const struct net_device_ops ppp_netdev_ops = {
 	.ndo_start_xmit  = ppp_start_xmit,
 	.ndo_do_ioctl    = ppp_net_ioctl,
 	.ndo_get_stats64 = ppp_get_stats64,
+	.ndo_get_encap   = ppp_get_encap,
 };
 
 static struct device_type ppp_type = {
@@ -975,8 +975,31 @@ static int pppoe_xmit(struct ppp_channel *chan, struct sk_buff *skb)
 	return __pppoe_xmit(sk, skb);
 }
 
+/************************************************************************
+ *
+ * Report the Ethernet device and session the channel sends on, so the
+ * flowtable fast path can pick PPPoE frames up at the lower device.
+ *
+ ***********************************************************************/
+static int pppoe_get_encap(struct ppp_channel *chan,
+			   struct net_device_encap *encap)
+{
+	struct sock *sk = (struct sock *)chan->private;
+	struct pppox_sock *po = pppox_sk(sk);
+
+	if (!po->pppoe_dev)
+		return -ENODEV;
+
+	encap->lower_dev = po->pppoe_dev;
+	encap->id = be16_to_cpu(po->pppoe_pa.sid);
+	encap->proto = htons(ETH_P_PPP_SES);
+
+	return 0;
+}
+
 static const struct ppp_channel_ops pppoe_chan_ops = {
 	.start_xmit = pppoe_xmit,
+	.get_encap = pppoe_get_encap,
 };
 
 static int pppoe_recvmsg(struct socket *sock, struct msghdr *m,
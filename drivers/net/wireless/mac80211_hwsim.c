@@ -65,6 +65,10 @@ static bool support_p2p_device = true;
 module_param(support_p2p_device, bool, 0444);
 MODULE_PARM_DESC(support_p2p_device, "Support P2P-Device interface type");
 
+static bool airtime_fairness;
+module_param(airtime_fairness, bool, 0444);
+MODULE_PARM_DESC(airtime_fairness, "Pull frames from mac80211 TXQs in airtime fair order");
+
 /**
  * enum hwsim_regtest - the type of regulatory tests we offer
  *
@@ -1373,6 +1377,56 @@ static bool mac80211_hwsim_tx_frame_no_nl(struct ieee80211_hw *hw,
 	return ack;
 }
 
+/* airtime of all transmission attempts of a frame, without contention */
+static u16 hwsim_tx_airtime(struct ieee80211_hw *hw, struct sk_buff *skb)
+{
+	struct ieee80211_tx_info *txi = IEEE80211_SKB_CB(skb);
+	struct ieee80211_supported_band *sband = hw->wiphy->bands[txi->band];
+	u32 airtime = 0;
+	int i;
+
+	for (i = 0; i < IEEE80211_TX_MAX_RATES; i++) {
+		struct ieee80211_tx_rate *r = &txi->status.rates[i];
+		struct rate_info ri = {};
+		u32 bitrate;
+
+		if (r->idx < 0 || !r->count)
+			break;
+
+		if (r->flags & IEEE80211_TX_RC_VHT_MCS) {
+			ri.flags = RATE_INFO_FLAGS_VHT_MCS;
+			ri.mcs = ieee80211_rate_get_vht_mcs(r);
+			ri.nss = ieee80211_rate_get_vht_nss(r);
+		} else if (r->flags & IEEE80211_TX_RC_MCS) {
+			ri.flags = RATE_INFO_FLAGS_MCS;
+			ri.mcs = r->idx;
+		} else {
+			ri.legacy = sband->bitrates[r->idx].bitrate;
+		}
+
+		if (r->flags & IEEE80211_TX_RC_SHORT_GI)
+			ri.flags |= RATE_INFO_FLAGS_SHORT_GI;
+
+		if (r->flags & IEEE80211_TX_RC_160_MHZ_WIDTH)
+			ri.bw = RATE_INFO_BW_160;
+		else if (r->flags & IEEE80211_TX_RC_80_MHZ_WIDTH)
+			ri.bw = RATE_INFO_BW_80;
+		else if (r->flags & IEEE80211_TX_RC_40_MHZ_WIDTH)
+			ri.bw = RATE_INFO_BW_40;
+		else
+			ri.bw = RATE_INFO_BW_20;
+
+		/* in units of 100 kbit/s */
+		bitrate = cfg80211_calculate_bitrate(&ri);
+		if (!bitrate)
+			break;
+
+		airtime += r->count * DIV_ROUND_UP(skb->len * 8 * 10, bitrate);
+	}
+
+	return min_t(u32, airtime, U16_MAX);
+}
+
 static void mac80211_hwsim_tx(struct ieee80211_hw *hw,
 			      struct ieee80211_tx_control *control,
 			      struct sk_buff *skb)
@@ -1463,9 +1517,58 @@ static void mac80211_hwsim_tx(struct ieee80211_hw *hw,
 
 	if (!(txi->flags & IEEE80211_TX_CTL_NO_ACK) && ack)
 		txi->flags |= IEEE80211_TX_STAT_ACK;
+	if (airtime_fairness)
+		txi->status.tx_time = hwsim_tx_airtime(hw, skb);
 	ieee80211_tx_status_irqsafe(hw, skb);
 }
 
+/*
+ * In airtime fairness mode at most HWSIM_TXQ_DEPTH frames are waiting for
+ * wmediumd, the rest stays in the mac80211 TXQs. Each txq handed out by
+ * ieee80211_next_txq() may send HWSIM_TXQ_BURST frames per round.
+ */
+#define HWSIM_TXQ_DEPTH 16
+#define HWSIM_TXQ_BURST 4
+
+static void mac80211_hwsim_tx_schedule(struct ieee80211_hw *hw, u8 ac)
+{
+	struct mac80211_hwsim_data *data = hw->priv;
+	struct ieee80211_tx_control control = {};
+	struct ieee80211_txq *txq;
+	struct sk_buff *skb;
+	int n, sent;
+
+	rcu_read_lock();
+
+	do {
+		sent = 0;
+		ieee80211_txq_schedule_start(hw, ac);
+
+		while (skb_queue_len(&data->pending) < HWSIM_TXQ_DEPTH &&
+		       (txq = ieee80211_next_txq(hw, ac))) {
+			control.sta = txq->sta;
+
+			for (n = 0; n < HWSIM_TXQ_BURST; n++) {
+				skb = ieee80211_tx_dequeue(hw, txq);
+				if (!skb)
+					break;
+				mac80211_hwsim_tx(hw, &control, skb);
+				sent++;
+			}
+
+			ieee80211_return_txq(hw, txq);
+		}
+	} while (sent && skb_queue_len(&data->pending) < HWSIM_TXQ_DEPTH);
+
+	rcu_read_unlock();
+}
+
+static void mac80211_hwsim_wake_tx_queue(struct ieee80211_hw *hw,
+					 struct ieee80211_txq *txq)
+{
+	mac80211_hwsim_tx_schedule(hw, txq->ac);
+}
+
 
 static int mac80211_hwsim_start(struct ieee80211_hw *hw)
 {
@@ -2382,13 +2485,13 @@ static void mac80211_hwsim_get_et_stats(struct ieee80211_hw *hw,
 	.get_et_stats = mac80211_hwsim_get_et_stats,		\
 	.get_et_strings = mac80211_hwsim_get_et_strings,
 
-static const struct ieee80211_ops mac80211_hwsim_ops = {
+static struct ieee80211_ops mac80211_hwsim_ops = {
 	HWSIM_COMMON_OPS
 	.sw_scan_start = mac80211_hwsim_sw_scan,
 	.sw_scan_complete = mac80211_hwsim_sw_scan_complete,
 };
 
-static const struct ieee80211_ops mac80211_hwsim_mchan_ops = {
+static struct ieee80211_ops mac80211_hwsim_mchan_ops = {
 	HWSIM_COMMON_OPS
 	.hw_scan = mac80211_hwsim_hw_scan,
 	.cancel_hw_scan = mac80211_hwsim_cancel_hw_scan,
@@ -2884,6 +2987,10 @@ static int mac80211_hwsim_new_radio(struct genl_info *info,
 
 	wiphy_ext_feature_set(hw->wiphy, NL80211_EXT_FEATURE_CQM_RSSI_LIST);
 
+	if (airtime_fairness)
+		wiphy_ext_feature_set(hw->wiphy,
+				      NL80211_EXT_FEATURE_AIRTIME_FAIRNESS);
+
 	err = ieee80211_register_hw(hw);
 	if (err < 0) {
 		pr_debug("mac80211_hwsim: ieee80211_register_hw failed (%d)\n",
@@ -3171,6 +3278,17 @@ static int hwsim_tx_info_frame_received_nl(struct sk_buff *skb_2,
 		}
 		txi->flags |= IEEE80211_TX_STAT_ACK;
 	}
+
+	if (airtime_fairness) {
+		txi->status.tx_time = hwsim_tx_airtime(data2->hw, skb);
+		ieee80211_tx_status_irqsafe(data2->hw, skb);
+
+		/* there is room for more frames in the pending queue */
+		for (i = 0; i < IEEE80211_NUM_ACS; i++)
+			mac80211_hwsim_tx_schedule(data2->hw, i);
+		return 0;
+	}
+
 	ieee80211_tx_status_irqsafe(data2->hw, skb);
 	return 0;
 out:
@@ -3691,6 +3809,12 @@ static int __init init_mac80211_hwsim(void)
 
 	spin_lock_init(&hwsim_radio_lock);
 
+	if (airtime_fairness) {
+		mac80211_hwsim_ops.wake_tx_queue = mac80211_hwsim_wake_tx_queue;
+		mac80211_hwsim_mchan_ops.wake_tx_queue =
+			mac80211_hwsim_wake_tx_queue;
+	}
+
 	err = rhashtable_init(&hwsim_radios_rht, &hwsim_rht_params);
 	if (err)
 		return err;
@@ -44,6 +44,7 @@ const struct btf_type *btf_type_id_size(const struct btf *btf,
 					u32 *ret_size);
 void btf_type_seq_show(const struct btf *btf, u32 type_id, void *obj,
 		       struct seq_file *m);
+int btf_find_spin_lock(const struct btf *btf, const struct btf_type *t);
 int btf_get_fd_by_id(u32 id);
 u32 btf_id(const struct btf *btf);
 
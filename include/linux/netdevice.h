@@ -912,6 +912,13 @@ struct netdev_bpf {
 	};
 };
 
+/* Link layer encapsulation a stacked device adds on its lower device. */
+struct net_device_encap {
+	struct net_device	*lower_dev;
+	u16			id;	/* VLAN id or PPPoE session id */
+	__be16			proto;	/* ETH_P_8021Q, ETH_P_8021AD, ETH_P_PPP_SES */
+};
+
 #ifdef CONFIG_XFRM_OFFLOAD
 struct xfrmdev_ops {
 	int	(*xdo_dev_state_add) (struct xfrm_state *x);
@@ -1253,6 +1260,13 @@ struct dev_ifalias {
  *	that got dropped are freed/returned via xdp_return_frame().
  *	Returns negative number, means general error invoking ndo, meaning
  *	no frames were xmit'ed and core-caller will free all frames.
+ * int (*ndo_get_encap)(const struct net_device *dev,
+ *			struct net_device_encap *encap);
+ *	Called by the flowtable fast path to find the lower device and the
+ *	VLAN or PPPoE header a stacked device puts on its frames, so that
+ *	forwarded traffic can be matched and decapsulated at the lower
+ *	device. Returns 0 on success, negative errno if the device has no
+ *	single lower device at the moment.
  */
 struct net_device_ops {
 	int			(*ndo_init)(struct net_device *dev);
@@ -1442,6 +1456,8 @@ struct net_device_ops {
 						u32 flags);
 	int			(*ndo_xsk_async_xmit)(struct net_device *dev,
 						      u32 queue_id);
+	int			(*ndo_get_encap)(const struct net_device *dev,
+						 struct net_device_encap *encap);
 };
 
 /**
@@ -2628,7 +2644,18 @@ u16 dev_pick_tx_cpu_id(struct net_device *dev, struct sk_buff *skb,
 		       select_queue_fallback_t fallback);
 int dev_queue_xmit(struct sk_buff *skb);
 int dev_queue_xmit_accel(struct sk_buff *skb, struct net_device *sb_dev);
-int dev_direct_xmit(struct sk_buff *skb, u16 queue_id);
+int __dev_direct_xmit(struct sk_buff *skb, u16 queue_id);
+
+static inline int dev_direct_xmit(struct sk_buff *skb, u16 queue_id)
+{
+	int ret;
+
+	ret = __dev_direct_xmit(skb, queue_id);
+	if (!dev_xmit_complete(ret))
+		kfree_skb(skb);
+	return ret;
+}
+
 int register_netdevice(struct net_device *dev);
 void unregister_netdevice_queue(struct net_device *dev, struct list_head *head);
 void unregister_netdevice_many(struct list_head *head);
@@ -25,6 +25,7 @@
 #include <net/net_namespace.h>
 
 struct ppp_channel;
+struct net_device_encap;
 
 struct ppp_channel_ops {
 	/* Send a packet (or multilink fragment) on this channel.
@@ -32,6 +33,8 @@ struct ppp_channel_ops {
 	int	(*start_xmit)(struct ppp_channel *, struct sk_buff *);
 	/* Handle an ioctl call that has come in via /dev/ppp. */
 	int	(*ioctl)(struct ppp_channel *, unsigned int, unsigned long);
+	/* Report the lower device and link layer header of this channel. */
+	int	(*get_encap)(struct ppp_channel *, struct net_device_encap *);
 };
 
 struct ppp_channel {
@@ -474,6 +474,8 @@ void mm_unaccount_pinned_pages(struct mmpin *mmp);
 struct ubuf_info *sock_zerocopy_alloc(struct sock *sk, size_t size);
 struct ubuf_info *sock_zerocopy_realloc(struct sock *sk, size_t size,
 					struct ubuf_info *uarg);
+struct ubuf_info *sock_zerocopy_batch(struct sock *sk, size_t size,
+				      struct msghdr *msg);
 
 static inline void sock_zerocopy_get(struct ubuf_info *uarg)
 {
@@ -485,6 +487,7 @@ void sock_zerocopy_put_abort(struct ubuf_info *uarg);
 
 void sock_zerocopy_callback(struct ubuf_info *uarg, bool success);
 
+int skb_zerocopy_iter_dgram(struct sk_buff *skb, struct msghdr *msg, int len);
 int skb_zerocopy_iter_stream(struct sock *sk, struct sk_buff *skb,
 			     struct msghdr *msg, int len,
 			     struct ubuf_info *uarg);
@@ -682,6 +685,7 @@ struct sk_buff {
 		};
 		struct rb_node		rbnode; /* used in netem, ip4 defrag, and tcp stack */
 		struct list_head	list;
+		struct llist_node	ll_node; /* used in qdisc_stage */
 	};
 
 	union {
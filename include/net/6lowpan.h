@@ -113,12 +113,18 @@ struct lowpan_iphc_ctx {
 	struct in6_addr pfx;
 	u8 plen;
 	unsigned long flags;
+	/* jiffies, set for contexts learned from a 6CO option only */
+	unsigned long expires;
 };
 
 struct lowpan_iphc_ctx_table {
 	spinlock_t lock;
 	const struct lowpan_iphc_ctx_ops *ops;
 	struct lowpan_iphc_ctx table[LOWPAN_IPHC_CTX_TABLE_SIZE];
+
+	/* ids of the compression contexts, longest prefix first */
+	u8 cmp_order[LOWPAN_IPHC_CTX_TABLE_SIZE];
+	u8 cmp_num;
 };
 
 static inline bool lowpan_iphc_ctx_is_active(const struct lowpan_iphc_ctx *ctx)
@@ -330,6 +330,8 @@ struct hci_dev {
 	unsigned long	sco_last_tx;
 	unsigned long	le_last_tx;
 
+	__u32		tx_turn;
+
 	__u8		le_tx_def_phys;
 	__u8		le_rx_def_phys;
 
@@ -500,6 +502,15 @@ struct hci_conn {
 
 	unsigned int	sent;
 
+	/* deficit round robin state of the TX scheduler */
+	__u32		tx_turn;
+	unsigned int	tx_deficit;
+
+	/* time from queueing to handing packets to the driver */
+	__u64		tx_pkts;
+	__u64		tx_lat_sum;
+	__u32		tx_lat_max;
+
 	struct sk_buff_head data_q;
 	struct list_head chan_list;
 
@@ -513,6 +513,11 @@ static inline bool fib6_rules_early_flow_dissect(struct net *net,
 
 	return true;
 }
+
+static inline bool fib6_has_custom_rules(const struct net *net)
+{
+	return net->ipv6.fib6_has_custom_rules;
+}
 #else
 static inline int               fib6_rules_init(void)
 {
@@ -541,5 +546,10 @@ static inline bool fib6_rules_early_flow_dissect(struct net *net,
 {
 	return false;
 }
+
+static inline bool fib6_has_custom_rules(const struct net *net)
+{
+	return false;
+}
 #endif
 #endif
@@ -312,6 +312,11 @@ static inline bool fib4_rules_early_flow_dissect(struct net *net,
 {
 	return false;
 }
+
+static inline bool fib4_has_custom_rules(const struct net *net)
+{
+	return false;
+}
 #else /* CONFIG_IP_MULTIPLE_TABLES */
 int __net_init fib4_rules_init(struct net *net);
 void __net_exit fib4_rules_exit(struct net *net);
@@ -378,6 +383,10 @@ static inline bool fib4_rules_early_flow_dissect(struct net *net,
 	return true;
 }
 
+static inline bool fib4_has_custom_rules(const struct net *net)
+{
+	return net->ipv4.fib_has_custom_rules;
+}
 #endif /* CONFIG_IP_MULTIPLE_TABLES */
 
 /* Exported by fib_frontend.c */
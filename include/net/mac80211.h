@@ -120,6 +120,19 @@
  * In that callback the driver is therefore expected to release its own
  * buffered frames and afterwards also frames from the ieee80211_txq (obtained
  * via the usual ieee80211_tx_dequeue).
+ *
+ * Instead of scheduling the queues itself, the driver can let mac80211 pick
+ * the next queue to serve. For each AC it starts a scheduling round with
+ * ieee80211_txq_schedule_start(), then calls ieee80211_next_txq() until it
+ * returns %NULL or the hardware queue is full, dequeues frames from each
+ * returned txq and hands the txq back with ieee80211_return_txq(). Each txq
+ * is returned at most once per round.
+ *
+ * If the driver also sets %NL80211_EXT_FEATURE_AIRTIME_FAIRNESS and reports
+ * the airtime used by each frame (in the @tx_time field of the TX status, or
+ * via ieee80211_sta_register_airtime()), mac80211 schedules the stations in
+ * deficit round robin order on their airtime, so that a slow station can no
+ * longer take most of the medium time.
  */
 
 struct device;
@@ -941,6 +954,8 @@ ieee80211_rate_get_vht_nss(const struct ieee80211_tx_rate *rate)
  * @ampdu_len: number of aggregated frames.
  * 	relevant only if IEEE80211_TX_STAT_AMPDU was set.
  * @ack_signal: signal strength of the ACK frame
+ * @tx_time: airtime (in usecs) used for all transmission attempts of the
+ *	frame; used for airtime fair scheduling when set
  */
 struct ieee80211_tx_info {
 	/* common information */
@@ -6110,6 +6125,67 @@ void ieee80211_txq_get_depth(struct ieee80211_txq *txq,
 			     unsigned long *frame_cnt,
 			     unsigned long *byte_cnt);
 
+/**
+ * ieee80211_txq_schedule_start - start a new scheduling round for TXQs
+ *
+ * @hw: pointer as obtained from ieee80211_alloc_hw()
+ * @ac: AC number to start the round for
+ *
+ * Each txq is returned by ieee80211_next_txq() at most once per round, so the
+ * driver can loop until %NULL is returned without serving a queue twice.
+ */
+void ieee80211_txq_schedule_start(struct ieee80211_hw *hw, u8 ac);
+
+/**
+ * ieee80211_next_txq - get next tx queue to pull packets from
+ *
+ * @hw: pointer as obtained from ieee80211_alloc_hw()
+ * @ac: AC number to return packets from
+ *
+ * Returns the next txq that has frames queued, %NULL if there is none left
+ * in this scheduling round. With airtime fairness enabled, stations which
+ * used up their airtime deficit are skipped. A returned txq must be handed
+ * back with ieee80211_return_txq() when the driver is done with it.
+ */
+struct ieee80211_txq *ieee80211_next_txq(struct ieee80211_hw *hw, u8 ac);
+
+/**
+ * ieee80211_return_txq - return a txq obtained from ieee80211_next_txq()
+ *
+ * @hw: pointer as obtained from ieee80211_alloc_hw()
+ * @txq: the txq to return
+ *
+ * The txq is scheduled again if it still has frames queued.
+ */
+void ieee80211_return_txq(struct ieee80211_hw *hw, struct ieee80211_txq *txq);
+
+/**
+ * ieee80211_schedule_txq - schedule a txq for transmission
+ *
+ * @hw: pointer as obtained from ieee80211_alloc_hw()
+ * @txq: the txq to schedule
+ *
+ * mac80211 schedules a txq whenever it queues frames on it, so this is only
+ * needed by drivers which hold back frames of a txq themselves.
+ */
+void ieee80211_schedule_txq(struct ieee80211_hw *hw, struct ieee80211_txq *txq);
+
+/**
+ * ieee80211_sta_register_airtime - register airtime usage for a sta/tid
+ *
+ * @pubsta: the station
+ * @tid: the TID the airtime was used for
+ * @tx_airtime: airtime used during TX (in usecs)
+ * @rx_airtime: airtime used during RX (in usecs)
+ *
+ * Drivers which cannot report the airtime of each frame in the TX status
+ * can use this to report airtime usage directly, for example once per
+ * aggregate. Both values are added to the station's airtime statistics and
+ * charged against its scheduling deficit.
+ */
+void ieee80211_sta_register_airtime(struct ieee80211_sta *pubsta, u8 tid,
+				    u32 tx_airtime, u32 rx_airtime);
+
 /**
  * ieee80211_nan_func_terminated - notify about NAN function termination.
  *
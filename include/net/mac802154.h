@@ -80,6 +80,10 @@ struct ieee802154_hw_addr_filt {
  *	this structure.
  *
  * @phy: This points to the &struct wpan_phy allocated for this 802.15.4 PHY.
+ *
+ * @tx_queue_depth: number of frames the stack keeps ready while the
+ *	transceiver is busy, before it stops the netif queues. Zero selects
+ *	a default depth.
  */
 struct ieee802154_hw {
 	/* filled by the driver */
@@ -87,6 +91,7 @@ struct ieee802154_hw {
 	u32	flags;
 	struct	device *parent;
 	void	*priv;
+	u8	tx_queue_depth;
 
 	/* filled by mac802154 core */
 	struct	wpan_phy *phy;
@@ -473,7 +478,9 @@ void ieee802154_rx_irqsafe(struct ieee802154_hw *hw, struct sk_buff *skb,
  * ieee802154_wake_queue - wake ieee802154 queue
  * @hw: pointer as obtained from ieee802154_alloc_hw().
  *
- * Drivers should use this function instead of netif_wake_queue.
+ * Drivers should use this function instead of netif_wake_queue. It tells
+ * the stack that the transceiver is ready for the next frame, e.g. after
+ * a transmission failed.
  */
 void ieee802154_wake_queue(struct ieee802154_hw *hw);
 
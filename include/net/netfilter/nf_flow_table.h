@@ -10,6 +10,7 @@
 #include <net/dst.h>
 
 struct nf_flowtable;
+struct flow_offload_tuple_rhash;
 
 struct nf_flowtable_type {
 	struct list_head		list;
@@ -20,9 +21,17 @@ struct nf_flowtable_type {
 	struct module			*owner;
 };
 
+/* Last flow looked up on this CPU, valid as long as @gen matches. */
+struct nf_flow_cache {
+	struct flow_offload_tuple_rhash	*tuplehash;
+	unsigned int			gen;
+};
+
 struct nf_flowtable {
 	struct list_head		list;
 	struct rhashtable		rhashtable;
+	struct nf_flow_cache __percpu	*cache;
+	atomic_t			gen;
 	const struct nf_flowtable_type	*type;
 	struct delayed_work		gc_work;
 };
@@ -47,6 +56,11 @@ struct flow_offload_tuple {
 		__be16			dst_port;
 	};
 
+	struct {
+		u16			id;
+		__be16			proto;
+	} encap;
+
 	int				iifidx;
 
 	u8				l3proto;
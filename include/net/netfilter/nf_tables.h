@@ -15,6 +15,8 @@
 
 #define NFT_JUMP_STACK_SIZE	16
 
+#define NFT_REG32_COUNT		(NFT_REG32_15 - NFT_REG32_00 + 1)
+
 struct nft_pktinfo {
 	struct sk_buff			*skb;
 	bool				tprot_set;
@@ -217,6 +219,7 @@ struct nft_userdata {
  *	struct nft_set_elem - generic representation of set elements
  *
  *	@key: element key
+ *	@key_end: closing element key
  *	@priv: element private data and extensions
  */
 struct nft_set_elem {
@@ -224,6 +227,10 @@ struct nft_set_elem {
 		u32		buf[NFT_DATA_VALUE_MAXLEN / sizeof(u32)];
 		struct nft_data	val;
 	} key;
+	union {
+		u32		buf[NFT_DATA_VALUE_MAXLEN / sizeof(u32)];
+		struct nft_data	val;
+	} key_end;
 	void			*priv;
 };
 
@@ -245,11 +252,15 @@ struct nft_set_iter {
  *	@klen: key length
  *	@dlen: data length
  *	@size: number of set elements
+ *	@field_len: length of each field in concatenation, bytes
+ *	@field_count: number of concatenated fields in element
  */
 struct nft_set_desc {
 	unsigned int		klen;
 	unsigned int		dlen;
 	unsigned int		size;
+	u8			field_len[NFT_REG32_COUNT];
+	u8			field_count;
 };
 
 /**
@@ -258,11 +269,13 @@ struct nft_set_desc {
  *	@NFT_LOOKUP_O_1: constant, O(1)
  *	@NFT_LOOKUP_O_LOG_N: logarithmic, O(log N)
  *	@NFT_LOOKUP_O_N: linear, O(N)
+ *	@NFT_LOOKUP_O_N2: quadratic, O(N^2)
  */
 enum nft_set_class {
 	NFT_SET_CLASS_O_1,
 	NFT_SET_CLASS_O_LOG_N,
 	NFT_SET_CLASS_O_N,
+	NFT_SET_CLASS_O_N2,
 };
 
 /**
@@ -291,6 +304,7 @@ struct nft_expr;
  *	@deactivate: lookup for element and deactivate it in the next generation
  *	@flush: deactivate element in the next generation
  *	@remove: remove element from set
+ *	@commit: make the changes of a committed transaction visible to lookups
  *	@walk: iterate over all set elemeennts
  *	@get: get set elements
  *	@privsize: function to return size of set private data
@@ -328,6 +342,7 @@ struct nft_set_ops {
 	void				(*remove)(const struct net *net,
 						  const struct nft_set *set,
 						  const struct nft_set_elem *elem);
+	void				(*commit)(const struct nft_set *set);
 	void				(*walk)(const struct nft_ctx *ctx,
 						struct nft_set *set,
 						struct nft_set_iter *iter);
@@ -384,6 +399,7 @@ void nft_unregister_set(struct nft_set_type *type);
  * 	@size: maximum set size
  * 	@nelems: number of elements
  * 	@ndeact: number of deactivated elements queued for removal
+ *	@pending_update: list of sets with changes to commit
  *	@timeout: default timeout value in jiffies
  * 	@gc_int: garbage collection interval in msecs
  *	@policy: set parameterization (see enum nft_set_policies)
@@ -394,6 +410,8 @@ void nft_unregister_set(struct nft_set_type *type);
  *	@genmask: generation mask
  * 	@klen: key length
  * 	@dlen: data length
+ *	@field_count: number of concatenated fields in element
+ *	@field_len: length of each field in concatenation, bytes
  * 	@data: private set data
  */
 struct nft_set {
@@ -409,6 +427,7 @@ struct nft_set {
 	u32				size;
 	atomic_t			nelems;
 	u32				ndeact;
+	struct list_head		pending_update;
 	u64				timeout;
 	u32				gc_int;
 	u16				policy;
@@ -420,6 +439,8 @@ struct nft_set {
 					genmask:2;
 	u8				klen;
 	u8				dlen;
+	u8				field_count;
+	u8				field_len[NFT_REG32_COUNT];
 	unsigned char			data[]
 		__attribute__((aligned(__alignof__(u64))));
 };
@@ -478,6 +499,7 @@ void nf_tables_destroy_set(const struct nft_ctx *ctx, struct nft_set *set);
  *	enum nft_set_extensions - set extension type IDs
  *
  *	@NFT_SET_EXT_KEY: element key
+ *	@NFT_SET_EXT_KEY_END: upper bound element key, for ranges
  *	@NFT_SET_EXT_DATA: mapping data
  *	@NFT_SET_EXT_FLAGS: element flags
  *	@NFT_SET_EXT_TIMEOUT: element timeout
@@ -489,6 +511,7 @@ void nf_tables_destroy_set(const struct nft_ctx *ctx, struct nft_set *set);
  */
 enum nft_set_extensions {
 	NFT_SET_EXT_KEY,
+	NFT_SET_EXT_KEY_END,
 	NFT_SET_EXT_DATA,
 	NFT_SET_EXT_FLAGS,
 	NFT_SET_EXT_TIMEOUT,
@@ -582,6 +605,11 @@ static inline struct nft_data *nft_set_ext_key(const struct nft_set_ext *ext)
 	return nft_set_ext(ext, NFT_SET_EXT_KEY);
 }
 
+static inline struct nft_data *nft_set_ext_key_end(const struct nft_set_ext *ext)
+{
+	return nft_set_ext(ext, NFT_SET_EXT_KEY_END);
+}
+
 static inline struct nft_data *nft_set_ext_data(const struct nft_set_ext *ext)
 {
 	return nft_set_ext(ext, NFT_SET_EXT_DATA);
@@ -631,8 +659,8 @@ static inline struct nft_object **nft_set_ext_obj(const struct nft_set_ext *ext)
 
 void *nft_set_elem_init(const struct nft_set *set,
 			const struct nft_set_ext_tmpl *tmpl,
-			const u32 *key, const u32 *data,
-			u64 timeout, gfp_t gfp);
+			const u32 *key, const u32 *key_end,
+			const u32 *data, u64 timeout, gfp_t gfp);
 void nft_set_elem_destroy(const struct nft_set *set, void *elem,
 			  bool destroy_expr);
 
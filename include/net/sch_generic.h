@@ -10,6 +10,8 @@
 #include <linux/percpu.h>
 #include <linux/dynamic_queue_limits.h>
 #include <linux/list.h>
+#include <linux/llist.h>
+#include <linux/cpumask.h>
 #include <linux/refcount.h>
 #include <linux/workqueue.h>
 #include <net/gen_stats.h>
@@ -52,6 +54,22 @@ struct qdisc_skb_head {
 	spinlock_t	lock;
 };
 
+/* Per-CPU staging of packets for TCQ_F_NOLOCK qdiscs whose enqueue needs
+ * to touch shared state (flows, tins, shaper).  Enqueue only links the
+ * skb on a lock-free list of the local CPU; the CPU owning the qdisc
+ * running bit drains all lists in one batch before dequeueing.  The
+ * number and truesize of staged packets are shared by all CPUs, so that
+ * they stay within the room the qdisc has left.
+ */
+struct qdisc_stage {
+	struct llist_head __percpu *lists;
+	cpumask_var_t		pending;	/* CPUs with staged packets */
+	atomic_t		qlen;
+	atomic_long_t		memory;
+	atomic_t		overlimits;	/* packets refused for lack of room */
+	bool			congested;	/* drain dropped packets */
+};
+
 struct Qdisc {
 	int 			(*enqueue)(struct sk_buff *skb,
 					   struct Qdisc *sch,
@@ -89,6 +107,7 @@ struct Qdisc {
 	struct net_rate_estimator __rcu *rate_est;
 	struct gnet_stats_basic_cpu __percpu *cpu_bstats;
 	struct gnet_stats_queue	__percpu *cpu_qstats;
+	struct qdisc_stage	*stage;
 	int			padded;
 	refcount_t		refcnt;
 
@@ -152,11 +171,25 @@ static inline bool qdisc_run_begin(struct Qdisc *qdisc)
 	return true;
 }
 
+/* A packet staged after the last drain, by a CPU that then failed to
+ * take the seqlock, is left to the CPU releasing it.
+ */
+static inline void qdisc_stage_recheck(struct Qdisc *qdisc)
+{
+	/* pairs with smp_mb__after_atomic() in qdisc_stage_add() */
+	smp_mb();
+	if (unlikely(!cpumask_empty(qdisc->stage->pending)))
+		__netif_schedule(qdisc);
+}
+
 static inline void qdisc_run_end(struct Qdisc *qdisc)
 {
 	write_seqcount_end(&qdisc->running);
-	if (qdisc->flags & TCQ_F_NOLOCK)
+	if (qdisc->flags & TCQ_F_NOLOCK) {
 		spin_unlock(&qdisc->seqlock);
+		if (qdisc->stage)
+			qdisc_stage_recheck(qdisc);
+	}
 }
 
 static inline bool qdisc_may_bulk(const struct Qdisc *qdisc)
@@ -843,6 +876,11 @@ static inline void qdisc_qstats_overlimit(struct Qdisc *sch)
 	sch->qstats.overlimits++;
 }
 
+static inline void qdisc_qstats_cpu_overlimit(struct Qdisc *sch)
+{
+	this_cpu_inc(sch->cpu_qstats->overlimits);
+}
+
 static inline void qdisc_skb_head_init(struct qdisc_skb_head *qh)
 {
 	qh->head = NULL;
@@ -1155,6 +1193,66 @@ void mini_qdisc_pair_swap(struct mini_Qdisc_pair *miniqp,
 void mini_qdisc_pair_init(struct mini_Qdisc_pair *miniqp, struct Qdisc *qdisc,
 			  struct mini_Qdisc __rcu **p_miniq);
 
+int qdisc_stage_init(struct Qdisc *sch, struct qdisc_stage *stage);
+void qdisc_stage_destroy(struct Qdisc *sch, struct qdisc_stage *stage);
+struct llist_node *qdisc_stage_drain(struct qdisc_stage *stage);
+void qdisc_stage_purge(struct qdisc_stage *stage);
+
+/* Stage @skb on the local CPU unless the packets staged on all CPUs
+ * would exceed @limit packets or @mem_limit bytes of truesize.
+ * Must be called with BH disabled.
+ */
+static inline bool qdisc_stage_add(struct qdisc_stage *stage,
+				   struct sk_buff *skb, unsigned int limit,
+				   unsigned long mem_limit)
+{
+	if (unlikely(atomic_inc_return(&stage->qlen) > limit))
+		goto overlimit;
+
+	if (unlikely(atomic_long_add_return(skb->truesize, &stage->memory) >
+		     mem_limit)) {
+		atomic_long_sub(skb->truesize, &stage->memory);
+		goto overlimit;
+	}
+
+	if (llist_add(&skb->ll_node, this_cpu_ptr(stage->lists))) {
+		cpumask_set_cpu(smp_processor_id(), stage->pending);
+		/* pairs with smp_mb() in qdisc_stage_recheck() */
+		smp_mb__after_atomic();
+	}
+
+	return true;
+
+overlimit:
+	atomic_dec(&stage->qlen);
+	atomic_inc(&stage->overlimits);
+	return false;
+}
+
+/* Return code of a staged enqueue. A packet dropped at drain time can no
+ * longer report NET_XMIT_CN to its own sender, so the next enqueue after
+ * such a drop reports it instead.
+ */
+static inline int qdisc_stage_xmit_ret(struct qdisc_stage *stage)
+{
+	if (unlikely(READ_ONCE(stage->congested))) {
+		WRITE_ONCE(stage->congested, false);
+		return NET_XMIT_CN;
+	}
+
+	return NET_XMIT_SUCCESS;
+}
+
+/* Give back the room of packets taken off the stage by
+ * qdisc_stage_drain(), once they are accounted by the qdisc.
+ */
+static inline void qdisc_stage_release(struct qdisc_stage *stage,
+				       unsigned int qlen, unsigned long memory)
+{
+	atomic_sub(qlen, &stage->qlen);
+	atomic_long_sub(memory, &stage->memory);
+}
+
 static inline void skb_tc_reinsert(struct sk_buff *skb, struct tcf_result *res)
 {
 	struct gnet_stats_queue *stats = res->qstats;
@@ -21,6 +21,10 @@ struct sock_reuseport {
 	unsigned int		synq_overflow_ts;
 	/* ID stays the same even after the size of socks[] grows. */
 	unsigned int		reuseport_id;
+	/* Number of socks[] with SO_INCOMING_CPU set; when non-zero the
+	 * sock bound to the receiving cpu is preferred over the hash.
+	 */
+	unsigned int		incoming_cpu;
 	bool			bind_inany;
 	struct bpf_prog __rcu	*prog;		/* optional BPF sock selector */
 	struct sock		*socks[0];	/* array of sock pointers */
@@ -30,6 +34,7 @@ extern int reuseport_alloc(struct sock *sk, bool bind_inany);
 extern int reuseport_add_sock(struct sock *sk, struct sock *sk2,
 			      bool bind_inany);
 extern void reuseport_detach_sock(struct sock *sk);
+extern void reuseport_update_incoming_cpu(struct sock *sk, int val);
 extern struct sock *reuseport_select_sock(struct sock *sk,
 					  u32 hash,
 					  struct sk_buff *skb,
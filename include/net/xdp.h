@@ -61,6 +61,7 @@ struct xdp_rxq_info {
 	u32 queue_index;
 	u32 reg_state;
 	struct xdp_mem_info mem;
+	unsigned int napi_id; /* Set by drivers supporting busy polling */
 } ____cacheline_aligned; /* perf critical, avoid false-sharing */
 
 struct xdp_buff {
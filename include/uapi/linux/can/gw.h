@@ -80,6 +80,8 @@ enum {
 	CGW_DELETED,	/* number of deleted CAN frames (see max_hops param) */
 	CGW_LIM_HOPS,	/* limit the number of hops of this specific rule */
 	CGW_MOD_UID,	/* user defined identifier for modification updates */
+	CGW_MOD_BPF_FD,	/* BPF program run on the CAN frame (create only) */
+	CGW_MOD_BPF_ID,	/* id of the BPF program above (dump only) */
 	__CGW_MAX
 };
 
@@ -168,6 +170,13 @@ enum {
  * Optional non-zero user defined routing job identifier to alter existing
  * modification settings at runtime.
  *
+ * CGW_MOD_BPF_FD (length 4 bytes):
+ * File descriptor of a BPF_PROG_TYPE_SCHED_ACT program that is run on the
+ * CAN frame after the AND/OR/XOR/SET modifications and before the checksum
+ * calculations. The program may rewrite the frame through direct packet
+ * access. Returning TC_ACT_SHOT drops the frame. Dumps report the program
+ * id in CGW_MOD_BPF_ID instead.
+ *
  * CGW_CS_XOR (length 4 bytes):
  * Set a simple XOR checksum starting with an initial value into
  * data[result-idx] using data[start-idx] .. data[end-idx]
@@ -16,6 +16,19 @@
 #define XDP_SHARED_UMEM	(1 << 0)
 #define XDP_COPY	(1 << 1) /* Force copy-mode */
 #define XDP_ZEROCOPY	(1 << 2) /* Force zero-copy mode */
+/* If this option is set, the driver might go sleep and in that case
+ * the XDP_RING_NEED_WAKEUP flag in the fill and/or Tx rings will be
+ * set. If it is set, the application need to explicitly wake up the
+ * driver with a poll() (Rx and Tx) or sendto() (Tx only). If you are
+ * running the driver and the application on the same core, you should
+ * use this option so that the kernel will yield to the user space
+ * application.
+ */
+#define XDP_USE_NEED_WAKEUP (1 << 3)
+/* Allow packets larger than one umem chunk. Such packets are carried in
+ * a chain of descriptors, see XDP_PKT_CONTD. Copy mode only.
+ */
+#define XDP_USE_SG	(1 << 4)
 
 struct sockaddr_xdp {
 	__u16 sxdp_family;
@@ -29,6 +42,7 @@ struct xdp_ring_offset {
 	__u64 producer;
 	__u64 consumer;
 	__u64 desc;
+	__u64 flags;
 };
 
 struct xdp_mmap_offsets {
@@ -60,6 +74,9 @@ struct xdp_statistics {
 	__u64 tx_invalid_descs; /* Dropped due to invalid descriptor */
 };
 
+/* Flags for the flags field of struct xdp_ring */
+#define XDP_RING_NEED_WAKEUP (1 << 0)
+
 /* Pgoff for mmaping the rings */
 #define XDP_PGOFF_RX_RING			  0
 #define XDP_PGOFF_TX_RING		 0x80000000
@@ -73,6 +90,13 @@ struct xdp_desc {
 	__u32 options;
 };
 
+/* Flag in the options field of struct xdp_desc, only used with
+ * XDP_USE_SG. It indicates that the packet continues in the buffer of
+ * the next descriptor in the ring. The last descriptor of a packet has
+ * it cleared, so single buffer packets look exactly as before.
+ */
+#define XDP_PKT_CONTD (1 << 0)
+
 /* UMEM descriptor is __u64 */
 
 #endif /* _LINUX_IF_XDP_H */
@@ -960,6 +960,7 @@ struct tc_etf_qopt {
 	__u32 flags;
 #define TC_ETF_DEADLINE_MODE_ON	BIT(0)
 #define TC_ETF_OFFLOAD_ON	BIT(1)
+#define TC_ETF_SKIP_SOCK_CHECK	BIT(2)
 };
 
 enum {
@@ -1125,9 +1126,22 @@ enum {
 	TCA_TAPRIO_ATTR_SCHED_SINGLE_ENTRY, /* single entry */
 	TCA_TAPRIO_ATTR_SCHED_CLOCKID, /* s32 */
 	TCA_TAPRIO_PAD,
+	TCA_TAPRIO_ATTR_FLAGS, /* u32 */
+	TCA_TAPRIO_ATTR_TXTIME_DELAY, /* u32 */
 	__TCA_TAPRIO_ATTR_MAX,
 };
 
+/* In txtime-assist mode taprio does not gate the queues itself: every
+ * packet gets a launch time (skb->tstamp) inside the next window where
+ * its traffic class is open, and is sent at that time by an ETF child
+ * or by the device's LaunchTime support.  TXTIME_DELAY (ns) is how far
+ * ahead of "now" the earliest launch time is placed.  An ETF child must
+ * be configured with TC_ETF_SKIP_SOCK_CHECK, packets from sockets without
+ * SO_TXTIME are dropped by it otherwise.  Packets from SO_TXTIME sockets
+ * using a different clock than the schedule are dropped.
+ */
+#define TCA_TAPRIO_ATTR_FLAG_TXTIME_ASSIST	BIT(0)
+
 #define TCA_TAPRIO_ATTR_MAX (__TCA_TAPRIO_ATTR_MAX - 1)
 
 #endif
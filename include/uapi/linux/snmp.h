@@ -282,6 +282,9 @@ enum
 	LINUX_MIB_TCPACKCOMPRESSED,		/* TCPAckCompressed */
 	LINUX_MIB_TCPZEROWINDOWDROP,		/* TCPZeroWindowDrop */
 	LINUX_MIB_TCPRCVQDROP,			/* TCPRcvQDrop */
+	LINUX_MIB_TCPIDLESHRINK,		/* TCPIdleShrink */
+	LINUX_MIB_REUSEPORTINCOMINGCPU,		/* ReusePortIncomingCPU */
+	LINUX_MIB_REUSEPORTINCOMINGCPUMISS,	/* ReusePortIncomingCPUMiss */
 	__LINUX_MIB_MAX
 };
 
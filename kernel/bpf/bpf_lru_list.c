@@ -30,6 +30,17 @@ static int get_next_cpu(int cpu)
 	return cpu;
 }
 
+/* Returns the LRU list (eviction domain) owned by @cpu */
+static struct bpf_lru_list *bpf_common_lru_list(struct bpf_lru *lru, int cpu)
+{
+	struct bpf_common_lru *clru = &lru->common_lru;
+
+	if (clru->shards)
+		return per_cpu_ptr(clru->shards, cpu);
+
+	return &clru->lru_list;
+}
+
 /* Local list helpers */
 static struct list_head *local_free_list(struct bpf_lru_locallist *loc_l)
 {
@@ -318,16 +329,23 @@ static void bpf_lru_list_push_free(struct bpf_lru_list *l,
 	raw_spin_unlock_irqrestore(&l->lock, flags);
 }
 
+/* Refill the local free list with up to lru->free_target nodes taken
+ * from the free list of @l.  The pending nodes of @loc_l are only
+ * flushed into @l when it is the LRU list of the local CPU.  If @shrink
+ * is set, the remaining nodes are evicted from @l in one batch.
+ */
 static void bpf_lru_list_pop_free_to_local(struct bpf_lru *lru,
-					   struct bpf_lru_locallist *loc_l)
+					   struct bpf_lru_list *l,
+					   struct bpf_lru_locallist *loc_l,
+					   bool flush, bool shrink)
 {
-	struct bpf_lru_list *l = &lru->common_lru.lru_list;
 	struct bpf_lru_node *node, *tmp_node;
 	unsigned int nfree = 0;
 
 	raw_spin_lock(&l->lock);
 
-	__local_list_flush(l, loc_l);
+	if (flush)
+		__local_list_flush(l, loc_l);
 
 	__bpf_lru_list_rotate(lru, l);
 
@@ -335,18 +353,68 @@ static void bpf_lru_list_pop_free_to_local(struct bpf_lru *lru,
 				 list) {
 		__bpf_lru_node_move_to_free(l, node, local_free_list(loc_l),
 					    BPF_LRU_LOCAL_LIST_T_FREE);
-		if (++nfree == LOCAL_FREE_TARGET)
+		if (++nfree == lru->free_target)
 			break;
 	}
 
-	if (nfree < LOCAL_FREE_TARGET)
-		__bpf_lru_list_shrink(lru, l, LOCAL_FREE_TARGET - nfree,
+	if (shrink && nfree < lru->free_target)
+		__bpf_lru_list_shrink(lru, l, lru->free_target - nfree,
 				      local_free_list(loc_l),
 				      BPF_LRU_LOCAL_LIST_T_FREE);
 
 	raw_spin_unlock(&l->lock);
 }
 
+/* Refill from the shards of the other CPUs in RR, starting with the
+ * loc_l->next_steal CPU.  Without @shrink, shards that look like they
+ * have no free node are skipped without taking their lock.
+ */
+static void bpf_lru_shards_pop_free_to_local(struct bpf_lru *lru,
+					     struct bpf_lru_locallist *loc_l,
+					     int cpu, bool shrink)
+{
+	struct bpf_lru_list *l;
+	int steal, first_steal;
+
+	first_steal = loc_l->next_steal;
+	steal = first_steal;
+	do {
+		l = per_cpu_ptr(lru->common_lru.shards, steal);
+		if (steal != cpu &&
+		    (shrink || !list_empty(&l->lists[BPF_LRU_LIST_T_FREE])))
+			bpf_lru_list_pop_free_to_local(lru, l, loc_l, false,
+						       shrink);
+		steal = get_next_cpu(steal);
+	} while (list_empty(local_free_list(loc_l)) && steal != first_steal);
+
+	loc_l->next_steal = steal;
+}
+
+/* A sharded LRU refills a CPU in this order:
+ * 1. Free nodes of its own shard
+ * 2. Free nodes of the other shards, so that the whole map capacity
+ *    can be used before anything is evicted
+ * 3. Evict a batch from its own shard
+ * 4. Evict a batch from the other shards
+ *
+ * Only the shard of the local CPU is touched in the steady state,
+ * so CPUs inserting into a full map do not contend with each other.
+ */
+static void bpf_sharded_lru_pop_free_to_local(struct bpf_lru *lru,
+					      struct bpf_lru_locallist *loc_l,
+					      int cpu)
+{
+	struct bpf_lru_list *l = bpf_common_lru_list(lru, cpu);
+
+	bpf_lru_list_pop_free_to_local(lru, l, loc_l, true, false);
+	if (list_empty(local_free_list(loc_l)))
+		bpf_lru_shards_pop_free_to_local(lru, loc_l, cpu, false);
+	if (list_empty(local_free_list(loc_l)))
+		bpf_lru_list_pop_free_to_local(lru, l, loc_l, false, true);
+	if (list_empty(local_free_list(loc_l)))
+		bpf_lru_shards_pop_free_to_local(lru, loc_l, cpu, true);
+}
+
 static void __local_list_add_pending(struct bpf_lru *lru,
 				     struct bpf_lru_locallist *loc_l,
 				     int cpu,
@@ -447,7 +515,11 @@ static struct bpf_lru_node *bpf_common_lru_pop_free(struct bpf_lru *lru,
 
 	node = __local_list_pop_free(loc_l);
 	if (!node) {
-		bpf_lru_list_pop_free_to_local(lru, loc_l);
+		if (clru->shards)
+			bpf_sharded_lru_pop_free_to_local(lru, loc_l, cpu);
+		else
+			bpf_lru_list_pop_free_to_local(lru, &clru->lru_list,
+						       loc_l, true, true);
 		node = __local_list_pop_free(loc_l);
 	}
 
@@ -460,7 +532,7 @@ static struct bpf_lru_node *bpf_common_lru_pop_free(struct bpf_lru *lru,
 		return node;
 
 	/* No free nodes found from the local free list and
-	 * the global LRU list.
+	 * the global (or any sharded) LRU list.
 	 *
 	 * Steal from the local free/pending list of the
 	 * current CPU and remote CPU in RR.  It starts
@@ -532,7 +604,8 @@ static void bpf_common_lru_push_free(struct bpf_lru *lru,
 	}
 
 check_lru_list:
-	bpf_lru_list_push_free(&lru->common_lru.lru_list, node);
+	/* Nodes are flushed into the LRU list of the CPU that added them */
+	bpf_lru_list_push_free(bpf_common_lru_list(lru, node->cpu), node);
 }
 
 static void bpf_percpu_lru_push_free(struct bpf_lru *lru,
@@ -576,6 +649,32 @@ static void bpf_common_lru_populate(struct bpf_lru *lru, void *buf,
 	}
 }
 
+/* Spread the free nodes evenly over the shards.  Unlike the percpu
+ * LRU, the number of nodes does not have to be a multiple of the
+ * number of CPUs, since the nodes can later move between the shards.
+ */
+static void bpf_sharded_lru_populate(struct bpf_lru *lru, void *buf,
+				     u32 node_offset, u32 elem_size,
+				     u32 nr_elems)
+{
+	int cpu = cpumask_first(cpu_possible_mask);
+	struct bpf_lru_list *l;
+	u32 i;
+
+	for (i = 0; i < nr_elems; i++) {
+		struct bpf_lru_node *node;
+
+		l = per_cpu_ptr(lru->common_lru.shards, cpu);
+		node = (struct bpf_lru_node *)(buf + node_offset);
+		node->cpu = cpu;
+		node->type = BPF_LRU_LIST_T_FREE;
+		node->ref = 0;
+		list_add(&node->list, &l->lists[BPF_LRU_LIST_T_FREE]);
+		buf += elem_size;
+		cpu = get_next_cpu(cpu);
+	}
+}
+
 static void bpf_percpu_lru_populate(struct bpf_lru *lru, void *buf,
 				    u32 node_offset, u32 elem_size,
 				    u32 nr_elems)
@@ -613,6 +712,9 @@ void bpf_lru_populate(struct bpf_lru *lru, void *buf, u32 node_offset,
 	if (lru->percpu)
 		bpf_percpu_lru_populate(lru, buf, node_offset, elem_size,
 					nr_elems);
+	else if (lru->common_lru.shards)
+		bpf_sharded_lru_populate(lru, buf, node_offset, elem_size,
+					 nr_elems);
 	else
 		bpf_common_lru_populate(lru, buf, node_offset, elem_size,
 					nr_elems);
@@ -645,8 +747,9 @@ static void bpf_lru_list_init(struct bpf_lru_list *l)
 	raw_spin_lock_init(&l->lock);
 }
 
-int bpf_lru_init(struct bpf_lru *lru, bool percpu, u32 hash_offset,
-		 del_from_htab_func del_from_htab, void *del_arg)
+int bpf_lru_init(struct bpf_lru *lru, bool percpu, bool sharded, u32 batch,
+		 u32 hash_offset, del_from_htab_func del_from_htab,
+		 void *del_arg)
 {
 	int cpu;
 
@@ -669,6 +772,19 @@ int bpf_lru_init(struct bpf_lru *lru, bool percpu, u32 hash_offset,
 		if (!clru->local_list)
 			return -ENOMEM;
 
+		clru->shards = NULL;
+		if (sharded) {
+			clru->shards = alloc_percpu(struct bpf_lru_list);
+			if (!clru->shards) {
+				free_percpu(clru->local_list);
+				return -ENOMEM;
+			}
+
+			for_each_possible_cpu(cpu)
+				bpf_lru_list_init(per_cpu_ptr(clru->shards,
+							      cpu));
+		}
+
 		for_each_possible_cpu(cpu) {
 			struct bpf_lru_locallist *loc_l;
 
@@ -677,7 +793,13 @@ int bpf_lru_init(struct bpf_lru *lru, bool percpu, u32 hash_offset,
 		}
 
 		bpf_lru_list_init(&clru->lru_list);
-		lru->nr_scans = LOCAL_NR_SCANS;
+		/* A larger batch refills (and evicts) more nodes per trip
+		 * to the LRU list, trading LRU accuracy for fewer lock
+		 * acquisitions.
+		 */
+		lru->free_target = batch ? : LOCAL_FREE_TARGET;
+		lru->nr_scans = max_t(unsigned int, lru->free_target,
+				      LOCAL_NR_SCANS);
 	}
 
 	lru->percpu = percpu;
@@ -690,8 +812,10 @@ int bpf_lru_init(struct bpf_lru *lru, bool percpu, u32 hash_offset,
 
 void bpf_lru_destroy(struct bpf_lru *lru)
 {
-	if (lru->percpu)
+	if (lru->percpu) {
 		free_percpu(lru->percpu_lru);
-	else
+	} else {
+		free_percpu(lru->common_lru.shards);
 		free_percpu(lru->common_lru.local_list);
+	}
 }
@@ -14,6 +14,7 @@
 #define NR_BPF_LRU_LIST_COUNT	(2)
 #define NR_BPF_LRU_LOCAL_LIST_T (2)
 #define BPF_LOCAL_LIST_T_OFFSET NR_BPF_LRU_LIST_T
+#define BPF_LRU_MAX_BATCH	(1024)
 
 enum bpf_lru_list_type {
 	BPF_LRU_LIST_T_ACTIVE,
@@ -47,6 +48,8 @@ struct bpf_lru_locallist {
 
 struct bpf_common_lru {
 	struct bpf_lru_list lru_list;
+	/* Per-CPU eviction domains replacing lru_list, NULL if not sharded */
+	struct bpf_lru_list __percpu *shards;
 	struct bpf_lru_locallist __percpu *local_list;
 };
 
@@ -61,6 +64,7 @@ struct bpf_lru {
 	void *del_arg;
 	unsigned int hash_offset;
 	unsigned int nr_scans;
+	unsigned int free_target;
 	bool percpu;
 };
 
@@ -73,8 +77,9 @@ static inline void bpf_lru_node_set_ref(struct bpf_lru_node *node)
 		node->ref = 1;
 }
 
-int bpf_lru_init(struct bpf_lru *lru, bool percpu, u32 hash_offset,
-		 del_from_htab_func del_from_htab, void *delete_arg);
+int bpf_lru_init(struct bpf_lru *lru, bool percpu, bool sharded, u32 batch,
+		 u32 hash_offset, del_from_htab_func del_from_htab,
+		 void *delete_arg);
 void bpf_lru_populate(struct bpf_lru *lru, void *buf, u32 node_offset,
 		      u32 elem_size, u32 nr_elems);
 void bpf_lru_destroy(struct bpf_lru *lru);
@@ -15,6 +15,8 @@ static inline bool lowpan_is_ll(const struct net_device *dev,
 
 extern const struct ndisc_ops lowpan_ndisc_ops;
 
+void lowpan_iphc_ctx_table_update(struct lowpan_iphc_ctx_table *t);
+
 int addrconf_ifid_802154_6lowpan(u8 *eui, struct net_device *dev);
 
 #ifdef CONFIG_6LOWPAN_DEBUGFS
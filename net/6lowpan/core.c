@@ -139,9 +139,12 @@ static int lowpan_event(struct notifier_block *unused,
 		}
 		break;
 	case NETDEV_DOWN:
+		spin_lock_bh(&lowpan_dev(dev)->ctx.lock);
 		for (i = 0; i < LOWPAN_IPHC_CTX_TABLE_SIZE; i++)
 			clear_bit(LOWPAN_IPHC_CTX_FLAG_ACTIVE,
 				  &lowpan_dev(dev)->ctx.table[i].flags);
+		lowpan_iphc_ctx_table_update(&lowpan_dev(dev)->ctx);
+		spin_unlock_bh(&lowpan_dev(dev)->ctx.lock);
 		break;
 	default:
 		return NOTIFY_DONE;
@@ -23,14 +23,20 @@ static struct dentry *lowpan_debugfs;
 static int lowpan_ctx_flag_active_set(void *data, u64 val)
 {
 	struct lowpan_iphc_ctx *ctx = data;
+	struct lowpan_iphc_ctx_table *t =
+		container_of(ctx, struct lowpan_iphc_ctx_table, table[ctx->id]);
 
 	if (val != 0 && val != 1)
 		return -EINVAL;
 
+	spin_lock_bh(&t->lock);
 	if (val)
 		set_bit(LOWPAN_IPHC_CTX_FLAG_ACTIVE, &ctx->flags);
 	else
 		clear_bit(LOWPAN_IPHC_CTX_FLAG_ACTIVE, &ctx->flags);
+	ctx->expires = 0;
+	lowpan_iphc_ctx_table_update(t);
+	spin_unlock_bh(&t->lock);
 
 	return 0;
 }
@@ -48,14 +54,19 @@ DEFINE_SIMPLE_ATTRIBUTE(lowpan_ctx_flag_active_fops,
 static int lowpan_ctx_flag_c_set(void *data, u64 val)
 {
 	struct lowpan_iphc_ctx *ctx = data;
+	struct lowpan_iphc_ctx_table *t =
+		container_of(ctx, struct lowpan_iphc_ctx_table, table[ctx->id]);
 
 	if (val != 0 && val != 1)
 		return -EINVAL;
 
+	spin_lock_bh(&t->lock);
 	if (val)
 		set_bit(LOWPAN_IPHC_CTX_FLAG_COMPRESSION, &ctx->flags);
 	else
 		clear_bit(LOWPAN_IPHC_CTX_FLAG_COMPRESSION, &ctx->flags);
+	lowpan_iphc_ctx_table_update(t);
+	spin_unlock_bh(&t->lock);
 
 	return 0;
 }
@@ -80,6 +91,7 @@ static int lowpan_ctx_plen_set(void *data, u64 val)
 
 	spin_lock_bh(&t->lock);
 	ctx->plen = val;
+	lowpan_iphc_ctx_table_update(t);
 	spin_unlock_bh(&t->lock);
 
 	return 0;
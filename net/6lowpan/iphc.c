@@ -197,68 +197,87 @@ lowpan_iphc_ctx_get_by_id(const struct net_device *dev, u8 id)
 	return ret;
 }
 
+/* Rebuilds the list of contexts usable for compression, sorted by
+ * descending prefix length, so that the first match of a lookup is the
+ * longest one. Must be called with t->lock held after any change of the
+ * flags or the prefix length of a context.
+ */
+void lowpan_iphc_ctx_table_update(struct lowpan_iphc_ctx_table *t)
+{
+	int i, j, n = 0;
+
+	for (i = 0; i < LOWPAN_IPHC_CTX_TABLE_SIZE; i++) {
+		/* Check if context is valid. A context that is not valid
+		 * MUST NOT be used for compression.
+		 */
+		if (!lowpan_iphc_ctx_is_active(&t->table[i]) ||
+		    !lowpan_iphc_ctx_is_compression(&t->table[i]))
+			continue;
+
+		for (j = n; j > 0 &&
+		     t->table[t->cmp_order[j - 1]].plen < t->table[i].plen; j--)
+			t->cmp_order[j] = t->cmp_order[j - 1];
+		t->cmp_order[j] = i;
+		n++;
+	}
+
+	WRITE_ONCE(t->cmp_num, n);
+}
+
+static bool lowpan_iphc_ctx_is_expired(const struct lowpan_iphc_ctx *ctx)
+{
+	return ctx->expires && time_after(jiffies, ctx->expires);
+}
+
 static struct lowpan_iphc_ctx *
 lowpan_iphc_ctx_get_by_addr(const struct net_device *dev,
 			    const struct in6_addr *addr)
 {
-	struct lowpan_iphc_ctx *table = lowpan_dev(dev)->ctx.table;
-	struct lowpan_iphc_ctx *ret = NULL;
+	struct lowpan_iphc_ctx_table *t = &lowpan_dev(dev)->ctx;
+	struct lowpan_iphc_ctx *ctx;
 	struct in6_addr addr_pfx;
 	u8 addr_plen;
 	int i;
 
-	for (i = 0; i < LOWPAN_IPHC_CTX_TABLE_SIZE; i++) {
-		/* Check if context is valid. A context that is not valid
-		 * MUST NOT be used for compression.
-		 */
-		if (!lowpan_iphc_ctx_is_active(&table[i]) ||
-		    !lowpan_iphc_ctx_is_compression(&table[i]))
+	for (i = 0; i < t->cmp_num; i++) {
+		ctx = &t->table[t->cmp_order[i]];
+		if (lowpan_iphc_ctx_is_expired(ctx))
 			continue;
 
-		ipv6_addr_prefix(&addr_pfx, addr, table[i].plen);
+		ipv6_addr_prefix(&addr_pfx, addr, ctx->plen);
 
 		/* if prefix len < 64, the remaining bits until 64th bit is
-		 * zero. Otherwise we use table[i]->plen.
+		 * zero. Otherwise we use ctx->plen.
 		 */
-		if (table[i].plen < 64)
+		if (ctx->plen < 64)
 			addr_plen = 64;
 		else
-			addr_plen = table[i].plen;
-
-		if (ipv6_prefix_equal(&addr_pfx, &table[i].pfx, addr_plen)) {
-			/* remember first match */
-			if (!ret) {
-				ret = &table[i];
-				continue;
-			}
+			addr_plen = ctx->plen;
 
-			/* get the context with longest prefix len */
-			if (table[i].plen > ret->plen)
-				ret = &table[i];
-		}
+		/* contexts are sorted, the first match is the longest */
+		if (ipv6_prefix_equal(&addr_pfx, &ctx->pfx, addr_plen))
+			return ctx;
 	}
 
-	return ret;
+	return NULL;
 }
 
 static struct lowpan_iphc_ctx *
 lowpan_iphc_ctx_get_by_mcast_addr(const struct net_device *dev,
 				  const struct in6_addr *addr)
 {
-	struct lowpan_iphc_ctx *table = lowpan_dev(dev)->ctx.table;
+	struct lowpan_iphc_ctx_table *t = &lowpan_dev(dev)->ctx;
+	struct lowpan_iphc_ctx *table = t->table;
 	struct lowpan_iphc_ctx *ret = NULL;
 	struct in6_addr addr_mcast, network_pfx = {};
-	int i;
+	int i, n;
 
 	/* init mcast address with  */
 	memcpy(&addr_mcast, addr, sizeof(*addr));
 
-	for (i = 0; i < LOWPAN_IPHC_CTX_TABLE_SIZE; i++) {
-		/* Check if context is valid. A context that is not valid
-		 * MUST NOT be used for compression.
-		 */
-		if (!lowpan_iphc_ctx_is_active(&table[i]) ||
-		    !lowpan_iphc_ctx_is_compression(&table[i]))
+	for (n = 0; n < t->cmp_num; n++) {
+		i = t->cmp_order[n];
+		if (lowpan_iphc_ctx_is_expired(&table[i]))
 			continue;
 
 		/* setting plen */
@@ -1163,24 +1182,28 @@ int lowpan_header_compress(struct sk_buff *skb, const struct net_device *dev,
 		       skb->data, skb->len);
 
 	ipv6_daddr_type = ipv6_addr_type(&hdr->daddr);
-	spin_lock_bh(&lowpan_dev(dev)->ctx.lock);
-	if (ipv6_daddr_type & IPV6_ADDR_MULTICAST)
-		dci = lowpan_iphc_ctx_get_by_mcast_addr(dev, &hdr->daddr);
-	else
-		dci = lowpan_iphc_ctx_get_by_addr(dev, &hdr->daddr);
-	if (dci) {
-		memcpy(&dci_entry, dci, sizeof(*dci));
-		cid |= dci->id;
-	}
-	spin_unlock_bh(&lowpan_dev(dev)->ctx.lock);
+	dci = NULL;
+	sci = NULL;
+	/* most networks run without contexts, skip the table lock then */
+	if (READ_ONCE(lowpan_dev(dev)->ctx.cmp_num)) {
+		spin_lock_bh(&lowpan_dev(dev)->ctx.lock);
+		if (ipv6_daddr_type & IPV6_ADDR_MULTICAST)
+			dci = lowpan_iphc_ctx_get_by_mcast_addr(dev,
+								&hdr->daddr);
+		else
+			dci = lowpan_iphc_ctx_get_by_addr(dev, &hdr->daddr);
+		if (dci) {
+			memcpy(&dci_entry, dci, sizeof(*dci));
+			cid |= dci->id;
+		}
 
-	spin_lock_bh(&lowpan_dev(dev)->ctx.lock);
-	sci = lowpan_iphc_ctx_get_by_addr(dev, &hdr->saddr);
-	if (sci) {
-		memcpy(&sci_entry, sci, sizeof(*sci));
-		cid |= (sci->id << 4);
+		sci = lowpan_iphc_ctx_get_by_addr(dev, &hdr->saddr);
+		if (sci) {
+			memcpy(&sci_entry, sci, sizeof(*sci));
+			cid |= (sci->id << 4);
+		}
+		spin_unlock_bh(&lowpan_dev(dev)->ctx.lock);
 	}
-	spin_unlock_bh(&lowpan_dev(dev)->ctx.lock);
 
 	/* if cid is zero it will be compressed */
 	if (cid) {
@@ -17,11 +17,85 @@
 
 #include "6lowpan_i.h"
 
+/* RFC6775 4.2 6LoWPAN Context Option */
+struct lowpan_ndisc_6co {
+	struct nd_opt_hdr hdr;
+	u8 ctx_len;
+	u8 flags_cid;
+	__be16 reserved;
+	__be16 lifetime;
+	u8 prefix[0];
+} __packed;
+
+#define LOWPAN_NDISC_6CO_C	BIT(4)
+#define LOWPAN_NDISC_6CO_CID	0x0f
+
 static int lowpan_ndisc_is_useropt(u8 nd_opt_type)
 {
 	return nd_opt_type == ND_OPT_6CO;
 }
 
+static void lowpan_ndisc_6co_rcv(const struct net_device *dev,
+				 const struct nd_opt_hdr *opt)
+{
+	const struct lowpan_ndisc_6co *co = (const void *)opt;
+	struct lowpan_iphc_ctx_table *t = &lowpan_dev(dev)->ctx;
+	struct lowpan_iphc_ctx *ctx;
+	struct in6_addr pfx = {};
+	unsigned long expires;
+	u16 lifetime;
+
+	/* a length of 2 carries up to 64 bits of prefix, 3 up to 128 */
+	if (opt->nd_opt_len < 2 || opt->nd_opt_len > 3 ||
+	    co->ctx_len > (opt->nd_opt_len - 1) * 64) {
+		ND_PRINTK(2, warn, "RA: invalid 6CO option\n");
+		return;
+	}
+
+	memcpy(&pfx, co->prefix, (opt->nd_opt_len << 3) - sizeof(*co));
+	lifetime = ntohs(co->lifetime);
+	expires = (jiffies + min_t(unsigned long, (unsigned long)lifetime *
+				   60 * HZ, MAX_JIFFY_OFFSET)) ?: 1;
+	ctx = &t->table[co->flags_cid & LOWPAN_NDISC_6CO_CID];
+
+	spin_lock_bh(&t->lock);
+	if (!lifetime) {
+		/* stop compressing, peers may still send with it for a while */
+		clear_bit(LOWPAN_IPHC_CTX_FLAG_COMPRESSION, &ctx->flags);
+	} else {
+		ipv6_addr_prefix(&ctx->pfx, &pfx, co->ctx_len);
+		ctx->plen = co->ctx_len;
+		ctx->expires = expires;
+		set_bit(LOWPAN_IPHC_CTX_FLAG_ACTIVE, &ctx->flags);
+		if (co->flags_cid & LOWPAN_NDISC_6CO_C)
+			set_bit(LOWPAN_IPHC_CTX_FLAG_COMPRESSION, &ctx->flags);
+		else
+			clear_bit(LOWPAN_IPHC_CTX_FLAG_COMPRESSION,
+				  &ctx->flags);
+	}
+	lowpan_iphc_ctx_table_update(t);
+	spin_unlock_bh(&t->lock);
+}
+
+/* Contexts are learned from the 6CO options of router advertisements.
+ * The options are still passed to userspace as well.
+ */
+static void lowpan_ndisc_ra_6co(const struct net_device *dev,
+				const struct ndisc_options *ndopts)
+{
+	struct inet6_dev *idev = __in6_dev_get(dev);
+	struct nd_opt_hdr *p;
+
+	if (!idev || !ipv6_accept_ra(idev) || !ndopts->nd_useropts)
+		return;
+
+	for (p = ndopts->nd_useropts; p <= ndopts->nd_useropts_end;
+	     p = (void *)p + (p->nd_opt_len << 3)) {
+		if (p->nd_opt_type == ND_OPT_6CO)
+			lowpan_ndisc_6co_rcv(dev, p);
+	}
+}
+
 #if IS_ENABLED(CONFIG_IEEE802154_6LOWPAN)
 #define NDISC_802154_SHORT_ADDR_LENGTH	1
 static int lowpan_ndisc_parse_802154_options(const struct net_device *dev,
@@ -105,18 +179,27 @@ static void lowpan_ndisc_802154_update(struct neighbour *n, u32 flags,
 	write_unlock_bh(&n->lock);
 }
 
+#endif
+
 static void lowpan_ndisc_update(const struct net_device *dev,
 				struct neighbour *n, u32 flags, u8 icmp6_type,
 				const struct ndisc_options *ndopts)
 {
+	if (icmp6_type == NDISC_ROUTER_ADVERTISEMENT)
+		lowpan_ndisc_ra_6co(dev, ndopts);
+
+#if IS_ENABLED(CONFIG_IEEE802154_6LOWPAN)
 	if (!lowpan_is_ll(dev, LOWPAN_LLTYPE_IEEE802154))
 		return;
 
 	/* react on overrides only. TODO check if this is really right. */
 	if (flags & NEIGH_UPDATE_F_OVERRIDE)
 		lowpan_ndisc_802154_update(n, flags, icmp6_type, ndopts);
+#endif
 }
 
+#if IS_ENABLED(CONFIG_IEEE802154_6LOWPAN)
+
 static int lowpan_ndisc_opt_addr_space(const struct net_device *dev,
 				       u8 icmp6_type, struct neighbour *neigh,
 				       u8 *ha_buf, u8 **ha)
@@ -229,9 +312,9 @@ static void lowpan_ndisc_prefix_rcv_add_addr(struct net *net,
 
 const struct ndisc_ops lowpan_ndisc_ops = {
 	.is_useropt		= lowpan_ndisc_is_useropt,
+	.update			= lowpan_ndisc_update,
 #if IS_ENABLED(CONFIG_IEEE802154_6LOWPAN)
 	.parse_options		= lowpan_ndisc_parse_options,
-	.update			= lowpan_ndisc_update,
 	.opt_addr_space		= lowpan_ndisc_opt_addr_space,
 	.fill_addr_option	= lowpan_ndisc_fill_addr_option,
 	.prefix_rcv_add_addr	= lowpan_ndisc_prefix_rcv_add_addr,
@@ -767,6 +767,22 @@ static int vlan_dev_get_iflink(const struct net_device *dev)
 	return real_dev->ifindex;
 }
 
+static int vlan_dev_get_encap(const struct net_device *dev,
+			      struct net_device_encap *encap)
+{
+	struct vlan_dev_priv *vlan = vlan_dev_priv(dev);
+
+	/* Only a single tag is handled by the callers */
+	if (is_vlan_dev(vlan->real_dev))
+		return -EOPNOTSUPP;
+
+	encap->lower_dev = vlan->real_dev;
+	encap->id = vlan->vlan_id;
+	encap->proto = vlan->vlan_proto;
+
+	return 0;
+}
+
 static const struct ethtool_ops vlan_ethtool_ops = {
 	.get_link_ksettings	= vlan_ethtool_get_link_ksettings,
 	.get_drvinfo	        = vlan_ethtool_get_drvinfo,
@@ -804,6 +820,7 @@ static const struct net_device_ops vlan_netdev_ops = {
 	.ndo_fix_features	= vlan_dev_fix_features,
 	.ndo_get_lock_subclass  = vlan_dev_get_lock_subclass,
 	.ndo_get_iflink		= vlan_dev_get_iflink,
+	.ndo_get_encap		= vlan_dev_get_encap,
 };
 
 static void vlan_dev_free(struct net_device *dev)
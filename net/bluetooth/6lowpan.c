@@ -450,19 +450,37 @@ static int header_create(struct sk_buff *skb, struct net_device *netdev,
 	return 0;
 }
 
-/* Packet to BT LE device */
+static int tx_account(struct net_device *netdev, int err)
+{
+	if (err > 0) {
+		netdev->stats.tx_bytes += err;
+		netdev->stats.tx_packets++;
+		return 0;
+	}
+
+	if (err < 0)
+		netdev->stats.tx_errors++;
+
+	return err;
+}
+
+/* Packet to BT LE device, the skb is consumed */
 static int send_pkt(struct l2cap_chan *chan, struct sk_buff *skb,
 		    struct net_device *netdev)
+{
+	return tx_account(netdev, l2cap_chan_send_skb(chan, skb));
+}
+
+/* Same as send_pkt() but leaves the skb to the caller, the data is
+ * copied into the L2CAP PDUs.
+ */
+static int send_pkt_copy(struct l2cap_chan *chan, struct sk_buff *skb,
+			 struct net_device *netdev)
 {
 	struct msghdr msg;
 	struct kvec iv;
 	int err;
 
-	/* Remember the skb so that we can send EAGAIN to the caller if
-	 * we run out of credits.
-	 */
-	chan->data = skb;
-
 	iv.iov_base = skb->data;
 	iv.iov_len = skb->len;
 
@@ -470,24 +488,25 @@ static int send_pkt(struct l2cap_chan *chan, struct sk_buff *skb,
 	iov_iter_kvec(&msg.msg_iter, WRITE | ITER_KVEC, &iv, 1, skb->len);
 
 	err = l2cap_chan_send(chan, &msg, skb->len);
-	if (err > 0) {
-		netdev->stats.tx_bytes += err;
-		netdev->stats.tx_packets++;
-		return 0;
-	}
-
-	if (err < 0)
-		netdev->stats.tx_errors++;
 
-	return err;
+	return tx_account(netdev, err);
 }
 
+/* The packet is compressed once for all peers. Every peer but the last
+ * one gets its PDUs built straight from the shared buffer, the last one
+ * is handed the skb itself. The skb is consumed.
+ */
 static int send_mcast_pkt(struct sk_buff *skb, struct net_device *netdev)
 {
-	struct sk_buff *local_skb;
+	struct l2cap_chan *last = NULL;
 	struct lowpan_btle_dev *entry;
 	int err = 0;
 
+	if (skb_linearize(skb)) {
+		kfree_skb(skb);
+		return -ENOMEM;
+	}
+
 	rcu_read_lock();
 
 	list_for_each_entry_rcu(entry, &bt_6lowpan_devices, list) {
@@ -502,20 +521,31 @@ static int send_mcast_pkt(struct sk_buff *skb, struct net_device *netdev)
 		list_for_each_entry_rcu(pentry, &dev->peers, list) {
 			int ret;
 
-			local_skb = skb_clone(skb, GFP_ATOMIC);
-
 			BT_DBG("xmit %s to %pMR type %d IP %pI6c chan %p",
 			       netdev->name,
 			       &pentry->chan->dst, pentry->chan->dst_type,
 			       &pentry->peer_addr, pentry->chan);
-			ret = send_pkt(pentry->chan, local_skb, netdev);
-			if (ret < 0)
-				err = ret;
 
-			kfree_skb(local_skb);
+			if (last) {
+				ret = send_pkt_copy(last, skb, netdev);
+				if (ret < 0)
+					err = ret;
+			}
+
+			last = pentry->chan;
 		}
 	}
 
+	if (last) {
+		int ret;
+
+		ret = send_pkt(last, skb, netdev);
+		if (ret < 0)
+			err = ret;
+	} else {
+		kfree_skb(skb);
+	}
+
 	rcu_read_unlock();
 
 	return err;
@@ -552,6 +582,7 @@ static netdev_tx_t bt_xmit(struct sk_buff *skb, struct net_device *netdev)
 			       &lowpan_cb(skb)->addr, lowpan_cb(skb)->chan);
 			err = send_pkt(lowpan_cb(skb)->chan, skb, netdev);
 		} else {
+			kfree_skb(skb);
 			err = -ENOENT;
 		}
 	} else {
@@ -561,8 +592,6 @@ static netdev_tx_t bt_xmit(struct sk_buff *skb, struct net_device *netdev)
 		err = send_mcast_pkt(skb, netdev);
 	}
 
-	dev_kfree_skb(skb);
-
 	if (err)
 		BT_DBG("ERROR: xmit failed (%d)", err);
 
@@ -588,6 +617,11 @@ static struct header_ops header_ops = {
 static void netdev_setup(struct net_device *dev)
 {
 	dev->hard_header_len	= 0;
+	/* Room for the L2CAP headers so that single PDU packets can be
+	 * handed to L2CAP without copying.
+	 */
+	dev->needed_headroom	= L2CAP_HDR_SIZE + L2CAP_SDULEN_SIZE +
+				  BT_SKB_RESERVE;
 	dev->needed_tailroom	= 0;
 	dev->flags		= IFF_RUNNING | IFF_MULTICAST;
 	dev->watchdog_timeo	= 0;
@@ -544,6 +544,7 @@ struct hci_conn *hci_conn_add(struct hci_dev *hdev, int type, bdaddr_t *dst,
 	}
 
 	skb_queue_head_init(&conn->data_q);
+	conn->tx_turn = hdev->tx_turn;
 
 	INIT_LIST_HEAD(&conn->chan_list);
 
@@ -3659,6 +3659,7 @@ static void hci_queue_acl(struct hci_chan *chan, struct sk_buff_head *queue,
 	skb->data_len = 0;
 
 	hci_skb_pkt_type(skb) = HCI_ACLDATA_PKT;
+	skb->tstamp = ktime_get();
 
 	switch (hdev->dev_type) {
 	case HCI_PRIMARY:
@@ -3699,6 +3700,7 @@ static void hci_queue_acl(struct hci_chan *chan, struct sk_buff_head *queue,
 			skb = list; list = list->next;
 
 			hci_skb_pkt_type(skb) = HCI_ACLDATA_PKT;
+			skb->tstamp = ktime_get();
 			hci_add_acl_hdr(skb, conn->handle, flags);
 
 			BT_DBG("%s frag %p len %d", hdev->name, skb, skb->len);
@@ -3737,6 +3739,7 @@ void hci_send_sco(struct hci_conn *conn, struct sk_buff *skb)
 	memcpy(skb_transport_header(skb), &hdr, HCI_SCO_HDR_SIZE);
 
 	hci_skb_pkt_type(skb) = HCI_SCODATA_PKT;
+	skb->tstamp = ktime_get();
 
 	skb_queue_tail(&conn->data_q, skb);
 	queue_work(hdev->workqueue, &hdev->tx_work);
@@ -3805,6 +3808,19 @@ static struct hci_conn *hci_low_sent(struct hci_dev *hdev, __u8 type,
 	return conn;
 }
 
+/* Data packets carry the time they were queued in skb->tstamp until
+ * hci_send_frame() stamps them for the monitor.
+ */
+static void hci_conn_tx_account(struct hci_conn *conn, struct sk_buff *skb)
+{
+	u32 lat = ktime_us_delta(ktime_get(), skb->tstamp);
+
+	conn->tx_pkts++;
+	conn->tx_lat_sum += lat;
+	if (lat > conn->tx_lat_max)
+		conn->tx_lat_max = lat;
+}
+
 static void hci_link_tx_to(struct hci_dev *hdev, __u8 type)
 {
 	struct hci_conn_hash *h = &hdev->conn_hash;
@@ -3831,7 +3847,7 @@ static struct hci_chan *hci_chan_sent(struct hci_dev *hdev, __u8 type,
 {
 	struct hci_conn_hash *h = &hdev->conn_hash;
 	struct hci_chan *chan = NULL;
-	unsigned int num = 0, min = ~0, cur_prio = 0;
+	unsigned int num = 0, max_age = 0, cur_prio = 0;
 	struct hci_conn *conn;
 	int cnt, q, conn_num = 0;
 
@@ -3862,14 +3878,18 @@ static struct hci_chan *hci_chan_sent(struct hci_dev *hdev, __u8 type,
 
 			if (skb->priority > cur_prio) {
 				num = 0;
-				min = ~0;
+				chan = NULL;
 				cur_prio = skb->priority;
 			}
 
 			num++;
 
-			if (conn->sent < min) {
-				min  = conn->sent;
+			/* The connection served longest ago goes first, so
+			 * that every backlogged connection gets a turn per
+			 * round.
+			 */
+			if (!chan || hdev->tx_turn - conn->tx_turn > max_age) {
+				max_age = hdev->tx_turn - conn->tx_turn;
 				chan = tmp;
 			}
 		}
@@ -3986,8 +4006,15 @@ static void hci_sched_acl_pkt(struct hci_dev *hdev)
 
 	while (hdev->acl_cnt &&
 	       (chan = hci_chan_sent(hdev, ACL_LINK, &quote))) {
+		struct hci_conn *conn = chan->conn;
 		u32 priority = (skb_peek(&chan->data_q))->priority;
-		while (quote-- && (skb = skb_peek(&chan->data_q))) {
+		bool served = false;
+		unsigned int len;
+
+		conn->tx_turn = ++hdev->tx_turn;
+		conn->tx_deficit += hdev->acl_mtu;
+
+		while (hdev->acl_cnt && (skb = skb_peek(&chan->data_q))) {
 			BT_DBG("chan %p skb %p len %d priority %u", chan, skb,
 			       skb->len, skb->priority);
 
@@ -3995,18 +4022,32 @@ static void hci_sched_acl_pkt(struct hci_dev *hdev)
 			if (skb->priority < priority)
 				break;
 
+			/* Stop when the turn of the connection is used up,
+			 * one packet always goes through.
+			 */
+			len = skb->len - HCI_ACL_HDR_SIZE;
+			if (served && len > conn->tx_deficit)
+				break;
+
 			skb = skb_dequeue(&chan->data_q);
+			conn->tx_deficit -= min(conn->tx_deficit, len);
+			served = true;
 
-			hci_conn_enter_active_mode(chan->conn,
+			hci_conn_enter_active_mode(conn,
 						   bt_cb(skb)->force_active);
 
+			hci_conn_tx_account(conn, skb);
 			hci_send_frame(hdev, skb);
 			hdev->acl_last_tx = jiffies;
 
 			hdev->acl_cnt--;
 			chan->sent++;
-			chan->conn->sent++;
+			conn->sent++;
 		}
+
+		/* An idle connection does not save up its turns */
+		if (skb_queue_empty(&chan->data_q))
+			conn->tx_deficit = 0;
 	}
 
 	if (cnt != hdev->acl_cnt)
@@ -4033,6 +4074,9 @@ static void hci_sched_acl_blk(struct hci_dev *hdev)
 	while (hdev->block_cnt > 0 &&
 	       (chan = hci_chan_sent(hdev, type, &quote))) {
 		u32 priority = (skb_peek(&chan->data_q))->priority;
+
+		chan->conn->tx_turn = ++hdev->tx_turn;
+
 		while (quote > 0 && (skb = skb_peek(&chan->data_q))) {
 			int blocks;
 
@@ -4052,6 +4096,7 @@ static void hci_sched_acl_blk(struct hci_dev *hdev)
 			hci_conn_enter_active_mode(chan->conn,
 						   bt_cb(skb)->force_active);
 
+			hci_conn_tx_account(chan->conn, skb);
 			hci_send_frame(hdev, skb);
 			hdev->acl_last_tx = jiffies;
 
@@ -4105,6 +4150,7 @@ static void hci_sched_sco(struct hci_dev *hdev)
 	while (hdev->sco_cnt && (conn = hci_low_sent(hdev, SCO_LINK, &quote))) {
 		while (quote-- && (skb = skb_dequeue(&conn->data_q))) {
 			BT_DBG("skb %p len %d", skb, skb->len);
+			hci_conn_tx_account(conn, skb);
 			hci_send_frame(hdev, skb);
 
 			conn->sent++;
@@ -4129,6 +4175,7 @@ static void hci_sched_esco(struct hci_dev *hdev)
 						     &quote))) {
 		while (quote-- && (skb = skb_dequeue(&conn->data_q))) {
 			BT_DBG("skb %p len %d", skb, skb->len);
+			hci_conn_tx_account(conn, skb);
 			hci_send_frame(hdev, skb);
 
 			conn->sent++;
@@ -4143,6 +4190,7 @@ static void hci_sched_le(struct hci_dev *hdev)
 	struct hci_chan *chan;
 	struct sk_buff *skb;
 	int quote, cnt, tmp;
+	unsigned int mtu;
 
 	BT_DBG("%s", hdev->name);
 
@@ -4158,10 +4206,18 @@ static void hci_sched_le(struct hci_dev *hdev)
 	}
 
 	cnt = hdev->le_pkts ? hdev->le_cnt : hdev->acl_cnt;
+	mtu = hdev->le_mtu ? hdev->le_mtu : hdev->acl_mtu;
 	tmp = cnt;
 	while (cnt && (chan = hci_chan_sent(hdev, LE_LINK, &quote))) {
+		struct hci_conn *conn = chan->conn;
 		u32 priority = (skb_peek(&chan->data_q))->priority;
-		while (quote-- && (skb = skb_peek(&chan->data_q))) {
+		bool served = false;
+		unsigned int len;
+
+		conn->tx_turn = ++hdev->tx_turn;
+		conn->tx_deficit += mtu;
+
+		while (cnt && (skb = skb_peek(&chan->data_q))) {
 			BT_DBG("chan %p skb %p len %d priority %u", chan, skb,
 			       skb->len, skb->priority);
 
@@ -4169,15 +4225,29 @@ static void hci_sched_le(struct hci_dev *hdev)
 			if (skb->priority < priority)
 				break;
 
+			/* Stop when the turn of the connection is used up,
+			 * one packet always goes through.
+			 */
+			len = skb->len - HCI_ACL_HDR_SIZE;
+			if (served && len > conn->tx_deficit)
+				break;
+
 			skb = skb_dequeue(&chan->data_q);
+			conn->tx_deficit -= min(conn->tx_deficit, len);
+			served = true;
 
+			hci_conn_tx_account(conn, skb);
 			hci_send_frame(hdev, skb);
 			hdev->le_last_tx = jiffies;
 
 			cnt--;
 			chan->sent++;
-			chan->conn->sent++;
+			conn->sent++;
 		}
+
+		/* An idle connection does not save up its turns */
+		if (skb_queue_empty(&chan->data_q))
+			conn->tx_deficit = 0;
 	}
 
 	if (hdev->le_pkts)
@@ -1003,6 +1003,23 @@ void hci_debugfs_create_le(struct hci_dev *hdev)
 			    &quirk_simultaneous_discovery_fops);
 }
 
+static int tx_latency_show(struct seq_file *f, void *ptr)
+{
+	struct hci_conn *conn = f->private;
+	u64 pkts = conn->tx_pkts;
+
+	seq_printf(f, "dst %pMR type %u\n", &conn->dst, conn->type);
+	seq_printf(f, "packets %llu\n", pkts);
+	seq_printf(f, "avg_us %llu\n",
+		   pkts ? div64_u64(conn->tx_lat_sum, pkts) : 0);
+	seq_printf(f, "max_us %u\n", conn->tx_lat_max);
+	seq_printf(f, "in_flight %u\n", conn->sent);
+
+	return 0;
+}
+
+DEFINE_SHOW_ATTRIBUTE(tx_latency);
+
 void hci_debugfs_create_conn(struct hci_conn *conn)
 {
 	struct hci_dev *hdev = conn->hdev;
@@ -1013,4 +1030,7 @@ void hci_debugfs_create_conn(struct hci_conn *conn)
 
 	snprintf(name, sizeof(name), "%u", conn->handle);
 	conn->debugfs = debugfs_create_dir(name, hdev->debugfs);
+
+	debugfs_create_file("tx_latency", 0444, conn->debugfs, conn,
+			    &tx_latency_fops);
 }
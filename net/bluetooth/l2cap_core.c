@@ -510,6 +510,11 @@ void l2cap_chan_set_defaults(struct l2cap_chan *chan)
 }
 EXPORT_SYMBOL_GPL(l2cap_chan_set_defaults);
 
+static u16 l2cap_le_max_credits(struct l2cap_chan *chan)
+{
+	return (chan->imtu / chan->mps) + 1;
+}
+
 static void l2cap_le_flowctl_init(struct l2cap_chan *chan)
 {
 	chan->sdu = NULL;
@@ -519,7 +524,7 @@ static void l2cap_le_flowctl_init(struct l2cap_chan *chan)
 	/* Derive MPS from connection MTU to stop HCI fragmentation */
 	chan->mps = min_t(u16, chan->imtu, chan->conn->mtu - L2CAP_HDR_SIZE);
 	/* Give enough credits for a full packet */
-	chan->rx_credits = (chan->imtu / chan->mps) + 1;
+	chan->rx_credits = l2cap_le_max_credits(chan);
 
 	skb_queue_head_init(&chan->tx_q);
 }
@@ -2442,6 +2447,17 @@ static void l2cap_le_flowctl_send(struct l2cap_chan *chan)
 	       skb_queue_len(&chan->tx_q));
 }
 
+static void l2cap_le_flowctl_queue(struct l2cap_chan *chan,
+				   struct sk_buff_head *seg_queue)
+{
+	skb_queue_splice_tail_init(seg_queue, &chan->tx_q);
+
+	l2cap_le_flowctl_send(chan);
+
+	if (!chan->tx_credits)
+		chan->ops->suspend(chan);
+}
+
 int l2cap_chan_send(struct l2cap_chan *chan, struct msghdr *msg, size_t len)
 {
 	struct sk_buff *skb;
@@ -2487,12 +2503,7 @@ int l2cap_chan_send(struct l2cap_chan *chan, struct msghdr *msg, size_t len)
 		if (err)
 			return err;
 
-		skb_queue_splice_tail_init(&seg_queue, &chan->tx_q);
-
-		l2cap_le_flowctl_send(chan);
-
-		if (!chan->tx_credits)
-			chan->ops->suspend(chan);
+		l2cap_le_flowctl_queue(chan, &seg_queue);
 
 		err = len;
 
@@ -2569,6 +2580,82 @@ int l2cap_chan_send(struct l2cap_chan *chan, struct msghdr *msg, size_t len)
 }
 EXPORT_SYMBOL_GPL(l2cap_chan_send);
 
+static int l2cap_le_send_single_pdu(struct l2cap_chan *chan,
+				    struct sk_buff *skb)
+{
+	struct sk_buff_head seg_queue;
+	struct l2cap_hdr *lh;
+	u16 len = skb->len;
+
+	if (skb_linearize(skb) ||
+	    skb_cow_head(skb, L2CAP_HDR_SIZE + L2CAP_SDULEN_SIZE +
+			 BT_SKB_RESERVE)) {
+		kfree_skb(skb);
+		return -ENOMEM;
+	}
+
+	put_unaligned_le16(len, skb_push(skb, L2CAP_SDULEN_SIZE));
+
+	lh = skb_push(skb, L2CAP_HDR_SIZE);
+	lh->cid = cpu_to_le16(chan->dcid);
+	lh->len = cpu_to_le16(len + L2CAP_SDULEN_SIZE);
+
+	/* The control block still holds the sender's private data, and the
+	 * priority is the one of the upper layer, not the HCI priority the
+	 * PDUs allocated for the channel get.
+	 */
+	memset(skb->cb, 0, sizeof(skb->cb));
+	skb->priority = 0;
+
+	__skb_queue_head_init(&seg_queue);
+	__skb_queue_tail(&seg_queue, skb);
+
+	l2cap_le_flowctl_queue(chan, &seg_queue);
+
+	return len;
+}
+
+/* Send the contents of an skb as one SDU. On LE flow control channels an
+ * SDU that fits into a single PDU is sent without copying: the L2CAP
+ * headers are pushed in front of the data and the skb itself is queued.
+ * Larger SDUs and other modes go through the regular segmentation path.
+ * The skb is always consumed.
+ */
+int l2cap_chan_send_skb(struct l2cap_chan *chan, struct sk_buff *skb)
+{
+	struct msghdr msg;
+	struct kvec iv;
+	size_t len = skb->len;
+	int err;
+
+	if (!chan->conn || chan->state != BT_CONNECTED) {
+		kfree_skb(skb);
+		return -ENOTCONN;
+	}
+
+	if (chan->mode == L2CAP_MODE_LE_FLOWCTL && len <= chan->omtu &&
+	    len + L2CAP_SDULEN_SIZE <= chan->remote_mps &&
+	    len + L2CAP_HDR_SIZE + L2CAP_SDULEN_SIZE <= chan->conn->mtu)
+		return l2cap_le_send_single_pdu(chan, skb);
+
+	if (skb_linearize(skb)) {
+		kfree_skb(skb);
+		return -ENOMEM;
+	}
+
+	iv.iov_base = skb->data;
+	iv.iov_len = len;
+
+	memset(&msg, 0, sizeof(msg));
+	iov_iter_kvec(&msg.msg_iter, WRITE | ITER_KVEC, &iv, 1, len);
+
+	err = l2cap_chan_send(chan, &msg, len);
+	kfree_skb(skb);
+
+	return err;
+}
+EXPORT_SYMBOL_GPL(l2cap_chan_send_skb);
+
 static void l2cap_send_srej(struct l2cap_chan *chan, u16 txseq)
 {
 	struct l2cap_ctrl control;
@@ -6709,7 +6796,7 @@ static void l2cap_chan_le_send_credits(struct l2cap_chan *chan)
 	struct l2cap_le_credits pkt;
 	u16 return_credits;
 
-	return_credits = ((chan->imtu / chan->mps) + 1) - chan->rx_credits;
+	return_credits = l2cap_le_max_credits(chan) - chan->rx_credits;
 
 	if (!return_credits)
 		return;
@@ -6726,6 +6813,19 @@ static void l2cap_chan_le_send_credits(struct l2cap_chan *chan)
 	l2cap_send_cmd(conn, chan->ident, L2CAP_LE_CREDITS, sizeof(pkt), &pkt);
 }
 
+/* Return credits in batches: only once the sender has used up at least
+ * half of what it was given, instead of sending an LE Flow Control
+ * Credit packet for every SDU. The sender always keeps the other half,
+ * so it never stalls waiting for the update.
+ */
+static void l2cap_chan_le_update_credits(struct l2cap_chan *chan)
+{
+	if (chan->rx_credits > l2cap_le_max_credits(chan) / 2)
+		return;
+
+	l2cap_chan_le_send_credits(chan);
+}
+
 static int l2cap_le_recv(struct l2cap_chan *chan, struct sk_buff *skb)
 {
 	int err;
@@ -6735,8 +6835,7 @@ static int l2cap_le_recv(struct l2cap_chan *chan, struct sk_buff *skb)
 	/* Wait recv to confirm reception before updating the credits */
 	err = chan->ops->recv(chan, skb);
 
-	/* Update credits whenever an SDU is received */
-	l2cap_chan_le_send_credits(chan);
+	l2cap_chan_le_update_credits(chan);
 
 	return err;
 }
@@ -6759,11 +6858,10 @@ static int l2cap_le_data_rcv(struct l2cap_chan *chan, struct sk_buff *skb)
 	chan->rx_credits--;
 	BT_DBG("rx_credits %u -> %u", chan->rx_credits + 1, chan->rx_credits);
 
-	/* Update if remote had run out of credits, this should only happens
-	 * if the remote is not using the entire MPS.
+	/* Update if remote is running out of credits, this should only
+	 * happen if the remote is not using the entire MPS.
 	 */
-	if (!chan->rx_credits)
-		l2cap_chan_le_send_credits(chan);
+	l2cap_chan_le_update_credits(chan);
 
 	err = 0;
 
@@ -59,6 +59,7 @@
 #include <linux/can/core.h>
 #include <linux/can/skb.h>
 #include <linux/ratelimit.h>
+#include <linux/hash.h>
 #include <net/net_namespace.h>
 #include <net/sock.h>
 
@@ -217,7 +218,7 @@ int can_send(struct sk_buff *skb, int loop)
 {
 	struct sk_buff *newskb = NULL;
 	struct canfd_frame *cfd = (struct canfd_frame *)skb->data;
-	struct s_stats *can_stats = dev_net(skb->dev)->can.can_stats;
+	struct net *net = dev_net(skb->dev);
 	int err = -EINVAL;
 
 	if (skb->len == CAN_MTU) {
@@ -306,8 +307,7 @@ int can_send(struct sk_buff *skb, int loop)
 		netif_rx_ni(newskb);
 
 	/* update statistics */
-	can_stats->tx_frames++;
-	can_stats->tx_frames_delta++;
+	this_cpu_inc(net->can.can_pcpu_stats->tx_frames);
 
 	return 0;
 
@@ -428,6 +428,56 @@ static struct hlist_head *find_rcv_list(canid_t *can_id, canid_t *mask,
 	return &d->rx[RX_FIL];
 }
 
+static unsigned int can_fil_hash(canid_t can_id)
+{
+	return hash_32(can_id, CAN_FIL_HASH_BITS);
+}
+
+/*
+ * RX_FIL receivers are additionally grouped by their mask. At receive time
+ * every distinct mask costs one hash lookup instead of testing every
+ * single can_id/mask filter. The rx[RX_FIL] list itself is kept for
+ * removal and procfs. Called with can_rcvlists_lock held.
+ */
+static int can_fil_add(struct can_dev_rcv_lists *d, struct receiver *r)
+{
+	struct can_fil_mask *fm;
+
+	hlist_for_each_entry(fm, &d->rx_fil_mask, list) {
+		if (fm->mask == r->mask)
+			goto found;
+	}
+
+	fm = kzalloc(sizeof(*fm), GFP_ATOMIC);
+	if (!fm)
+		return -ENOMEM;
+
+	fm->mask = r->mask;
+	hlist_add_head_rcu(&fm->list, &d->rx_fil_mask);
+found:
+	hlist_add_head_rcu(&r->fil_list, &fm->rx[can_fil_hash(r->can_id)]);
+	fm->entries++;
+
+	return 0;
+}
+
+static void can_fil_del(struct can_dev_rcv_lists *d, struct receiver *r)
+{
+	struct can_fil_mask *fm;
+
+	hlist_for_each_entry(fm, &d->rx_fil_mask, list) {
+		if (fm->mask != r->mask)
+			continue;
+
+		hlist_del_rcu(&r->fil_list);
+		if (!--fm->entries) {
+			hlist_del_rcu(&fm->list);
+			kfree_rcu(fm, rcu);
+		}
+		return;
+	}
+}
+
 /**
  * can_rx_register - subscribe CAN frames from a specific interface
  * @dev: pointer to netdevice (NULL => subcribe from 'all' CAN devices list)
@@ -494,6 +544,14 @@ int can_rx_register(struct net *net, struct net_device *dev, canid_t can_id,
 		r->ident   = ident;
 		r->sk      = sk;
 
+		if (rl == &d->rx[RX_FIL]) {
+			err = can_fil_add(d, r);
+			if (err) {
+				kmem_cache_free(rcv_cache, r);
+				goto out;
+			}
+		}
+
 		hlist_add_head_rcu(&r->list, rl);
 		d->entries++;
 
@@ -505,6 +563,7 @@ int can_rx_register(struct net *net, struct net_device *dev, canid_t can_id,
 		err = -ENODEV;
 	}
 
+ out:
 	spin_unlock(&net->can.can_rcvlists_lock);
 
 	return err;
@@ -586,6 +645,8 @@ void can_rx_unregister(struct net *net, struct net_device *dev, canid_t can_id,
 	}
 
 	hlist_del_rcu(&r->list);
+	if (rl == &d->rx[RX_FIL])
+		can_fil_del(d, r);
 	d->entries--;
 
 	if (can_pstats->rcv_entries > 0)
@@ -617,6 +678,7 @@ static inline void deliver(struct sk_buff *skb, struct receiver *r)
 
 static int can_rcv_filter(struct can_dev_rcv_lists *d, struct sk_buff *skb)
 {
+	struct can_fil_mask *fm;
 	struct receiver *r;
 	int matches = 0;
 	struct can_frame *cf = (struct can_frame *)skb->data;
@@ -642,11 +704,16 @@ static int can_rcv_filter(struct can_dev_rcv_lists *d, struct sk_buff *skb)
 		matches++;
 	}
 
-	/* check for can_id/mask entries */
-	hlist_for_each_entry_rcu(r, &d->rx[RX_FIL], list) {
-		if ((can_id & r->mask) == r->can_id) {
-			deliver(skb, r);
-			matches++;
+	/* check for can_id/mask entries, one hash lookup per distinct mask */
+	hlist_for_each_entry_rcu(fm, &d->rx_fil_mask, list) {
+		canid_t key = can_id & fm->mask;
+
+		hlist_for_each_entry_rcu(r, &fm->rx[can_fil_hash(key)],
+					 fil_list) {
+			if (r->can_id == key) {
+				deliver(skb, r);
+				matches++;
+			}
 		}
 	}
 
@@ -684,12 +751,10 @@ static void can_receive(struct sk_buff *skb, struct net_device *dev)
 {
 	struct can_dev_rcv_lists *d;
 	struct net *net = dev_net(dev);
-	struct s_stats *can_stats = net->can.can_stats;
 	int matches;
 
 	/* update statistics */
-	can_stats->rx_frames++;
-	can_stats->rx_frames_delta++;
+	this_cpu_inc(net->can.can_pcpu_stats->rx_frames);
 
 	/* create non-zero unique skb identifier together with *skb */
 	while (!(can_skb_prv(skb)->skbcnt))
@@ -710,10 +775,8 @@ static void can_receive(struct sk_buff *skb, struct net_device *dev)
 	/* consume the skbuff allocated by the netdevice driver */
 	consume_skb(skb);
 
-	if (matches > 0) {
-		can_stats->matches++;
-		can_stats->matches_delta++;
-	}
+	if (matches > 0)
+		this_cpu_inc(net->can.can_pcpu_stats->matches);
 }
 
 static int can_rcv(struct sk_buff *skb, struct net_device *dev,
@@ -875,6 +938,9 @@ static int can_pernet_init(struct net *net)
 	net->can.can_pstats = kzalloc(sizeof(struct s_pstats), GFP_KERNEL);
 	if (!net->can.can_pstats)
 		goto out_free_can_stats;
+	net->can.can_pcpu_stats = alloc_percpu(struct can_pcpu_stats);
+	if (!net->can.can_pcpu_stats)
+		goto out_free_can_pstats;
 
 	if (IS_ENABLED(CONFIG_PROC_FS)) {
 		/* the statistics are updated every second (timer triggered) */
@@ -890,6 +956,8 @@ static int can_pernet_init(struct net *net)
 
 	return 0;
 
+ out_free_can_pstats:
+	kfree(net->can.can_pstats);
  out_free_can_stats:
 	kfree(net->can.can_stats);
  out_free_alldev_list:
@@ -924,6 +992,7 @@ static void can_pernet_exit(struct net *net)
 	kfree(net->can.can_rx_alldev_list);
 	kfree(net->can.can_stats);
 	kfree(net->can.can_pstats);
+	free_percpu(net->can.can_pcpu_stats);
 }
 
 /*
@@ -57,6 +57,7 @@ struct receiver {
 	void *data;
 	char *ident;
 	struct sock *sk;
+	struct hlist_node fil_list;
 	struct rcu_head rcu;
 };
 
@@ -64,21 +65,44 @@ struct receiver {
 #define CAN_EFF_RCV_HASH_BITS 10
 #define CAN_EFF_RCV_ARRAY_SZ (1 << CAN_EFF_RCV_HASH_BITS)
 
+#define CAN_FIL_HASH_BITS 6
+#define CAN_FIL_HASH_SZ (1 << CAN_FIL_HASH_BITS)
+
 enum { RX_ERR, RX_ALL, RX_FIL, RX_INV, RX_MAX };
 
+/* RX_FIL receivers sharing the same mask, hashed by their can_id */
+struct can_fil_mask {
+	struct hlist_node list;
+	canid_t mask;
+	int entries;
+	struct hlist_head rx[CAN_FIL_HASH_SZ];
+	struct rcu_head rcu;
+};
+
 /* per device receive filters linked at dev->ml_priv */
 struct can_dev_rcv_lists {
 	struct hlist_head rx[RX_MAX];
 	struct hlist_head rx_sff[CAN_SFF_RCV_ARRAY_SZ];
 	struct hlist_head rx_eff[CAN_EFF_RCV_ARRAY_SZ];
+	struct hlist_head rx_fil_mask;
 	int remove_on_zero_entries;
 	int entries;
 };
 
 /* statistic structures */
 
+/* per-CPU packet counters, never reset */
+struct can_pcpu_stats {
+	unsigned long rx_frames;
+	unsigned long tx_frames;
+	unsigned long matches;
+};
+
 /* can be reset e.g. by can_init_stats() */
 struct s_stats {
+	/* per-CPU counter sums at the time of the last reset */
+	struct can_pcpu_stats base;
+
 	unsigned long jiffies_init;
 
 	unsigned long rx_frames;
@@ -114,5 +138,6 @@ struct s_pstats {
 void can_init_proc(struct net *net);
 void can_remove_proc(struct net *net);
 void can_stat_update(struct timer_list *t);
+void can_sum_stats(struct net *net, struct can_pcpu_stats *sum);
 
 #endif /* AF_CAN_H */
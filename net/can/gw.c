@@ -55,6 +55,9 @@
 #include <linux/can/core.h>
 #include <linux/can/skb.h>
 #include <linux/can/gw.h>
+#include <linux/filter.h>
+#include <linux/bpf.h>
+#include <linux/pkt_cls.h>
 #include <net/rtnetlink.h>
 #include <net/net_namespace.h>
 #include <net/sock.h>
@@ -109,6 +112,7 @@ struct cf_mod {
 		void (*crc8)(struct can_frame *cf, struct cgw_csum_crc8 *crc8);
 	} csumfunc;
 	u32 uid;
+	struct bpf_prog *prog;
 };
 
 
@@ -344,10 +348,43 @@ static void cgw_csum_crc8_neg(struct can_frame *cf, struct cgw_csum_crc8 *crc8)
 	cf->data[crc8->result_idx] = crc^crc8->final_xor_val;
 }
 
+static void cgw_job_free_rcu(struct rcu_head *rcu_head)
+{
+	struct cgw_job *gwj = container_of(rcu_head, struct cgw_job, rcu);
+
+	if (gwj->mod.prog)
+		bpf_prog_put(gwj->mod.prog);
+
+	kmem_cache_free(cgw_cache, gwj);
+}
+
+static void cgw_job_free(struct cgw_job *gwj)
+{
+	/* receivers may still run the job until the end of the grace period */
+	call_rcu(&gwj->rcu, cgw_job_free_rcu);
+}
+
+/*
+ * Run the job's BPF program on the (private) frame copy. Returns false
+ * when the frame is to be dropped, either on request of the program or
+ * because it no longer has the size of the received frame.
+ */
+static bool cgw_run_prog(struct bpf_prog *prog, struct sk_buff *skb,
+			 unsigned int len)
+{
+	u32 res;
+
+	bpf_compute_data_pointers(skb);
+	res = BPF_PROG_RUN(prog, skb);
+
+	return res != TC_ACT_SHOT && skb->len == len && !skb_is_nonlinear(skb);
+}
+
 /* the receive & process & send function */
 static void can_can_gw_rcv(struct sk_buff *skb, void *data)
 {
 	struct cgw_job *gwj = (struct cgw_job *)data;
+	struct bpf_prog *prog;
 	struct can_frame *cf;
 	struct sk_buff *nskb;
 	int modidx = 0;
@@ -387,10 +424,13 @@ static void can_can_gw_rcv(struct sk_buff *skb, void *data)
 	/*
 	 * clone the given skb, which has not been done in can_rcv()
 	 *
-	 * When there is at least one modification function activated,
-	 * we need to copy the skb as we want to modify skb->data.
+	 * When there is at least one modification function or a BPF program
+	 * activated, we need to copy the skb as we want to modify skb->data.
+	 * The program may be replaced by a job update on another CPU, so
+	 * the one the copy was made for is also the one that runs.
 	 */
-	if (gwj->mod.modfunc[0])
+	prog = READ_ONCE(gwj->mod.prog);
+	if (gwj->mod.modfunc[0] || prog)
 		nskb = skb_copy(skb, GFP_ATOMIC);
 	else
 		nskb = skb_clone(skb, GFP_ATOMIC);
@@ -416,8 +456,20 @@ static void can_can_gw_rcv(struct sk_buff *skb, void *data)
 	while (modidx < MAX_MODFUNCTIONS && gwj->mod.modfunc[modidx])
 		(*gwj->mod.modfunc[modidx++])(cf, &gwj->mod);
 
+	if (prog) {
+		if (!cgw_run_prog(prog, nskb, skb->len)) {
+			/* dropped by the BPF program */
+			kfree_skb(nskb);
+			gwj->dropped_frames++;
+			return;
+		}
+
+		/* the frame may have been moved by a helper */
+		cf = (struct can_frame *)nskb->data;
+	}
+
 	/* check for checksum updates when the CAN frame has been modified */
-	if (modidx) {
+	if (modidx || prog) {
 		if (gwj->mod.csumfunc.crc8)
 			(*gwj->mod.csumfunc.crc8)(cf, &gwj->mod.csum.crc8);
 
@@ -470,7 +522,7 @@ static int cgw_notifier(struct notifier_block *nb,
 			if (gwj->src.dev == dev || gwj->dst.dev == dev) {
 				hlist_del(&gwj->list);
 				cgw_unregister_filter(net, gwj);
-				kmem_cache_free(cgw_cache, gwj);
+				cgw_job_free(gwj);
 			}
 		}
 	}
@@ -551,6 +603,11 @@ static int cgw_put_job(struct sk_buff *skb, struct cgw_job *gwj, int type,
 			goto cancel;
 	}
 
+	if (gwj->mod.prog) {
+		if (nla_put_u32(skb, CGW_MOD_BPF_ID, gwj->mod.prog->aux->id) < 0)
+			goto cancel;
+	}
+
 	if (gwj->mod.csumfunc.crc8) {
 		if (nla_put(skb, CGW_CS_CRC8, CGW_CS_CRC8_LEN,
 			    &gwj->mod.csum.crc8) < 0)
@@ -624,6 +681,7 @@ static const struct nla_policy cgw_policy[CGW_MAX+1] = {
 	[CGW_FILTER]	= { .len = sizeof(struct can_filter) },
 	[CGW_LIM_HOPS]	= { .type = NLA_U8 },
 	[CGW_MOD_UID]	= { .type = NLA_U32 },
+	[CGW_MOD_BPF_FD] = { .type = NLA_U32 },
 };
 
 /* check for common and gwtype specific attributes */
@@ -717,7 +775,7 @@ static int cgw_parse_attr(struct nlmsghdr *nlh, struct cf_mod *mod,
 	}
 
 	/* check for checksum operations after CAN frame modifications */
-	if (modidx) {
+	if (modidx || tb[CGW_MOD_BPF_FD]) {
 
 		if (tb[CGW_CS_CRC8]) {
 			struct cgw_csum_crc8 *c = nla_data(tb[CGW_CS_CRC8]);
@@ -804,6 +862,18 @@ static int cgw_parse_attr(struct nlmsghdr *nlh, struct cf_mod *mod,
 
 	/* add the checks for other gwtypes here */
 
+	/* take the program reference last, nothing can fail afterwards */
+	if (tb[CGW_MOD_BPF_FD]) {
+		struct bpf_prog *prog;
+
+		prog = bpf_prog_get_type(nla_get_u32(tb[CGW_MOD_BPF_FD]),
+					 BPF_PROG_TYPE_SCHED_ACT);
+		if (IS_ERR(prog))
+			return PTR_ERR(prog);
+
+		mod->prog = prog;
+	}
+
 	return 0;
 }
 
@@ -815,6 +885,7 @@ static int cgw_create_job(struct sk_buff *skb,  struct nlmsghdr *nlh,
 	struct cgw_job *gwj;
 	struct cf_mod mod;
 	struct can_can_gw ccgw;
+	struct bpf_prog *old_prog;
 	u8 limhops = 0;
 	int err = 0;
 
@@ -847,24 +918,35 @@ static int cgw_create_job(struct sk_buff *skb,  struct nlmsghdr *nlh,
 				continue;
 
 			/* interfaces & filters must be identical */
-			if (memcmp(&gwj->ccgw, &ccgw, sizeof(ccgw)))
-				return -EINVAL;
+			if (memcmp(&gwj->ccgw, &ccgw, sizeof(ccgw))) {
+				err = -EINVAL;
+				goto out_prog;
+			}
 
 			/* update modifications with disabled softirq & quit */
+			old_prog = gwj->mod.prog;
 			local_bh_disable();
 			memcpy(&gwj->mod, &mod, sizeof(mod));
 			local_bh_enable();
+
+			/* running programs are protected by RCU */
+			if (old_prog)
+				bpf_prog_put(old_prog);
 			return 0;
 		}
 	}
 
 	/* ifindex == 0 is not allowed for job creation */
-	if (!ccgw.src_idx || !ccgw.dst_idx)
-		return -ENODEV;
+	if (!ccgw.src_idx || !ccgw.dst_idx) {
+		err = -ENODEV;
+		goto out_prog;
+	}
 
 	gwj = kmem_cache_alloc(cgw_cache, GFP_KERNEL);
-	if (!gwj)
-		return -ENOMEM;
+	if (!gwj) {
+		err = -ENOMEM;
+		goto out_prog;
+	}
 
 	gwj->handled_frames = 0;
 	gwj->dropped_frames = 0;
@@ -898,11 +980,17 @@ static int cgw_create_job(struct sk_buff *skb,  struct nlmsghdr *nlh,
 	ASSERT_RTNL();
 
 	err = cgw_register_filter(net, gwj);
-	if (!err)
-		hlist_add_head_rcu(&gwj->list, &net->can.cgw_list);
-out:
 	if (err)
-		kmem_cache_free(cgw_cache, gwj);
+		goto out;
+
+	hlist_add_head_rcu(&gwj->list, &net->can.cgw_list);
+	return 0;
+
+out:
+	kmem_cache_free(cgw_cache, gwj);
+out_prog:
+	if (mod.prog)
+		bpf_prog_put(mod.prog);
 
 	return err;
 }
@@ -917,7 +1005,7 @@ static void cgw_remove_all_jobs(struct net *net)
 	hlist_for_each_entry_safe(gwj, nx, &net->can.cgw_list, list) {
 		hlist_del(&gwj->list);
 		cgw_unregister_filter(net, gwj);
-		kmem_cache_free(cgw_cache, gwj);
+		cgw_job_free(gwj);
 	}
 }
 
@@ -954,7 +1042,8 @@ static int cgw_remove_job(struct sk_buff *skb, struct nlmsghdr *nlh,
 	/* two interface indices both set to 0 => remove all entries */
 	if (!ccgw.src_idx && !ccgw.dst_idx) {
 		cgw_remove_all_jobs(net);
-		return 0;
+		err = 0;
+		goto out;
 	}
 
 	err = -EINVAL;
@@ -986,11 +1075,15 @@ static int cgw_remove_job(struct sk_buff *skb, struct nlmsghdr *nlh,
 
 		hlist_del(&gwj->list);
 		cgw_unregister_filter(net, gwj);
-		kmem_cache_free(cgw_cache, gwj);
+		cgw_job_free(gwj);
 		err = 0;
 		break;
 	}
 
+out:
+	if (mod.prog)
+		bpf_prog_put(mod.prog);
+
 	return err;
 }
 
@@ -1057,6 +1150,7 @@ static __exit void cgw_module_exit(void)
 	unregister_netdevice_notifier(&notifier);
 
 	unregister_pernet_subsys(&cangw_pernet_ops);
+
 	rcu_barrier(); /* Wait for completion of call_rcu()'s */
 
 	kmem_cache_destroy(cgw_cache);
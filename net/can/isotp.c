@@ -0,0 +1,1423 @@
+// SPDX-License-Identifier: (GPL-2.0 OR BSD-3-Clause)
+/*
+ * isotp.c - ISO 15765-2 CAN transport protocol for protocol family CAN
+ *
+ * This implementation does not provide ISO-TP specific return values to the
+ * userspace.
+ *
+ * - RX path timeout of data reception leads to -ETIMEDOUT
+ * - RX path SN mismatch leads to -EILSEQ
+ * - RX path data reception with wrong padding leads to -EBADMSG
+ * - TX path flowcontrol reception timeout leads to -ECOMM
+ * - TX path flowcontrol reception overflow leads to -EMSGSIZE
+ * - TX path flowcontrol reception with wrong layout/padding leads to -EBADMSG
+ * - when a transfer (tx) is on the run the next write() blocks until it's done
+ * - use CAN_ISOTP_WAIT_TX_DONE flag to block the caller until the PDU is sent
+ * - as we have static buffers the check whether the PDU fits into the buffer
+ *   is done at FF reception time (no support for sending 'wait frames')
+ *
+ * The flow control timing (STmin, N_Bs, N_Cr) is driven by softirq based
+ * hrtimers, so it does not depend on the scheduling of the sending or
+ * receiving process. Received PDUs are reassembled directly into the skb
+ * that is queued to the socket, there is no intermediate buffer.
+ */
+
+#include <linux/module.h>
+#include <linux/init.h>
+#include <linux/interrupt.h>
+#include <linux/hrtimer.h>
+#include <linux/wait.h>
+#include <linux/uio.h>
+#include <linux/net.h>
+#include <linux/netdevice.h>
+#include <linux/socket.h>
+#include <linux/if_arp.h>
+#include <linux/skbuff.h>
+#include <linux/can.h>
+#include <linux/can/core.h>
+#include <linux/can/skb.h>
+#include <linux/can/isotp.h>
+#include <linux/slab.h>
+#include <net/sock.h>
+#include <net/net_namespace.h>
+#include <asm/unaligned.h>
+
+#define CAN_ISOTP_VERSION "20181018"
+
+MODULE_DESCRIPTION("PF_CAN isotp 15765-2:2016 protocol");
+MODULE_LICENSE("Dual BSD/GPL");
+MODULE_ALIAS("can-proto-6");
+
+#define SINGLE_MASK(id) ((id & CAN_EFF_FLAG) ? \
+			 (CAN_EFF_MASK | CAN_EFF_FLAG | CAN_RTR_FLAG) : \
+			 (CAN_SFF_MASK | CAN_EFF_FLAG | CAN_RTR_FLAG))
+
+/*
+ * ISO 15765-2:2016 supports more than 4095 byte per ISO PDU as the FF_DL can
+ * take full 32 bit values (4 Gbyte). We would need some good concept to handle
+ * this between user space and kernel space. For now increase the static buffer
+ * to something about 8 kbyte to be able to test this new functionality.
+ */
+#define MAX_MSG_LENGTH 8200
+
+/* N_PCI type values in bits 7-4 of N_PCI bytes */
+#define N_PCI_SF 0x00	/* single frame */
+#define N_PCI_FF 0x10	/* first frame */
+#define N_PCI_CF 0x20	/* consecutive frame */
+#define N_PCI_FC 0x30	/* flow control */
+
+#define N_PCI_SZ 1	/* size of the PCI byte #1 */
+#define SF_PCI_SZ4 1	/* size of SingleFrame PCI including 4 bit SF_DL */
+#define SF_PCI_SZ8 2	/* size of SingleFrame PCI including 8 bit SF_DL */
+#define FF_PCI_SZ12 2	/* size of FirstFrame PCI including 12 bit FF_DL */
+#define FF_PCI_SZ32 6	/* size of FirstFrame PCI including 32 bit FF_DL */
+#define FC_CONTENT_SZ 3	/* flow control content size in byte (FS/BS/STmin) */
+
+#define ISOTP_CHECK_PADDING (CAN_ISOTP_CHK_PAD_LEN | CAN_ISOTP_CHK_PAD_DATA)
+
+/* Flow Status given in FC frame */
+#define ISOTP_FC_CTS 0		/* clear to send */
+#define ISOTP_FC_WT 1		/* wait */
+#define ISOTP_FC_OVFLW 2	/* overflow */
+
+/* N_Bs and N_Cr timeout */
+#define ISOTP_TIMEOUT ktime_set(1, 0)
+
+/* retry delay when the CAN interface queue is full */
+#define ISOTP_TX_BACKOFF ktime_set(0, 100 * NSEC_PER_USEC)
+
+enum {
+	ISOTP_IDLE = 0,
+	ISOTP_PREPARING,	/* tx: write() is filling the buffer */
+	ISOTP_WAIT_FIRST_FC,
+	ISOTP_WAIT_FC,
+	ISOTP_WAIT_DATA,
+	ISOTP_SENDING
+};
+
+struct tpcon {
+	unsigned int idx;
+	unsigned int len;
+	u32 state;
+	u8 bs;
+	u8 sn;
+	u8 ll_dl;
+};
+
+struct isotp_sock {
+	struct sock sk;
+	int bound;
+	int ifindex;
+	canid_t txid;
+	canid_t rxid;
+	ktime_t tx_gap;
+	ktime_t lastrxcf_tstamp;
+	struct hrtimer rxtimer, txtimer;
+	struct can_isotp_options opt;
+	struct can_isotp_fc_options rxfc, txfc;
+	struct can_isotp_ll_options ll;
+	u32 force_tx_stmin;
+	u32 force_rx_stmin;
+	struct tpcon rx, tx;
+	struct sk_buff *rx_skb;		/* PDU under reassembly */
+	spinlock_t lock;		/* protects the rx/tx state machines */
+	struct notifier_block notifier;
+	wait_queue_head_t wait;
+	u8 tx_buf[MAX_MSG_LENGTH];
+};
+
+static inline struct isotp_sock *isotp_sk(const struct sock *sk)
+{
+	return (struct isotp_sock *)sk;
+}
+
+/* valid CAN (FD) frame data length for a given payload length */
+static u8 padlen(u8 datalen)
+{
+	if (datalen <= CAN_MAX_DLEN)
+		return CAN_MAX_DLEN;
+
+	/* 12, 16, 20, 24 */
+	if (datalen <= 24)
+		return (datalen + 3) & ~3;
+
+	if (datalen <= 32)
+		return 32;
+
+	if (datalen <= 48)
+		return 48;
+
+	return CANFD_MAX_DLEN;
+}
+
+static void isotp_report_error(struct isotp_sock *so, int err)
+{
+	struct sock *sk = &so->sk;
+
+	sk->sk_err = err;
+	if (!sock_flag(sk, SOCK_DEAD))
+		sk->sk_error_report(sk);
+}
+
+/* set the frame length for @len bytes of content and pad if needed */
+static void isotp_fill_frame(struct isotp_sock *so, struct canfd_frame *cf,
+			     u8 len)
+{
+	u8 plen = len;
+
+	/* CAN FD frames only exist with the lengths padlen() returns */
+	if ((so->opt.flags & CAN_ISOTP_TX_PADDING) || len > CAN_MAX_DLEN) {
+		plen = padlen(len);
+		memset(cf->data + len, so->opt.txpad_content, plen - len);
+	}
+
+	cf->len = plen;
+
+	if (so->ll.mtu == CANFD_MTU)
+		cf->flags = so->ll.tx_flags;
+}
+
+static struct sk_buff *isotp_alloc_frame(struct isotp_sock *so,
+					 struct net_device *dev)
+{
+	struct sk_buff *skb;
+
+	skb = alloc_skb(so->ll.mtu + sizeof(struct can_skb_priv), GFP_ATOMIC);
+	if (!skb)
+		return NULL;
+
+	can_skb_reserve(skb);
+	can_skb_prv(skb)->ifindex = dev->ifindex;
+	can_skb_prv(skb)->skbcnt = 0;
+
+	skb->dev = dev;
+	can_skb_set_owner(skb, &so->sk);
+	skb_put_zero(skb, so->ll.mtu);
+
+	return skb;
+}
+
+static bool isotp_pad_ok(struct isotp_sock *so, struct canfd_frame *cf,
+			 int start_idx)
+{
+	u32 flags = so->opt.flags;
+	int i;
+
+	if (!(flags & CAN_ISOTP_RX_PADDING)) {
+		/* the sender is expected to use optimized frame lengths */
+		if (flags & CAN_ISOTP_CHK_PAD_LEN) {
+			u8 len = start_idx;
+
+			if (len > CAN_MAX_DLEN)
+				len = padlen(len);
+
+			return cf->len == len;
+		}
+		return true;
+	}
+
+	if ((flags & CAN_ISOTP_CHK_PAD_LEN) && cf->len != padlen(cf->len))
+		return false;
+
+	if (flags & CAN_ISOTP_CHK_PAD_DATA) {
+		for (i = start_idx; i < cf->len; i++)
+			if (cf->data[i] != so->opt.rxpad_content)
+				return false;
+	}
+
+	return true;
+}
+
+static int isotp_send_fc(struct isotp_sock *so, int ae, u8 flowstatus)
+{
+	struct net_device *dev;
+	struct sk_buff *skb;
+	struct canfd_frame *ncf;
+	int err;
+
+	dev = dev_get_by_index(sock_net(&so->sk), so->ifindex);
+	if (!dev)
+		return -ENXIO;
+
+	skb = isotp_alloc_frame(so, dev);
+	if (!skb) {
+		dev_put(dev);
+		return -ENOMEM;
+	}
+
+	ncf = (struct canfd_frame *)skb->data;
+
+	/* create & send flow control reply */
+	ncf->can_id = so->txid;
+
+	if (ae)
+		ncf->data[0] = so->opt.ext_address;
+
+	ncf->data[ae] = N_PCI_FC | flowstatus;
+	ncf->data[ae + 1] = so->rxfc.bs;
+	ncf->data[ae + 2] = so->rxfc.stmin;
+
+	isotp_fill_frame(so, ncf, ae + FC_CONTENT_SZ);
+
+	err = can_send(skb, 1);
+	dev_put(dev);
+
+	return err;
+}
+
+/* (re)start waiting for the next block of consecutive frames */
+static void isotp_rx_wait_cf(struct isotp_sock *so)
+{
+	so->rx.bs = 0;
+	so->lastrxcf_tstamp = 0;
+	hrtimer_start(&so->rxtimer, ISOTP_TIMEOUT, HRTIMER_MODE_REL_SOFT);
+}
+
+static void isotp_rx_reset(struct isotp_sock *so)
+{
+	so->rx.state = ISOTP_IDLE;
+	kfree_skb(so->rx_skb);
+	so->rx_skb = NULL;
+}
+
+static void isotp_rcv_skb(struct isotp_sock *so, struct sk_buff *skb)
+{
+	struct sockaddr_can *addr;
+
+	sock_skb_cb_check_size(sizeof(struct sockaddr_can));
+	addr = (struct sockaddr_can *)skb->cb;
+	memset(addr, 0, sizeof(*addr));
+	addr->can_family = AF_CAN;
+	addr->can_ifindex = so->ifindex;
+
+	if (sock_queue_rcv_skb(&so->sk, skb) < 0)
+		kfree_skb(skb);
+}
+
+static void isotp_tx_done(struct isotp_sock *so, int err)
+{
+	if (err)
+		isotp_report_error(so, err);
+
+	so->tx.state = ISOTP_IDLE;
+	wake_up_interruptible(&so->wait);
+}
+
+static void isotp_rcv_fc(struct isotp_sock *so, struct canfd_frame *cf, int ae)
+{
+	if (so->tx.state != ISOTP_WAIT_FC &&
+	    so->tx.state != ISOTP_WAIT_FIRST_FC)
+		return;
+
+	if (cf->len < ae + FC_CONTENT_SZ ||
+	    ((so->opt.flags & ISOTP_CHECK_PADDING) &&
+	     !isotp_pad_ok(so, cf, ae + FC_CONTENT_SZ))) {
+		/* malformed PDU - report 'not a data message' */
+		hrtimer_try_to_cancel(&so->txtimer);
+		isotp_tx_done(so, EBADMSG);
+		return;
+	}
+
+	/* get communication parameters only from the first FC frame */
+	if (so->tx.state == ISOTP_WAIT_FIRST_FC) {
+		so->txfc.bs = cf->data[ae + 1];
+		so->txfc.stmin = cf->data[ae + 2];
+
+		/* fix wrong STmin values according spec */
+		if (so->txfc.stmin > 0x7F &&
+		    (so->txfc.stmin < 0xF1 || so->txfc.stmin > 0xF9))
+			so->txfc.stmin = 0x7F;
+
+		if (so->opt.flags & CAN_ISOTP_FORCE_TXSTMIN)
+			so->tx_gap = ktime_set(0, so->force_tx_stmin);
+		else if (so->txfc.stmin < 0x80)
+			so->tx_gap = ktime_set(0, so->txfc.stmin *
+					       NSEC_PER_MSEC);
+		else
+			so->tx_gap = ktime_set(0, (so->txfc.stmin - 0xF0) *
+					       100 * NSEC_PER_USEC);
+
+		so->tx_gap = ktime_add_ns(so->tx_gap, so->opt.frame_txtime);
+		so->tx.state = ISOTP_WAIT_FC;
+	}
+
+	switch (cf->data[ae] & 0x0F) {
+	case ISOTP_FC_CTS:
+		so->tx.bs = 0;
+		so->tx.state = ISOTP_SENDING;
+		/* start cyclic timer for sending CF frame */
+		hrtimer_start(&so->txtimer, 0, HRTIMER_MODE_REL_SOFT);
+		break;
+
+	case ISOTP_FC_WT:
+		/* start timer to wait for next FC frame */
+		hrtimer_start(&so->txtimer, ISOTP_TIMEOUT,
+			      HRTIMER_MODE_REL_SOFT);
+		break;
+
+	case ISOTP_FC_OVFLW:
+		/* overflow on receiver side - report 'message too long' */
+		hrtimer_try_to_cancel(&so->txtimer);
+		isotp_tx_done(so, EMSGSIZE);
+		break;
+
+	default:
+		/* stop this tx job - report 'not a data message' */
+		hrtimer_try_to_cancel(&so->txtimer);
+		isotp_tx_done(so, EBADMSG);
+	}
+}
+
+static void isotp_rcv_sf(struct isotp_sock *so, struct canfd_frame *cf,
+			 int pcilen, struct sk_buff *fskb, unsigned int len)
+{
+	struct sk_buff *skb;
+
+	/* a single frame ends any reception in progress */
+	hrtimer_try_to_cancel(&so->rxtimer);
+	isotp_rx_reset(so);
+
+	if (!len || len > cf->len - pcilen)
+		return;
+
+	if ((so->opt.flags & ISOTP_CHECK_PADDING) &&
+	    !isotp_pad_ok(so, cf, pcilen + len)) {
+		/* malformed PDU - report 'not a data message' */
+		isotp_report_error(so, EBADMSG);
+		return;
+	}
+
+	skb = alloc_skb(len, GFP_ATOMIC);
+	if (!skb)
+		return;
+
+	skb_put_data(skb, &cf->data[pcilen], len);
+	skb->tstamp = fskb->tstamp;
+
+	isotp_rcv_skb(so, skb);
+}
+
+static void isotp_rcv_ff(struct isotp_sock *so, struct canfd_frame *cf, int ae)
+{
+	unsigned int len, ff_pci_sz, off;
+	struct sk_buff *skb;
+
+	hrtimer_try_to_cancel(&so->rxtimer);
+	isotp_rx_reset(so);
+
+	/* get the used sender LL_DL from the (first) CAN frame data length */
+	so->rx.ll_dl = padlen(cf->len);
+
+	/* the first frame has to use the entire frame up to LL_DL length */
+	if (cf->len != so->rx.ll_dl)
+		return;
+
+	/* get the FF_DL */
+	len = (cf->data[ae] & 0x0F) << 8;
+	len += cf->data[ae + 1];
+
+	/* Check for FF_DL escape sequence supporting 32 bit PDU length */
+	if (len) {
+		ff_pci_sz = FF_PCI_SZ12;
+	} else {
+		/* FF_DL = 0 => get real length from next 4 bytes */
+		len = get_unaligned_be32(&cf->data[ae + 2]);
+		ff_pci_sz = FF_PCI_SZ32;
+	}
+
+	/* take care of a potential SF_DL ESC offset for TX_DL > 8 */
+	off = (so->rx.ll_dl > CAN_MAX_DLEN) ? 1 : 0;
+
+	/* this PDU would have fit into a single frame */
+	if (len + ae + off + ff_pci_sz < so->rx.ll_dl)
+		return;
+
+	if (len > MAX_MSG_LENGTH) {
+		/* send FC frame with overflow status */
+		if (!(so->opt.flags & CAN_ISOTP_LISTEN_MODE))
+			isotp_send_fc(so, ae, ISOTP_FC_OVFLW);
+		return;
+	}
+
+	/* the PDU is reassembled in the skb that is queued to the socket */
+	skb = alloc_skb(len, GFP_ATOMIC);
+	if (!skb) {
+		if (!(so->opt.flags & CAN_ISOTP_LISTEN_MODE))
+			isotp_send_fc(so, ae, ISOTP_FC_OVFLW);
+		return;
+	}
+
+	/* copy the first received data bytes */
+	skb_put_data(skb, &cf->data[ae + ff_pci_sz],
+		     min_t(unsigned int, len, so->rx.ll_dl - ae - ff_pci_sz));
+
+	so->rx_skb = skb;
+	so->rx.len = len;
+	so->rx.sn = 1;
+	so->rx.state = ISOTP_WAIT_DATA;
+
+	/* no creation of flow control frames in listen mode */
+	if (!(so->opt.flags & CAN_ISOTP_LISTEN_MODE))
+		isotp_send_fc(so, ae, ISOTP_FC_CTS);
+
+	isotp_rx_wait_cf(so);
+}
+
+static void isotp_rcv_cf(struct isotp_sock *so, struct canfd_frame *cf,
+			 int ae, struct sk_buff *fskb)
+{
+	struct sk_buff *skb = so->rx_skb;
+	unsigned int count, space;
+
+	if (so->rx.state != ISOTP_WAIT_DATA)
+		return;
+
+	/* CFs are never longer than the FF */
+	if (cf->len > so->rx.ll_dl)
+		return;
+
+	space = so->rx.ll_dl - ae - N_PCI_SZ;
+
+	/* CFs have usually the LL_DL length, only the last may be shorter */
+	if (cf->len < so->rx.ll_dl && so->rx.len - skb->len > space)
+		return;
+
+	if (so->opt.flags & CAN_ISOTP_FORCE_RXSTMIN) {
+		ktime_t now = ktime_get();
+
+		/* ignore CFs that arrive faster than the forced rx stmin */
+		if (so->lastrxcf_tstamp &&
+		    ktime_to_ns(ktime_sub(now, so->lastrxcf_tstamp)) <
+		    so->force_rx_stmin)
+			return;
+
+		so->lastrxcf_tstamp = now;
+	}
+
+	hrtimer_try_to_cancel(&so->rxtimer);
+
+	if ((cf->data[ae] & 0x0F) != so->rx.sn) {
+		/* wrong sn detected - report 'illegal byte sequence' */
+		isotp_report_error(so, EILSEQ);
+		isotp_rx_reset(so);
+		return;
+	}
+	so->rx.sn = (so->rx.sn + 1) & 0x0F;
+
+	count = min_t(unsigned int, so->rx.len - skb->len,
+		      min_t(unsigned int, cf->len - ae - N_PCI_SZ, space));
+	skb_put_data(skb, &cf->data[ae + N_PCI_SZ], count);
+
+	if (skb->len >= so->rx.len) {
+		if ((so->opt.flags & ISOTP_CHECK_PADDING) &&
+		    !isotp_pad_ok(so, cf, ae + N_PCI_SZ + count)) {
+			/* malformed PDU - report 'not a data message' */
+			isotp_report_error(so, EBADMSG);
+			isotp_rx_reset(so);
+			return;
+		}
+
+		/* we are done */
+		so->rx_skb = NULL;
+		so->rx.state = ISOTP_IDLE;
+		skb->tstamp = fskb->tstamp;
+		isotp_rcv_skb(so, skb);
+		return;
+	}
+
+	/* perform blocksize handling, if enabled */
+	if (!so->rxfc.bs || ++so->rx.bs < so->rxfc.bs) {
+		/* start rx timeout watchdog */
+		hrtimer_start(&so->rxtimer, ISOTP_TIMEOUT,
+			      HRTIMER_MODE_REL_SOFT);
+		return;
+	}
+
+	/* we reached the specified blocksize so->rxfc.bs */
+	if (!(so->opt.flags & CAN_ISOTP_LISTEN_MODE))
+		isotp_send_fc(so, ae, ISOTP_FC_CTS);
+
+	isotp_rx_wait_cf(so);
+}
+
+static void isotp_rcv(struct sk_buff *skb, void *data)
+{
+	struct sock *sk = (struct sock *)data;
+	struct isotp_sock *so = isotp_sk(sk);
+	struct canfd_frame *cf;
+	int ae = (so->opt.flags & CAN_ISOTP_EXTEND_ADDR) ? 1 : 0;
+	u8 n_pci_type, sf_dl;
+
+	/*
+	 * Strictly receive only frames with the configured MTU size
+	 * => clear separation of CAN2.0 / CAN FD transport channels
+	 */
+	if (skb->len != so->ll.mtu)
+		return;
+
+	cf = (struct canfd_frame *)skb->data;
+
+	/* there has to be at least the N_PCI byte */
+	if (cf->len <= ae)
+		return;
+
+	/* if enabled: check reception of my configured extended address */
+	if (ae && cf->data[0] != so->opt.rx_ext_address)
+		return;
+
+	n_pci_type = cf->data[ae] & 0xF0;
+
+	spin_lock(&so->lock);
+
+	if (so->opt.flags & CAN_ISOTP_HALF_DUPLEX) {
+		/* check rx/tx path half duplex expectations */
+		if ((so->tx.state != ISOTP_IDLE && n_pci_type != N_PCI_FC) ||
+		    (so->rx.state != ISOTP_IDLE && n_pci_type == N_PCI_FC))
+			goto out_unlock;
+	}
+
+	switch (n_pci_type) {
+	case N_PCI_FC:
+		/* tx path: flow control frame containing the FC parameters */
+		isotp_rcv_fc(so, cf, ae);
+		break;
+
+	case N_PCI_SF:
+		/*
+		 * rx path: single frame
+		 *
+		 * As we do not have a rx.ll_dl configuration, we can only test
+		 * if the CAN frames payload length matches the LL_DL == 8
+		 * requirements - no matter if it's CAN 2.0 or CAN FD
+		 */
+		sf_dl = cf->data[ae] & 0x0F;
+
+		if (cf->len <= CAN_MAX_DLEN) {
+			isotp_rcv_sf(so, cf, SF_PCI_SZ4 + ae, skb, sf_dl);
+		} else if (skb->len == CANFD_MTU && !sf_dl) {
+			/*
+			 * We have a CAN FD frame and CAN_DL is greater than 8:
+			 * Only frames with the SF_DL == 0 ESC value are valid.
+			 * The real SF_DL is in the byte after the N_PCI.
+			 */
+			isotp_rcv_sf(so, cf, SF_PCI_SZ8 + ae, skb,
+				     cf->data[SF_PCI_SZ4 + ae]);
+		}
+		break;
+
+	case N_PCI_FF:
+		/* rx path: first frame */
+		isotp_rcv_ff(so, cf, ae);
+		break;
+
+	case N_PCI_CF:
+		/* rx path: consecutive frame */
+		isotp_rcv_cf(so, cf, ae, skb);
+		break;
+	}
+
+out_unlock:
+	spin_unlock(&so->lock);
+}
+
+static enum hrtimer_restart isotp_rx_timer_handler(struct hrtimer *hrtimer)
+{
+	struct isotp_sock *so = container_of(hrtimer, struct isotp_sock,
+					     rxtimer);
+
+	spin_lock(&so->lock);
+
+	/* re-armed by isotp_rcv() while we were waiting for the lock */
+	if (!hrtimer_is_queued(hrtimer) && so->rx.state == ISOTP_WAIT_DATA) {
+		/* N_Cr timeout - report 'timer expired' */
+		isotp_report_error(so, ETIMEDOUT);
+		isotp_rx_reset(so);
+	}
+
+	spin_unlock(&so->lock);
+
+	return HRTIMER_NORESTART;
+}
+
+/* send the next consecutive frame, called with so->lock held */
+static int isotp_send_cframe(struct isotp_sock *so)
+{
+	int ae = (so->opt.flags & CAN_ISOTP_EXTEND_ADDR) ? 1 : 0;
+	struct net_device *dev;
+	struct canfd_frame *cf;
+	struct sk_buff *skb;
+	unsigned int num;
+	int err;
+
+	dev = dev_get_by_index(sock_net(&so->sk), so->ifindex);
+	if (!dev)
+		return -ENXIO;
+
+	skb = isotp_alloc_frame(so, dev);
+	if (!skb) {
+		dev_put(dev);
+		return -ENOBUFS;
+	}
+
+	cf = (struct canfd_frame *)skb->data;
+
+	/* create consecutive frame */
+	num = min_t(unsigned int, so->tx.len - so->tx.idx,
+		    so->tx.ll_dl - ae - N_PCI_SZ);
+
+	cf->can_id = so->txid;
+
+	if (ae)
+		cf->data[0] = so->opt.ext_address;
+
+	cf->data[ae] = N_PCI_CF | so->tx.sn;
+	memcpy(&cf->data[ae + N_PCI_SZ], &so->tx_buf[so->tx.idx], num);
+
+	isotp_fill_frame(so, cf, ae + N_PCI_SZ + num);
+
+	err = can_send(skb, 1);
+	dev_put(dev);
+	if (err)
+		return err;
+
+	so->tx.idx += num;
+	so->tx.sn = (so->tx.sn + 1) & 0x0F;
+	so->tx.bs++;
+
+	return 0;
+}
+
+static enum hrtimer_restart isotp_tx_timer_handler(struct hrtimer *hrtimer)
+{
+	struct isotp_sock *so = container_of(hrtimer, struct isotp_sock,
+					     txtimer);
+	enum hrtimer_restart restart = HRTIMER_NORESTART;
+	int err;
+
+	spin_lock(&so->lock);
+
+	/* re-armed by isotp_rcv() while we were waiting for the lock */
+	if (hrtimer_is_queued(hrtimer))
+		goto out_unlock;
+
+	switch (so->tx.state) {
+	case ISOTP_WAIT_FC:
+	case ISOTP_WAIT_FIRST_FC:
+		/* N_Bs timeout - report 'communication error on send' */
+		isotp_tx_done(so, ECOMM);
+		break;
+
+	case ISOTP_SENDING:
+		/* without separation time send the block in one go */
+		do {
+			err = isotp_send_cframe(so);
+			if (err == -ENOBUFS) {
+				/* interface queue is full, retry shortly */
+				hrtimer_forward_now(hrtimer, ISOTP_TX_BACKOFF);
+				restart = HRTIMER_RESTART;
+				goto out_unlock;
+			}
+
+			if (err) {
+				isotp_tx_done(so, -err);
+				goto out_unlock;
+			}
+
+			if (so->tx.idx >= so->tx.len) {
+				/* we are done */
+				isotp_tx_done(so, 0);
+				goto out_unlock;
+			}
+
+			if (so->txfc.bs && so->tx.bs >= so->txfc.bs) {
+				/* stop and wait for FC with timeout */
+				so->tx.state = ISOTP_WAIT_FC;
+				hrtimer_forward_now(hrtimer, ISOTP_TIMEOUT);
+				restart = HRTIMER_RESTART;
+				goto out_unlock;
+			}
+		} while (!so->tx_gap);
+
+		/* send the next CF after the separation time */
+		hrtimer_forward_now(hrtimer, so->tx_gap);
+		restart = HRTIMER_RESTART;
+		break;
+
+	default:
+		break;
+	}
+
+out_unlock:
+	spin_unlock(&so->lock);
+
+	return restart;
+}
+
+/* wait until no other PDU is being sent and take over the tx path */
+static int isotp_tx_claim(struct isotp_sock *so, int noblock)
+{
+	int err;
+
+	spin_lock_bh(&so->lock);
+
+	while (so->tx.state != ISOTP_IDLE) {
+		spin_unlock_bh(&so->lock);
+
+		if (noblock)
+			return -EAGAIN;
+
+		err = wait_event_interruptible(so->wait,
+					       so->tx.state == ISOTP_IDLE);
+		if (err)
+			return err;
+
+		spin_lock_bh(&so->lock);
+	}
+
+	so->tx.state = ISOTP_PREPARING;
+
+	spin_unlock_bh(&so->lock);
+
+	return 0;
+}
+
+static void isotp_tx_release(struct isotp_sock *so)
+{
+	spin_lock_bh(&so->lock);
+	hrtimer_try_to_cancel(&so->txtimer);
+	isotp_tx_done(so, 0);
+	spin_unlock_bh(&so->lock);
+}
+
+static int isotp_sendmsg(struct socket *sock, struct msghdr *msg, size_t size)
+{
+	struct sock *sk = sock->sk;
+	struct isotp_sock *so = isotp_sk(sk);
+	int ae = (so->opt.flags & CAN_ISOTP_EXTEND_ADDR) ? 1 : 0;
+	struct net_device *dev;
+	struct canfd_frame *cf;
+	struct sk_buff *skb;
+	unsigned int ff_pci_sz, num;
+	bool single = true;
+	int err;
+
+	if (!so->bound)
+		return -EADDRNOTAVAIL;
+
+	if (!size || size > MAX_MSG_LENGTH)
+		return -EINVAL;
+
+	/* we do not support multiple buffers - for now */
+	err = isotp_tx_claim(so, msg->msg_flags & MSG_DONTWAIT);
+	if (err)
+		return err;
+
+	err = memcpy_from_msg(so->tx_buf, msg, size);
+	if (err < 0)
+		goto err_release;
+
+	dev = dev_get_by_index(sock_net(sk), so->ifindex);
+	if (!dev) {
+		err = -ENXIO;
+		goto err_release;
+	}
+
+	skb = sock_alloc_send_skb(sk, so->ll.mtu + sizeof(struct can_skb_priv),
+				  msg->msg_flags & MSG_DONTWAIT, &err);
+	if (!skb) {
+		dev_put(dev);
+		goto err_release;
+	}
+
+	can_skb_reserve(skb);
+	can_skb_prv(skb)->ifindex = dev->ifindex;
+	can_skb_prv(skb)->skbcnt = 0;
+
+	cf = skb_put_zero(skb, so->ll.mtu);
+
+	so->tx.ll_dl = so->ll.tx_dl;
+	so->tx.len = size;
+	so->tx.idx = 0;
+
+	cf->can_id = so->txid;
+
+	if (ae)
+		cf->data[0] = so->opt.ext_address;
+
+	if (size + SF_PCI_SZ4 + ae <= CAN_MAX_DLEN) {
+		/* single frame with 4 bit SF_DL */
+		cf->data[ae] = N_PCI_SF | size;
+		memcpy(&cf->data[ae + SF_PCI_SZ4], so->tx_buf, size);
+		isotp_fill_frame(so, cf, ae + SF_PCI_SZ4 + size);
+	} else if (so->tx.ll_dl > CAN_MAX_DLEN &&
+		   size + SF_PCI_SZ8 + ae <= so->tx.ll_dl) {
+		/* CAN FD single frame with SF_DL escape sequence */
+		cf->data[ae] = N_PCI_SF;
+		cf->data[ae + SF_PCI_SZ4] = size;
+		memcpy(&cf->data[ae + SF_PCI_SZ8], so->tx_buf, size);
+		isotp_fill_frame(so, cf, ae + SF_PCI_SZ8 + size);
+	} else {
+		/* first frame, the rest follows on flow control */
+		single = false;
+
+		if (size > 4095) {
+			/* use 32 bit FF_DL notation */
+			cf->data[ae] = N_PCI_FF;
+			cf->data[ae + 1] = 0;
+			put_unaligned_be32(size, &cf->data[ae + 2]);
+			ff_pci_sz = FF_PCI_SZ32;
+		} else {
+			/* use 12 bit FF_DL notation */
+			cf->data[ae] = N_PCI_FF | (size >> 8);
+			cf->data[ae + 1] = size & 0xFF;
+			ff_pci_sz = FF_PCI_SZ12;
+		}
+
+		/* the first frame uses the entire LL_DL */
+		num = so->tx.ll_dl - ff_pci_sz - ae;
+		memcpy(&cf->data[ae + ff_pci_sz], so->tx_buf, num);
+		isotp_fill_frame(so, cf, so->tx.ll_dl);
+
+		so->tx.idx = num;
+		so->tx.sn = 1;
+
+		/* be ready for the FC before the FF is on the bus */
+		spin_lock_bh(&so->lock);
+		so->tx.state = ISOTP_WAIT_FIRST_FC;
+		hrtimer_start(&so->txtimer, ISOTP_TIMEOUT,
+			      HRTIMER_MODE_REL_SOFT);
+		spin_unlock_bh(&so->lock);
+	}
+
+	sock_tx_timestamp(sk, sk->sk_tsflags, &skb_shinfo(skb)->tx_flags);
+
+	skb->dev = dev;
+	skb->sk = sk;
+	skb->priority = sk->sk_priority;
+
+	err = can_send(skb, 1);
+	dev_put(dev);
+	if (err)
+		goto err_release;
+
+	if (single)
+		isotp_tx_release(so);
+
+	if (so->opt.flags & CAN_ISOTP_WAIT_TX_DONE) {
+		/* wait for complete transmission of current pdu */
+		err = wait_event_interruptible(so->wait,
+					       so->tx.state == ISOTP_IDLE);
+		if (err)
+			return err;
+
+		err = sock_error(sk);
+		if (err)
+			return err;
+	}
+
+	return size;
+
+err_release:
+	isotp_tx_release(so);
+	return err;
+}
+
+static int isotp_recvmsg(struct socket *sock, struct msghdr *msg, size_t size,
+			 int flags)
+{
+	struct sock *sk = sock->sk;
+	struct sk_buff *skb;
+	int err = 0;
+	int noblock;
+
+	noblock = flags & MSG_DONTWAIT;
+	flags &= ~MSG_DONTWAIT;
+
+	skb = skb_recv_datagram(sk, flags, noblock, &err);
+	if (!skb)
+		return err;
+
+	if (size < skb->len)
+		msg->msg_flags |= MSG_TRUNC;
+	else
+		size = skb->len;
+
+	err = memcpy_to_msg(msg, skb->data, size);
+	if (err < 0) {
+		skb_free_datagram(sk, skb);
+		return err;
+	}
+
+	sock_recv_timestamp(msg, sk, skb);
+
+	if (msg->msg_name) {
+		__sockaddr_check_size(sizeof(struct sockaddr_can));
+		msg->msg_namelen = sizeof(struct sockaddr_can);
+		memcpy(msg->msg_name, skb->cb, msg->msg_namelen);
+	}
+
+	skb_free_datagram(sk, skb);
+
+	return size;
+}
+
+static int isotp_release(struct socket *sock)
+{
+	struct sock *sk = sock->sk;
+	struct isotp_sock *so;
+	struct net *net;
+
+	if (!sk)
+		return 0;
+
+	so = isotp_sk(sk);
+	net = sock_net(sk);
+
+	/* wait for complete transmission of current pdu */
+	wait_event_interruptible(so->wait, so->tx.state == ISOTP_IDLE);
+
+	unregister_netdevice_notifier(&so->notifier);
+
+	lock_sock(sk);
+
+	/* remove current filters & unregister */
+	if (so->bound) {
+		struct net_device *dev;
+
+		dev = dev_get_by_index(net, so->ifindex);
+		if (dev) {
+			can_rx_unregister(net, dev, so->rxid,
+					  SINGLE_MASK(so->rxid),
+					  isotp_rcv, sk);
+			dev_put(dev);
+		}
+	}
+
+	/* The filter may also have been dropped by the netdevice notifier
+	 * just before. isotp_rcv() can not arm the timers after this point.
+	 */
+	synchronize_rcu();
+
+	hrtimer_cancel(&so->txtimer);
+	hrtimer_cancel(&so->rxtimer);
+
+	kfree_skb(so->rx_skb);
+	so->rx_skb = NULL;
+
+	so->ifindex = 0;
+	so->bound = 0;
+
+	sock_orphan(sk);
+	sock->sk = NULL;
+
+	release_sock(sk);
+	sock_put(sk);
+
+	return 0;
+}
+
+static int isotp_bind(struct socket *sock, struct sockaddr *uaddr, int len)
+{
+	struct sockaddr_can *addr = (struct sockaddr_can *)uaddr;
+	struct sock *sk = sock->sk;
+	struct isotp_sock *so = isotp_sk(sk);
+	struct net *net = sock_net(sk);
+	struct net_device *dev;
+	canid_t rx_id, tx_id;
+	int notify_enetdown = 0;
+	int err = 0;
+
+	if (len < sizeof(*addr))
+		return -EINVAL;
+
+	if (addr->can_family != AF_CAN)
+		return -EINVAL;
+
+	/* sanitize tx/rx CAN identifiers */
+	tx_id = addr->can_addr.tp.tx_id;
+	if (tx_id & CAN_EFF_FLAG)
+		tx_id &= (CAN_EFF_FLAG | CAN_EFF_MASK);
+	else
+		tx_id &= CAN_SFF_MASK;
+
+	rx_id = addr->can_addr.tp.rx_id;
+	if (rx_id & CAN_EFF_FLAG)
+		rx_id &= (CAN_EFF_FLAG | CAN_EFF_MASK);
+	else
+		rx_id &= CAN_SFF_MASK;
+
+	if (!addr->can_ifindex)
+		return -ENODEV;
+
+	lock_sock(sk);
+
+	if (so->bound) {
+		err = -EINVAL;
+		goto out;
+	}
+
+	/* do not register frame reception for functional addressing */
+	if (rx_id == tx_id && !(so->opt.flags & CAN_ISOTP_EXTEND_ADDR)) {
+		err = -EADDRNOTAVAIL;
+		goto out;
+	}
+
+	dev = dev_get_by_index(net, addr->can_ifindex);
+	if (!dev) {
+		err = -ENODEV;
+		goto out;
+	}
+
+	if (dev->type != ARPHRD_CAN || dev->mtu < so->ll.mtu) {
+		dev_put(dev);
+		err = -ENODEV;
+		goto out;
+	}
+
+	if (!(dev->flags & IFF_UP))
+		notify_enetdown = 1;
+
+	so->ifindex = dev->ifindex;
+	so->rxid = rx_id;
+	so->txid = tx_id;
+
+	err = can_rx_register(net, dev, rx_id, SINGLE_MASK(rx_id),
+			      isotp_rcv, sk, "isotp", sk);
+	dev_put(dev);
+
+	if (!err)
+		so->bound = 1;
+
+out:
+	release_sock(sk);
+
+	if (notify_enetdown) {
+		sk->sk_err = ENETDOWN;
+		if (!sock_flag(sk, SOCK_DEAD))
+			sk->sk_error_report(sk);
+	}
+
+	return err;
+}
+
+static int isotp_getname(struct socket *sock, struct sockaddr *uaddr,
+			 int peer)
+{
+	struct sockaddr_can *addr = (struct sockaddr_can *)uaddr;
+	struct sock *sk = sock->sk;
+	struct isotp_sock *so = isotp_sk(sk);
+
+	if (peer)
+		return -EOPNOTSUPP;
+
+	memset(addr, 0, sizeof(*addr));
+	addr->can_family = AF_CAN;
+	addr->can_ifindex = so->ifindex;
+	addr->can_addr.tp.rx_id = so->rxid;
+	addr->can_addr.tp.tx_id = so->txid;
+
+	return sizeof(*addr);
+}
+
+static int isotp_setsockopt(struct socket *sock, int level, int optname,
+			    char __user *optval, unsigned int optlen)
+{
+	struct sock *sk = sock->sk;
+	struct isotp_sock *so = isotp_sk(sk);
+	struct can_isotp_ll_options ll;
+	int err = 0;
+
+	if (level != SOL_CAN_ISOTP)
+		return -EINVAL;
+
+	lock_sock(sk);
+
+	if (so->bound) {
+		err = -EISCONN;
+		goto out;
+	}
+
+	switch (optname) {
+	case CAN_ISOTP_OPTS:
+		if (optlen != sizeof(struct can_isotp_options)) {
+			err = -EINVAL;
+			break;
+		}
+
+		if (copy_from_user(&so->opt, optval, optlen)) {
+			err = -EFAULT;
+			break;
+		}
+
+		/* no separate rx_ext_address is given => use ext_address */
+		if (!(so->opt.flags & CAN_ISOTP_RX_EXT_ADDR))
+			so->opt.rx_ext_address = so->opt.ext_address;
+		break;
+
+	case CAN_ISOTP_RECV_FC:
+		if (optlen != sizeof(struct can_isotp_fc_options)) {
+			err = -EINVAL;
+			break;
+		}
+
+		if (copy_from_user(&so->rxfc, optval, optlen))
+			err = -EFAULT;
+		break;
+
+	case CAN_ISOTP_TX_STMIN:
+		if (optlen != sizeof(u32)) {
+			err = -EINVAL;
+			break;
+		}
+
+		if (copy_from_user(&so->force_tx_stmin, optval, optlen))
+			err = -EFAULT;
+		break;
+
+	case CAN_ISOTP_RX_STMIN:
+		if (optlen != sizeof(u32)) {
+			err = -EINVAL;
+			break;
+		}
+
+		if (copy_from_user(&so->force_rx_stmin, optval, optlen))
+			err = -EFAULT;
+		break;
+
+	case CAN_ISOTP_LL_OPTS:
+		if (optlen != sizeof(struct can_isotp_ll_options)) {
+			err = -EINVAL;
+			break;
+		}
+
+		if (copy_from_user(&ll, optval, optlen)) {
+			err = -EFAULT;
+			break;
+		}
+
+		/* check for correct ISO 11898-1 DLC data length */
+		if (ll.tx_dl != padlen(ll.tx_dl) ||
+		    (ll.mtu != CAN_MTU && ll.mtu != CANFD_MTU) ||
+		    (ll.mtu == CAN_MTU && ll.tx_dl > CAN_MAX_DLEN)) {
+			err = -EINVAL;
+			break;
+		}
+
+		memcpy(&so->ll, &ll, sizeof(ll));
+		break;
+
+	default:
+		err = -ENOPROTOOPT;
+	}
+
+out:
+	release_sock(sk);
+
+	return err;
+}
+
+static int isotp_getsockopt(struct socket *sock, int level, int optname,
+			    char __user *optval, int __user *optlen)
+{
+	struct sock *sk = sock->sk;
+	struct isotp_sock *so = isotp_sk(sk);
+	int len;
+	void *val;
+
+	if (level != SOL_CAN_ISOTP)
+		return -EINVAL;
+	if (get_user(len, optlen))
+		return -EFAULT;
+	if (len < 0)
+		return -EINVAL;
+
+	switch (optname) {
+	case CAN_ISOTP_OPTS:
+		len = min_t(int, len, sizeof(struct can_isotp_options));
+		val = &so->opt;
+		break;
+
+	case CAN_ISOTP_RECV_FC:
+		len = min_t(int, len, sizeof(struct can_isotp_fc_options));
+		val = &so->rxfc;
+		break;
+
+	case CAN_ISOTP_TX_STMIN:
+		len = min_t(int, len, sizeof(u32));
+		val = &so->force_tx_stmin;
+		break;
+
+	case CAN_ISOTP_RX_STMIN:
+		len = min_t(int, len, sizeof(u32));
+		val = &so->force_rx_stmin;
+		break;
+
+	case CAN_ISOTP_LL_OPTS:
+		len = min_t(int, len, sizeof(struct can_isotp_ll_options));
+		val = &so->ll;
+		break;
+
+	default:
+		return -ENOPROTOOPT;
+	}
+
+	if (put_user(len, optlen))
+		return -EFAULT;
+	if (copy_to_user(optval, val, len))
+		return -EFAULT;
+	return 0;
+}
+
+static int isotp_notifier(struct notifier_block *nb, unsigned long msg,
+			  void *ptr)
+{
+	struct net_device *dev = netdev_notifier_info_to_dev(ptr);
+	struct isotp_sock *so = container_of(nb, struct isotp_sock, notifier);
+	struct sock *sk = &so->sk;
+
+	if (!net_eq(dev_net(dev), sock_net(sk)))
+		return NOTIFY_DONE;
+
+	if (dev->type != ARPHRD_CAN)
+		return NOTIFY_DONE;
+
+	if (so->ifindex != dev->ifindex)
+		return NOTIFY_DONE;
+
+	switch (msg) {
+	case NETDEV_UNREGISTER:
+		lock_sock(sk);
+		/* remove current filters & unregister */
+		if (so->bound)
+			can_rx_unregister(dev_net(dev), dev, so->rxid,
+					  SINGLE_MASK(so->rxid),
+					  isotp_rcv, sk);
+
+		so->ifindex = 0;
+		so->bound = 0;
+		release_sock(sk);
+
+		sk->sk_err = ENODEV;
+		if (!sock_flag(sk, SOCK_DEAD))
+			sk->sk_error_report(sk);
+		break;
+
+	case NETDEV_DOWN:
+		sk->sk_err = ENETDOWN;
+		if (!sock_flag(sk, SOCK_DEAD))
+			sk->sk_error_report(sk);
+		break;
+	}
+
+	return NOTIFY_DONE;
+}
+
+static int isotp_init(struct sock *sk)
+{
+	struct isotp_sock *so = isotp_sk(sk);
+
+	so->ifindex = 0;
+	so->bound = 0;
+
+	so->opt.flags = CAN_ISOTP_DEFAULT_FLAGS;
+	so->opt.ext_address = CAN_ISOTP_DEFAULT_EXT_ADDRESS;
+	so->opt.rx_ext_address = CAN_ISOTP_DEFAULT_EXT_ADDRESS;
+	so->opt.rxpad_content = CAN_ISOTP_DEFAULT_PAD_CONTENT;
+	so->opt.txpad_content = CAN_ISOTP_DEFAULT_PAD_CONTENT;
+	so->opt.frame_txtime = CAN_ISOTP_DEFAULT_FRAME_TXTIME;
+	so->rxfc.bs = CAN_ISOTP_DEFAULT_RECV_BS;
+	so->rxfc.stmin = CAN_ISOTP_DEFAULT_RECV_STMIN;
+	so->rxfc.wftmax = CAN_ISOTP_DEFAULT_RECV_WFTMAX;
+	so->ll.mtu = CAN_ISOTP_DEFAULT_LL_MTU;
+	so->ll.tx_dl = CAN_ISOTP_DEFAULT_LL_TX_DL;
+	so->ll.tx_flags = CAN_ISOTP_DEFAULT_LL_TX_FLAGS;
+
+	so->rx.state = ISOTP_IDLE;
+	so->tx.state = ISOTP_IDLE;
+	so->rx_skb = NULL;
+
+	hrtimer_init(&so->rxtimer, CLOCK_MONOTONIC, HRTIMER_MODE_REL_SOFT);
+	so->rxtimer.function = isotp_rx_timer_handler;
+	hrtimer_init(&so->txtimer, CLOCK_MONOTONIC, HRTIMER_MODE_REL_SOFT);
+	so->txtimer.function = isotp_tx_timer_handler;
+
+	spin_lock_init(&so->lock);
+	init_waitqueue_head(&so->wait);
+
+	/* set notifier */
+	so->notifier.notifier_call = isotp_notifier;
+	register_netdevice_notifier(&so->notifier);
+
+	return 0;
+}
+
+static __poll_t isotp_poll(struct file *file, struct socket *sock,
+			   poll_table *wait)
+{
+	struct sock *sk = sock->sk;
+	struct isotp_sock *so = isotp_sk(sk);
+	__poll_t mask = datagram_poll(file, sock, wait);
+
+	poll_wait(file, &so->wait, wait);
+
+	/* only writable when no other PDU is being sent */
+	if ((mask & EPOLLWRNORM) && so->tx.state != ISOTP_IDLE)
+		mask &= ~(EPOLLOUT | EPOLLWRNORM);
+
+	return mask;
+}
+
+static const struct proto_ops isotp_ops = {
+	.family        = PF_CAN,
+	.release       = isotp_release,
+	.bind          = isotp_bind,
+	.connect       = sock_no_connect,
+	.socketpair    = sock_no_socketpair,
+	.accept        = sock_no_accept,
+	.getname       = isotp_getname,
+	.poll          = isotp_poll,
+	.ioctl         = can_ioctl,	/* use can_ioctl() from af_can.c */
+	.listen        = sock_no_listen,
+	.shutdown      = sock_no_shutdown,
+	.setsockopt    = isotp_setsockopt,
+	.getsockopt    = isotp_getsockopt,
+	.sendmsg       = isotp_sendmsg,
+	.recvmsg       = isotp_recvmsg,
+	.mmap          = sock_no_mmap,
+	.sendpage      = sock_no_sendpage,
+};
+
+static struct proto isotp_proto __read_mostly = {
+	.name       = "CAN_ISOTP",
+	.owner      = THIS_MODULE,
+	.obj_size   = sizeof(struct isotp_sock),
+	.init       = isotp_init,
+};
+
+static const struct can_proto isotp_can_proto = {
+	.type       = SOCK_DGRAM,
+	.protocol   = CAN_ISOTP,
+	.ops        = &isotp_ops,
+	.prot       = &isotp_proto,
+};
+
+static __init int isotp_module_init(void)
+{
+	int err;
+
+	pr_info("can: isotp protocol (rev " CAN_ISOTP_VERSION ")\n");
+
+	err = can_proto_register(&isotp_can_proto);
+	if (err < 0)
+		pr_err("can: registration of isotp protocol failed\n");
+
+	return err;
+}
+
+static __exit void isotp_module_exit(void)
+{
+	can_proto_unregister(&isotp_can_proto);
+}
+
+module_init(isotp_module_init);
+module_exit(isotp_module_exit);
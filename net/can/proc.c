@@ -75,6 +75,44 @@ static const char rx_list_name[][8] = {
  * af_can statistics stuff
  */
 
+void can_sum_stats(struct net *net, struct can_pcpu_stats *sum)
+{
+	int cpu;
+
+	memset(sum, 0, sizeof(*sum));
+
+	for_each_possible_cpu(cpu) {
+		const struct can_pcpu_stats *pcpu;
+
+		pcpu = per_cpu_ptr(net->can.can_pcpu_stats, cpu);
+		sum->rx_frames += READ_ONCE(pcpu->rx_frames);
+		sum->tx_frames += READ_ONCE(pcpu->tx_frames);
+		sum->matches += READ_ONCE(pcpu->matches);
+	}
+}
+
+/* fold the per-CPU counters into the values since the last reset */
+static void can_fold_stats(struct net *net)
+{
+	struct s_stats *can_stats = net->can.can_stats;
+	struct can_pcpu_stats sum;
+	unsigned long rx_frames, tx_frames, matches;
+
+	can_sum_stats(net, &sum);
+
+	rx_frames = sum.rx_frames - can_stats->base.rx_frames;
+	tx_frames = sum.tx_frames - can_stats->base.tx_frames;
+	matches = sum.matches - can_stats->base.matches;
+
+	can_stats->rx_frames_delta = rx_frames - can_stats->rx_frames;
+	can_stats->tx_frames_delta = tx_frames - can_stats->tx_frames;
+	can_stats->matches_delta = matches - can_stats->matches;
+
+	can_stats->rx_frames = rx_frames;
+	can_stats->tx_frames = tx_frames;
+	can_stats->matches = matches;
+}
+
 static void can_init_stats(struct net *net)
 {
 	struct s_stats *can_stats = net->can.can_stats;
@@ -85,6 +123,7 @@ static void can_init_stats(struct net *net)
 	 * context (reading the proc_fs when can_stattimer is disabled).
 	 */
 	memset(can_stats, 0, sizeof(struct s_stats));
+	can_sum_stats(net, &can_stats->base);
 	can_stats->jiffies_init = jiffies;
 
 	can_pstats->stats_reset++;
@@ -121,6 +160,8 @@ void can_stat_update(struct timer_list *t)
 	struct s_stats *can_stats = net->can.can_stats;
 	unsigned long j = jiffies; /* snapshot */
 
+	can_fold_stats(net);
+
 	/* restart counting in timer context on user request */
 	if (user_reset)
 		can_init_stats(net);
@@ -170,11 +211,6 @@ void can_stat_update(struct timer_list *t)
 	if (can_stats->max_rx_match_ratio < can_stats->current_rx_match_ratio)
 		can_stats->max_rx_match_ratio = can_stats->current_rx_match_ratio;
 
-	/* clear values for 'current rate' calculation */
-	can_stats->tx_frames_delta = 0;
-	can_stats->rx_frames_delta = 0;
-	can_stats->matches_delta   = 0;
-
 	/* restart timer (one second) */
 	mod_timer(&net->can.can_stattimer, round_jiffies(jiffies + HZ));
 }
@@ -213,11 +249,17 @@ static int can_stats_proc_show(struct seq_file *m, void *v)
 	struct net *net = m->private;
 	struct s_stats *can_stats = net->can.can_stats;
 	struct s_pstats *can_pstats = net->can.can_pstats;
+	struct can_pcpu_stats sum;
+
+	can_sum_stats(net, &sum);
 
 	seq_putc(m, '\n');
-	seq_printf(m, " %8ld transmitted frames (TXF)\n", can_stats->tx_frames);
-	seq_printf(m, " %8ld received frames (RXF)\n", can_stats->rx_frames);
-	seq_printf(m, " %8ld matched frames (RXMF)\n", can_stats->matches);
+	seq_printf(m, " %8ld transmitted frames (TXF)\n",
+		   sum.tx_frames - can_stats->base.tx_frames);
+	seq_printf(m, " %8ld received frames (RXF)\n",
+		   sum.rx_frames - can_stats->base.rx_frames);
+	seq_printf(m, " %8ld matched frames (RXMF)\n",
+		   sum.matches - can_stats->base.matches);
 
 	seq_putc(m, '\n');
 
@@ -3378,6 +3378,7 @@ static int xdp_do_generic_redirect_map(struct net_device *dev,
 	} else if (map->map_type == BPF_MAP_TYPE_XSKMAP) {
 		struct xdp_sock *xs = fwd;
 
+		sk_mark_napi_id_once(&xs->sk, skb);
 		err = xsk_generic_rcv(xs, xdp);
 		if (err)
 			goto err;
@@ -5014,6 +5015,16 @@ bpf_base_func_proto(enum bpf_func_id func_id)
 		return &bpf_map_pop_elem_proto;
 	case BPF_FUNC_map_peek_elem:
 		return &bpf_map_peek_elem_proto;
+	case BPF_FUNC_ringbuf_output:
+		return &bpf_ringbuf_output_proto;
+	case BPF_FUNC_ringbuf_reserve:
+		return &bpf_ringbuf_reserve_proto;
+	case BPF_FUNC_ringbuf_submit:
+		return &bpf_ringbuf_submit_proto;
+	case BPF_FUNC_ringbuf_discard:
+		return &bpf_ringbuf_discard_proto;
+	case BPF_FUNC_ringbuf_query:
+		return &bpf_ringbuf_query_proto;
 	case BPF_FUNC_get_prandom_u32:
 		return &bpf_get_prandom_u32_proto;
 	case BPF_FUNC_get_smp_processor_id:
@@ -5024,6 +5035,14 @@ bpf_base_func_proto(enum bpf_func_id func_id)
 		return &bpf_tail_call_proto;
 	case BPF_FUNC_ktime_get_ns:
 		return &bpf_ktime_get_ns_proto;
+	case BPF_FUNC_spin_lock:
+		if (capable(CAP_SYS_ADMIN))
+			return &bpf_spin_lock_proto;
+		return NULL;
+	case BPF_FUNC_spin_unlock:
+		if (capable(CAP_SYS_ADMIN))
+			return &bpf_spin_unlock_proto;
+		return NULL;
 	case BPF_FUNC_trace_printk:
 		if (capable(CAP_SYS_ADMIN))
 			return bpf_get_trace_printk_proto();
@@ -1009,6 +1009,52 @@ struct ubuf_info *sock_zerocopy_realloc(struct sock *sk, size_t size,
 }
 EXPORT_SYMBOL_GPL(sock_zerocopy_realloc);
 
+/* Datagrams sent with one sendmmsg() call share a single ubuf_info, so
+ * that the batch is accounted against the locked page limit once and
+ * completes with a single notification. The first datagram allocates
+ * it and leaves a reference in msg->msg_ubuf, the caller of sendmmsg()
+ * drops that reference once the last datagram is queued.
+ */
+struct ubuf_info *sock_zerocopy_batch(struct sock *sk, size_t size,
+				      struct msghdr *msg)
+{
+	struct ubuf_info *uarg = msg->msg_ubuf;
+
+	if (uarg) {
+		u32 next = uarg->id + uarg->len;
+
+		/* the socket is not locked, so the range can only be
+		 * extended if no other send took a notification id since
+		 */
+		if (uarg->len < USHRT_MAX - 1 &&
+		    size <= U32_MAX - uarg->bytelen &&
+		    atomic_cmpxchg(&sk->sk_zckey, next, next + 1) == next) {
+			if (mm_account_pinned_pages(&uarg->mmp, size)) {
+				/* the id may not be the last one any more,
+				 * keep it in the range that is notified
+				 */
+				uarg->len++;
+				return NULL;
+			}
+			uarg->len++;
+			uarg->bytelen += size;
+			sock_zerocopy_get(uarg);
+			return uarg;
+		}
+
+		msg->msg_ubuf = NULL;
+		sock_zerocopy_put(uarg);
+	}
+
+	uarg = sock_zerocopy_alloc(sk, size);
+	if (uarg && msg->msg_flags & MSG_BATCH) {
+		sock_zerocopy_get(uarg);
+		msg->msg_ubuf = uarg;
+	}
+	return uarg;
+}
+EXPORT_SYMBOL_GPL(sock_zerocopy_batch);
+
 static bool skb_zerocopy_notify_extend(struct sk_buff *skb, u32 lo, u16 len)
 {
 	struct sock_exterr_skb *serr = SKB_EXT_ERR(skb);
@@ -1093,9 +1139,14 @@ void sock_zerocopy_put_abort(struct ubuf_info *uarg)
 {
 	if (uarg) {
 		struct sock *sk = skb_from_uarg(uarg)->sk;
+		u32 next = uarg->id + uarg->len;
 
-		atomic_dec(&sk->sk_zckey);
-		uarg->len--;
+		/* UDP sends without the socket lock. Give the id back only
+		 * if no other send took a newer one, else it stays in the
+		 * range of this notification.
+		 */
+		if (atomic_cmpxchg(&sk->sk_zckey, next, next - 1) == next)
+			uarg->len--;
 
 		sock_zerocopy_put(uarg);
 	}
@@ -1105,6 +1156,12 @@ EXPORT_SYMBOL_GPL(sock_zerocopy_put_abort);
 extern int __zerocopy_sg_from_iter(struct sock *sk, struct sk_buff *skb,
 				   struct iov_iter *from, size_t length);
 
+int skb_zerocopy_iter_dgram(struct sk_buff *skb, struct msghdr *msg, int len)
+{
+	return __zerocopy_sg_from_iter(skb->sk, skb, &msg->msg_iter, len);
+}
+EXPORT_SYMBOL_GPL(skb_zerocopy_iter_dgram);
+
 int skb_zerocopy_iter_stream(struct sock *sk, struct sk_buff *skb,
 			     struct msghdr *msg, int len,
 			     struct ubuf_info *uarg)
@@ -11,6 +11,7 @@
 #include <linux/idr.h>
 #include <linux/filter.h>
 #include <linux/rcupdate.h>
+#include <net/ip.h>
 
 #define INIT_SOCKS 128
 
@@ -84,6 +85,7 @@ int reuseport_alloc(struct sock *sk, bool bind_inany)
 
 	reuse->socks[0] = sk;
 	reuse->num_socks = 1;
+	reuse->incoming_cpu = sk->sk_incoming_cpu_pin;
 	reuse->bind_inany = bind_inany;
 	rcu_assign_pointer(sk->sk_reuseport_cb, reuse);
 
@@ -111,6 +113,7 @@ static struct sock_reuseport *reuseport_grow(struct sock_reuseport *reuse)
 	more_reuse->num_socks = reuse->num_socks;
 	more_reuse->prog = reuse->prog;
 	more_reuse->reuseport_id = reuse->reuseport_id;
+	more_reuse->incoming_cpu = reuse->incoming_cpu;
 	more_reuse->bind_inany = reuse->bind_inany;
 
 	memcpy(more_reuse->socks, reuse->socks,
@@ -179,6 +182,8 @@ int reuseport_add_sock(struct sock *sk, struct sock *sk2, bool bind_inany)
 	/* paired with smp_rmb() in reuseport_select_sock() */
 	smp_wmb();
 	reuse->num_socks++;
+	if (sk->sk_incoming_cpu_pin)
+		WRITE_ONCE(reuse->incoming_cpu, reuse->incoming_cpu + 1);
 	rcu_assign_pointer(sk->sk_reuseport_cb, reuse);
 
 	spin_unlock_bh(&reuseport_lock);
@@ -208,6 +213,9 @@ void reuseport_detach_sock(struct sock *sk)
 
 	for (i = 0; i < reuse->num_socks; i++) {
 		if (reuse->socks[i] == sk) {
+			if (sk->sk_incoming_cpu_pin)
+				WRITE_ONCE(reuse->incoming_cpu,
+					   reuse->incoming_cpu - 1);
 			reuse->socks[i] = reuse->socks[reuse->num_socks - 1];
 			reuse->num_socks--;
 			if (reuse->num_socks == 0)
@@ -219,6 +227,38 @@ void reuseport_detach_sock(struct sock *sk)
 }
 EXPORT_SYMBOL(reuseport_detach_sock);
 
+/* SO_INCOMING_CPU on a member of a reuseport group pins it to that cpu:
+ * keep track of how many members did so, the selection only has to look
+ * for a cpu match while there is at least one.  The receive path rewrites
+ * sk_incoming_cpu as well, so membership in the count is tracked with
+ * sk_incoming_cpu_pin, which only changes here under reuseport_lock once
+ * the sock is in a group.
+ */
+void reuseport_update_incoming_cpu(struct sock *sk, int val)
+{
+	struct sock_reuseport *reuse;
+	bool pin = val >= 0;
+
+	if (!rcu_access_pointer(sk->sk_reuseport_cb)) {
+		sk->sk_incoming_cpu_pin = pin;
+		WRITE_ONCE(sk->sk_incoming_cpu, val);
+		return;
+	}
+
+	spin_lock_bh(&reuseport_lock);
+	reuse = rcu_dereference_protected(sk->sk_reuseport_cb,
+					  lockdep_is_held(&reuseport_lock));
+	if (reuse && pin != sk->sk_incoming_cpu_pin) {
+		if (pin)
+			WRITE_ONCE(reuse->incoming_cpu, reuse->incoming_cpu + 1);
+		else
+			WRITE_ONCE(reuse->incoming_cpu, reuse->incoming_cpu - 1);
+	}
+	sk->sk_incoming_cpu_pin = pin;
+	WRITE_ONCE(sk->sk_incoming_cpu, val);
+	spin_unlock_bh(&reuseport_lock);
+}
+
 static struct sock *run_bpf_filter(struct sock_reuseport *reuse, u16 socks,
 				   struct bpf_prog *prog, struct sk_buff *skb,
 				   int hdr_len)
@@ -249,6 +289,38 @@ static struct sock *run_bpf_filter(struct sock_reuseport *reuse, u16 socks,
 	return reuse->socks[index];
 }
 
+/* Prefer the sock pinned to the receiving cpu with SO_INCOMING_CPU, so that
+ * the connection is accepted and served where its packets arrive. Start at
+ * the hashed slot so that groups with several socks per cpu still spread.
+ */
+static struct sock *reuseport_select_sock_by_hash(struct sock *sk,
+						  struct sock_reuseport *reuse,
+						  u32 hash, u16 socks)
+{
+	int cpu, i, j;
+
+	i = j = reciprocal_scale(hash, socks);
+	if (!READ_ONCE(reuse->incoming_cpu))
+		return reuse->socks[i];
+
+	cpu = raw_smp_processor_id();
+	do {
+		struct sock *sk2 = reuse->socks[i];
+
+		if (sk2->sk_incoming_cpu_pin &&
+		    READ_ONCE(sk2->sk_incoming_cpu) == cpu) {
+			NET_INC_STATS(sock_net(sk),
+				      LINUX_MIB_REUSEPORTINCOMINGCPU);
+			return sk2;
+		}
+		if (++i >= socks)
+			i = 0;
+	} while (i != j);
+
+	NET_INC_STATS(sock_net(sk), LINUX_MIB_REUSEPORTINCOMINGCPUMISS);
+	return reuse->socks[j];
+}
+
 /**
  *  reuseport_select_sock - Select a socket from an SO_REUSEPORT group.
  *  @sk: First socket in the group.
@@ -293,7 +365,8 @@ struct sock *reuseport_select_sock(struct sock *sk,
 select_by_hash:
 		/* no bpf or invalid bpf result: fall back to hash usage */
 		if (!sk2)
-			sk2 = reuse->socks[reciprocal_scale(hash, socks)];
+			sk2 = reuseport_select_sock_by_hash(sk, reuse, hash,
+							    socks);
 	}
 
 out:
@@ -17,6 +17,11 @@ typedef unsigned __bitwise lowpan_rx_result;
 #define LOWPAN_DISPATCH_FRAG1           0xc0
 #define LOWPAN_DISPATCH_FRAGN           0xe0
 
+#define LOWPAN_FRAG1_HEAD_SIZE		0x4
+#define LOWPAN_FRAGN_HEAD_SIZE		0x5
+/* datagram offsets are counted in 8 byte units in a u8 */
+#define LOWPAN_FRAG_OFFSETS		256
+
 struct frag_lowpan_compare_key {
 	u16 tag;
 	u16 d_size;
@@ -28,6 +33,13 @@ struct frag_lowpan_compare_key {
  */
 struct lowpan_frag_queue {
 	struct inet_frag_queue	q;
+
+	/* datagram is forwarded fragment by fragment, not reassembled */
+	bool			fwd;
+	DECLARE_BITMAP(fwd_seen, LOWPAN_FRAG_OFFSETS);
+	u16			fwd_tag;
+	struct ieee802154_addr	fwd_daddr;
+	struct ieee802154_addr	fwd_saddr;
 };
 
 int lowpan_frag_rcv(struct sk_buff *skb, const u8 frag_type);
@@ -24,9 +24,14 @@
 #include <linux/export.h>
 
 #include <net/ieee802154_netdev.h>
+#include <net/cfg802154.h>
 #include <net/6lowpan.h>
 #include <net/ipv6_frag.h>
 #include <net/inet_frag.h>
+#include <net/ip6_route.h>
+#include <net/inetpeer.h>
+#include <net/ndisc.h>
+#include <net/xfrm.h>
 
 #include "6lowpan_i.h"
 
@@ -48,9 +53,9 @@ static void lowpan_frag_init(struct inet_frag_queue *q, const void *a)
 static void lowpan_frag_expire(struct timer_list *t)
 {
 	struct inet_frag_queue *frag = from_timer(frag, t, timer);
-	struct frag_queue *fq;
+	struct lowpan_frag_queue *fq;
 
-	fq = container_of(frag, struct frag_queue, q);
+	fq = container_of(frag, struct lowpan_frag_queue, q);
 
 	spin_lock(&fq->q.lock);
 
@@ -273,6 +278,335 @@ static int lowpan_frag_reasm(struct lowpan_frag_queue *fq, struct sk_buff *prev,
 	return -1;
 }
 
+static bool lowpan_frag_fwd_lladdr(struct net_device *ldev,
+				   const struct in6_addr *nexthop,
+				   struct ieee802154_addr *daddr)
+{
+	struct lowpan_802154_neigh *llneigh;
+	struct neighbour *n;
+	bool ret = false;
+
+	n = neigh_lookup(&nd_tbl, nexthop, ldev);
+	if (!n)
+		return false;
+
+	read_lock_bh(&n->lock);
+	if (n->nud_state & NUD_VALID) {
+		llneigh = lowpan_802154_neigh(neighbour_priv(n));
+		if (lowpan_802154_is_valid_src_short_addr(llneigh->short_addr)) {
+			daddr->mode = IEEE802154_ADDR_SHORT;
+			daddr->short_addr = llneigh->short_addr;
+		} else {
+			daddr->mode = IEEE802154_ADDR_LONG;
+			ieee802154_be64_to_le64(&daddr->extended_addr, n->ha);
+		}
+		ret = true;
+	}
+	read_unlock_bh(&n->lock);
+	neigh_release(n);
+
+	return ret;
+}
+
+/* fragment_tag is otherwise only advanced by lowpan_xmit() under the
+ * lowpan interface's queue lock, take the same lock from the RX path.
+ */
+static u16 lowpan_frag_fwd_tag(struct net_device *ldev)
+{
+	struct netdev_queue *txq = netdev_get_tx_queue(ldev, 0);
+	u16 tag;
+
+	__netif_tx_lock(txq, smp_processor_id());
+	tag = lowpan_802154_dev(ldev)->fragment_tag++;
+	__netif_tx_unlock(txq);
+
+	return tag;
+}
+
+/* Hooks on the IPv6 forward path need the whole datagram */
+static bool lowpan_frag_fwd_nf_hooks(const struct net *net)
+{
+#ifdef CONFIG_NETFILTER
+	return rcu_access_pointer(net->nf.hooks_ipv6[NF_INET_FORWARD]) ||
+	       rcu_access_pointer(net->nf.hooks_ipv6[NF_INET_POST_ROUTING]);
+#else
+	return false;
+#endif
+}
+
+/* IPsec policies are checked and applied to the whole datagram */
+static bool lowpan_frag_fwd_xfrm(const struct net *net)
+{
+#ifdef CONFIG_XFRM
+	return net->xfrm.policy_count[XFRM_POLICY_FWD] ||
+	       net->xfrm.policy_count[XFRM_POLICY_OUT];
+#else
+	return false;
+#endif
+}
+
+/* Next hop of a datagram that is forwarded fragment by fragment */
+struct lowpan_frag_fwd_hop {
+	struct ieee802154_addr daddr;
+	struct ieee802154_addr saddr;
+	struct in6_addr nexthop;
+	struct dst_entry *dst;
+};
+
+/* Builds the FRAG1 for the next hop from a copy of the decompressed one:
+ * hop limit decremented, IPv6 header compressed again for the new
+ * link-layer addresses, fragment and MAC headers pushed. The tag is
+ * filled in by lowpan_frag_fwd_start(). Returns NULL if the frame, or
+ * the FRAGNs sized by the previous hop, would not fit.
+ */
+static struct sk_buff *lowpan_frag_fwd_frag1(struct sk_buff *skb,
+					     struct lowpan_frag_fwd_hop *hop)
+{
+	struct net_device *ldev = skb->dev;
+	struct net_device *wdev = lowpan_802154_dev(ldev)->wdev;
+	u16 d_size = lowpan_802154_cb(skb)->d_size;
+	struct ieee802154_hdr in_hdr, out_hdr;
+	struct ieee802154_mac_cb *cb;
+	struct sk_buff *frame;
+	u8 *frag_hdr;
+
+	if (ieee802154_hdr_peek(skb, &in_hdr) < 0)
+		return NULL;
+
+	frame = skb_copy_expand(skb, wdev->needed_headroom +
+				LOWPAN_FRAG1_HEAD_SIZE,
+				wdev->needed_tailroom, GFP_ATOMIC);
+	if (!frame)
+		return NULL;
+
+	ipv6_hdr(frame)->hop_limit--;
+	skb_set_transport_header(frame, sizeof(struct ipv6hdr));
+	if (lowpan_header_compress(frame, ldev, &hop->daddr,
+				   &hop->saddr) < 0)
+		goto err;
+
+	frag_hdr = skb_push(frame, LOWPAN_FRAG1_HEAD_SIZE);
+	frag_hdr[0] = LOWPAN_DISPATCH_FRAG1 | ((d_size >> 8) & 0x07);
+	frag_hdr[1] = d_size & 0xff;
+	skb_reset_network_header(frame);
+
+	cb = mac_cb_init(frame);
+	cb->type = IEEE802154_FC_TYPE_DATA;
+	cb->ackreq = wdev->ieee802154_ptr->ackreq;
+
+	if (wpan_dev_hard_header(frame, wdev, &hop->daddr, &hop->saddr,
+				 frame->len) < 0 ||
+	    ieee802154_hdr_peek(frame, &out_hdr) < 0)
+		goto err;
+
+	/* Eliding the source IID may no longer be possible, the header can
+	 * grow by up to 8 bytes.
+	 */
+	if (skb_tail_pointer(frame) - skb_network_header(frame) >
+	    ieee802154_max_payload(&out_hdr) ||
+	    ieee802154_max_payload(&out_hdr) <
+	    ieee802154_max_payload(&in_hdr))
+		goto err;
+
+	frame->dev = wdev;
+	frame->protocol = htons(ETH_P_IEEE802154);
+
+	return frame;
+err:
+	kfree_skb(frame);
+	return NULL;
+}
+
+/* Called with the decompressed FRAG1 of a datagram, before the queue is
+ * locked. If the datagram is routed to another hop on the same 6LoWPAN
+ * interface and needs nothing from ip6_forward() that can't be done on
+ * its first fragment, the FRAG1 for the next hop is returned and @hop
+ * holds a reference on the route. Anything else, including datagrams
+ * whose next hop is not resolved yet or whose FRAG1 grows past the frame
+ * size, takes the reassembly path and ip6_forward().
+ */
+static struct sk_buff *lowpan_frag_fwd_prepare(struct sk_buff *skb,
+					       struct lowpan_frag_fwd_hop *hop)
+{
+	struct net_device *ldev = skb->dev;
+	struct net *net = dev_net(ldev);
+	struct wpan_dev *wpan_dev = lowpan_802154_dev(ldev)->wdev->ieee802154_ptr;
+	u16 d_size = lowpan_802154_cb(skb)->d_size;
+	const struct ipv6hdr *hdr = ipv6_hdr(skb);
+	struct flowi6 fl6 = {
+		.flowi6_iif = ldev->ifindex,
+		.flowi6_mark = skb->mark,
+		.daddr = hdr->daddr,
+		.saddr = hdr->saddr,
+		.flowlabel = ip6_flowinfo(hdr),
+		.flowi6_proto = hdr->nexthdr,
+	};
+	struct sk_buff *frame;
+	struct dst_entry *dst;
+	struct rt6_info *rt;
+
+	if (!net_ieee802154_lowpan(net)->frags_forward)
+		return NULL;
+
+	/* hop limit expiry, router alert and proxy NDP are left to
+	 * ip6_forward(), so is anything netfilter or IPsec wants to see
+	 */
+	if (skb->pkt_type != PACKET_HOST ||
+	    !net->ipv6.devconf_all->forwarding ||
+	    net->ipv6.devconf_all->proxy_ndp ||
+	    hdr->hop_limit <= 1 || hdr->nexthdr == NEXTHDR_HOP ||
+	    ipv6_addr_is_multicast(&hdr->daddr) ||
+	    lowpan_frag_fwd_nf_hooks(net) || lowpan_frag_fwd_xfrm(net))
+		return NULL;
+
+	dst = ip6_route_input_lookup(net, ldev, &fl6, skb,
+				     RT6_LOOKUP_F_HAS_SADDR);
+	rt = (struct rt6_info *)dst;
+	if (dst->error || dst->dev != ldev ||
+	    rt->rt6i_flags & (RTF_LOCAL | RTF_ANYCAST) ||
+	    d_size > max_t(unsigned int, ip6_dst_mtu_forward(dst),
+			   IPV6_MIN_MTU))
+		goto out;
+	hop->nexthop = *rt6_nexthop(rt, &hdr->daddr);
+
+	hop->daddr.pan_id = wpan_dev->pan_id;
+	if (!lowpan_frag_fwd_lladdr(ldev, &hop->nexthop, &hop->daddr))
+		goto out;
+
+	hop->saddr.pan_id = wpan_dev->pan_id;
+	if (lowpan_802154_is_valid_src_short_addr(wpan_dev->short_addr)) {
+		hop->saddr.mode = IEEE802154_ADDR_SHORT;
+		hop->saddr.short_addr = wpan_dev->short_addr;
+	} else {
+		hop->saddr.mode = IEEE802154_ADDR_LONG;
+		hop->saddr.extended_addr = wpan_dev->extended_addr;
+	}
+
+	frame = lowpan_frag_fwd_frag1(skb, hop);
+	if (!frame)
+		goto out;
+
+	hop->dst = dst;
+	return frame;
+out:
+	dst_release(dst);
+	return NULL;
+}
+
+/* Under the queue lock: switches the queue to forwarding if the FRAG1
+ * is the first fragment of the datagram seen. Every following fragment
+ * is then sent on as it arrives.
+ */
+static bool lowpan_frag_fwd_start(struct lowpan_frag_queue *fq,
+				  struct sk_buff *skb, struct sk_buff *frame,
+				  const struct lowpan_frag_fwd_hop *hop)
+{
+	u16 d_size = lowpan_802154_cb(skb)->d_size;
+	__be16 tag;
+
+	if (fq->fwd || fq->q.fragments ||
+	    fq->q.flags & (INET_FRAG_COMPLETE | INET_FRAG_FIRST_IN))
+		return false;
+
+	fq->fwd_daddr = hop->daddr;
+	fq->fwd_saddr = hop->saddr;
+	fq->fwd_tag = lowpan_frag_fwd_tag(skb->dev);
+	tag = htons(fq->fwd_tag);
+	memcpy(skb_network_header(frame) + 2, &tag, sizeof(tag));
+
+	bitmap_zero(fq->fwd_seen, LOWPAN_FRAG_OFFSETS);
+	__set_bit(0, fq->fwd_seen);
+	fq->q.len = d_size;
+	fq->q.meat = skb->len;
+	fq->fwd = true;
+	if (fq->q.meat >= fq->q.len)
+		inet_frag_kill(&fq->q);
+
+	return true;
+}
+
+/* Once the queue was switched to forwarding, does what ip6_forward()
+ * would for the datagram. Incoming and outgoing devices are the same,
+ * so a redirect is sent, limited by destination here and by source
+ * inside ndisc_send_redirect().
+ */
+static void lowpan_frag_fwd_started(struct sk_buff *skb,
+				    struct lowpan_frag_fwd_hop *hop)
+{
+	const struct ipv6hdr *hdr = ipv6_hdr(skb);
+	struct net *net = dev_net(skb->dev);
+	struct inet_peer *peer;
+
+	peer = inet_getpeer_v6(net->ipv6.peers, &hdr->daddr, 1);
+	if (inet_peer_xrlim_allow(peer, 1 * HZ))
+		ndisc_send_redirect(skb, &hop->nexthop);
+	if (peer)
+		inet_putpeer(peer);
+
+	__IP6_INC_STATS(net, ip6_dst_idev(hop->dst),
+			IPSTATS_MIB_OUTFORWDATAGRAMS);
+	__IP6_ADD_STATS(net, ip6_dst_idev(hop->dst), IPSTATS_MIB_OUTOCTETS,
+			lowpan_802154_cb(skb)->d_size);
+}
+
+/* Turns a received FRAGN into the one for the next hop, under the queue
+ * lock: only the tag changes. Fragments are counted once per offset, so
+ * duplicates are dropped and don't release the queue early. Once all
+ * bytes of the datagram went through, the queue is released.
+ */
+static int lowpan_frag_fwd(struct lowpan_frag_queue *fq, struct sk_buff *skb)
+{
+	struct net_device *ldev = skb->dev;
+	struct net_device *wdev = lowpan_802154_dev(ldev)->wdev;
+	u16 d_size = lowpan_802154_cb(skb)->d_size;
+	u8 d_offset = lowpan_802154_cb(skb)->d_offset;
+	__be16 tag = htons(fq->fwd_tag);
+	unsigned int len = skb->len;
+	struct ieee802154_mac_cb *cb;
+	int rc;
+	u8 *frag_hdr;
+
+	if (fq->q.flags & INET_FRAG_COMPLETE)
+		return -ENOENT;
+
+	/* FRAG1 is offset 0 and was the first one seen */
+	if (test_bit(d_offset, fq->fwd_seen))
+		return -EEXIST;
+
+	if (d_offset * 8 + len > d_size)
+		return -EINVAL;
+
+	rc = skb_cow_head(skb, wdev->needed_headroom + LOWPAN_FRAGN_HEAD_SIZE);
+	if (rc)
+		return rc;
+
+	frag_hdr = skb_push(skb, LOWPAN_FRAGN_HEAD_SIZE);
+	frag_hdr[0] = LOWPAN_DISPATCH_FRAGN | ((d_size >> 8) & 0x07);
+	frag_hdr[1] = d_size & 0xff;
+	memcpy(frag_hdr + 2, &tag, sizeof(tag));
+	frag_hdr[4] = d_offset;
+	skb_reset_network_header(skb);
+
+	cb = mac_cb_init(skb);
+	cb->type = IEEE802154_FC_TYPE_DATA;
+	cb->ackreq = wdev->ieee802154_ptr->ackreq;
+
+	rc = wpan_dev_hard_header(skb, wdev, &fq->fwd_daddr, &fq->fwd_saddr,
+				  skb->len);
+	if (rc < 0)
+		return rc;
+
+	skb->dev = wdev;
+	skb->protocol = htons(ETH_P_IEEE802154);
+
+	__set_bit(d_offset, fq->fwd_seen);
+	fq->q.meat += len;
+	if (fq->q.meat >= fq->q.len)
+		inet_frag_kill(&fq->q);
+
+	return 0;
+}
+
 static int lowpan_frag_rx_handlers_result(struct sk_buff *skb,
 					  lowpan_rx_result res)
 {
@@ -390,13 +724,49 @@ int lowpan_frag_rcv(struct sk_buff *skb, u8 frag_type)
 
 	fq = fq_find(net, cb, &hdr.source, &hdr.dest);
 	if (fq != NULL) {
+		struct lowpan_frag_fwd_hop hop;
+		struct sk_buff *frame = NULL;
+		bool fwd, started = false;
 		int ret;
 
+		if (frag_type == LOWPAN_DISPATCH_FRAG1)
+			frame = lowpan_frag_fwd_prepare(skb, &hop);
+
 		spin_lock(&fq->q.lock);
-		ret = lowpan_frag_queue(fq, skb, frag_type);
+		if (frame)
+			started = lowpan_frag_fwd_start(fq, skb, frame, &hop);
+		fwd = fq->fwd;
+		if (started)
+			ret = 0;
+		else if (fwd)
+			ret = lowpan_frag_fwd(fq, skb);
+		else
+			ret = lowpan_frag_queue(fq, skb, frag_type);
 		spin_unlock(&fq->q.lock);
 
 		inet_frag_put(&fq->q);
+
+		if (frame) {
+			if (started)
+				lowpan_frag_fwd_started(skb, &hop);
+			else
+				consume_skb(frame);
+			dst_release(hop.dst);
+		}
+
+		if (fwd) {
+			if (ret < 0) {
+				kfree_skb(skb);
+				return -1;
+			}
+
+			if (started) {
+				consume_skb(skb);
+				skb = frame;
+			}
+			dev_queue_xmit(skb);
+			return 0;
+		}
 		return ret;
 	}
 
@@ -407,6 +777,9 @@ int lowpan_frag_rcv(struct sk_buff *skb, u8 frag_type)
 
 #ifdef CONFIG_SYSCTL
 
+static int zero;
+static int one = 1;
+
 static struct ctl_table lowpan_frags_ns_ctl_table[] = {
 	{
 		.procname	= "6lowpanfrag_high_thresh",
@@ -431,6 +804,15 @@ static struct ctl_table lowpan_frags_ns_ctl_table[] = {
 		.mode		= 0644,
 		.proc_handler	= proc_dointvec_jiffies,
 	},
+	{
+		.procname	= "6lowpanfrag_forward",
+		.data		= &init_net.ieee802154_lowpan.frags_forward,
+		.maxlen		= sizeof(int),
+		.mode		= 0644,
+		.proc_handler	= proc_dointvec_minmax,
+		.extra1		= &zero,
+		.extra2		= &one,
+	},
 	{ }
 };
 
@@ -466,6 +848,7 @@ static int __net_init lowpan_frags_ns_sysctl_register(struct net *net)
 		table[1].data = &ieee802154_lowpan->frags.low_thresh;
 		table[1].extra2 = &ieee802154_lowpan->frags.high_thresh;
 		table[2].data = &ieee802154_lowpan->frags.timeout;
+		table[3].data = &ieee802154_lowpan->frags_forward;
 
 		/* Don't export sysctls to unprivileged users */
 		if (net->user_ns != &init_user_ns)
@@ -602,7 +985,7 @@ int __init lowpan_net_frag_init(void)
 
 	lowpan_frags.constructor = lowpan_frag_init;
 	lowpan_frags.destructor = NULL;
-	lowpan_frags.qsize = sizeof(struct frag_queue);
+	lowpan_frags.qsize = sizeof(struct lowpan_frag_queue);
 	lowpan_frags.frag_expire = lowpan_frag_expire;
 	lowpan_frags.frags_cache_name = lowpan_frags_cache_name;
 	lowpan_frags.rhash_params = lowpan_rhash_params;
@@ -15,9 +15,6 @@
 
 #include "6lowpan_i.h"
 
-#define LOWPAN_FRAG1_HEAD_SIZE	0x4
-#define LOWPAN_FRAGN_HEAD_SIZE	0x5
-
 struct lowpan_addr_info {
 	struct ieee802154_addr daddr;
 	struct ieee802154_addr saddr;
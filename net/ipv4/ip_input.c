@@ -307,8 +307,73 @@ static inline bool ip_rcv_options(struct sk_buff *skb)
 	return true;
 }
 
+/* Packets of one flow tend to sit next to each other in a receive list.
+ * The first packet of such a run serves as hint for the ones behind it:
+ * with no policy rules and no L4 multipath hashing, the route only
+ * depends on the addresses, tos and mark, and the socket found by early
+ * demux only on the ports on top of that.
+ */
+static bool ip_can_use_hint(const struct sk_buff *skb, const struct iphdr *iph,
+			    const struct sk_buff *hint)
+{
+	const struct iphdr *hint_iph;
+
+	if (!hint || skb_dst(skb) || skb->dev != hint->dev ||
+	    skb->mark != hint->mark)
+		return false;
+
+	hint_iph = ip_hdr(hint);
+	return hint_iph->daddr == iph->daddr &&
+	       hint_iph->saddr == iph->saddr &&
+	       hint_iph->tos == iph->tos;
+}
+
+static struct sk_buff *ip_extract_route_hint(const struct net *net,
+					     struct sk_buff *skb)
+{
+	const struct rtable *rt = skb_rtable(skb);
+	const struct iphdr *iph = ip_hdr(skb);
+
+	/* Broadcast and multicast input routes depend on more than the
+	 * addresses, e.g. the protocol for IGMP.
+	 */
+	if (fib4_has_custom_rules(net) ||
+	    rt->rt_type == RTN_BROADCAST || rt->rt_type == RTN_MULTICAST ||
+	    ipv4_is_lbcast(iph->daddr) || ipv4_is_zeronet(iph->daddr))
+		return NULL;
+#ifdef CONFIG_IP_ROUTE_MULTIPATH
+	/* the L3 policy hashes ICMP errors on their inner header */
+	if (net->ipv4.sysctl_fib_multipath_hash_policy ||
+	    iph->protocol == IPPROTO_ICMP)
+		return NULL;
+#endif
+	return skb;
+}
+
+static void ip_use_sk_hint(struct sk_buff *skb, const struct sk_buff *hint)
+{
+	struct sock *sk = hint->sk;
+
+	/* Only take over sockets early demux attached */
+	if (!sk || (hint->destructor != sock_edemux &&
+		    hint->destructor != sock_efree))
+		return;
+
+	if (ip_hdr(hint)->protocol != ip_hdr(skb)->protocol ||
+	    !pskb_may_pull(skb, skb_transport_offset(skb) + sizeof(u32)) ||
+	    *(u32 *)skb_transport_header(skb) !=
+	    *(u32 *)skb_transport_header(hint))
+		return;
+
+	if (!refcount_inc_not_zero(&sk->sk_refcnt))
+		return;
+
+	skb->sk = sk;
+	skb->destructor = hint->destructor;
+}
+
 static int ip_rcv_finish_core(struct net *net, struct sock *sk,
-			      struct sk_buff *skb)
+			      struct sk_buff *skb, const struct sk_buff *hint)
 {
 	const struct iphdr *iph = ip_hdr(skb);
 	int (*edemux)(struct sk_buff *skb);
@@ -316,6 +381,17 @@ static int ip_rcv_finish_core(struct net *net, struct sock *sk,
 	struct rtable *rt;
 	int err;
 
+	if (ip_can_use_hint(skb, iph, hint)) {
+		if (net->ipv4.sysctl_ip_early_demux &&
+		    !skb->sk &&
+		    !ip_is_fragment(iph)) {
+			ip_use_sk_hint(skb, hint);
+			/* must reload iph, skb->head might have changed */
+			iph = ip_hdr(skb);
+		}
+		skb_dst_copy(skb, hint);
+	}
+
 	if (net->ipv4.sysctl_ip_early_demux &&
 	    !skb_dst(skb) &&
 	    !skb->sk &&
@@ -410,7 +486,7 @@ static int ip_rcv_finish(struct net *net, struct sock *sk, struct sk_buff *skb)
 	if (!skb)
 		return NET_RX_SUCCESS;
 
-	ret = ip_rcv_finish_core(net, sk, skb);
+	ret = ip_rcv_finish_core(net, sk, skb, NULL);
 	if (ret != NET_RX_DROP)
 		ret = dst_input(skb);
 	return ret;
@@ -526,10 +602,45 @@ int ip_rcv(struct sk_buff *skb, struct net_device *dev, struct packet_type *pt,
 		       ip_rcv_finish);
 }
 
-static void ip_sublist_rcv_finish(struct list_head *head)
+/* Local delivery of a list of packets sharing one route. Fragments take
+ * the single packet path through reassembly, everything else traverses
+ * LOCAL_IN as a list and is then handed to the protocol handlers.
+ */
+static void ip_list_local_deliver(struct net *net, struct net_device *dev,
+				  struct list_head *head)
+{
+	struct sk_buff *skb, *next;
+	struct list_head sublist;
+
+	INIT_LIST_HEAD(&sublist);
+	list_for_each_entry_safe(skb, next, head, list) {
+		if (ip_is_fragment(ip_hdr(skb))) {
+			skb_list_del_init(skb);
+			ip_local_deliver(skb);
+			continue;
+		}
+		list_move_tail(&skb->list, &sublist);
+	}
+
+	NF_HOOK_LIST(NFPROTO_IPV4, NF_INET_LOCAL_IN, net, NULL,
+		     &sublist, dev, NULL, ip_local_deliver_finish);
+
+	list_for_each_entry_safe(skb, next, &sublist, list) {
+		skb_list_del_init(skb);
+		ip_local_deliver_finish(net, NULL, skb);
+	}
+}
+
+static void ip_sublist_rcv_finish(struct net *net, struct list_head *head)
 {
 	struct sk_buff *skb, *next;
 
+	skb = list_first_entry(head, struct sk_buff, list);
+	if (skb_dst(skb)->input == ip_local_deliver) {
+		ip_list_local_deliver(net, skb->dev, head);
+		return;
+	}
+
 	list_for_each_entry_safe(skb, next, head, list) {
 		skb_list_del_init(skb);
 		dst_input(skb);
@@ -539,8 +650,8 @@ static void ip_sublist_rcv_finish(struct list_head *head)
 static void ip_list_rcv_finish(struct net *net, struct sock *sk,
 			       struct list_head *head)
 {
+	struct sk_buff *skb, *next, *hint = NULL;
 	struct dst_entry *curr_dst = NULL;
-	struct sk_buff *skb, *next;
 	struct list_head sublist;
 
 	INIT_LIST_HEAD(&sublist);
@@ -554,22 +665,24 @@ static void ip_list_rcv_finish(struct net *net, struct sock *sk,
 		skb = l3mdev_ip_rcv(skb);
 		if (!skb)
 			continue;
-		if (ip_rcv_finish_core(net, sk, skb) == NET_RX_DROP)
+		if (ip_rcv_finish_core(net, sk, skb, hint) == NET_RX_DROP)
 			continue;
 
 		dst = skb_dst(skb);
 		if (curr_dst != dst) {
 			/* dispatch old sublist */
 			if (!list_empty(&sublist))
-				ip_sublist_rcv_finish(&sublist);
+				ip_sublist_rcv_finish(net, &sublist);
 			/* start new sublist */
 			INIT_LIST_HEAD(&sublist);
 			curr_dst = dst;
 		}
 		list_add_tail(&skb->list, &sublist);
+		hint = ip_extract_route_hint(net, skb);
 	}
 	/* dispatch final sublist */
-	ip_sublist_rcv_finish(&sublist);
+	if (!list_empty(&sublist))
+		ip_sublist_rcv_finish(net, &sublist);
 }
 
 static void ip_sublist_rcv(struct list_head *head, struct net_device *dev,
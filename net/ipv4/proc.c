@@ -290,6 +290,9 @@ static const struct snmp_mib snmp4_net_list[] = {
 	SNMP_MIB_ITEM("TCPAckCompressed", LINUX_MIB_TCPACKCOMPRESSED),
 	SNMP_MIB_ITEM("TCPZeroWindowDrop", LINUX_MIB_TCPZEROWINDOWDROP),
 	SNMP_MIB_ITEM("TCPRcvQDrop", LINUX_MIB_TCPRCVQDROP),
+	SNMP_MIB_ITEM("TCPIdleShrink", LINUX_MIB_TCPIDLESHRINK),
+	SNMP_MIB_ITEM("ReusePortIncomingCPU", LINUX_MIB_REUSEPORTINCOMINGCPU),
+	SNMP_MIB_ITEM("ReusePortIncomingCPUMiss", LINUX_MIB_REUSEPORTINCOMINGCPUMISS),
 	SNMP_MIB_SENTINEL
 };
 
@@ -467,6 +467,7 @@ void tcp_init_transfer(struct sock *sk, int bpf_op)
 	tcp_call_bpf(sk, bpf_op, 0, NULL);
 	tcp_init_congestion_control(sk);
 	tcp_init_buffer_space(sk);
+	tcp_idle_shrink_init(sk);
 }
 
 static void tcp_tx_timestamp(struct sock *sk, u16 tsflags)
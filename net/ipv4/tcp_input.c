@@ -5090,6 +5090,21 @@ static int tcp_prune_queue(struct sock *sk)
 	return -1;
 }
 
+/* Collapse whatever an idle socket still holds in its receive queues,
+ * the application may not read it for a long time.
+ */
+void tcp_collapse_idle(struct sock *sk)
+{
+	struct tcp_sock *tp = tcp_sk(sk);
+
+	tcp_collapse_ofo_queue(sk);
+	if (!skb_queue_empty(&sk->sk_receive_queue))
+		tcp_collapse(sk, &sk->sk_receive_queue, NULL,
+			     skb_peek(&sk->sk_receive_queue),
+			     NULL,
+			     tp->copied_seq, tp->rcv_nxt);
+}
+
 static bool tcp_should_expand_sndbuf(const struct sock *sk)
 {
 	const struct tcp_sock *tp = tcp_sk(sk);
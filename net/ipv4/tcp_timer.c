@@ -640,18 +640,98 @@ void tcp_set_keepalive(struct sock *sk, int val)
 
 	if (val && !sock_flag(sk, SOCK_KEEPOPEN))
 		inet_csk_reset_keepalive_timer(sk, keepalive_time_when(tcp_sk(sk)));
-	else if (!val)
+	else if (!val) {
 		inet_csk_delete_keepalive_timer(sk);
+		tcp_idle_shrink_init(sk);
+	}
 }
 EXPORT_SYMBOL_GPL(tcp_set_keepalive);
 
+/* The keepalive timer doubles as idle timer when tcp_idle_shrink_time is
+ * set, make sure it fires no later than one idle period from now.
+ */
+void tcp_idle_shrink_init(struct sock *sk)
+{
+	u32 idle_time = sock_net(sk)->ipv4.sysctl_tcp_idle_shrink_time;
+
+	if (!idle_time)
+		return;
+
+	if (timer_pending(&sk->sk_timer) &&
+	    time_before_eq(sk->sk_timer.expires, jiffies + idle_time))
+		return;
+
+	inet_csk_reset_keepalive_timer(sk, idle_time);
+}
+
+/* Once a connection saw no data in either direction for
+ * tcp_idle_shrink_time, collapse what is left in its receive queues,
+ * let the buffer sizes fall back to their defaults and give the forward
+ * allocated memory back. Buffer autotuning grows them again as soon as
+ * traffic resumes. Returns the time until the next check, 0 if the
+ * socket does not need one.
+ */
+static u32 tcp_idle_shrink(struct sock *sk)
+{
+	struct inet_connection_sock *icsk = inet_csk(sk);
+	struct tcp_sock *tp = tcp_sk(sk);
+	struct net *net = sock_net(sk);
+	u32 idle_time, last, idle;
+	int before;
+
+	idle_time = net->ipv4.sysctl_tcp_idle_shrink_time;
+	if (!idle_time ||
+	    !((1 << sk->sk_state) & (TCPF_ESTABLISHED | TCPF_CLOSE_WAIT)))
+		return 0;
+
+	last = tp->lsndtime;
+	if (after(icsk->icsk_ack.lrcvtime, last))
+		last = icsk->icsk_ack.lrcvtime;
+	idle = tcp_jiffies32 - last;
+	if (idle < idle_time)
+		return idle_time - idle;
+
+	/* Data in flight or waiting for the peer window is not idle */
+	if (tp->packets_out || !tcp_write_queue_empty(sk))
+		return idle_time;
+
+	before = sk->sk_forward_alloc + atomic_read(&sk->sk_rmem_alloc);
+
+	tcp_collapse_idle(sk);
+
+	if (!(sk->sk_userlocks & SOCK_RCVBUF_LOCK)) {
+		/* The window already advertised can still be filled by the
+		 * peer: keep room for it on top of what is queued.
+		 */
+		int floor = atomic_read(&sk->sk_rmem_alloc) +
+			    tcp_space_from_win(sk, tcp_receive_window(tp));
+
+		floor = min(floor, sk->sk_rcvbuf);
+		sk->sk_rcvbuf = min(sk->sk_rcvbuf, net->ipv4.sysctl_tcp_rmem[1]);
+		sk->sk_rcvbuf = max(sk->sk_rcvbuf, floor);
+		tp->rcv_ssthresh = min_t(u32, tp->rcv_ssthresh,
+					 tcp_full_space(sk));
+		tp->rcvq_space.space = min_t(u32, tp->rcvq_space.space,
+					     TCP_INIT_CWND * tp->advmss);
+	}
+	if (!(sk->sk_userlocks & SOCK_SNDBUF_LOCK))
+		sk->sk_sndbuf = min(sk->sk_sndbuf, net->ipv4.sysctl_tcp_wmem[1]);
+
+	sk_mem_reclaim(sk);
+
+	if (sk->sk_forward_alloc + atomic_read(&sk->sk_rmem_alloc) < before)
+		__NET_INC_STATS(net, LINUX_MIB_TCPIDLESHRINK);
+
+	return idle_time;
+}
+
 
 static void tcp_keepalive_timer (struct timer_list *t)
 {
 	struct sock *sk = from_timer(sk, t, sk_timer);
 	struct inet_connection_sock *icsk = inet_csk(sk);
 	struct tcp_sock *tp = tcp_sk(sk);
-	u32 elapsed;
+	u32 elapsed, idle_when;
 
 	/* Only process if socket is not in use. */
 	bh_lock_sock(sk);
@@ -680,15 +760,23 @@ static void tcp_keepalive_timer (struct timer_list *t)
 		goto death;
 	}
 
+	idle_when = tcp_idle_shrink(sk);
+
 	if (!sock_flag(sk, SOCK_KEEPOPEN) ||
-	    ((1 << sk->sk_state) & (TCPF_CLOSE | TCPF_SYN_SENT)))
+	    ((1 << sk->sk_state) & (TCPF_CLOSE | TCPF_SYN_SENT))) {
+		if (idle_when)
+			inet_csk_reset_keepalive_timer(sk, idle_when);
 		goto out;
+	}
 
 	elapsed = keepalive_time_when(tp);
 
 	/* It is alive without keepalive 8) */
-	if (tp->packets_out || !tcp_write_queue_empty(sk))
+	if (tp->packets_out || !tcp_write_queue_empty(sk)) {
+		if (idle_when)
+			elapsed = min(elapsed, idle_when);
 		goto resched;
+	}
 
 	elapsed = keepalive_time_elapsed(tp);
 
@@ -717,6 +805,9 @@ static void tcp_keepalive_timer (struct timer_list *t)
 	} else {
 		/* It is tp->rcv_tstamp + keepalive_time_when(tp) */
 		elapsed = keepalive_time_when(tp) - elapsed;
+		/* Not probing yet, an early run is harmless */
+		if (idle_when)
+			elapsed = min(elapsed, idle_when);
 	}
 
 	sk_mem_reclaim(sk);
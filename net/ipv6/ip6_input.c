@@ -47,11 +47,69 @@
 #include <net/inet_ecn.h>
 #include <net/dst_metadata.h>
 
+/* See ip_can_use_hint(). Multipath hashing in the input path covers
+ * addresses, flow label and next header, so they all have to match.
+ */
+static bool ip6_can_use_hint(const struct sk_buff *skb,
+			     const struct sk_buff *hint)
+{
+	const struct ipv6hdr *hdr, *hint_hdr;
+
+	if (!hint || skb_dst(skb) || skb->dev != hint->dev ||
+	    skb->mark != hint->mark)
+		return false;
+
+	hdr = ipv6_hdr(skb);
+	hint_hdr = ipv6_hdr(hint);
+	return ipv6_addr_equal(&hint_hdr->daddr, &hdr->daddr) &&
+	       ipv6_addr_equal(&hint_hdr->saddr, &hdr->saddr) &&
+	       ip6_flowinfo(hint_hdr) == ip6_flowinfo(hdr) &&
+	       hint_hdr->nexthdr == hdr->nexthdr;
+}
+
+static struct sk_buff *ip6_extract_route_hint(const struct net *net,
+					      struct sk_buff *skb)
+{
+	if (fib6_has_custom_rules(net) || ip6_multipath_hash_policy(net) ||
+	    ipv6_hdr(skb)->nexthdr == IPPROTO_ICMPV6 ||
+	    ipv6_addr_is_multicast(&ipv6_hdr(skb)->daddr))
+		return NULL;
+
+	return skb;
+}
+
+static void ip6_use_sk_hint(struct sk_buff *skb, const struct sk_buff *hint)
+{
+	struct sock *sk = hint->sk;
+
+	/* Only take over sockets early demux attached */
+	if (!sk || (hint->destructor != sock_edemux &&
+		    hint->destructor != sock_efree))
+		return;
+
+	if (!pskb_may_pull(skb, skb_transport_offset(skb) + sizeof(u32)) ||
+	    *(u32 *)skb_transport_header(skb) !=
+	    *(u32 *)skb_transport_header(hint))
+		return;
+
+	if (!refcount_inc_not_zero(&sk->sk_refcnt))
+		return;
+
+	skb->sk = sk;
+	skb->destructor = hint->destructor;
+}
+
 static void ip6_rcv_finish_core(struct net *net, struct sock *sk,
-				struct sk_buff *skb)
+				struct sk_buff *skb, const struct sk_buff *hint)
 {
 	void (*edemux)(struct sk_buff *skb);
 
+	if (ip6_can_use_hint(skb, hint)) {
+		if (net->ipv4.sysctl_ip_early_demux && !skb->sk)
+			ip6_use_sk_hint(skb, hint);
+		skb_dst_copy(skb, hint);
+	}
+
 	if (net->ipv4.sysctl_ip_early_demux && !skb_dst(skb) && skb->sk == NULL) {
 		const struct inet6_protocol *ipprot;
 
@@ -71,7 +129,7 @@ int ip6_rcv_finish(struct net *net, struct sock *sk, struct sk_buff *skb)
 	skb = l3mdev_ip6_rcv(skb);
 	if (!skb)
 		return NET_RX_SUCCESS;
-	ip6_rcv_finish_core(net, sk, skb);
+	ip6_rcv_finish_core(net, sk, skb, NULL);
 
 	return dst_input(skb);
 }
@@ -80,15 +138,17 @@ static void ip6_sublist_rcv_finish(struct list_head *head)
 {
 	struct sk_buff *skb, *next;
 
-	list_for_each_entry_safe(skb, next, head, list)
+	list_for_each_entry_safe(skb, next, head, list) {
+		skb_list_del_init(skb);
 		dst_input(skb);
+	}
 }
 
 static void ip6_list_rcv_finish(struct net *net, struct sock *sk,
 				struct list_head *head)
 {
+	struct sk_buff *skb, *next, *hint = NULL;
 	struct dst_entry *curr_dst = NULL;
-	struct sk_buff *skb, *next;
 	struct list_head sublist;
 
 	INIT_LIST_HEAD(&sublist);
@@ -102,7 +162,7 @@ static void ip6_list_rcv_finish(struct net *net, struct sock *sk,
 		skb = l3mdev_ip6_rcv(skb);
 		if (!skb)
 			continue;
-		ip6_rcv_finish_core(net, sk, skb);
+		ip6_rcv_finish_core(net, sk, skb, hint);
 		dst = skb_dst(skb);
 		if (curr_dst != dst) {
 			/* dispatch old sublist */
@@ -113,6 +173,7 @@ static void ip6_list_rcv_finish(struct net *net, struct sock *sk,
 			curr_dst = dst;
 		}
 		list_add_tail(&skb->list, &sublist);
+		hint = ip6_extract_route_hint(net, skb);
 	}
 	/* dispatch final sublist */
 	ip6_sublist_rcv_finish(&sublist);
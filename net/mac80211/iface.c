@@ -1010,6 +1010,15 @@ static void ieee80211_do_stop(struct ieee80211_sub_if_data *sdata,
 	if (sdata->vif.type == NL80211_IFTYPE_AP_VLAN)
 		ieee80211_txq_remove_vlan(local, sdata);
 
+	/* the txq is freed with the netdev, take it off the schedule */
+	if (sdata->vif.txq) {
+		struct txq_info *txqi = to_txq_info(sdata->vif.txq);
+
+		spin_lock_bh(&local->fq.lock);
+		ieee80211_txq_purge(local, txqi);
+		spin_unlock_bh(&local->fq.lock);
+	}
+
 	sdata->bss = NULL;
 
 	if (local->open_count == 0)
@@ -419,6 +419,27 @@ struct ieee80211_sta_rx_stats {
  */
 #define STA_SLOW_THRESHOLD 6000 /* 6 Mbps */
 
+/* airtime sources accounted against the per-AC deficit, see local->airtime_flags */
+#define AIRTIME_USE_TX		BIT(0)
+#define AIRTIME_USE_RX		BIT(1)
+
+/* default airtime quantum (usecs) added to a station's deficit per round */
+#define IEEE80211_DEFAULT_AIRTIME_WEIGHT 256
+
+/**
+ * struct airtime_info - per-AC airtime state of a station
+ *
+ * @rx_airtime: total airtime used by frames received from the station
+ * @tx_airtime: total airtime used by frames sent to the station
+ * @deficit: airtime the station may still use in the current scheduling
+ *	round; protected by local->active_txq_lock of the AC
+ */
+struct airtime_info {
+	u64 rx_airtime;
+	u64 tx_airtime;
+	s64 deficit;
+};
+
 /**
  * struct sta_info - STA information
  *
@@ -472,6 +493,8 @@ struct ieee80211_sta_rx_stats {
  *	AP only.
  * @cipher_scheme: optional cipher scheme for this station
  * @cparams: CoDel parameters for this station.
+ * @airtime: per-AC airtime accounting for airtime fair scheduling
+ * @airtime_weight: airtime quantum this station gets per scheduling round
  * @reserved_tid: reserved TID (if any, otherwise IEEE80211_TID_UNRESERVED)
  * @fast_tx: TX fastpath information
  * @fast_rx: RX fastpath information
@@ -579,6 +602,9 @@ struct sta_info {
 
 	struct codel_params cparams;
 
+	struct airtime_info airtime[IEEE80211_NUM_ACS];
+	u16 airtime_weight;
+
 	u8 reserved_tid;
 
 	struct cfg80211_chan_def tdls_chandef;
@@ -277,7 +277,7 @@ static void __ieee80211_wake_txqs(struct ieee80211_sub_if_data *sdata, int ac)
 				continue;
 
 			spin_unlock_bh(&fq->lock);
-			drv_wake_tx_queue(local, txqi);
+			schedule_and_wake_txq(local, txqi);
 			spin_lock_bh(&fq->lock);
 		}
 	}
@@ -293,7 +293,7 @@ static void __ieee80211_wake_txqs(struct ieee80211_sub_if_data *sdata, int ac)
 
 	spin_unlock_bh(&fq->lock);
 
-	drv_wake_tx_queue(local, txqi);
+	schedule_and_wake_txq(local, txqi);
 	return;
 out:
 	spin_unlock_bh(&fq->lock);
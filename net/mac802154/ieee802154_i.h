@@ -64,8 +64,19 @@ struct ieee802154_local {
 
 	struct sk_buff *tx_skb;
 	struct work_struct tx_work;
+
+	/* Frames waiting for the transceiver. tx_busy is set while it
+	 * transmits one, tx_crypt counts frames still being encrypted by
+	 * an asynchronous engine; all are protected by tx_queue.lock.
+	 */
+	struct tasklet_struct tx_tasklet;
+	struct sk_buff_head tx_queue;
+	unsigned int tx_crypt;
+	bool tx_busy;
 };
 
+#define IEEE802154_TX_QUEUE_DEPTH	8
+
 enum {
 	IEEE802154_RX_MSG        = 1,
 };
@@ -130,6 +141,7 @@ extern struct ieee802154_mlme_ops mac802154_mlme_wpan;
 
 void ieee802154_rx(struct ieee802154_local *local, struct sk_buff *skb);
 void ieee802154_xmit_worker(struct work_struct *work);
+void ieee802154_tx_tasklet(unsigned long data);
 netdev_tx_t
 ieee802154_monitor_start_xmit(struct sk_buff *skb, struct net_device *dev);
 netdev_tx_t
@@ -184,5 +196,6 @@ ieee802154_if_add(struct ieee802154_local *local, const char *name,
 		  __le64 extended_addr);
 void ieee802154_remove_interfaces(struct ieee802154_local *local);
 void ieee802154_stop_device(struct ieee802154_local *local);
+void ieee802154_wake_netif_queues(struct ieee802154_local *local);
 
 #endif /* __IEEE802154_I_H */
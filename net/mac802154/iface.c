@@ -600,11 +600,16 @@ ieee802154_setup_sdata(struct ieee802154_sub_if_data *sdata,
 
 		mutex_init(&sdata->sec_mtx);
 
-		mac802154_llsec_init(&sdata->sec);
-		ret = mac802154_wpan_update_llsec(sdata->dev);
+		ret = mac802154_llsec_init(&sdata->sec);
 		if (ret < 0)
 			return ret;
 
+		ret = mac802154_wpan_update_llsec(sdata->dev);
+		if (ret < 0) {
+			mac802154_llsec_destroy(&sdata->sec);
+			return ret;
+		}
+
 		break;
 	case NL802154_IFTYPE_MONITOR:
 		sdata->dev->needs_free_netdev = true;
@@ -675,6 +680,9 @@ ieee802154_if_add(struct ieee802154_local *local, const char *name,
 	if (ret)
 		goto err;
 
+	/* a failing register_netdevice() runs the priv_destructor, which
+	 * destroys the llsec state set up above
+	 */
 	ret = register_netdevice(ndev);
 	if (ret < 0)
 		goto err;
@@ -19,6 +19,8 @@
 #include <linux/completion.h>
 #include <linux/ieee802154.h>
 #include <linux/rculist.h>
+#include <linux/hash.h>
+#include <linux/percpu.h>
 
 #include <crypto/aead.h>
 #include <crypto/skcipher.h>
@@ -32,10 +34,14 @@ static bool llsec_key_id_equal(const struct ieee802154_llsec_key_id *a,
 
 static void llsec_dev_free(struct mac802154_llsec_device *dev);
 
-void mac802154_llsec_init(struct mac802154_llsec *sec)
+int mac802154_llsec_init(struct mac802154_llsec *sec)
 {
 	memset(sec, 0, sizeof(*sec));
 
+	sec->key_cache = alloc_percpu(struct mac802154_llsec_key_cache);
+	if (!sec->key_cache)
+		return -ENOMEM;
+
 	memset(&sec->params.default_key_source, 0xFF, IEEE802154_ADDR_LEN);
 
 	INIT_LIST_HEAD(&sec->table.security_levels);
@@ -44,6 +50,8 @@ void mac802154_llsec_init(struct mac802154_llsec *sec)
 	hash_init(sec->devices_short);
 	hash_init(sec->devices_hw);
 	rwlock_init(&sec->lock);
+
+	return 0;
 }
 
 void mac802154_llsec_destroy(struct mac802154_llsec *sec)
@@ -76,6 +84,8 @@ void mac802154_llsec_destroy(struct mac802154_llsec *sec)
 		llsec_key_put(mkey);
 		kzfree(key);
 	}
+
+	free_percpu(sec->key_cache);
 }
 
 int mac802154_llsec_get_params(struct mac802154_llsec *sec,
@@ -118,6 +128,58 @@ int mac802154_llsec_set_params(struct mac802154_llsec *sec,
 	return 0;
 }
 
+static void llsec_key_free_reqs(struct mac802154_llsec_key *key)
+{
+	int cpu, i;
+
+	if (!key->reqs)
+		return;
+
+	for_each_possible_cpu(cpu) {
+		struct mac802154_llsec_key_reqs *reqs;
+
+		reqs = per_cpu_ptr(key->reqs, cpu);
+		for (i = 0; i < ARRAY_SIZE(reqs->req); i++)
+			aead_request_free(reqs->req[i]);
+	}
+
+	free_percpu(key->reqs);
+}
+
+/* Synchronous tfms get one request per cpu and authsize up front, so the
+ * data path does not allocate. Async tfms, e.g. hardware AES engines,
+ * need a request that lives until completion and allocate it per frame.
+ */
+static int llsec_key_alloc_reqs(struct mac802154_llsec_key *key)
+{
+	int cpu, i;
+
+	if (crypto_aead_alg(key->tfm[0])->base.cra_flags & CRYPTO_ALG_ASYNC)
+		return 0;
+
+	key->reqs = alloc_percpu(struct mac802154_llsec_key_reqs);
+	if (!key->reqs)
+		return -ENOMEM;
+
+	for_each_possible_cpu(cpu) {
+		struct mac802154_llsec_key_reqs *reqs;
+
+		reqs = per_cpu_ptr(key->reqs, cpu);
+		for (i = 0; i < ARRAY_SIZE(reqs->req); i++) {
+			reqs->req[i] = aead_request_alloc(key->tfm[i],
+							  GFP_KERNEL);
+			if (!reqs->req[i]) {
+				llsec_key_free_reqs(key);
+				key->reqs = NULL;
+				return -ENOMEM;
+			}
+			aead_request_set_callback(reqs->req[i], 0, NULL, NULL);
+		}
+	}
+
+	return 0;
+}
+
 static struct mac802154_llsec_key*
 llsec_key_alloc(const struct ieee802154_llsec_key *template)
 {
@@ -135,10 +197,11 @@ llsec_key_alloc(const struct ieee802154_llsec_key *template)
 	BUILD_BUG_ON(ARRAY_SIZE(authsizes) != ARRAY_SIZE(key->tfm));
 
 	for (i = 0; i < ARRAY_SIZE(key->tfm); i++) {
-		key->tfm[i] = crypto_alloc_aead("ccm(aes)", 0,
-						CRYPTO_ALG_ASYNC);
-		if (IS_ERR(key->tfm[i]))
+		key->tfm[i] = crypto_alloc_aead("ccm(aes)", 0, 0);
+		if (IS_ERR(key->tfm[i])) {
+			key->tfm[i] = NULL;
 			goto err_tfm;
+		}
 		if (crypto_aead_setkey(key->tfm[i], template->key,
 				       IEEE802154_LLSEC_KEY_SIZE))
 			goto err_tfm;
@@ -154,6 +217,9 @@ llsec_key_alloc(const struct ieee802154_llsec_key *template)
 				   IEEE802154_LLSEC_KEY_SIZE))
 		goto err_tfm0;
 
+	if (llsec_key_alloc_reqs(key))
+		goto err_tfm0;
+
 	return key;
 
 err_tfm0:
@@ -174,6 +240,8 @@ static void llsec_key_release(struct kref *ref)
 
 	key = container_of(ref, struct mac802154_llsec_key, ref);
 
+	llsec_key_free_reqs(key);
+
 	for (i = 0; i < ARRAY_SIZE(key->tfm); i++)
 		crypto_free_aead(key->tfm[i]);
 
@@ -265,6 +333,7 @@ int mac802154_llsec_key_add(struct mac802154_llsec *sec,
 	new->key = &mkey->key;
 
 	list_add_rcu(&new->list, &sec->table.keys);
+	atomic_inc(&sec->key_gen);
 
 	return 0;
 
@@ -285,6 +354,7 @@ int mac802154_llsec_key_del(struct mac802154_llsec *sec,
 
 		if (llsec_key_id_equal(&pos->id, key)) {
 			list_del_rcu(&pos->list);
+			atomic_inc(&sec->key_gen);
 			llsec_key_put(mkey);
 			return 0;
 		}
@@ -546,16 +616,14 @@ static int llsec_recover_addr(struct mac802154_llsec *sec,
 	return 0;
 }
 
-static struct mac802154_llsec_key*
-llsec_lookup_key(struct mac802154_llsec *sec,
-		 const struct ieee802154_hdr *hdr,
-		 const struct ieee802154_addr *addr,
-		 struct ieee802154_llsec_key_id *key_id)
+static struct ieee802154_llsec_key_entry*
+__llsec_lookup_key(struct mac802154_llsec *sec,
+		   const struct ieee802154_hdr *hdr,
+		   const struct ieee802154_addr *addr)
 {
 	struct ieee802154_addr devaddr = *addr;
 	u8 key_id_mode = hdr->sec.key_id_mode;
 	struct ieee802154_llsec_key_entry *key_entry;
-	struct mac802154_llsec_key *key;
 
 	if (key_id_mode == IEEE802154_SCF_KEY_IMPLICIT &&
 	    devaddr.mode == IEEE802154_ADDR_NONE) {
@@ -588,11 +656,83 @@ llsec_lookup_key(struct mac802154_llsec *sec,
 			     id->short_source == hdr->sec.short_src) ||
 			    (key_id_mode == IEEE802154_SCF_KEY_HW_INDEX &&
 			     id->extended_source == hdr->sec.extended_src))
-				goto found;
+				return key_entry;
 		}
 	}
 
 	return NULL;
+}
+
+/* Only lookups that depend on nothing but the frame type, the key id
+ * and the short address of the peer are cached.
+ */
+static struct mac802154_llsec_key_cache_entry*
+llsec_key_cache_slot(struct mac802154_llsec *sec,
+		     const struct ieee802154_hdr *hdr,
+		     const struct ieee802154_addr *addr, u8 *key_id)
+{
+	u8 key_id_mode = hdr->sec.key_id_mode;
+	u32 hash;
+
+	if (addr->mode != IEEE802154_ADDR_SHORT)
+		return NULL;
+
+	if (key_id_mode == IEEE802154_SCF_KEY_IMPLICIT)
+		*key_id = 0;
+	else if (key_id_mode == IEEE802154_SCF_KEY_INDEX)
+		*key_id = hdr->sec.key_id;
+	else
+		return NULL;
+
+	hash = ((__force u16)addr->short_addr << 16 | *key_id << 8 |
+		key_id_mode << 4 | hdr->fc.type) ^ (__force u16)addr->pan_id;
+
+	return &this_cpu_ptr(sec->key_cache)->slot[
+		hash_32(hash, MAC802154_LLSEC_KEY_CACHE_BITS)];
+}
+
+static struct mac802154_llsec_key*
+llsec_lookup_key(struct mac802154_llsec *sec,
+		 const struct ieee802154_hdr *hdr,
+		 const struct ieee802154_addr *addr,
+		 struct ieee802154_llsec_key_id *key_id)
+{
+	struct mac802154_llsec_key_cache_entry *slot;
+	struct ieee802154_llsec_key_entry *key_entry;
+	struct mac802154_llsec_key *key;
+	u32 gen = atomic_read(&sec->key_gen);
+	u8 id;
+
+	local_bh_disable();
+	slot = llsec_key_cache_slot(sec, hdr, addr, &id);
+	if (slot && slot->entry && slot->gen == gen &&
+	    slot->pan_id == addr->pan_id &&
+	    slot->short_addr == addr->short_addr &&
+	    slot->frame_type == hdr->fc.type &&
+	    slot->key_id_mode == hdr->sec.key_id_mode &&
+	    slot->key_id == id) {
+		key_entry = slot->entry;
+		local_bh_enable();
+		goto found;
+	}
+	local_bh_enable();
+
+	key_entry = __llsec_lookup_key(sec, hdr, addr);
+	if (!key_entry)
+		return NULL;
+
+	local_bh_disable();
+	slot = llsec_key_cache_slot(sec, hdr, addr, &id);
+	if (slot) {
+		slot->entry = key_entry;
+		slot->gen = gen;
+		slot->pan_id = addr->pan_id;
+		slot->short_addr = addr->short_addr;
+		slot->frame_type = hdr->fc.type;
+		slot->key_id_mode = hdr->sec.key_id_mode;
+		slot->key_id = id;
+	}
+	local_bh_enable();
 
 found:
 	key = container_of(key_entry->key, struct mac802154_llsec_key, key);
@@ -640,36 +780,153 @@ llsec_do_encrypt_unauth(struct sk_buff *skb, const struct mac802154_llsec *sec,
 	return err;
 }
 
-static struct crypto_aead*
-llsec_tfm_by_len(struct mac802154_llsec_key *key, int authlen)
+static int
+llsec_tfm_idx(struct mac802154_llsec_key *key, int authlen)
 {
 	int i;
 
 	for (i = 0; i < ARRAY_SIZE(key->tfm); i++)
 		if (crypto_aead_authsize(key->tfm[i]) == authlen)
-			return key->tfm[i];
+			return i;
 
 	BUG();
 }
 
+/* State of a frame handed to an asynchronous AES-CCM engine. */
+struct llsec_async_req {
+	struct sk_buff *skb;
+	struct mac802154_llsec_key *key;
+	mac802154_llsec_done_t done;
+	struct scatterlist sg;
+	u8 iv[16];
+	int authlen;
+	bool enc;
+
+	/* must be last, followed by the tfm request context */
+	struct aead_request req;
+};
+
+static void llsec_async_req_free(struct llsec_async_req *areq)
+{
+	struct net_device *dev = areq->skb->dev;
+
+	if (!areq->enc)
+		skb_trim(areq->skb, areq->skb->len - areq->authlen);
+
+	llsec_key_put(areq->key);
+	dev_put(dev);
+	kzfree(areq);
+}
+
+static void llsec_aead_complete(struct crypto_async_request *base, int err)
+{
+	struct llsec_async_req *areq = base->data;
+	struct net_device *dev = areq->skb->dev;
+
+	/* moved off the backlog, the real completion follows */
+	if (err == -EINPROGRESS)
+		return;
+
+	if (!areq->enc)
+		skb_trim(areq->skb, areq->skb->len - areq->authlen);
+
+	/* keep the device alive while the frame is passed on */
+	llsec_key_put(areq->key);
+	areq->done(areq->skb, err);
+	dev_put(dev);
+	kzfree(areq);
+}
+
+static int
+llsec_do_aead_async(struct sk_buff *skb, struct mac802154_llsec_key *key,
+		    struct crypto_aead *tfm, const u8 *iv, int authlen,
+		    int assoclen, int datalen, int sglen, bool enc,
+		    mac802154_llsec_done_t done)
+{
+	struct llsec_async_req *areq;
+	int rc;
+
+	areq = kmalloc(sizeof(*areq) + crypto_aead_reqsize(tfm), GFP_ATOMIC);
+	if (!areq) {
+		if (!enc)
+			skb_trim(skb, skb->len - authlen);
+		return -ENOMEM;
+	}
+
+	areq->skb = skb;
+	areq->key = llsec_key_get(key);
+	areq->done = done;
+	areq->authlen = authlen;
+	areq->enc = enc;
+	memcpy(areq->iv, iv, sizeof(areq->iv));
+	sg_init_one(&areq->sg, skb_mac_header(skb), sglen);
+	dev_hold(skb->dev);
+
+	aead_request_set_tfm(&areq->req, tfm);
+	aead_request_set_callback(&areq->req, CRYPTO_TFM_REQ_MAY_BACKLOG,
+				  llsec_aead_complete, areq);
+	aead_request_set_crypt(&areq->req, &areq->sg, &areq->sg, datalen,
+			       areq->iv);
+	aead_request_set_ad(&areq->req, assoclen);
+
+	rc = enc ? crypto_aead_encrypt(&areq->req) :
+		   crypto_aead_decrypt(&areq->req);
+	if (rc == -EINPROGRESS || rc == -EBUSY)
+		return -EINPROGRESS;
+
+	llsec_async_req_free(areq);
+	return rc;
+}
+
+/* Runs AES-CCM over the frame at the mac header, sglen bytes long. For
+ * synchronous tfms the per-cpu request of the key is used and the result
+ * is returned directly. Asynchronous tfms may return -EINPROGRESS, done
+ * is then called with the result once the engine has finished.
+ */
+static int
+llsec_do_aead(struct sk_buff *skb, struct mac802154_llsec_key *key,
+	      const u8 *iv, int authlen, int assoclen, int datalen, int sglen,
+	      bool enc, mac802154_llsec_done_t done)
+{
+	int idx = llsec_tfm_idx(key, authlen);
+	struct aead_request *req;
+	struct scatterlist sg;
+	int rc;
+
+	if (!key->reqs)
+		return llsec_do_aead_async(skb, key, key->tfm[idx], iv,
+					   authlen, assoclen, datalen, sglen,
+					   enc, done);
+
+	sg_init_one(&sg, skb_mac_header(skb), sglen);
+
+	local_bh_disable();
+	req = this_cpu_ptr(key->reqs)->req[idx];
+	aead_request_set_crypt(req, &sg, &sg, datalen, (u8 *)iv);
+	aead_request_set_ad(req, assoclen);
+
+	rc = enc ? crypto_aead_encrypt(req) : crypto_aead_decrypt(req);
+	local_bh_enable();
+
+	if (!enc)
+		skb_trim(skb, skb->len - authlen);
+
+	return rc;
+}
+
 static int
 llsec_do_encrypt_auth(struct sk_buff *skb, const struct mac802154_llsec *sec,
 		      const struct ieee802154_hdr *hdr,
-		      struct mac802154_llsec_key *key)
+		      struct mac802154_llsec_key *key,
+		      mac802154_llsec_done_t done)
 {
 	u8 iv[16];
 	unsigned char *data;
-	int authlen, assoclen, datalen, rc;
-	struct scatterlist sg;
-	struct aead_request *req;
+	int authlen, assoclen, datalen, sglen;
 
 	authlen = ieee802154_sechdr_authtag_len(&hdr->sec);
 	llsec_geniv(iv, sec->params.hwaddr, &hdr->sec);
 
-	req = aead_request_alloc(llsec_tfm_by_len(key, authlen), GFP_ATOMIC);
-	if (!req)
-		return -ENOMEM;
-
 	assoclen = skb->mac_len;
 
 	data = skb_mac_header(skb) + skb->mac_len;
@@ -677,36 +934,31 @@ llsec_do_encrypt_auth(struct sk_buff *skb, const struct mac802154_llsec *sec,
 
 	skb_put(skb, authlen);
 
-	sg_init_one(&sg, skb_mac_header(skb), assoclen + datalen + authlen);
+	sglen = assoclen + datalen + authlen;
 
 	if (!(hdr->sec.level & IEEE802154_SCF_SECLEVEL_ENC)) {
 		assoclen += datalen;
 		datalen = 0;
 	}
 
-	aead_request_set_callback(req, 0, NULL, NULL);
-	aead_request_set_crypt(req, &sg, &sg, datalen, iv);
-	aead_request_set_ad(req, assoclen);
-
-	rc = crypto_aead_encrypt(req);
-
-	kzfree(req);
-
-	return rc;
+	return llsec_do_aead(skb, key, iv, authlen, assoclen, datalen, sglen,
+			     true, done);
 }
 
 static int llsec_do_encrypt(struct sk_buff *skb,
 			    const struct mac802154_llsec *sec,
 			    const struct ieee802154_hdr *hdr,
-			    struct mac802154_llsec_key *key)
+			    struct mac802154_llsec_key *key,
+			    mac802154_llsec_done_t done)
 {
 	if (hdr->sec.level == IEEE802154_SCF_SECLEVEL_ENC)
 		return llsec_do_encrypt_unauth(skb, sec, hdr, key);
 	else
-		return llsec_do_encrypt_auth(skb, sec, hdr, key);
+		return llsec_do_encrypt_auth(skb, sec, hdr, key, done);
 }
 
-int mac802154_llsec_encrypt(struct mac802154_llsec *sec, struct sk_buff *skb)
+int mac802154_llsec_encrypt(struct mac802154_llsec *sec, struct sk_buff *skb,
+			    mac802154_llsec_done_t done)
 {
 	struct ieee802154_hdr hdr;
 	int rc, authlen, hlen;
@@ -766,7 +1018,7 @@ int mac802154_llsec_encrypt(struct mac802154_llsec *sec, struct sk_buff *skb)
 	skb->mac_len = ieee802154_hdr_push(skb, &hdr);
 	skb_reset_mac_header(skb);
 
-	rc = llsec_do_encrypt(skb, sec, &hdr, key);
+	rc = llsec_do_encrypt(skb, sec, &hdr, key, done);
 	llsec_key_put(key);
 
 	return rc;
@@ -861,54 +1113,43 @@ llsec_do_decrypt_unauth(struct sk_buff *skb, const struct mac802154_llsec *sec,
 static int
 llsec_do_decrypt_auth(struct sk_buff *skb, const struct mac802154_llsec *sec,
 		      const struct ieee802154_hdr *hdr,
-		      struct mac802154_llsec_key *key, __le64 dev_addr)
+		      struct mac802154_llsec_key *key, __le64 dev_addr,
+		      mac802154_llsec_done_t done)
 {
 	u8 iv[16];
 	unsigned char *data;
-	int authlen, datalen, assoclen, rc;
-	struct scatterlist sg;
-	struct aead_request *req;
+	int authlen, datalen, assoclen, sglen;
 
 	authlen = ieee802154_sechdr_authtag_len(&hdr->sec);
 	llsec_geniv(iv, dev_addr, &hdr->sec);
 
-	req = aead_request_alloc(llsec_tfm_by_len(key, authlen), GFP_ATOMIC);
-	if (!req)
-		return -ENOMEM;
-
 	assoclen = skb->mac_len;
 
 	data = skb_mac_header(skb) + skb->mac_len;
 	datalen = skb_tail_pointer(skb) - data;
 
-	sg_init_one(&sg, skb_mac_header(skb), assoclen + datalen);
+	sglen = assoclen + datalen;
 
 	if (!(hdr->sec.level & IEEE802154_SCF_SECLEVEL_ENC)) {
 		assoclen += datalen - authlen;
 		datalen = authlen;
 	}
 
-	aead_request_set_callback(req, 0, NULL, NULL);
-	aead_request_set_crypt(req, &sg, &sg, datalen, iv);
-	aead_request_set_ad(req, assoclen);
-
-	rc = crypto_aead_decrypt(req);
-
-	kzfree(req);
-	skb_trim(skb, skb->len - authlen);
-
-	return rc;
+	return llsec_do_aead(skb, key, iv, authlen, assoclen, datalen, sglen,
+			     false, done);
 }
 
 static int
 llsec_do_decrypt(struct sk_buff *skb, const struct mac802154_llsec *sec,
 		 const struct ieee802154_hdr *hdr,
-		 struct mac802154_llsec_key *key, __le64 dev_addr)
+		 struct mac802154_llsec_key *key, __le64 dev_addr,
+		 mac802154_llsec_done_t done)
 {
 	if (hdr->sec.level == IEEE802154_SCF_SECLEVEL_ENC)
 		return llsec_do_decrypt_unauth(skb, sec, hdr, key, dev_addr);
 	else
-		return llsec_do_decrypt_auth(skb, sec, hdr, key, dev_addr);
+		return llsec_do_decrypt_auth(skb, sec, hdr, key, dev_addr,
+					     done);
 }
 
 static int
@@ -980,7 +1221,8 @@ llsec_update_devkey_info(struct mac802154_llsec_device *dev,
 	return 0;
 }
 
-int mac802154_llsec_decrypt(struct mac802154_llsec *sec, struct sk_buff *skb)
+int mac802154_llsec_decrypt(struct mac802154_llsec *sec, struct sk_buff *skb,
+			    mac802154_llsec_done_t done)
 {
 	struct ieee802154_hdr hdr;
 	struct mac802154_llsec_key *key;
@@ -1046,7 +1288,7 @@ int mac802154_llsec_decrypt(struct mac802154_llsec *sec, struct sk_buff *skb)
 
 	rcu_read_unlock();
 
-	err = llsec_do_decrypt(skb, sec, &hdr, key, dev_addr);
+	err = llsec_do_decrypt(skb, sec, &hdr, key, dev_addr, done);
 	llsec_key_put(key);
 	return err;
 
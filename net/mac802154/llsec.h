@@ -24,6 +24,10 @@
 #include <net/af_ieee802154.h>
 #include <net/ieee802154_netdev.h>
 
+struct mac802154_llsec_key_reqs {
+	struct aead_request *req[3];
+};
+
 struct mac802154_llsec_key {
 	struct ieee802154_llsec_key key;
 
@@ -31,6 +35,9 @@ struct mac802154_llsec_key {
 	struct crypto_aead *tfm[3];
 	struct crypto_sync_skcipher *tfm0;
 
+	/* preallocated requests for tfm[], NULL if the tfms are async */
+	struct mac802154_llsec_key_reqs __percpu *reqs;
+
 	struct kref ref;
 };
 
@@ -58,6 +65,26 @@ struct mac802154_llsec_seclevel {
 	struct rcu_head rcu;
 };
 
+#define MAC802154_LLSEC_KEY_CACHE_BITS	4
+
+/* recent key lookups of peers with a short address, valid while gen
+ * matches mac802154_llsec.key_gen
+ */
+struct mac802154_llsec_key_cache_entry {
+	struct ieee802154_llsec_key_entry *entry;
+	u32 gen;
+	__le16 pan_id;
+	__le16 short_addr;
+	u8 frame_type;
+	u8 key_id_mode;
+	u8 key_id;
+};
+
+struct mac802154_llsec_key_cache {
+	struct mac802154_llsec_key_cache_entry
+		slot[1 << MAC802154_LLSEC_KEY_CACHE_BITS];
+};
+
 struct mac802154_llsec {
 	struct ieee802154_llsec_params params;
 	struct ieee802154_llsec_table table;
@@ -65,11 +92,20 @@ struct mac802154_llsec {
 	DECLARE_HASHTABLE(devices_short, 6);
 	DECLARE_HASHTABLE(devices_hw, 6);
 
+	struct mac802154_llsec_key_cache __percpu *key_cache;
+	atomic_t key_gen;
+
 	/* protects params, all other fields are fine with RCU */
 	rwlock_t lock;
 };
 
-void mac802154_llsec_init(struct mac802154_llsec *sec);
+/* Called with the result of an encryption or decryption that completed
+ * asynchronously, after mac802154_llsec_encrypt/decrypt returned
+ * -EINPROGRESS.
+ */
+typedef void (*mac802154_llsec_done_t)(struct sk_buff *skb, int err);
+
+int mac802154_llsec_init(struct mac802154_llsec *sec);
 void mac802154_llsec_destroy(struct mac802154_llsec *sec);
 
 int mac802154_llsec_get_params(struct mac802154_llsec *sec,
@@ -101,7 +137,9 @@ int mac802154_llsec_seclevel_add(struct mac802154_llsec *sec,
 int mac802154_llsec_seclevel_del(struct mac802154_llsec *sec,
 				 const struct ieee802154_llsec_seclevel *sl);
 
-int mac802154_llsec_encrypt(struct mac802154_llsec *sec, struct sk_buff *skb);
-int mac802154_llsec_decrypt(struct mac802154_llsec *sec, struct sk_buff *skb);
+int mac802154_llsec_encrypt(struct mac802154_llsec *sec, struct sk_buff *skb,
+			    mac802154_llsec_done_t done);
+int mac802154_llsec_decrypt(struct mac802154_llsec *sec, struct sk_buff *skb,
+			    mac802154_llsec_done_t done);
 
 #endif /* MAC802154_LLSEC_H */
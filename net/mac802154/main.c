@@ -107,6 +107,12 @@ ieee802154_alloc_hw(size_t priv_data_len, const struct ieee802154_ops *ops)
 
 	INIT_WORK(&local->tx_work, ieee802154_xmit_worker);
 
+	tasklet_init(&local->tx_tasklet,
+		     ieee802154_tx_tasklet,
+		     (unsigned long)local);
+
+	skb_queue_head_init(&local->tx_queue);
+
 	/* init supported flags with 802.15.4 default ranges */
 	phy->supported.max_minbe = 8;
 	phy->supported.min_maxbe = 3;
@@ -163,6 +169,9 @@ int ieee802154_register_hw(struct ieee802154_hw *hw)
 	hrtimer_init(&local->ifs_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
 	local->ifs_timer.function = ieee802154_xmit_ifs_timer;
 
+	if (!hw->tx_queue_depth)
+		hw->tx_queue_depth = IEEE802154_TX_QUEUE_DEPTH;
+
 	wpan_phy_set_dev(local->phy, local->hw.parent);
 
 	ieee802154_setup_wpan_phy_pib(local->phy);
@@ -225,6 +234,7 @@ void ieee802154_unregister_hw(struct ieee802154_hw *hw)
 
 	rtnl_unlock();
 
+	tasklet_kill(&local->tx_tasklet);
 	destroy_workqueue(local->workqueue);
 	wpan_phy_unregister(local->phy);
 }
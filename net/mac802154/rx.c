@@ -37,6 +37,49 @@ static int ieee802154_deliver_skb(struct sk_buff *skb)
 	return netif_receive_skb(skb);
 }
 
+static int
+ieee802154_subif_deliver(struct ieee802154_sub_if_data *sdata,
+			 struct sk_buff *skb)
+{
+	sdata->dev->stats.rx_packets++;
+	sdata->dev->stats.rx_bytes += skb->len;
+
+	switch (mac_cb(skb)->type) {
+	case IEEE802154_FC_TYPE_BEACON:
+	case IEEE802154_FC_TYPE_ACK:
+	case IEEE802154_FC_TYPE_MAC_CMD:
+		goto fail;
+
+	case IEEE802154_FC_TYPE_DATA:
+		return ieee802154_deliver_skb(skb);
+	default:
+		pr_warn_ratelimited("ieee802154: bad frame received "
+				    "(type = %d)\n", mac_cb(skb)->type);
+		goto fail;
+	}
+
+fail:
+	kfree_skb(skb);
+	return NET_RX_DROP;
+}
+
+/* Completion of a frame decrypted by an asynchronous crypto engine. */
+static void ieee802154_subif_decrypted(struct sk_buff *skb, int err)
+{
+	struct ieee802154_sub_if_data *sdata =
+		IEEE802154_DEV_TO_SUB_IF(skb->dev);
+
+	if (err) {
+		pr_debug("decryption failed: %i\n", err);
+		kfree_skb(skb);
+		return;
+	}
+
+	local_bh_disable();
+	ieee802154_subif_deliver(sdata, skb);
+	local_bh_enable();
+}
+
 static int
 ieee802154_subif_frame(struct ieee802154_sub_if_data *sdata,
 		       struct sk_buff *skb, const struct ieee802154_hdr *hdr)
@@ -91,28 +134,16 @@ ieee802154_subif_frame(struct ieee802154_sub_if_data *sdata,
 	 * wireshark will show a mac header with security fields and the
 	 * payload is already decrypted.
 	 */
-	rc = mac802154_llsec_decrypt(&sdata->sec, skb);
+	rc = mac802154_llsec_decrypt(&sdata->sec, skb,
+				     ieee802154_subif_decrypted);
+	if (rc == -EINPROGRESS)
+		return NET_RX_SUCCESS;
 	if (rc) {
 		pr_debug("decryption failed: %i\n", rc);
 		goto fail;
 	}
 
-	sdata->dev->stats.rx_packets++;
-	sdata->dev->stats.rx_bytes += skb->len;
-
-	switch (mac_cb(skb)->type) {
-	case IEEE802154_FC_TYPE_BEACON:
-	case IEEE802154_FC_TYPE_ACK:
-	case IEEE802154_FC_TYPE_MAC_CMD:
-		goto fail;
-
-	case IEEE802154_FC_TYPE_DATA:
-		return ieee802154_deliver_skb(skb);
-	default:
-		pr_warn_ratelimited("ieee802154: bad frame received "
-				    "(type = %d)\n", mac_cb(skb)->type);
-		goto fail;
-	}
+	return ieee802154_subif_deliver(sdata, skb);
 
 fail:
 	kfree_skb(skb);
@@ -42,25 +42,86 @@ void ieee802154_xmit_worker(struct work_struct *work)
 	if (res)
 		goto err_tx;
 
-	ieee802154_xmit_complete(&local->hw, skb, false);
-
 	dev->stats.tx_packets++;
 	dev->stats.tx_bytes += skb->len;
 
+	ieee802154_xmit_complete(&local->hw, skb, false);
+
 	return;
 
 err_tx:
-	/* Restart the netif queue on each sub_if_data object. */
+	/* Hand the next frame to the transceiver. */
 	ieee802154_wake_queue(&local->hw);
 	kfree_skb(skb);
 	netdev_dbg(dev, "transmission failed\n");
 }
 
+/* Returns false if the frame was dropped and the transceiver is idle. */
+static bool
+ieee802154_tx_frame(struct ieee802154_local *local, struct sk_buff *skb)
+{
+	struct net_device *dev = skb->dev;
+	unsigned int len = skb->len;
+
+	/* async is priority, otherwise sync is fallback */
+	if (!local->ops->xmit_async) {
+		local->tx_skb = skb;
+		queue_work(local->workqueue, &local->tx_work);
+		return true;
+	}
+
+	/* the frame may be completed, and freed, before this returns */
+	if (drv_xmit_async(local, skb)) {
+		kfree_skb(skb);
+		netdev_dbg(dev, "transmission failed\n");
+		return false;
+	}
+
+	dev->stats.tx_packets++;
+	dev->stats.tx_bytes += len;
+	return true;
+}
+
+/* The transceiver sends one frame at a time, while up to tx_queue_depth
+ * frames wait on local->tx_queue. The next one is handed over as soon
+ * as the driver completes the current one, without waiting for the
+ * netif queue to be woken and rescheduled.
+ */
+static void ieee802154_tx_kick(struct ieee802154_local *local)
+{
+	struct sk_buff *skb;
+	unsigned long flags;
+
+	for (;;) {
+		spin_lock_irqsave(&local->tx_queue.lock, flags);
+		skb = NULL;
+		if (!local->tx_busy) {
+			skb = __skb_dequeue(&local->tx_queue);
+			local->tx_busy = !!skb;
+		}
+		if (skb_queue_len(&local->tx_queue) + local->tx_crypt <
+		    local->hw.tx_queue_depth)
+			ieee802154_wake_netif_queues(local);
+		spin_unlock_irqrestore(&local->tx_queue.lock, flags);
+
+		if (!skb || ieee802154_tx_frame(local, skb))
+			return;
+
+		spin_lock_irqsave(&local->tx_queue.lock, flags);
+		local->tx_busy = false;
+		spin_unlock_irqrestore(&local->tx_queue.lock, flags);
+	}
+}
+
+void ieee802154_tx_tasklet(unsigned long data)
+{
+	ieee802154_tx_kick((struct ieee802154_local *)data);
+}
+
 static netdev_tx_t
 ieee802154_tx(struct ieee802154_local *local, struct sk_buff *skb)
 {
-	struct net_device *dev = skb->dev;
-	int ret;
+	unsigned long flags;
 
 	if (!(local->hw.flags & IEEE802154_HW_TX_OMIT_CKSUM)) {
 		struct sk_buff *nskb;
@@ -81,23 +142,15 @@ ieee802154_tx(struct ieee802154_local *local, struct sk_buff *skb)
 		put_unaligned_le16(crc, skb_put(skb, 2));
 	}
 
+	spin_lock_irqsave(&local->tx_queue.lock, flags);
+	__skb_queue_tail(&local->tx_queue, skb);
 	/* Stop the netif queue on each sub_if_data object. */
-	ieee802154_stop_queue(&local->hw);
+	if (skb_queue_len(&local->tx_queue) + local->tx_crypt >=
+	    local->hw.tx_queue_depth)
+		ieee802154_stop_queue(&local->hw);
+	spin_unlock_irqrestore(&local->tx_queue.lock, flags);
 
-	/* async is priority, otherwise sync is fallback */
-	if (local->ops->xmit_async) {
-		ret = drv_xmit_async(local, skb);
-		if (ret) {
-			ieee802154_wake_queue(&local->hw);
-			goto err_tx;
-		}
-
-		dev->stats.tx_packets++;
-		dev->stats.tx_bytes += skb->len;
-	} else {
-		local->tx_skb = skb;
-		queue_work(local->workqueue, &local->tx_work);
-	}
+	ieee802154_tx_kick(local);
 
 	return NETDEV_TX_OK;
 
@@ -116,6 +169,52 @@ ieee802154_monitor_start_xmit(struct sk_buff *skb, struct net_device *dev)
 	return ieee802154_tx(sdata->local, skb);
 }
 
+/* Frames handed to an asynchronous crypto engine count against
+ * tx_queue_depth like the queued ones, so that the pending encryptions
+ * stay bounded by the netif queue stop.
+ */
+static void ieee802154_tx_crypt_begin(struct ieee802154_local *local)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&local->tx_queue.lock, flags);
+	local->tx_crypt++;
+	if (skb_queue_len(&local->tx_queue) + local->tx_crypt >=
+	    local->hw.tx_queue_depth)
+		ieee802154_stop_queue(&local->hw);
+	spin_unlock_irqrestore(&local->tx_queue.lock, flags);
+}
+
+static void ieee802154_tx_crypt_end(struct ieee802154_local *local)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&local->tx_queue.lock, flags);
+	local->tx_crypt--;
+	spin_unlock_irqrestore(&local->tx_queue.lock, flags);
+}
+
+/* Completion of a frame encrypted by an asynchronous crypto engine. */
+static void ieee802154_subif_encrypted(struct sk_buff *skb, int err)
+{
+	struct ieee802154_sub_if_data *sdata =
+		IEEE802154_DEV_TO_SUB_IF(skb->dev);
+	struct ieee802154_local *local = sdata->local;
+
+	ieee802154_tx_crypt_end(local);
+
+	local_bh_disable();
+	if (err) {
+		netdev_warn(skb->dev, "encryption failed: %i\n", err);
+		kfree_skb(skb);
+		/* wakes the queue if this frame held it stopped */
+		ieee802154_tx_kick(local);
+	} else {
+		ieee802154_tx(local, skb);
+	}
+	local_bh_enable();
+}
+
 netdev_tx_t
 ieee802154_subif_start_xmit(struct sk_buff *skb, struct net_device *dev)
 {
@@ -126,14 +225,21 @@ ieee802154_subif_start_xmit(struct sk_buff *skb, struct net_device *dev)
 	 * functions. The reason is wireshark will show a mac header which is
 	 * with security fields but the payload is not encrypted.
 	 */
-	rc = mac802154_llsec_encrypt(&sdata->sec, skb);
+	skb->skb_iif = dev->ifindex;
+
+	ieee802154_tx_crypt_begin(sdata->local);
+	rc = mac802154_llsec_encrypt(&sdata->sec, skb,
+				     ieee802154_subif_encrypted);
+	if (rc == -EINPROGRESS)
+		return NETDEV_TX_OK;
+
+	ieee802154_tx_crypt_end(sdata->local);
 	if (rc) {
 		netdev_warn(dev, "encryption failed: %i\n", rc);
 		kfree_skb(skb);
+		ieee802154_tx_kick(sdata->local);
 		return NETDEV_TX_OK;
 	}
 
-	skb->skb_iif = dev->ifindex;
-
 	return ieee802154_tx(sdata->local, skb);
 }
@@ -19,9 +19,8 @@
 /* privid for wpan_phys to determine whether they belong to us or not */
 const void *const mac802154_wpan_phy_privid = &mac802154_wpan_phy_privid;
 
-void ieee802154_wake_queue(struct ieee802154_hw *hw)
+void ieee802154_wake_netif_queues(struct ieee802154_local *local)
 {
-	struct ieee802154_local *local = hw_to_local(hw);
 	struct ieee802154_sub_if_data *sdata;
 
 	rcu_read_lock();
@@ -33,6 +32,19 @@ void ieee802154_wake_queue(struct ieee802154_hw *hw)
 	}
 	rcu_read_unlock();
 }
+
+void ieee802154_wake_queue(struct ieee802154_hw *hw)
+{
+	struct ieee802154_local *local = hw_to_local(hw);
+	unsigned long flags;
+
+	spin_lock_irqsave(&local->tx_queue.lock, flags);
+	local->tx_busy = false;
+	spin_unlock_irqrestore(&local->tx_queue.lock, flags);
+
+	/* hands over the next frame and wakes the netif queues */
+	tasklet_schedule(&local->tx_tasklet);
+}
 EXPORT_SYMBOL(ieee802154_wake_queue);
 
 void ieee802154_stop_queue(struct ieee802154_hw *hw)
@@ -96,7 +108,13 @@ EXPORT_SYMBOL(ieee802154_xmit_complete);
 
 void ieee802154_stop_device(struct ieee802154_local *local)
 {
+	skb_queue_purge(&local->tx_queue);
 	flush_workqueue(local->workqueue);
 	hrtimer_cancel(&local->ifs_timer);
+	tasklet_kill(&local->tx_tasklet);
 	drv_stop(local);
+
+	spin_lock_irq(&local->tx_queue.lock);
+	local->tx_busy = false;
+	spin_unlock_irq(&local->tx_queue.lock);
 }
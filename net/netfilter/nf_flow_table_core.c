@@ -21,6 +21,26 @@ struct flow_offload_entry {
 static DEFINE_MUTEX(flowtable_lock);
 static LIST_HEAD(flowtables);
 
+/* Packets from a VLAN or PPPoE device are matched at the lower device,
+ * with the tag or session id as part of the tuple.
+ */
+static void flow_offload_fill_encap(struct flow_offload_tuple *ft,
+				    struct nf_conn *ct)
+{
+	struct net_device_encap encap;
+	struct net_device *dev;
+
+	rcu_read_lock();
+	dev = dev_get_by_index_rcu(nf_ct_net(ct), ft->iifidx);
+	if (dev && dev->netdev_ops->ndo_get_encap &&
+	    !dev->netdev_ops->ndo_get_encap(dev, &encap)) {
+		ft->iifidx = encap.lower_dev->ifindex;
+		ft->encap.id = encap.id;
+		ft->encap.proto = encap.proto;
+	}
+	rcu_read_unlock();
+}
+
 static void
 flow_offload_fill_dir(struct flow_offload *flow, struct nf_conn *ct,
 		      struct nf_flow_route *route,
@@ -53,6 +73,8 @@ flow_offload_fill_dir(struct flow_offload *flow, struct nf_conn *ct,
 	ft->iifidx = route->tuple[dir].ifindex;
 	ft->oifidx = route->tuple[!dir].ifindex;
 	ft->dst_cache = dst;
+
+	flow_offload_fill_encap(ft, ct);
 }
 
 struct flow_offload *
@@ -211,6 +233,10 @@ static void flow_offload_del(struct nf_flowtable *flow_table,
 	e = container_of(flow, struct flow_offload_entry, flow);
 	clear_bit(IPS_OFFLOAD_BIT, &e->ct->status);
 
+	/* Invalidate the per-cpu caches before the entry can go away. */
+	smp_mb__before_atomic();
+	atomic_inc(&flow_table->gen);
+
 	flow_offload_free(flow);
 }
 
@@ -230,11 +256,29 @@ flow_offload_lookup(struct nf_flowtable *flow_table,
 		    struct flow_offload_tuple *tuple)
 {
 	struct flow_offload_tuple_rhash *tuplehash;
+	struct nf_flow_cache *cache;
 	struct flow_offload *flow;
+	unsigned int gen;
 	int dir;
 
-	tuplehash = rhashtable_lookup(&flow_table->rhashtable, tuple,
-				      nf_flow_offload_rhash_params);
+	/* Packets of a flow tend to come in bursts on the same cpu, check
+	 * the last hit first. The generation is read before the table so
+	 * that an entry removed during the lookup is never cached as valid.
+	 */
+	gen = atomic_read(&flow_table->gen);
+	smp_rmb();
+
+	cache = get_cpu_ptr(flow_table->cache);
+	tuplehash = cache->tuplehash;
+	if (!tuplehash || cache->gen != gen ||
+	    memcmp(&tuplehash->tuple, tuple,
+		   offsetof(struct flow_offload_tuple, dir))) {
+		tuplehash = rhashtable_lookup(&flow_table->rhashtable, tuple,
+					      nf_flow_offload_rhash_params);
+		cache->tuplehash = tuplehash;
+		cache->gen = gen;
+	}
+	put_cpu_ptr(flow_table->cache);
 	if (!tuplehash)
 		return NULL;
 
@@ -446,10 +490,17 @@ int nf_flow_table_init(struct nf_flowtable *flowtable)
 
 	INIT_DEFERRABLE_WORK(&flowtable->gc_work, nf_flow_offload_work_gc);
 
+	flowtable->cache = alloc_percpu(struct nf_flow_cache);
+	if (!flowtable->cache)
+		return -ENOMEM;
+	atomic_set(&flowtable->gen, 0);
+
 	err = rhashtable_init(&flowtable->rhashtable,
 			      &nf_flow_offload_rhash_params);
-	if (err < 0)
+	if (err < 0) {
+		free_percpu(flowtable->cache);
 		return err;
+	}
 
 	queue_delayed_work(system_power_efficient_wq,
 			   &flowtable->gc_work, HZ);
@@ -473,9 +524,14 @@ static void nf_flow_table_do_cleanup(struct flow_offload *flow, void *data)
 		flow_offload_teardown(flow);
 		return;
 	}
+	/* The input side of an encapsulated flow is keyed on the lower
+	 * device, the upper one only shows up as output.
+	 */
 	if (net_eq(nf_ct_net(e->ct), dev_net(dev)) &&
 	    (flow->tuplehash[0].tuple.iifidx == dev->ifindex ||
-	     flow->tuplehash[1].tuple.iifidx == dev->ifindex))
+	     flow->tuplehash[1].tuple.iifidx == dev->ifindex ||
+	     flow->tuplehash[0].tuple.oifidx == dev->ifindex ||
+	     flow->tuplehash[1].tuple.oifidx == dev->ifindex))
 		flow_offload_dead(flow);
 }
 
@@ -506,6 +562,7 @@ void nf_flow_table_free(struct nf_flowtable *flow_table)
 	nf_flow_table_iterate(flow_table, nf_flow_table_do_cleanup, NULL);
 	nf_flow_offload_gc_step(flow_table);
 	rhashtable_destroy(&flow_table->rhashtable);
+	free_percpu(flow_table->cache);
 }
 EXPORT_SYMBOL_GPL(nf_flow_table_free);
 
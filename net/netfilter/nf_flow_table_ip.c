@@ -6,6 +6,9 @@
 #include <linux/ip.h>
 #include <linux/ipv6.h>
 #include <linux/netdevice.h>
+#include <linux/if_vlan.h>
+#include <linux/if_pppox.h>
+#include <linux/ppp_defs.h>
 #include <net/ip.h>
 #include <net/ipv6.h>
 #include <net/ip6_route.h>
@@ -15,6 +18,116 @@
 #include <linux/tcp.h>
 #include <linux/udp.h>
 
+static __be16 nf_flow_pppoe_proto(const struct sk_buff *skb)
+{
+	__be16 proto;
+
+	proto = *((__be16 *)(skb->data + sizeof(struct pppoe_hdr)));
+	switch (proto) {
+	case htons(PPP_IP):
+		return htons(ETH_P_IP);
+	case htons(PPP_IPV6):
+		return htons(ETH_P_IPV6);
+	}
+
+	return 0;
+}
+
+/* Fill in the input device and encapsulation of @tuple. Frames that are
+ * still tagged or carry a PPPoE session header are looked up as they are,
+ * frames already received on a VLAN or PPP device are looked up at its
+ * lower device, so either hook location finds the same flow. Returns the
+ * length of the header in front of the network header, negative if the
+ * frame does not carry @proto.
+ */
+static int nf_flow_tuple_encap(struct sk_buff *skb,
+			       const struct net_device *dev, __be16 proto,
+			       struct flow_offload_tuple *tuple)
+{
+	struct net_device_encap encap;
+	struct pppoe_hdr *phdr;
+	struct vlan_hdr *vhdr;
+	int offset = 0;
+
+	if (skb_vlan_tag_present(skb)) {
+		if (skb->protocol != proto)
+			return -1;
+
+		tuple->encap.id = skb_vlan_tag_get_id(skb);
+		tuple->encap.proto = skb->vlan_proto;
+		tuple->iifidx = dev->ifindex;
+		return 0;
+	}
+
+	switch (skb->protocol) {
+	case htons(ETH_P_8021Q):
+		if (!pskb_may_pull(skb, VLAN_HLEN))
+			return -1;
+
+		vhdr = (struct vlan_hdr *)skb->data;
+		if (vhdr->h_vlan_encapsulated_proto != proto)
+			return -1;
+
+		tuple->encap.id = ntohs(vhdr->h_vlan_TCI) & VLAN_VID_MASK;
+		tuple->encap.proto = skb->protocol;
+		offset = VLAN_HLEN;
+		break;
+	case htons(ETH_P_PPP_SES):
+		if (!pskb_may_pull(skb, PPPOE_SES_HLEN))
+			return -1;
+
+		phdr = (struct pppoe_hdr *)skb->data;
+		if (phdr->code || nf_flow_pppoe_proto(skb) != proto)
+			return -1;
+
+		tuple->encap.id = ntohs(phdr->sid);
+		tuple->encap.proto = skb->protocol;
+		offset = PPPOE_SES_HLEN;
+		break;
+	default:
+		if (skb->protocol != proto)
+			return -1;
+
+		if (dev->netdev_ops->ndo_get_encap &&
+		    !dev->netdev_ops->ndo_get_encap(dev, &encap)) {
+			tuple->encap.id = encap.id;
+			tuple->encap.proto = encap.proto;
+			dev = encap.lower_dev;
+		}
+		break;
+	}
+	tuple->iifidx = dev->ifindex;
+
+	return offset;
+}
+
+/* Strip what nf_flow_tuple_encap() matched on, the frame leaves through
+ * the upper device which adds its own header again.
+ */
+static void nf_flow_encap_pop(struct sk_buff *skb)
+{
+	struct vlan_hdr *vhdr;
+
+	if (skb_vlan_tag_present(skb)) {
+		skb->vlan_tci = 0;
+		return;
+	}
+
+	switch (skb->protocol) {
+	case htons(ETH_P_8021Q):
+		vhdr = (struct vlan_hdr *)skb->data;
+		skb_pull_rcsum(skb, VLAN_HLEN);
+		vlan_set_encap_proto(skb, vhdr);
+		skb_reset_network_header(skb);
+		break;
+	case htons(ETH_P_PPP_SES):
+		skb->protocol = nf_flow_pppoe_proto(skb);
+		skb_pull_rcsum(skb, PPPOE_SES_HLEN);
+		skb_reset_network_header(skb);
+		break;
+	}
+}
+
 static int nf_flow_state_check(struct flow_offload *flow, int proto,
 			       struct sk_buff *skb, unsigned int thoff)
 {
@@ -161,16 +274,20 @@ static bool ip_has_options(unsigned int thoff)
 }
 
 static int nf_flow_tuple_ip(struct sk_buff *skb, const struct net_device *dev,
-			    struct flow_offload_tuple *tuple)
+			    struct flow_offload_tuple *tuple, int *offset)
 {
 	struct flow_ports *ports;
 	unsigned int thoff;
 	struct iphdr *iph;
 
-	if (!pskb_may_pull(skb, sizeof(*iph)))
+	*offset = nf_flow_tuple_encap(skb, dev, htons(ETH_P_IP), tuple);
+	if (*offset < 0)
 		return -1;
 
-	iph = ip_hdr(skb);
+	if (!pskb_may_pull(skb, *offset + sizeof(*iph)))
+		return -1;
+
+	iph = (struct iphdr *)(skb_network_header(skb) + *offset);
 	thoff = iph->ihl * 4;
 
 	if (ip_is_fragment(iph) ||
@@ -181,10 +298,11 @@ static int nf_flow_tuple_ip(struct sk_buff *skb, const struct net_device *dev,
 	    iph->protocol != IPPROTO_UDP)
 		return -1;
 
-	thoff = iph->ihl * 4;
+	thoff = *offset + iph->ihl * 4;
 	if (!pskb_may_pull(skb, thoff + sizeof(*ports)))
 		return -1;
 
+	iph = (struct iphdr *)(skb_network_header(skb) + *offset);
 	ports = (struct flow_ports *)(skb_network_header(skb) + thoff);
 
 	tuple->src_v4.s_addr	= iph->saddr;
@@ -193,7 +311,6 @@ static int nf_flow_tuple_ip(struct sk_buff *skb, const struct net_device *dev,
 	tuple->dst_port		= ports->dest;
 	tuple->l3proto		= AF_INET;
 	tuple->l4proto		= iph->protocol;
-	tuple->iifidx		= dev->ifindex;
 
 	return 0;
 }
@@ -224,11 +341,9 @@ nf_flow_offload_ip_hook(void *priv, struct sk_buff *skb,
 	unsigned int thoff;
 	struct iphdr *iph;
 	__be32 nexthop;
+	int offset;
 
-	if (skb->protocol != htons(ETH_P_IP))
-		return NF_ACCEPT;
-
-	if (nf_flow_tuple_ip(skb, state->in, &tuple) < 0)
+	if (nf_flow_tuple_ip(skb, state->in, &tuple, &offset) < 0)
 		return NF_ACCEPT;
 
 	tuplehash = flow_offload_lookup(flow_table, &tuple);
@@ -243,17 +358,21 @@ nf_flow_offload_ip_hook(void *priv, struct sk_buff *skb,
 	flow = container_of(tuplehash, struct flow_offload, tuplehash[dir]);
 	rt = (struct rtable *)flow->tuplehash[dir].tuple.dst_cache;
 
-	if (unlikely(nf_flow_exceeds_mtu(skb, flow->tuplehash[dir].tuple.mtu)) &&
-	    (ip_hdr(skb)->frag_off & htons(IP_DF)) != 0)
+	iph = (struct iphdr *)(skb_network_header(skb) + offset);
+	if (unlikely(nf_flow_exceeds_mtu(skb, flow->tuplehash[dir].tuple.mtu +
+					      offset)) &&
+	    (iph->frag_off & htons(IP_DF)) != 0)
 		return NF_ACCEPT;
 
+	thoff = iph->ihl * 4;
+	if (nf_flow_state_check(flow, iph->protocol, skb, offset + thoff))
+		return NF_ACCEPT;
+
+	nf_flow_encap_pop(skb);
+
 	if (skb_try_make_writable(skb, sizeof(*iph)))
 		return NF_DROP;
 
-	thoff = ip_hdr(skb)->ihl * 4;
-	if (nf_flow_state_check(flow, ip_hdr(skb)->protocol, skb, thoff))
-		return NF_ACCEPT;
-
 	if (nf_flow_nat_ip(flow, skb, thoff, dir) < 0)
 		return NF_DROP;
 
@@ -396,25 +515,30 @@ static int nf_flow_nat_ipv6(const struct flow_offload *flow,
 }
 
 static int nf_flow_tuple_ipv6(struct sk_buff *skb, const struct net_device *dev,
-			      struct flow_offload_tuple *tuple)
+			      struct flow_offload_tuple *tuple, int *offset)
 {
 	struct flow_ports *ports;
 	struct ipv6hdr *ip6h;
 	unsigned int thoff;
 
-	if (!pskb_may_pull(skb, sizeof(*ip6h)))
+	*offset = nf_flow_tuple_encap(skb, dev, htons(ETH_P_IPV6), tuple);
+	if (*offset < 0)
 		return -1;
 
-	ip6h = ipv6_hdr(skb);
+	if (!pskb_may_pull(skb, *offset + sizeof(*ip6h)))
+		return -1;
+
+	ip6h = (struct ipv6hdr *)(skb_network_header(skb) + *offset);
 
 	if (ip6h->nexthdr != IPPROTO_TCP &&
 	    ip6h->nexthdr != IPPROTO_UDP)
 		return -1;
 
-	thoff = sizeof(*ip6h);
+	thoff = *offset + sizeof(*ip6h);
 	if (!pskb_may_pull(skb, thoff + sizeof(*ports)))
 		return -1;
 
+	ip6h = (struct ipv6hdr *)(skb_network_header(skb) + *offset);
 	ports = (struct flow_ports *)(skb_network_header(skb) + thoff);
 
 	tuple->src_v6		= ip6h->saddr;
@@ -423,7 +547,6 @@ static int nf_flow_tuple_ipv6(struct sk_buff *skb, const struct net_device *dev,
 	tuple->dst_port		= ports->dest;
 	tuple->l3proto		= AF_INET6;
 	tuple->l4proto		= ip6h->nexthdr;
-	tuple->iifidx		= dev->ifindex;
 
 	return 0;
 }
@@ -441,11 +564,9 @@ nf_flow_offload_ipv6_hook(void *priv, struct sk_buff *skb,
 	struct in6_addr *nexthop;
 	struct ipv6hdr *ip6h;
 	struct rt6_info *rt;
+	int offset;
 
-	if (skb->protocol != htons(ETH_P_IPV6))
-		return NF_ACCEPT;
-
-	if (nf_flow_tuple_ipv6(skb, state->in, &tuple) < 0)
+	if (nf_flow_tuple_ipv6(skb, state->in, &tuple, &offset) < 0)
 		return NF_ACCEPT;
 
 	tuplehash = flow_offload_lookup(flow_table, &tuple);
@@ -460,13 +581,17 @@ nf_flow_offload_ipv6_hook(void *priv, struct sk_buff *skb,
 	flow = container_of(tuplehash, struct flow_offload, tuplehash[dir]);
 	rt = (struct rt6_info *)flow->tuplehash[dir].tuple.dst_cache;
 
-	if (unlikely(nf_flow_exceeds_mtu(skb, flow->tuplehash[dir].tuple.mtu)))
+	if (unlikely(nf_flow_exceeds_mtu(skb, flow->tuplehash[dir].tuple.mtu +
+					      offset)))
 		return NF_ACCEPT;
 
-	if (nf_flow_state_check(flow, ipv6_hdr(skb)->nexthdr, skb,
-				sizeof(*ip6h)))
+	ip6h = (struct ipv6hdr *)(skb_network_header(skb) + offset);
+	if (nf_flow_state_check(flow, ip6h->nexthdr, skb,
+				offset + sizeof(*ip6h)))
 		return NF_ACCEPT;
 
+	nf_flow_encap_pop(skb);
+
 	if (skb_try_make_writable(skb, sizeof(*ip6h)))
 		return NF_DROP;
 
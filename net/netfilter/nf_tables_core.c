@@ -60,13 +60,10 @@ static void nft_cmp_fast_eval(const struct nft_expr *expr,
 	regs->verdict.code = NFT_BREAK;
 }
 
-static bool nft_payload_fast_eval(const struct nft_expr *expr,
-				  struct nft_regs *regs,
-				  const struct nft_pktinfo *pkt)
+static bool nft_payload_fast_load(const struct nft_payload *priv,
+				  const struct nft_pktinfo *pkt, u32 *dest)
 {
-	const struct nft_payload *priv = nft_expr_priv(expr);
 	const struct sk_buff *skb = pkt->skb;
-	u32 *dest = &regs->data[priv->dreg];
 	unsigned char *ptr;
 
 	if (priv->base == NFT_PAYLOAD_NETWORK_HEADER)
@@ -92,6 +89,38 @@ static bool nft_payload_fast_eval(const struct nft_expr *expr,
 	return true;
 }
 
+static bool nft_payload_fast_eval(const struct nft_expr *expr,
+				  struct nft_regs *regs,
+				  const struct nft_pktinfo *pkt)
+{
+	const struct nft_payload *priv = nft_expr_priv(expr);
+
+	return nft_payload_fast_load(priv, pkt, &regs->data[priv->dreg]);
+}
+
+/*
+ * Payload load fused with the fast compare that follows it: the packet
+ * bytes are compared as loaded, the register is still written for any
+ * later expression of the rule that reads it.
+ */
+static bool nft_payload_cmp_fast_eval(const struct nft_expr *expr,
+				      struct nft_regs *regs,
+				      const struct nft_pktinfo *pkt)
+{
+	const struct nft_payload *priv = nft_expr_priv(expr);
+	const struct nft_cmp_fast_expr *cmp;
+	u32 data;
+
+	if (!nft_payload_fast_load(priv, pkt, &data))
+		return false;
+
+	regs->data[priv->dreg] = data;
+	cmp = nft_expr_priv(nft_expr_next(expr));
+	if ((data & nft_cmp_fast_mask(cmp->len)) != cmp->data)
+		regs->verdict.code = NFT_BREAK;
+	return true;
+}
+
 DEFINE_STATIC_KEY_FALSE(nft_counters_enabled);
 
 static noinline void nft_update_chain_stats(const struct nft_chain *chain,
@@ -165,6 +194,9 @@ nft_do_chain(struct nft_pktinfo *pkt, void *priv)
 		nft_rule_for_each_expr(expr, last, rule) {
 			if (expr->ops == &nft_cmp_fast_ops)
 				nft_cmp_fast_eval(expr, &regs);
+			else if (expr->ops == &nft_payload_cmp_fast_ops &&
+				 nft_payload_cmp_fast_eval(expr, &regs, pkt))
+				expr = nft_expr_next(expr);
 			else if (expr->ops != &nft_payload_fast_ops ||
 				 !nft_payload_fast_eval(expr, &regs, pkt))
 				expr_call_ops_eval(expr, &regs, pkt);
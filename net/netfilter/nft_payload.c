@@ -169,6 +169,20 @@ const struct nft_expr_ops nft_payload_fast_ops = {
 	.dump		= nft_payload_dump,
 };
 
+/*
+ * Fast payload loads followed by a fast compare of the same register are
+ * evaluated together with it by nft_do_chain(), see nft_rule_fuse_exprs().
+ * Only ever set on an expression after its initialisation, the slow path
+ * and the dump are the same as above.
+ */
+const struct nft_expr_ops nft_payload_cmp_fast_ops = {
+	.type		= &nft_payload_type,
+	.size		= NFT_EXPR_SIZE(sizeof(struct nft_payload)),
+	.eval		= nft_payload_eval,
+	.init		= nft_payload_init,
+	.dump		= nft_payload_dump,
+};
+
 static inline void nft_csum_replace(__sum16 *sum, __wsum fsum, __wsum tsum)
 {
 	*sum = csum_fold(csum_add(csum_sub(~csum_unfold(*sum), fsum), tsum));
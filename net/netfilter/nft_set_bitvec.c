@@ -0,0 +1,878 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Set of ranges of concatenated fields, e.g. "10.0.0.0-10.0.0.255 . 1024-2047",
+ * looked up with the bit vector scheme by Lakshman and Stiliadis.
+ *
+ * Each element is a box: one range per field. For every field, the start of
+ * all ranges and the first value past their end split the field space into
+ * elementary intervals, and every elementary interval is given a bitmap of
+ * the elements whose range in that field covers it. A lookup then does one
+ * binary search per field, to find the elementary interval of the packet
+ * value, and ANDs the bitmaps of all fields: set bits are the matching
+ * elements, the lowest one being the first inserted.
+ *
+ * The bitmaps of each field are stored one after the other, so the AND is a
+ * linear pass over a few cachelines that the compiler can vectorise.
+ *
+ * The tables take one bit per element and elementary interval, that is up
+ * to (2n + 1) * n bits per field, so sets are capped to
+ * NFT_BITVEC_MAX_ELEMS elements.
+ *
+ * When a transaction touching the set is committed, the tables are cloned,
+ * patched and replaced under RCU. New elements take the next free bits,
+ * which the tables leave room for, and split the intervals they start or
+ * end in. Removed elements only have their bit cleared. The tables are
+ * built again from the element list once they run out of bits or half of
+ * them are unused. Elements added by a pending transaction are not active
+ * in the current generation yet, so the packet path doesn't need to see
+ * them before that. If the tables can't be allocated, lookups fall back to
+ * a linear walk of the element list.
+ */
+
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/list.h>
+#include <linux/rculist.h>
+#include <linux/slab.h>
+#include <linux/sort.h>
+#include <linux/netlink.h>
+#include <linux/netfilter.h>
+#include <linux/netfilter/nf_tables.h>
+#include <net/netfilter/nf_tables.h>
+#include <asm/unaligned.h>
+
+/* Fields up to the size of an IPv6 address */
+#define NFT_BITVEC_FIELD_MAXLEN		16
+
+/* About 2 MiB of bitmaps per field */
+#define NFT_BITVEC_MAX_ELEMS		4096
+
+/* Element not in the lookup tables yet */
+#define NFT_BITVEC_BIT_NONE		UINT_MAX
+
+struct nft_bitvec_key {
+	u64			hi;
+	u64			lo;
+};
+
+/**
+ *	struct nft_bitvec_field - lookup table for one field of the key
+ *
+ *	@offset: offset of the field in the key, bytes
+ *	@len: length of the field, bytes
+ *	@nbounds: number of elementary intervals
+ *	@bounds: sorted lower bounds of the elementary intervals
+ *	@bits: element bitmap of each elementary interval, match->longs each
+ */
+struct nft_bitvec_field {
+	unsigned int		offset;
+	unsigned int		len;
+	unsigned int		nbounds;
+	struct nft_bitvec_key	*bounds;
+	unsigned long		*bits;
+};
+
+struct nft_bitvec_elem;
+
+/**
+ *	struct nft_bitvec_match - lookup tables of a committed set
+ *
+ *	@rcu: used to release the tables
+ *	@rules: number of bits in use, including those of removed elements
+ *	@holes: bits of removed elements
+ *	@longs: words in each element bitmap
+ *	@elems: element for each bit, NULL once removed
+ *	@field_count: number of fields
+ *	@f: per-field tables
+ */
+struct nft_bitvec_match {
+	struct rcu_head		rcu;
+	unsigned int		rules;
+	unsigned int		holes;
+	unsigned int		longs;
+	struct nft_bitvec_elem	**elems;
+	unsigned int		field_count;
+	struct nft_bitvec_field	f[];
+};
+
+struct nft_bitvec {
+	struct list_head		list;
+	struct nft_bitvec_match __rcu	*match;
+	unsigned int			nelems;
+};
+
+struct nft_bitvec_elem {
+	struct list_head	head;
+	unsigned int		bit;
+	bool			removed;
+	struct nft_set_ext	ext;
+};
+
+static const struct nft_data *
+nft_bitvec_elem_key_end(const struct nft_bitvec_elem *be)
+{
+	if (nft_set_ext_exists(&be->ext, NFT_SET_EXT_KEY_END))
+		return nft_set_ext_key_end(&be->ext);
+
+	return nft_set_ext_key(&be->ext);
+}
+
+static inline unsigned int nft_bitvec_field_size(unsigned int len)
+{
+	return round_up(len, sizeof(u32));
+}
+
+/* Fields are in network byte order, read them as 128 bit integers */
+static inline struct nft_bitvec_key nft_bitvec_key_load(const void *data,
+							unsigned int len)
+{
+	struct nft_bitvec_key k = { 0, 0 };
+	const u8 *p = data;
+	unsigned int i;
+
+	switch (len) {
+	case 2:
+		k.lo = be16_to_cpu(*(const __be16 *)p);
+		break;
+	case 4:
+		k.lo = be32_to_cpu(*(const __be32 *)p);
+		break;
+	case 16:
+		k.hi = get_unaligned_be64(p);
+		k.lo = get_unaligned_be64(p + 8);
+		break;
+	default:
+		for (i = 0; i < len; i++) {
+			k.hi = k.hi << 8 | k.lo >> 56;
+			k.lo = k.lo << 8 | p[i];
+		}
+		break;
+	}
+
+	return k;
+}
+
+static inline int nft_bitvec_key_cmp(const struct nft_bitvec_key *a,
+				     const struct nft_bitvec_key *b)
+{
+	if (a->hi != b->hi)
+		return a->hi < b->hi ? -1 : 1;
+	if (a->lo != b->lo)
+		return a->lo < b->lo ? -1 : 1;
+	return 0;
+}
+
+static int nft_bitvec_key_sort_cmp(const void *a, const void *b)
+{
+	return nft_bitvec_key_cmp(a, b);
+}
+
+/* Increment @k, returns false if it is already the largest value of a
+ * @len bytes field.
+ */
+static bool nft_bitvec_key_inc(struct nft_bitvec_key *k, unsigned int len)
+{
+	u64 hi_max, lo_max;
+
+	if (len >= 16) {
+		hi_max = ~0ULL;
+		lo_max = ~0ULL;
+	} else if (len > 8) {
+		hi_max = (1ULL << ((len - 8) * BITS_PER_BYTE)) - 1;
+		lo_max = ~0ULL;
+	} else {
+		hi_max = 0;
+		lo_max = len == 8 ? ~0ULL : (1ULL << (len * BITS_PER_BYTE)) - 1;
+	}
+
+	if (k->hi == hi_max && k->lo == lo_max)
+		return false;
+
+	if (++k->lo == 0)
+		k->hi++;
+
+	return true;
+}
+
+/* Index of the elementary interval containing @k */
+static inline unsigned int
+nft_bitvec_field_find(const struct nft_bitvec_field *f,
+		      const struct nft_bitvec_key *k)
+{
+	unsigned int lo = 0, hi = f->nbounds, mid;
+
+	while (hi - lo > 1) {
+		mid = lo + (hi - lo) / 2;
+		if (nft_bitvec_key_cmp(&f->bounds[mid], k) <= 0)
+			lo = mid;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+static bool nft_bitvec_elem_match(const struct nft_set *set,
+				  const struct nft_bitvec_elem *be,
+				  const u8 *key)
+{
+	const u8 *start = (const u8 *)nft_set_ext_key(&be->ext);
+	const u8 *end = (const u8 *)nft_bitvec_elem_key_end(be);
+	unsigned int i, off = 0, len;
+
+	for (i = 0; i < set->field_count; i++) {
+		len = set->field_len[i];
+		if (memcmp(key + off, start + off, len) < 0 ||
+		    memcmp(key + off, end + off, len) > 0)
+			return false;
+		off += nft_bitvec_field_size(len);
+	}
+
+	return true;
+}
+
+static bool nft_bitvec_lookup_slow(const struct net *net,
+				   const struct nft_set *set,
+				   const u32 *key,
+				   const struct nft_set_ext **ext)
+{
+	const struct nft_bitvec *priv = nft_set_priv(set);
+	u8 genmask = nft_genmask_cur(net);
+	struct nft_bitvec_elem *be;
+
+	list_for_each_entry_rcu(be, &priv->list, head) {
+		if (!nft_set_elem_active(&be->ext, genmask) ||
+		    !nft_bitvec_elem_match(set, be, (const u8 *)key))
+			continue;
+
+		*ext = &be->ext;
+		return true;
+	}
+
+	return false;
+}
+
+static bool nft_bitvec_lookup(const struct net *net, const struct nft_set *set,
+			      const u32 *key, const struct nft_set_ext **ext)
+{
+	const struct nft_bitvec *priv = nft_set_priv(set);
+	unsigned int pos[NFT_REG32_COUNT];
+	const struct nft_bitvec_match *m;
+	u8 genmask = nft_genmask_cur(net);
+	const struct nft_bitvec_elem *be;
+	struct nft_bitvec_key k;
+	unsigned long bits;
+	unsigned int i, w;
+
+	m = rcu_dereference(priv->match);
+	if (unlikely(!m))
+		return nft_bitvec_lookup_slow(net, set, key, ext);
+	if (!m->rules)
+		return false;
+
+	for (i = 0; i < m->field_count; i++) {
+		const struct nft_bitvec_field *f = &m->f[i];
+
+		k = nft_bitvec_key_load((const u8 *)key + f->offset, f->len);
+		pos[i] = nft_bitvec_field_find(f, &k) * m->longs;
+	}
+
+	for (w = 0; w < m->longs; w++) {
+		bits = ~0UL;
+		for (i = 0; i < m->field_count; i++)
+			bits &= m->f[i].bits[pos[i] + w];
+
+		while (bits) {
+			be = m->elems[w * BITS_PER_LONG + __ffs(bits)];
+			if (nft_set_elem_active(&be->ext, genmask)) {
+				*ext = &be->ext;
+				return true;
+			}
+			bits &= bits - 1;
+		}
+	}
+
+	return false;
+}
+
+static void nft_bitvec_match_free(struct nft_bitvec_match *m)
+{
+	unsigned int i;
+
+	for (i = 0; i < m->field_count; i++) {
+		kvfree(m->f[i].bounds);
+		kvfree(m->f[i].bits);
+	}
+	kvfree(m->elems);
+	kfree(m);
+}
+
+static void nft_bitvec_match_free_rcu(struct rcu_head *rcu)
+{
+	nft_bitvec_match_free(container_of(rcu, struct nft_bitvec_match, rcu));
+}
+
+static void nft_bitvec_field_fill(struct nft_bitvec_field *f,
+				  const struct nft_bitvec_match *m,
+				  unsigned int bit)
+{
+	const struct nft_bitvec_elem *be = m->elems[bit];
+	struct nft_bitvec_key start, end;
+	unsigned int first, last, j;
+
+	start = nft_bitvec_key_load(
+		(const u8 *)nft_set_ext_key(&be->ext) + f->offset, f->len);
+	end = nft_bitvec_key_load(
+		(const u8 *)nft_bitvec_elem_key_end(be) + f->offset, f->len);
+
+	first = nft_bitvec_field_find(f, &start);
+	last = nft_bitvec_field_find(f, &end);
+	for (j = first; j <= last; j++)
+		__set_bit(bit, &f->bits[j * m->longs]);
+}
+
+/* Collects the bounds of elements @from to m->rules - 1, sorted and
+ * without duplicates. Returns how many there are.
+ */
+static int nft_bitvec_field_points(const struct nft_bitvec_match *m,
+				   const struct nft_bitvec_field *f,
+				   unsigned int from,
+				   struct nft_bitvec_key **pointsp)
+{
+	const struct nft_bitvec_elem *be;
+	struct nft_bitvec_key *points, end;
+	unsigned int i, j, n = 0;
+
+	points = kvmalloc_array(2 * (m->rules - from) + 1, sizeof(*points),
+				GFP_KERNEL);
+	if (!points)
+		return -ENOMEM;
+
+	points[n].hi = 0;
+	points[n++].lo = 0;
+	for (i = from; i < m->rules; i++) {
+		be = m->elems[i];
+		points[n++] = nft_bitvec_key_load(
+			(const u8 *)nft_set_ext_key(&be->ext) + f->offset,
+			f->len);
+		end = nft_bitvec_key_load(
+			(const u8 *)nft_bitvec_elem_key_end(be) + f->offset,
+			f->len);
+		if (nft_bitvec_key_inc(&end, f->len))
+			points[n++] = end;
+	}
+
+	sort(points, n, sizeof(*points), nft_bitvec_key_sort_cmp, NULL);
+	for (i = 1, j = 0; i < n; i++) {
+		if (nft_bitvec_key_cmp(&points[i], &points[j]))
+			points[++j] = points[i];
+	}
+
+	*pointsp = points;
+	return j + 1;
+}
+
+static int nft_bitvec_field_build(struct nft_bitvec_match *m,
+				  struct nft_bitvec_field *f)
+{
+	unsigned int i;
+	int n;
+
+	n = nft_bitvec_field_points(m, f, 0, &f->bounds);
+	if (n < 0)
+		return n;
+	f->nbounds = n;
+
+	f->bits = kvcalloc(array_size(f->nbounds, m->longs),
+			   sizeof(unsigned long), GFP_KERNEL);
+	if (!f->bits)
+		return -ENOMEM;
+
+	for (i = 0; i < m->rules; i++)
+		nft_bitvec_field_fill(f, m, i);
+
+	return 0;
+}
+
+static void nft_bitvec_row_copy(struct nft_bitvec_field *f, unsigned int row,
+				const struct nft_bitvec_key *bound,
+				const unsigned long *bits,
+				const unsigned long *keep, unsigned int longs)
+{
+	f->bounds[row] = *bound;
+	if (keep)
+		bitmap_and(&f->bits[row * longs], bits, keep,
+			   longs * BITS_PER_LONG);
+	else
+		memcpy(&f->bits[row * longs], bits,
+		       longs * sizeof(unsigned long));
+}
+
+/* Splits the intervals of @old at the bounds of the elements added to @m,
+ * a new interval starting with the bitmap of the one it was split from,
+ * drops the bits not in @keep and sets the bits of the new elements.
+ */
+static int nft_bitvec_field_update(struct nft_bitvec_match *m,
+				   struct nft_bitvec_field *f,
+				   const struct nft_bitvec_match *old,
+				   const struct nft_bitvec_field *of,
+				   const unsigned long *keep)
+{
+	unsigned int i, j, k = 0, out = 0, idx, longs = m->longs;
+	struct nft_bitvec_key *points;
+	int n;
+
+	n = nft_bitvec_field_points(m, f, old->rules, &points);
+	if (n < 0)
+		return n;
+
+	/* points[0] is always zero, like the first bound */
+	for (j = 1; j < n; j++) {
+		idx = nft_bitvec_field_find(of, &points[j]);
+		if (nft_bitvec_key_cmp(&of->bounds[idx], &points[j]))
+			points[k++] = points[j];
+	}
+
+	f->nbounds = of->nbounds + k;
+	f->bounds = kvmalloc_array(f->nbounds, sizeof(*f->bounds), GFP_KERNEL);
+	f->bits = kvmalloc_array(array_size(f->nbounds, longs),
+				 sizeof(unsigned long), GFP_KERNEL);
+	if (!f->bounds || !f->bits) {
+		kvfree(points);
+		return -ENOMEM;
+	}
+
+	/* each old interval, then the new ones it is split into */
+	for (i = 0, j = 0; i < of->nbounds; i++) {
+		nft_bitvec_row_copy(f, out++, &of->bounds[i],
+				    &of->bits[i * longs], keep, longs);
+		while (j < k &&
+		       (i + 1 == of->nbounds ||
+			nft_bitvec_key_cmp(&points[j], &of->bounds[i + 1]) < 0))
+			nft_bitvec_row_copy(f, out++, &points[j++],
+					    &of->bits[i * longs], keep, longs);
+	}
+	kvfree(points);
+
+	for (i = old->rules; i < m->rules; i++)
+		nft_bitvec_field_fill(f, m, i);
+
+	return 0;
+}
+
+static struct nft_bitvec_match *nft_bitvec_alloc(const struct nft_set *set,
+						 unsigned int longs)
+{
+	struct nft_bitvec_match *m;
+	unsigned int i, off = 0;
+
+	m = kzalloc(struct_size(m, f, set->field_count), GFP_KERNEL);
+	if (!m)
+		return NULL;
+
+	m->longs = longs;
+	m->field_count = set->field_count;
+	m->elems = kvcalloc(array_size(longs, BITS_PER_LONG),
+			    sizeof(*m->elems), GFP_KERNEL);
+	if (!m->elems) {
+		kfree(m);
+		return NULL;
+	}
+
+	for (i = 0; i < m->field_count; i++) {
+		m->f[i].offset = off;
+		m->f[i].len = set->field_len[i];
+		off += nft_bitvec_field_size(set->field_len[i]);
+	}
+
+	return m;
+}
+
+static struct nft_bitvec_match *nft_bitvec_build(const struct nft_set *set)
+{
+	const struct nft_bitvec *priv = nft_set_priv(set);
+	struct nft_bitvec_match *m;
+	struct nft_bitvec_elem *be;
+	unsigned int i, n = 0;
+
+	list_for_each_entry(be, &priv->list, head)
+		n++;
+
+	/* leave room for a quarter more elements before the next build */
+	m = nft_bitvec_alloc(set, BITS_TO_LONGS(n + n / 4 + 1));
+	if (!m)
+		return NULL;
+
+	list_for_each_entry(be, &priv->list, head) {
+		be->bit = m->rules;
+		m->elems[m->rules++] = be;
+	}
+
+	for (i = 0; i < m->field_count; i++) {
+		if (nft_bitvec_field_build(m, &m->f[i]) < 0)
+			goto err;
+	}
+
+	return m;
+err:
+	nft_bitvec_match_free(m);
+	return NULL;
+}
+
+/* Clones @old with the elements added and removed since it was built.
+ * Returns @old if nothing changed.
+ */
+static struct nft_bitvec_match *
+nft_bitvec_update(const struct nft_set *set, struct nft_bitvec_match *old)
+{
+	const struct nft_bitvec *priv = nft_set_priv(set);
+	unsigned int i, added = 0, removed = 0;
+	unsigned long *keep = NULL;
+	struct nft_bitvec_match *m;
+	struct nft_bitvec_elem *be;
+
+	list_for_each_entry(be, &priv->list, head) {
+		if (be->bit == NFT_BITVEC_BIT_NONE)
+			added++;
+	}
+	for (i = 0; i < old->rules; i++) {
+		if (old->elems[i] && old->elems[i]->removed)
+			removed++;
+	}
+
+	if (!added && !removed)
+		return old;
+
+	if (old->rules + added > old->longs * BITS_PER_LONG ||
+	    (old->holes + removed) * 2 > old->rules + added)
+		return nft_bitvec_build(set);
+
+	m = nft_bitvec_alloc(set, old->longs);
+	if (!m)
+		return NULL;
+
+	if (removed) {
+		keep = bitmap_alloc(m->longs * BITS_PER_LONG, GFP_KERNEL);
+		if (!keep)
+			goto err;
+		bitmap_fill(keep, m->longs * BITS_PER_LONG);
+	}
+
+	m->holes = old->holes + removed;
+	for (i = 0; i < old->rules; i++) {
+		be = old->elems[i];
+		if (be && be->removed) {
+			__clear_bit(i, keep);
+			be = NULL;
+		}
+		m->elems[i] = be;
+	}
+	m->rules = old->rules;
+
+	list_for_each_entry(be, &priv->list, head) {
+		if (be->bit != NFT_BITVEC_BIT_NONE)
+			continue;
+
+		be->bit = m->rules;
+		m->elems[m->rules++] = be;
+	}
+
+	for (i = 0; i < m->field_count; i++) {
+		if (nft_bitvec_field_update(m, &m->f[i], old, &old->f[i],
+					    keep) < 0)
+			goto err;
+	}
+
+	bitmap_free(keep);
+	return m;
+err:
+	bitmap_free(keep);
+	nft_bitvec_match_free(m);
+	return NULL;
+}
+
+static void nft_bitvec_commit(const struct nft_set *set)
+{
+	struct nft_bitvec *priv = nft_set_priv(set);
+	struct nft_bitvec_match *old, *new;
+
+	/* On allocation failure lookups walk the element list instead,
+	 * until the next commit builds the tables again.
+	 */
+	old = rcu_dereference_protected(priv->match, true);
+	if (old)
+		new = nft_bitvec_update(set, old);
+	else
+		new = nft_bitvec_build(set);
+	if (new == old)
+		return;
+
+	rcu_assign_pointer(priv->match, new);
+	if (old)
+		call_rcu(&old->rcu, nft_bitvec_match_free_rcu);
+}
+
+static bool nft_bitvec_elem_equal(const struct nft_set *set,
+				  const struct nft_bitvec_elem *be,
+				  const u32 *key, const u32 *key_end)
+{
+	return !memcmp(nft_set_ext_key(&be->ext), key, set->klen) &&
+	       !memcmp(nft_bitvec_elem_key_end(be), key_end, set->klen);
+}
+
+/* Two boxes overlap if their ranges overlap in every field */
+static bool nft_bitvec_elem_overlap(const struct nft_set *set,
+				    const struct nft_bitvec_elem *a,
+				    const struct nft_bitvec_elem *b)
+{
+	const u8 *a_start = (const u8 *)nft_set_ext_key(&a->ext);
+	const u8 *a_end = (const u8 *)nft_bitvec_elem_key_end(a);
+	const u8 *b_start = (const u8 *)nft_set_ext_key(&b->ext);
+	const u8 *b_end = (const u8 *)nft_bitvec_elem_key_end(b);
+	unsigned int i, off = 0, len;
+
+	for (i = 0; i < set->field_count; i++) {
+		len = set->field_len[i];
+		if (memcmp(a_end + off, b_start + off, len) < 0 ||
+		    memcmp(b_end + off, a_start + off, len) < 0)
+			return false;
+		off += nft_bitvec_field_size(len);
+	}
+
+	return true;
+}
+
+static struct nft_bitvec_elem *
+nft_bitvec_elem_find(const struct nft_set *set, const u32 *key,
+		     const u32 *key_end, u8 genmask)
+{
+	const struct nft_bitvec *priv = nft_set_priv(set);
+	struct nft_bitvec_elem *be;
+
+	list_for_each_entry_rcu(be, &priv->list, head) {
+		if (!nft_set_elem_active(&be->ext, genmask) ||
+		    !nft_bitvec_elem_equal(set, be, key, key_end))
+			continue;
+
+		return be;
+	}
+
+	return NULL;
+}
+
+static void *nft_bitvec_get(const struct net *net, const struct nft_set *set,
+			    const struct nft_set_elem *elem, unsigned int flags)
+{
+	struct nft_bitvec_elem *be;
+
+	be = nft_bitvec_elem_find(set, elem->key.val.data,
+				  elem->key_end.val.data,
+				  nft_genmask_cur(net));
+
+	return be ? be : ERR_PTR(-ENOENT);
+}
+
+static int nft_bitvec_insert(const struct net *net, const struct nft_set *set,
+			     const struct nft_set_elem *elem,
+			     struct nft_set_ext **ext)
+{
+	struct nft_bitvec *priv = nft_set_priv(set);
+	struct nft_bitvec_elem *new = elem->priv, *be;
+	const u8 *start = (const u8 *)nft_set_ext_key(&new->ext);
+	const u8 *end = (const u8 *)nft_bitvec_elem_key_end(new);
+	u8 genmask = nft_genmask_next(net);
+	unsigned int i, off = 0;
+
+	for (i = 0; i < set->field_count; i++) {
+		if (memcmp(start + off, end + off, set->field_len[i]) > 0)
+			return -EINVAL;
+		off += nft_bitvec_field_size(set->field_len[i]);
+	}
+
+	list_for_each_entry(be, &priv->list, head) {
+		if (!nft_set_elem_active(&be->ext, genmask))
+			continue;
+
+		if (nft_bitvec_elem_equal(set, be,
+					  nft_set_ext_key(&new->ext)->data,
+					  nft_bitvec_elem_key_end(new)->data)) {
+			*ext = &be->ext;
+			return -EEXIST;
+		}
+
+		if (nft_bitvec_elem_overlap(set, be, new))
+			return -ENOTEMPTY;
+	}
+
+	if (priv->nelems >= NFT_BITVEC_MAX_ELEMS)
+		return -ENFILE;
+
+	new->bit = NFT_BITVEC_BIT_NONE;
+	list_add_tail_rcu(&new->head, &priv->list);
+	priv->nelems++;
+
+	return 0;
+}
+
+static void nft_bitvec_remove(const struct net *net,
+			      const struct nft_set *set,
+			      const struct nft_set_elem *elem)
+{
+	struct nft_bitvec *priv = nft_set_priv(set);
+	struct nft_bitvec_elem *be = elem->priv;
+
+	/* its bit is cleared by the next commit */
+	be->removed = true;
+	list_del_rcu(&be->head);
+	priv->nelems--;
+}
+
+static void nft_bitvec_activate(const struct net *net,
+				const struct nft_set *set,
+				const struct nft_set_elem *elem)
+{
+	struct nft_bitvec_elem *be = elem->priv;
+
+	nft_set_elem_change_active(net, set, &be->ext);
+	nft_set_elem_clear_busy(&be->ext);
+}
+
+static bool nft_bitvec_flush(const struct net *net,
+			     const struct nft_set *set, void *priv)
+{
+	struct nft_bitvec_elem *be = priv;
+
+	if (!nft_set_elem_mark_busy(&be->ext) ||
+	    !nft_is_active(net, &be->ext)) {
+		nft_set_elem_change_active(net, set, &be->ext);
+		return true;
+	}
+	return false;
+}
+
+static void *nft_bitvec_deactivate(const struct net *net,
+				   const struct nft_set *set,
+				   const struct nft_set_elem *elem)
+{
+	struct nft_bitvec_elem *be;
+
+	be = nft_bitvec_elem_find(set, elem->key.val.data,
+				  elem->key_end.val.data,
+				  nft_genmask_next(net));
+	if (!be)
+		return NULL;
+
+	nft_bitvec_flush(net, set, be);
+
+	return be;
+}
+
+static void nft_bitvec_walk(const struct nft_ctx *ctx,
+			    struct nft_set *set,
+			    struct nft_set_iter *iter)
+{
+	const struct nft_bitvec *priv = nft_set_priv(set);
+	struct nft_bitvec_elem *be;
+	struct nft_set_elem elem;
+
+	list_for_each_entry_rcu(be, &priv->list, head) {
+		if (iter->count < iter->skip)
+			goto cont;
+		if (!nft_set_elem_active(&be->ext, iter->genmask))
+			goto cont;
+
+		elem.priv = be;
+
+		iter->err = iter->fn(ctx, set, iter, &elem);
+		if (iter->err < 0)
+			return;
+cont:
+		iter->count++;
+	}
+}
+
+static u64 nft_bitvec_privsize(const struct nlattr * const nla[],
+			       const struct nft_set_desc *desc)
+{
+	return sizeof(struct nft_bitvec);
+}
+
+static int nft_bitvec_init(const struct nft_set *set,
+			   const struct nft_set_desc *desc,
+			   const struct nlattr * const nla[])
+{
+	struct nft_bitvec *priv = nft_set_priv(set);
+
+	INIT_LIST_HEAD(&priv->list);
+	RCU_INIT_POINTER(priv->match, NULL);
+	priv->nelems = 0;
+
+	return 0;
+}
+
+static void nft_bitvec_destroy(const struct nft_set *set)
+{
+	struct nft_bitvec *priv = nft_set_priv(set);
+	struct nft_bitvec_elem *be, *n;
+	struct nft_bitvec_match *m;
+
+	m = rcu_dereference_protected(priv->match, true);
+	if (m)
+		nft_bitvec_match_free(m);
+
+	list_for_each_entry_safe(be, n, &priv->list, head)
+		nft_set_elem_destroy(set, be, true);
+}
+
+static bool nft_bitvec_estimate(const struct nft_set_desc *desc, u32 features,
+				struct nft_set_estimate *est)
+{
+	unsigned int i;
+	u64 size;
+
+	if (!(features & NFT_SET_INTERVAL) || desc->field_count < 2 ||
+	    desc->size > NFT_BITVEC_MAX_ELEMS)
+		return false;
+
+	for (i = 0; i < desc->field_count; i++) {
+		if (desc->field_len[i] > NFT_BITVEC_FIELD_MAXLEN)
+			return false;
+	}
+
+	/* up to 2 * size + 1 intervals per field, one bit per element each,
+	 * the lookup ANDs one word per BITS_PER_LONG elements
+	 */
+	size = desc->size ? : NFT_BITVEC_MAX_ELEMS;
+	est->size = sizeof(struct nft_bitvec) +
+		    size * sizeof(struct nft_bitvec_elem) +
+		    desc->field_count * (2 * size + 1) *
+		    (sizeof(struct nft_bitvec_key) +
+		     BITS_TO_LONGS(size + size / 4 + 1) * sizeof(long));
+
+	est->lookup = NFT_SET_CLASS_O_N;
+	est->space  = NFT_SET_CLASS_O_N2;
+
+	return true;
+}
+
+struct nft_set_type nft_set_bitvec_type __read_mostly = {
+	.owner		= THIS_MODULE,
+	.features	= NFT_SET_INTERVAL | NFT_SET_MAP | NFT_SET_OBJECT,
+	.ops		= {
+		.privsize	= nft_bitvec_privsize,
+		.elemsize	= offsetof(struct nft_bitvec_elem, ext),
+		.estimate	= nft_bitvec_estimate,
+		.init		= nft_bitvec_init,
+		.destroy	= nft_bitvec_destroy,
+		.insert		= nft_bitvec_insert,
+		.remove		= nft_bitvec_remove,
+		.deactivate	= nft_bitvec_deactivate,
+		.flush		= nft_bitvec_flush,
+		.activate	= nft_bitvec_activate,
+		.commit		= nft_bitvec_commit,
+		.lookup		= nft_bitvec_lookup,
+		.walk		= nft_bitvec_walk,
+		.get		= nft_bitvec_get,
+	},
+};
@@ -48,6 +48,10 @@
  *
  * This qdisc was inspired by Eric Dumazet's fq_codel code, which he kindly
  * granted us permission to leverage.
+ *
+ * Like fq_codel, cake is a TCQ_F_NOLOCK qdisc: enqueue only timestamps the
+ * packet and stages it on a per-CPU list, and the CPU running the qdisc
+ * classifies and queues the staged packets in a batch before dequeueing.
  */
 
 #include <linux/module.h>
@@ -234,6 +238,7 @@ struct cake_sched_data {
 	u16		cur_flow;
 
 	struct qdisc_watchdog watchdog;
+	struct qdisc_stage stage;	/* packets staged by TCQ_F_NOLOCK enqueue */
 	const u8	*tin_index;
 	const u8	*tin_order;
 
@@ -1495,7 +1500,9 @@ static unsigned int cake_drop(struct Qdisc *sch, struct sk_buff **to_free)
 
 	flow->dropped++;
 	b->tin_dropped++;
-	sch->qstats.drops++;
+	qdisc_qstats_cpu_drop(sch);
+	qdisc_qstats_cpu_qlen_dec(sch);
+	this_cpu_sub(sch->cpu_qstats->backlog, len);
 
 	if (q->rate_flags & CAKE_FLAG_INGRESS)
 		cake_advance_shaper(q, b, skb, now, true);
@@ -1617,8 +1624,12 @@ static u32 cake_classify(struct Qdisc *sch, struct cake_tin_data **t,
 
 static void cake_reconfigure(struct Qdisc *sch);
 
-static s32 cake_enqueue(struct sk_buff *skb, struct Qdisc *sch,
-			struct sk_buff **to_free)
+/* Classify and queue a packet already accounted in the per-CPU stats.
+ * The caller owns the qdisc: either the root lock, or the qdisc lock of a
+ * TCQ_F_NOLOCK qdisc.
+ */
+static s32 __cake_enqueue(struct sk_buff *skb, struct Qdisc *sch,
+			  struct sk_buff **to_free)
 {
 	struct cake_sched_data *q = qdisc_priv(sch);
 	int len = qdisc_pkt_len(skb);
@@ -1632,8 +1643,10 @@ static s32 cake_enqueue(struct sk_buff *skb, struct Qdisc *sch,
 	/* choose flow to insert into */
 	idx = cake_classify(sch, &b, skb, q->flow_mode, &ret);
 	if (idx == 0) {
+		qdisc_qstats_cpu_qlen_dec(sch);
+		qdisc_qstats_cpu_backlog_dec(sch, skb);
 		if (ret & __NET_XMIT_BYPASS)
-			qdisc_qstats_drop(sch);
+			qdisc_qstats_cpu_drop(sch);
 		__qdisc_drop(skb, to_free);
 		return ret;
 	}
@@ -1655,7 +1668,7 @@ static s32 cake_enqueue(struct sk_buff *skb, struct Qdisc *sch,
 					min(ktime_to_ns(q->time_next_packet),
 					    ktime_to_ns(
 						   q->failsafe_next_packet));
-				sch->qstats.overlimits++;
+				qdisc_qstats_cpu_overlimit(sch);
 				qdisc_watchdog_schedule_ns(&q->watchdog, next);
 			}
 		}
@@ -1667,28 +1680,38 @@ static s32 cake_enqueue(struct sk_buff *skb, struct Qdisc *sch,
 	if (skb_is_gso(skb) && q->rate_flags & CAKE_FLAG_SPLIT_GSO) {
 		struct sk_buff *segs, *nskb;
 		netdev_features_t features = netif_skb_features(skb);
-		unsigned int slen = 0;
+		ktime_t enqueue_time = cobalt_get_enqueue_time(skb);
+		unsigned int slen = 0, numsegs = 0;
 
 		segs = skb_gso_segment(skb, features & ~NETIF_F_GSO_MASK);
-		if (IS_ERR_OR_NULL(segs))
-			return qdisc_drop(skb, sch, to_free);
+		if (IS_ERR_OR_NULL(segs)) {
+			qdisc_qstats_cpu_qlen_dec(sch);
+			qdisc_qstats_cpu_backlog_dec(sch, skb);
+			return qdisc_drop_cpu(skb, sch, to_free);
+		}
 
 		while (segs) {
 			nskb = segs->next;
 			skb_mark_not_on_list(segs);
 			qdisc_skb_cb(segs)->pkt_len = segs->len;
-			cobalt_set_enqueue_time(segs, now);
+			cobalt_set_enqueue_time(segs, enqueue_time);
 			get_cobalt_cb(segs)->adjusted_len = cake_overhead(q,
 									  segs);
 			flow_queue_add(flow, segs);
 
 			sch->q.qlen++;
+			numsegs++;
 			slen += segs->len;
 			q->buffer_used += segs->truesize;
 			b->packets++;
 			segs = nskb;
 		}
 
+		/* the original skb was accounted as one packet of len bytes */
+		this_cpu_add(sch->cpu_qstats->qlen, numsegs - 1);
+		this_cpu_add(sch->cpu_qstats->backlog, slen);
+		this_cpu_sub(sch->cpu_qstats->backlog, len);
+
 		/* stats */
 		b->bytes	    += slen;
 		b->backlogs[idx]    += slen;
@@ -1700,7 +1723,6 @@ static s32 cake_enqueue(struct sk_buff *skb, struct Qdisc *sch,
 		consume_skb(skb);
 	} else {
 		/* not splitting */
-		cobalt_set_enqueue_time(skb, now);
 		get_cobalt_cb(skb)->adjusted_len = cake_overhead(q, skb);
 		flow_queue_add(flow, skb);
 
@@ -1709,7 +1731,9 @@ static s32 cake_enqueue(struct sk_buff *skb, struct Qdisc *sch,
 
 		if (ack) {
 			b->ack_drops++;
-			sch->qstats.drops++;
+			qdisc_qstats_cpu_drop(sch);
+			qdisc_qstats_cpu_qlen_dec(sch);
+			qdisc_qstats_cpu_backlog_dec(sch, ack);
 			b->bytes += qdisc_pkt_len(ack);
 			len -= qdisc_pkt_len(ack);
 			q->buffer_used += skb->truesize - ack->truesize;
@@ -1824,6 +1848,52 @@ static s32 cake_enqueue(struct sk_buff *skb, struct Qdisc *sch,
 	return NET_XMIT_SUCCESS;
 }
 
+static s32 cake_enqueue(struct sk_buff *skb, struct Qdisc *sch,
+			struct sk_buff **to_free)
+{
+	struct cake_sched_data *q = qdisc_priv(sch);
+	unsigned int room, mem_room;
+
+	/* Classification updates the set-associative hash, so it has to
+	 * wait for the dequeuer.  Stamp the packet now so that its sojourn
+	 * time includes the time spent staged.
+	 */
+	cobalt_set_enqueue_time(skb, ktime_get());
+	qdisc_qstats_cpu_qlen_inc(sch);
+	qdisc_qstats_cpu_backlog_inc(sch, skb);
+
+	if (!(sch->flags & TCQ_F_NOLOCK))
+		return __cake_enqueue(skb, sch, to_free);
+
+	room = sch->limit - min(READ_ONCE(sch->q.qlen), sch->limit);
+	mem_room = q->buffer_limit -
+		   min(READ_ONCE(q->buffer_used), q->buffer_limit);
+	if (likely(qdisc_stage_add(&q->stage, skb, room, mem_room)))
+		return qdisc_stage_xmit_ret(&q->stage);
+
+	qdisc_qstats_cpu_qlen_dec(sch);
+	qdisc_qstats_cpu_backlog_dec(sch, skb);
+	return qdisc_drop_cpu(skb, sch, to_free);
+}
+
+/* Queue the packets staged by TCQ_F_NOLOCK enqueue */
+static void cake_drain(struct Qdisc *sch, struct sk_buff **to_free)
+{
+	struct cake_sched_data *q = qdisc_priv(sch);
+	struct llist_node *node = qdisc_stage_drain(&q->stage);
+	struct sk_buff *skb, *tmp;
+	unsigned long memory = 0;
+	unsigned int qlen = 0;
+
+	llist_for_each_entry_safe(skb, tmp, node, ll_node) {
+		qlen++;
+		memory += skb->truesize;
+		if (__cake_enqueue(skb, sch, to_free) != NET_XMIT_SUCCESS)
+			WRITE_ONCE(q->stage.congested, true);
+	}
+	qdisc_stage_release(&q->stage, qlen, memory);
+}
+
 static struct sk_buff *cake_dequeue_one(struct Qdisc *sch)
 {
 	struct cake_sched_data *q = qdisc_priv(sch);
@@ -1840,6 +1910,8 @@ static struct sk_buff *cake_dequeue_one(struct Qdisc *sch)
 		sch->qstats.backlog      -= len;
 		q->buffer_used		 -= skb->truesize;
 		sch->q.qlen--;
+		qdisc_qstats_cpu_qlen_dec(sch);
+		qdisc_qstats_cpu_backlog_dec(sch, skb);
 
 		if (q->overflow_timeout)
 			cake_heapify(q, b->overflow_idx[q->cur_flow]);
@@ -1859,7 +1931,7 @@ static void cake_clear_tin(struct Qdisc *sch, u16 tin)
 			kfree_skb(skb);
 }
 
-static struct sk_buff *cake_dequeue(struct Qdisc *sch)
+static struct sk_buff *__cake_dequeue(struct Qdisc *sch)
 {
 	struct cake_sched_data *q = qdisc_priv(sch);
 	struct cake_tin_data *b = &q->tins[q->cur_tin];
@@ -1883,7 +1955,7 @@ static struct sk_buff *cake_dequeue(struct Qdisc *sch)
 		u64 next = min(ktime_to_ns(q->time_next_packet),
 			       ktime_to_ns(q->failsafe_next_packet));
 
-		sch->qstats.overlimits++;
+		qdisc_qstats_cpu_overlimit(sch);
 		qdisc_watchdog_schedule_ns(&q->watchdog, next);
 		return NULL;
 	}
@@ -2071,14 +2143,14 @@ static struct sk_buff *cake_dequeue(struct Qdisc *sch)
 		flow->dropped++;
 		b->tin_dropped++;
 		qdisc_tree_reduce_backlog(sch, 1, qdisc_pkt_len(skb));
-		qdisc_qstats_drop(sch);
+		qdisc_qstats_cpu_drop(sch);
 		kfree_skb(skb);
 		if (q->rate_flags & CAKE_FLAG_INGRESS)
 			goto retry;
 	}
 
 	b->tin_ecn_mark += !!flow->cvars.ecn_marked;
-	qdisc_bstats_update(sch, skb);
+	qdisc_bstats_cpu_update(sch, skb);
 
 	/* collect delay stats */
 	delay = ktime_to_ns(ktime_sub(now, cobalt_get_enqueue_time(skb)));
@@ -2119,12 +2191,44 @@ static struct sk_buff *cake_dequeue(struct Qdisc *sch)
 	return skb;
 }
 
+static struct sk_buff *cake_dequeue(struct Qdisc *sch)
+{
+	struct sk_buff *to_free = NULL;
+	struct sk_buff *skb;
+
+	if (!(sch->flags & TCQ_F_NOLOCK))
+		return __cake_dequeue(sch);
+
+	/* The running bit keeps other dequeuers away, the qdisc lock
+	 * protects the tins against change(), reset() and dumps.
+	 */
+	spin_lock(qdisc_lock(sch));
+	cake_drain(sch, &to_free);
+	skb = __cake_dequeue(sch);
+	spin_unlock(qdisc_lock(sch));
+
+	if (unlikely(to_free))
+		kfree_skb_list(to_free);
+	return skb;
+}
+
 static void cake_reset(struct Qdisc *sch)
 {
+	struct cake_sched_data *q = qdisc_priv(sch);
 	u32 c;
+	int i;
+
+	qdisc_stage_purge(&q->stage);
 
 	for (c = 0; c < CAKE_MAX_TINS; c++)
 		cake_clear_tin(sch, c);
+
+	for_each_possible_cpu(i) {
+		struct gnet_stats_queue *qs = per_cpu_ptr(sch->cpu_qstats, i);
+
+		qs->backlog = 0;
+		qs->qlen = 0;
+	}
 }
 
 static const struct nla_policy cake_policy[TCA_CAKE_MAX + 1] = {
@@ -2604,6 +2708,7 @@ static void cake_destroy(struct Qdisc *sch)
 
 	qdisc_watchdog_cancel(&q->watchdog);
 	tcf_block_put(q->block);
+	qdisc_stage_destroy(sch, &q->stage);
 	kvfree(q->tins);
 }
 
@@ -2640,6 +2745,10 @@ static int cake_init(struct Qdisc *sch, struct nlattr *opt,
 	if (err)
 		return err;
 
+	err = qdisc_stage_init(sch, &q->stage);
+	if (err)
+		return err;
+
 	quantum_div[0] = ~0;
 	for (i = 1; i <= CAKE_QUEUES; i++)
 		quantum_div[i] = 65535 / i;
@@ -3014,6 +3123,7 @@ static struct Qdisc_ops cake_qdisc_ops __read_mostly = {
 	.change		=	cake_change,
 	.dump		=	cake_dump,
 	.dump_stats	=	cake_dump_stats,
+	.static_flags	=	TCQ_F_NOLOCK | TCQ_F_CPUSTATS,
 	.owner		=	THIS_MODULE,
 };
 
@@ -42,6 +42,12 @@
  * head drops only.
  * ECN capability is on by default.
  * Low memory footprint (64 bytes per flow)
+ *
+ * As a TCQ_F_NOLOCK qdisc, enqueue only classifies the packet and stages
+ * it on a per-CPU list. The CPU running the qdisc moves all staged packets
+ * to their flows under the qdisc lock before each dequeue, so flows, CoDel
+ * state and drops stay exactly as with a locked enqueue, while senders on
+ * different CPUs no longer serialize on the root lock.
  */
 
 struct fq_codel_flow {
@@ -71,8 +77,22 @@ struct fq_codel_sched_data {
 
 	struct list_head new_flows;	/* list of new flows */
 	struct list_head old_flows;	/* list of old flows */
+
+	struct qdisc_stage stage;	/* packets staged by TCQ_F_NOLOCK enqueue */
+};
+
+/* The flow index is computed at enqueue time, before the packet is staged */
+struct fq_codel_skb_cb {
+	struct codel_skb_cb cb;
+	u32		idx;
 };
 
+static struct fq_codel_skb_cb *get_fq_codel_cb(const struct sk_buff *skb)
+{
+	qdisc_cb_private_validate(skb, sizeof(struct fq_codel_skb_cb));
+	return (struct fq_codel_skb_cb *)qdisc_skb_cb(skb)->data;
+}
+
 static unsigned int fq_codel_hash(const struct fq_codel_sched_data *q,
 				  struct sk_buff *skb)
 {
@@ -180,32 +200,32 @@ static unsigned int fq_codel_drop(struct Qdisc *sch, unsigned int max_packets,
 	flow->dropped += i;
 	q->backlogs[idx] -= len;
 	q->memory_usage -= mem;
-	sch->qstats.drops += i;
+	this_cpu_add(sch->cpu_qstats->drops, i);
+	this_cpu_sub(sch->cpu_qstats->backlog, len);
+	this_cpu_sub(sch->cpu_qstats->qlen, i);
 	sch->qstats.backlog -= len;
 	sch->q.qlen -= i;
 	return idx;
 }
 
-static int fq_codel_enqueue(struct sk_buff *skb, struct Qdisc *sch,
-			    struct sk_buff **to_free)
+/* Queue an already classified packet to its flow.  The caller owns the
+ * qdisc: either the root lock, or the qdisc lock of a TCQ_F_NOLOCK qdisc.
+ *
+ * sch->q.qlen and sch->qstats.backlog only count the packets held in the
+ * flows; the reported statistics are kept in the per-CPU counters, which
+ * also include the staged packets.
+ */
+static int __fq_codel_enqueue(struct sk_buff *skb, struct Qdisc *sch,
+			      struct sk_buff **to_free)
 {
 	struct fq_codel_sched_data *q = qdisc_priv(sch);
 	unsigned int idx, prev_backlog, prev_qlen;
 	struct fq_codel_flow *flow;
-	int uninitialized_var(ret);
 	unsigned int pkt_len;
 	bool memory_limited;
+	int ret;
 
-	idx = fq_codel_classify(skb, sch, &ret);
-	if (idx == 0) {
-		if (ret & __NET_XMIT_BYPASS)
-			qdisc_qstats_drop(sch);
-		__qdisc_drop(skb, to_free);
-		return ret;
-	}
-	idx--;
-
-	codel_set_enqueue_time(skb);
+	idx = get_fq_codel_cb(skb)->idx;
 	flow = &q->flows[idx];
 	flow_queue_add(flow, skb);
 	q->backlogs[idx] += qdisc_pkt_len(skb);
@@ -254,6 +274,61 @@ static int fq_codel_enqueue(struct sk_buff *skb, struct Qdisc *sch,
 	return NET_XMIT_SUCCESS;
 }
 
+static int fq_codel_enqueue(struct sk_buff *skb, struct Qdisc *sch,
+			    struct sk_buff **to_free)
+{
+	struct fq_codel_sched_data *q = qdisc_priv(sch);
+	unsigned int idx, room, mem_room;
+	int uninitialized_var(ret);
+
+	idx = fq_codel_classify(skb, sch, &ret);
+	if (idx == 0) {
+		if (ret & __NET_XMIT_BYPASS)
+			qdisc_qstats_cpu_drop(sch);
+		__qdisc_drop(skb, to_free);
+		return ret;
+	}
+	get_fq_codel_cb(skb)->idx = idx - 1;
+
+	codel_set_enqueue_time(skb);
+	qdisc_qstats_cpu_qlen_inc(sch);
+	qdisc_qstats_cpu_backlog_inc(sch, skb);
+
+	if (!(sch->flags & TCQ_F_NOLOCK))
+		return __fq_codel_enqueue(skb, sch, to_free);
+
+	/* Packets staged beyond the room left in the flows would only be
+	 * dropped by __fq_codel_enqueue() later, drop them right away.
+	 */
+	room = sch->limit - min(READ_ONCE(sch->q.qlen), sch->limit);
+	mem_room = q->memory_limit -
+		   min(READ_ONCE(q->memory_usage), q->memory_limit);
+	if (likely(qdisc_stage_add(&q->stage, skb, room, mem_room)))
+		return qdisc_stage_xmit_ret(&q->stage);
+
+	qdisc_qstats_cpu_qlen_dec(sch);
+	qdisc_qstats_cpu_backlog_dec(sch, skb);
+	return qdisc_drop_cpu(skb, sch, to_free);
+}
+
+/* Move the packets staged by TCQ_F_NOLOCK enqueue to their flows */
+static void fq_codel_drain(struct Qdisc *sch, struct sk_buff **to_free)
+{
+	struct fq_codel_sched_data *q = qdisc_priv(sch);
+	struct llist_node *node = qdisc_stage_drain(&q->stage);
+	struct sk_buff *skb, *tmp;
+	unsigned long memory = 0;
+	unsigned int qlen = 0;
+
+	llist_for_each_entry_safe(skb, tmp, node, ll_node) {
+		qlen++;
+		memory += skb->truesize;
+		if (__fq_codel_enqueue(skb, sch, to_free) != NET_XMIT_SUCCESS)
+			WRITE_ONCE(q->stage.congested, true);
+	}
+	qdisc_stage_release(&q->stage, qlen, memory);
+}
+
 /* This is the specific function called from codel_dequeue()
  * to dequeue a packet from queue. Note: backlog is handled in
  * codel, we dont need to reduce it here.
@@ -280,11 +355,13 @@ static void drop_func(struct sk_buff *skb, void *ctx)
 {
 	struct Qdisc *sch = ctx;
 
+	qdisc_qstats_cpu_qlen_dec(sch);
+	qdisc_qstats_cpu_backlog_dec(sch, skb);
+	qdisc_qstats_cpu_drop(sch);
 	kfree_skb(skb);
-	qdisc_qstats_drop(sch);
 }
 
-static struct sk_buff *fq_codel_dequeue(struct Qdisc *sch)
+static struct sk_buff *__fq_codel_dequeue(struct Qdisc *sch)
 {
 	struct fq_codel_sched_data *q = qdisc_priv(sch);
 	struct sk_buff *skb;
@@ -325,7 +402,9 @@ static struct sk_buff *fq_codel_dequeue(struct Qdisc *sch)
 			list_del_init(&flow->flowchain);
 		goto begin;
 	}
-	qdisc_bstats_update(sch, skb);
+	qdisc_bstats_cpu_update(sch, skb);
+	qdisc_qstats_cpu_qlen_dec(sch);
+	qdisc_qstats_cpu_backlog_dec(sch, skb);
 	flow->deficit -= qdisc_pkt_len(skb);
 	/* We cant call qdisc_tree_reduce_backlog() if our qlen is 0,
 	 * or HTB crashes. Defer it for next round.
@@ -339,6 +418,28 @@ static struct sk_buff *fq_codel_dequeue(struct Qdisc *sch)
 	return skb;
 }
 
+static struct sk_buff *fq_codel_dequeue(struct Qdisc *sch)
+{
+	struct fq_codel_sched_data *q = qdisc_priv(sch);
+	struct sk_buff *to_free = NULL;
+	struct sk_buff *skb;
+
+	if (!(sch->flags & TCQ_F_NOLOCK))
+		return __fq_codel_dequeue(sch);
+
+	/* The running bit keeps other dequeuers away, the qdisc lock
+	 * protects the flows against change(), reset() and dumps.
+	 */
+	spin_lock(qdisc_lock(sch));
+	fq_codel_drain(sch, &to_free);
+	skb = __fq_codel_dequeue(sch);
+	spin_unlock(qdisc_lock(sch));
+
+	if (unlikely(to_free))
+		kfree_skb_list(to_free);
+	return skb;
+}
+
 static void fq_codel_flow_purge(struct fq_codel_flow *flow)
 {
 	rtnl_kfree_skbs(flow->head, flow->tail);
@@ -350,6 +451,8 @@ static void fq_codel_reset(struct Qdisc *sch)
 	struct fq_codel_sched_data *q = qdisc_priv(sch);
 	int i;
 
+	qdisc_stage_purge(&q->stage);
+
 	INIT_LIST_HEAD(&q->new_flows);
 	INIT_LIST_HEAD(&q->old_flows);
 	for (i = 0; i < q->flows_cnt; i++) {
@@ -363,6 +466,13 @@ static void fq_codel_reset(struct Qdisc *sch)
 	sch->q.qlen = 0;
 	sch->qstats.backlog = 0;
 	q->memory_usage = 0;
+
+	for_each_possible_cpu(i) {
+		struct gnet_stats_queue *qs = per_cpu_ptr(sch->cpu_qstats, i);
+
+		qs->backlog = 0;
+		qs->qlen = 0;
+	}
 }
 
 static const struct nla_policy fq_codel_policy[TCA_FQ_CODEL_MAX + 1] = {
@@ -436,7 +546,7 @@ static int fq_codel_change(struct Qdisc *sch, struct nlattr *opt,
 
 	while (sch->q.qlen > sch->limit ||
 	       q->memory_usage > q->memory_limit) {
-		struct sk_buff *skb = fq_codel_dequeue(sch);
+		struct sk_buff *skb = __fq_codel_dequeue(sch);
 
 		q->cstats.drop_len += qdisc_pkt_len(skb);
 		rtnl_kfree_skbs(skb, skb);
@@ -455,6 +565,7 @@ static void fq_codel_destroy(struct Qdisc *sch)
 	struct fq_codel_sched_data *q = qdisc_priv(sch);
 
 	tcf_block_put(q->block);
+	qdisc_stage_destroy(sch, &q->stage);
 	kvfree(q->backlogs);
 	kvfree(q->flows);
 }
@@ -488,6 +599,10 @@ static int fq_codel_init(struct Qdisc *sch, struct nlattr *opt,
 	if (err)
 		goto init_failure;
 
+	err = qdisc_stage_init(sch, &q->stage);
+	if (err)
+		goto init_failure;
+
 	if (!q->flows) {
 		q->flows = kvcalloc(q->flows_cnt,
 				    sizeof(struct fq_codel_flow),
@@ -569,7 +684,8 @@ static int fq_codel_dump_stats(struct Qdisc *sch, struct gnet_dump *d)
 	struct list_head *pos;
 
 	st.qdisc_stats.maxpacket = q->cstats.maxpacket;
-	st.qdisc_stats.drop_overlimit = q->drop_overlimit;
+	st.qdisc_stats.drop_overlimit = q->drop_overlimit +
+					atomic_read(&q->stage.overlimits);
 	st.qdisc_stats.ecn_mark = q->cstats.ecn_mark;
 	st.qdisc_stats.new_flow_count = q->new_flow_count;
 	st.qdisc_stats.ce_mark = q->cstats.ce_mark;
@@ -710,6 +826,7 @@ static struct Qdisc_ops fq_codel_qdisc_ops __read_mostly = {
 	.cl_ops		=	&fq_codel_class_ops,
 	.id		=	"fq_codel",
 	.priv_size	=	sizeof(struct fq_codel_sched_data),
+	.static_flags	=	TCQ_F_NOLOCK | TCQ_F_CPUSTATS,
 	.enqueue	=	fq_codel_enqueue,
 	.dequeue	=	fq_codel_dequeue,
 	.peek		=	qdisc_peek_dequeued,
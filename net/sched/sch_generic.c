@@ -943,6 +943,93 @@ void qdisc_reset(struct Qdisc *qdisc)
 }
 EXPORT_SYMBOL(qdisc_reset);
 
+int qdisc_stage_init(struct Qdisc *sch, struct qdisc_stage *stage)
+{
+	int cpu;
+
+	stage->lists = alloc_percpu(struct llist_head);
+	if (!stage->lists)
+		return -ENOMEM;
+
+	if (!zalloc_cpumask_var(&stage->pending, GFP_KERNEL)) {
+		free_percpu(stage->lists);
+		stage->lists = NULL;
+		return -ENOMEM;
+	}
+
+	for_each_possible_cpu(cpu)
+		init_llist_head(per_cpu_ptr(stage->lists, cpu));
+
+	atomic_set(&stage->qlen, 0);
+	atomic_long_set(&stage->memory, 0);
+	atomic_set(&stage->overlimits, 0);
+	stage->congested = false;
+	sch->stage = stage;
+
+	return 0;
+}
+EXPORT_SYMBOL(qdisc_stage_init);
+
+/* Detach the packets staged on all CPUs and return them as one list,
+ * in arrival order for each CPU.  Callers must own the qdisc running bit
+ * or otherwise exclude the dequeuer, and give the room back with
+ * qdisc_stage_release() once the packets are queued or dropped.
+ */
+struct llist_node *qdisc_stage_drain(struct qdisc_stage *stage)
+{
+	struct llist_node *head = NULL, **tail = &head, *node;
+	int cpu;
+
+	for_each_cpu(cpu, stage->pending) {
+		/* Clear the bit first: a CPU staging into an empty list
+		 * after llist_del_all() sets it again.
+		 */
+		if (!cpumask_test_and_clear_cpu(cpu, stage->pending))
+			continue;
+
+		node = llist_del_all(per_cpu_ptr(stage->lists, cpu));
+		*tail = llist_reverse_order(node);
+		while (*tail)
+			tail = &(*tail)->next;
+	}
+
+	return head;
+}
+EXPORT_SYMBOL(qdisc_stage_drain);
+
+void qdisc_stage_purge(struct qdisc_stage *stage)
+{
+	struct llist_node *node;
+	struct sk_buff *skb, *tmp;
+	unsigned long memory = 0;
+	unsigned int qlen = 0;
+
+	if (!stage->lists)
+		return;
+
+	node = qdisc_stage_drain(stage);
+	llist_for_each_entry_safe(skb, tmp, node, ll_node) {
+		qlen++;
+		memory += skb->truesize;
+		kfree_skb(skb);
+	}
+	qdisc_stage_release(stage, qlen, memory);
+}
+EXPORT_SYMBOL(qdisc_stage_purge);
+
+void qdisc_stage_destroy(struct Qdisc *sch, struct qdisc_stage *stage)
+{
+	if (!stage->lists)
+		return;
+
+	sch->stage = NULL;
+	qdisc_stage_purge(stage);
+	free_cpumask_var(stage->pending);
+	free_percpu(stage->lists);
+	stage->lists = NULL;
+}
+EXPORT_SYMBOL(qdisc_stage_destroy);
+
 void qdisc_free(struct Qdisc *qdisc)
 {
 	if (qdisc_is_percpu_stats(qdisc)) {
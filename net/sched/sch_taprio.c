@@ -19,9 +19,13 @@
 #include <net/pkt_sched.h>
 #include <net/pkt_cls.h>
 #include <net/sch_generic.h>
+#include <net/sock.h>
 
 #define TAPRIO_ALL_GATES_OPEN -1
 
+#define TXTIME_ASSIST_IS_ENABLED(flags) \
+	((flags) & TCA_TAPRIO_ATTR_FLAG_TXTIME_ASSIST)
+
 struct sched_entry {
 	struct list_head list;
 
@@ -37,11 +41,39 @@ struct sched_entry {
 	u8 command;
 };
 
+/* Part of the cycle, relative to its start, during which the gate of a
+ * traffic class is open.  Consecutive entries that leave the gate open
+ * are merged into a single window.
+ */
+struct taprio_gate_window {
+	u64 start;
+	u64 end;
+};
+
+/* Per traffic class view of the schedule used in txtime-assist mode, so
+ * that finding a launch time is a search in a sorted array instead of a
+ * walk of the entry list.  Rebuilt on every schedule change.
+ */
+struct taprio_gate_table {
+	struct rcu_head rcu;
+	s64 base_time;
+	u64 cycle_time;
+	/* end of the last launch time given to each traffic class, written
+	 * under the root qdisc lock from taprio_enqueue()
+	 */
+	ktime_t next_txtime[TC_MAX_QUEUE];
+	/* windows of class tc are windows[first[tc]] .. windows[first[tc + 1] - 1] */
+	u32 first[TC_MAX_QUEUE + 1];
+	struct taprio_gate_window windows[];
+};
+
 struct taprio_sched {
 	struct Qdisc **qdiscs;
 	struct Qdisc *root;
 	s64 base_time;
 	int clockid;
+	u32 flags;
+	u32 txtime_delay;
 	int picos_per_byte; /* Using picoseconds because for 10Gbps+
 			     * speeds it's sub-nanoseconds per byte
 			     */
@@ -53,8 +85,106 @@ struct taprio_sched {
 	struct list_head entries;
 	ktime_t (*get_time)(void);
 	struct hrtimer advance_timer;
+	struct taprio_gate_table __rcu *gate_table;
 };
 
+static inline int length_to_duration(struct taprio_sched *q, int len)
+{
+	return (len * q->picos_per_byte) / 1000;
+}
+
+/* Returns the earliest time, not before @earliest, at which a packet of
+ * @len bytes of traffic class @tc can be sent entirely while its gate is
+ * open, or 0 if the packet does not fit in any window of the class.
+ */
+static ktime_t taprio_find_txtime(struct taprio_sched *q,
+				  struct taprio_gate_table *table,
+				  u8 tc, int len, ktime_t earliest)
+{
+	const struct taprio_gate_window *first, *last, *lo, *hi, *w;
+	u64 duration = length_to_duration(q, len);
+	ktime_t cycle_start;
+	u64 pos, start;
+	int pass;
+
+	first = &table->windows[table->first[tc]];
+	last = &table->windows[table->first[tc + 1]];
+	if (first == last || !table->cycle_time)
+		return 0;
+
+	earliest = max(earliest, table->next_txtime[tc]);
+	if (ktime_before(earliest, table->base_time))
+		earliest = table->base_time;
+
+	div64_u64_rem(ktime_sub_ns(earliest, table->base_time),
+		      table->cycle_time, &pos);
+	cycle_start = ktime_sub_ns(earliest, pos);
+
+	/* If nothing fits in the rest of this cycle, the next cycle is
+	 * searched from its start; failing that, nothing ever fits.
+	 */
+	for (pass = 0; pass < 2; pass++) {
+		lo = first;
+		hi = last;
+		while (lo < hi) {
+			w = lo + (hi - lo) / 2;
+			if (w->end <= pos)
+				lo = w + 1;
+			else
+				hi = w;
+		}
+
+		for (w = lo; w < last; w++) {
+			start = max(pos, w->start);
+			if (start + duration > w->end)
+				continue;
+
+			table->next_txtime[tc] =
+				ktime_add_ns(cycle_start, start + duration);
+			return ktime_add_ns(cycle_start, start);
+		}
+
+		cycle_start = ktime_add_ns(cycle_start, table->cycle_time);
+		pos = 0;
+	}
+
+	return 0;
+}
+
+/* txtime-assist: set skb->tstamp to a launch time inside the gate
+ * schedule.  A launch time requested by the socket (SO_TXTIME) is used
+ * as a lower bound, it has to be on the schedule's clock: there is no
+ * cross-timestamping, packets of sockets using another clock are dropped.
+ */
+static bool taprio_set_txtime(struct Qdisc *sch, struct sk_buff *skb)
+{
+	struct taprio_sched *q = qdisc_priv(sch);
+	struct net_device *dev = qdisc_dev(sch);
+	struct taprio_gate_table *table;
+	struct sock *sk = skb->sk;
+	ktime_t earliest, txtime = 0;
+	u8 tc;
+
+	tc = netdev_get_prio_tc_map(dev, skb->priority);
+	earliest = ktime_add_ns(q->get_time(), q->txtime_delay);
+	if (sk && sk_fullsock(sk) && sock_flag(sk, SOCK_TXTIME)) {
+		if (sk->sk_clockid != q->clockid)
+			return false;
+		earliest = max(earliest, skb->tstamp);
+	}
+
+	rcu_read_lock();
+	table = rcu_dereference(q->gate_table);
+	if (likely(table))
+		txtime = taprio_find_txtime(q, table, tc, qdisc_pkt_len(skb),
+					    earliest);
+	rcu_read_unlock();
+
+	skb->tstamp = txtime;
+
+	return txtime != 0;
+}
+
 static int taprio_enqueue(struct sk_buff *skb, struct Qdisc *sch,
 			  struct sk_buff **to_free)
 {
@@ -68,6 +198,10 @@ static int taprio_enqueue(struct sk_buff *skb, struct Qdisc *sch,
 	if (unlikely(!child))
 		return qdisc_drop(skb, sch, to_free);
 
+	if (TXTIME_ASSIST_IS_ENABLED(q->flags) &&
+	    !taprio_set_txtime(sch, skb))
+		return qdisc_drop(skb, sch, to_free);
+
 	qdisc_qstats_backlog_inc(sch, skb);
 	sch->q.qlen++;
 
@@ -83,10 +217,15 @@ static struct sk_buff *taprio_peek(struct Qdisc *sch)
 	u32 gate_mask;
 	int i;
 
-	rcu_read_lock();
-	entry = rcu_dereference(q->current_entry);
-	gate_mask = entry ? entry->gate_mask : -1;
-	rcu_read_unlock();
+	/* with txtime-assist, the gates are enforced at launch time */
+	if (TXTIME_ASSIST_IS_ENABLED(q->flags)) {
+		gate_mask = TAPRIO_ALL_GATES_OPEN;
+	} else {
+		rcu_read_lock();
+		entry = rcu_dereference(q->current_entry);
+		gate_mask = entry ? entry->gate_mask : -1;
+		rcu_read_unlock();
+	}
 
 	if (!gate_mask)
 		return NULL;
@@ -115,11 +254,6 @@ static struct sk_buff *taprio_peek(struct Qdisc *sch)
 	return NULL;
 }
 
-static inline int length_to_duration(struct taprio_sched *q, int len)
-{
-	return (len * q->picos_per_byte) / 1000;
-}
-
 static struct sk_buff *taprio_dequeue(struct Qdisc *sch)
 {
 	struct taprio_sched *q = qdisc_priv(sch);
@@ -129,15 +263,21 @@ static struct sk_buff *taprio_dequeue(struct Qdisc *sch)
 	u32 gate_mask;
 	int i;
 
-	rcu_read_lock();
-	entry = rcu_dereference(q->current_entry);
-	/* if there's no entry, it means that the schedule didn't
-	 * start yet, so force all gates to be open, this is in
-	 * accordance to IEEE 802.1Qbv-2015 Section 8.6.9.4.5
-	 * "AdminGateSates"
-	 */
-	gate_mask = entry ? entry->gate_mask : TAPRIO_ALL_GATES_OPEN;
-	rcu_read_unlock();
+	/* with txtime-assist, the gates are enforced at launch time */
+	if (TXTIME_ASSIST_IS_ENABLED(q->flags)) {
+		entry = NULL;
+		gate_mask = TAPRIO_ALL_GATES_OPEN;
+	} else {
+		rcu_read_lock();
+		entry = rcu_dereference(q->current_entry);
+		/* if there's no entry, it means that the schedule didn't
+		 * start yet, so force all gates to be open, this is in
+		 * accordance to IEEE 802.1Qbv-2015 Section 8.6.9.4.5
+		 * "AdminGateSates"
+		 */
+		gate_mask = entry ? entry->gate_mask : TAPRIO_ALL_GATES_OPEN;
+		rcu_read_unlock();
+	}
 
 	if (!gate_mask)
 		return NULL;
@@ -267,6 +407,8 @@ static const struct nla_policy taprio_policy[TCA_TAPRIO_ATTR_MAX + 1] = {
 	[TCA_TAPRIO_ATTR_SCHED_BASE_TIME]      = { .type = NLA_S64 },
 	[TCA_TAPRIO_ATTR_SCHED_SINGLE_ENTRY]   = { .type = NLA_NESTED },
 	[TCA_TAPRIO_ATTR_SCHED_CLOCKID]        = { .type = NLA_S32 },
+	[TCA_TAPRIO_ATTR_FLAGS]                = { .type = NLA_U32 },
+	[TCA_TAPRIO_ATTR_TXTIME_DELAY]         = { .type = NLA_U32 },
 };
 
 static int fill_sched_entry(struct nlattr **tb, struct sched_entry *entry,
@@ -422,6 +564,7 @@ static int parse_taprio_opt(struct nlattr **tb, struct taprio_sched *q,
 {
 	int err = 0;
 	int clockid;
+	u32 flags;
 
 	if (tb[TCA_TAPRIO_ATTR_SCHED_ENTRY_LIST] &&
 	    tb[TCA_TAPRIO_ATTR_SCHED_SINGLE_ENTRY])
@@ -433,6 +576,32 @@ static int parse_taprio_opt(struct nlattr **tb, struct taprio_sched *q,
 	if (q->clockid == -1 && !tb[TCA_TAPRIO_ATTR_SCHED_CLOCKID])
 		return -EINVAL;
 
+	if (tb[TCA_TAPRIO_ATTR_FLAGS]) {
+		flags = nla_get_u32(tb[TCA_TAPRIO_ATTR_FLAGS]);
+
+		if (flags & ~TCA_TAPRIO_ATTR_FLAG_TXTIME_ASSIST) {
+			NL_SET_ERR_MSG(extack, "Unsupported flags");
+			return -EINVAL;
+		}
+
+		/* Like the clockid, the mode is fixed at the first init. */
+		if (q->clockid != -1 && flags != q->flags) {
+			NL_SET_ERR_MSG(extack, "Changing flags of a running schedule is not supported");
+			return -EOPNOTSUPP;
+		}
+
+		q->flags = flags;
+	}
+
+	if (tb[TCA_TAPRIO_ATTR_TXTIME_DELAY]) {
+		if (!TXTIME_ASSIST_IS_ENABLED(q->flags)) {
+			NL_SET_ERR_MSG(extack, "txtime-delay can only be set in txtime-assist mode");
+			return -EINVAL;
+		}
+
+		q->txtime_delay = nla_get_u32(tb[TCA_TAPRIO_ATTR_TXTIME_DELAY]);
+	}
+
 	if (tb[TCA_TAPRIO_ATTR_SCHED_BASE_TIME])
 		q->base_time = nla_get_s64(
 			tb[TCA_TAPRIO_ATTR_SCHED_BASE_TIME]);
@@ -523,6 +692,49 @@ static int taprio_parse_mqprio_opt(struct net_device *dev,
 	return 0;
 }
 
+static struct taprio_gate_table *taprio_build_gate_table(struct taprio_sched *q,
+							  int num_tc)
+{
+	struct taprio_gate_table *table;
+	struct sched_entry *entry;
+	u32 n = 0;
+	u64 offset;
+	int tc;
+
+	table = kzalloc(struct_size(table, windows, q->num_entries * num_tc),
+			GFP_KERNEL);
+	if (!table)
+		return NULL;
+
+	table->base_time = q->base_time;
+
+	for (tc = 0; tc < num_tc; tc++) {
+		table->first[tc] = n;
+		offset = 0;
+
+		list_for_each_entry(entry, &q->entries, list) {
+			if (entry->gate_mask & BIT(tc)) {
+				if (n > table->first[tc] &&
+				    table->windows[n - 1].end == offset) {
+					table->windows[n - 1].end += entry->interval;
+				} else {
+					table->windows[n].start = offset;
+					table->windows[n].end = offset +
+								entry->interval;
+					n++;
+				}
+			}
+
+			offset += entry->interval;
+		}
+	}
+
+	table->first[num_tc] = n;
+	table->cycle_time = offset;
+
+	return table;
+}
+
 static ktime_t taprio_get_start_time(struct Qdisc *sch)
 {
 	struct taprio_sched *q = qdisc_priv(sch);
@@ -581,6 +793,7 @@ static int taprio_change(struct Qdisc *sch, struct nlattr *opt,
 	struct nlattr *tb[TCA_TAPRIO_ATTR_MAX + 1] = { };
 	struct taprio_sched *q = qdisc_priv(sch);
 	struct net_device *dev = qdisc_dev(sch);
+	struct taprio_gate_table *table, *old;
 	struct tc_mqprio_qopt *mqprio = NULL;
 	struct ethtool_link_ksettings ecmd;
 	int i, err, size;
@@ -605,6 +818,19 @@ static int taprio_change(struct Qdisc *sch, struct nlattr *opt,
 	if (size < 0)
 		return size;
 
+	if (TXTIME_ASSIST_IS_ENABLED(q->flags)) {
+		table = taprio_build_gate_table(q, mqprio->num_tc);
+		if (!table) {
+			NL_SET_ERR_MSG(extack, "Not enough memory for gate table");
+			return -ENOMEM;
+		}
+
+		old = rtnl_dereference(q->gate_table);
+		rcu_assign_pointer(q->gate_table, table);
+		if (old)
+			kfree_rcu(old, rcu);
+	}
+
 	hrtimer_init(&q->advance_timer, q->clockid, HRTIMER_MODE_ABS);
 	q->advance_timer.function = advance_sched;
 
@@ -665,6 +891,12 @@ static int taprio_change(struct Qdisc *sch, struct nlattr *opt,
 	q->picos_per_byte = div64_s64(NSEC_PER_SEC * 1000LL * 8,
 				      link_speed * 1000 * 1000);
 
+	/* Launch times already follow the gate table, there are no gate
+	 * transitions for the hrtimer to drive.
+	 */
+	if (TXTIME_ASSIST_IS_ENABLED(q->flags))
+		return 0;
+
 	start = taprio_get_start_time(sch);
 	if (!start)
 		return 0;
@@ -697,6 +929,8 @@ static void taprio_destroy(struct Qdisc *sch)
 		list_del(&entry->list);
 		kfree(entry);
 	}
+
+	kfree(rtnl_dereference(q->gate_table));
 }
 
 static int taprio_init(struct Qdisc *sch, struct nlattr *opt,
@@ -837,6 +1071,13 @@ static int taprio_dump(struct Qdisc *sch, struct sk_buff *skb)
 	if (nla_put_s32(skb, TCA_TAPRIO_ATTR_SCHED_CLOCKID, q->clockid))
 		goto options_error;
 
+	if (q->flags && nla_put_u32(skb, TCA_TAPRIO_ATTR_FLAGS, q->flags))
+		goto options_error;
+
+	if (TXTIME_ASSIST_IS_ENABLED(q->flags) &&
+	    nla_put_u32(skb, TCA_TAPRIO_ATTR_TXTIME_DELAY, q->txtime_delay))
+		goto options_error;
+
 	entry_list = nla_nest_start(skb, TCA_TAPRIO_ATTR_SCHED_ENTRY_LIST);
 	if (!entry_list)
 		goto options_error;
@@ -1775,6 +1775,7 @@ int __sys_sendto(int fd, void __user *buff, size_t len, unsigned int flags,
 	msg.msg_control = NULL;
 	msg.msg_controllen = 0;
 	msg.msg_namelen = 0;
+	msg.msg_ubuf = NULL;
 	if (addr) {
 		err = move_addr_to_kernel(addr, addr_len, &address);
 		if (err < 0)
@@ -1786,6 +1787,7 @@ int __sys_sendto(int fd, void __user *buff, size_t len, unsigned int flags,
 		flags |= MSG_DONTWAIT;
 	msg.msg_flags = flags;
 	err = sock_sendmsg(sock, &msg);
+	sock_zerocopy_put(msg.msg_ubuf);
 
 out_put:
 	fput_light(sock->file, fput_needed);
@@ -2151,7 +2153,9 @@ long __sys_sendmsg(int fd, struct user_msghdr __user *msg, unsigned int flags,
 	if (!sock)
 		goto out;
 
+	msg_sys.msg_ubuf = NULL;
 	err = ___sys_sendmsg(sock, msg, &msg_sys, flags, NULL, 0);
+	sock_zerocopy_put(msg_sys.msg_ubuf);
 
 	fput_light(sock->file, fput_needed);
 out:
@@ -2196,6 +2200,11 @@ int __sys_sendmmsg(int fd, struct mmsghdr __user *mmsg, unsigned int vlen,
 	err = 0;
 	flags |= MSG_BATCH;
 
+	/* MSG_ZEROCOPY datagrams of one call share a notification, the
+	 * protocol keeps a reference to it in msg_sys.msg_ubuf.
+	 */
+	msg_sys.msg_ubuf = NULL;
+
 	while (datagrams < vlen) {
 		if (datagrams == vlen - 1)
 			flags = oflags;
@@ -2225,6 +2234,7 @@ int __sys_sendmmsg(int fd, struct mmsghdr __user *mmsg, unsigned int vlen,
 		cond_resched();
 	}
 
+	sock_zerocopy_put(msg_sys.msg_ubuf);
 	fput_light(sock->file, fput_needed);
 
 	/* We only return an error if no datagrams were able to be sent */
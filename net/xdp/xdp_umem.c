@@ -91,6 +91,16 @@ int xdp_umem_assign_dev(struct xdp_umem *umem, struct net_device *dev,
 	xdp_reg_umem_at_qid(dev, umem, queue_id);
 	umem->dev = dev;
 	umem->queue_id = queue_id;
+
+	if (flags & XDP_USE_NEED_WAKEUP) {
+		umem->flags |= XDP_UMEM_USES_NEED_WAKEUP;
+		/* Tx needs to be explicitly woken up the first time.
+		 * Also for supporting drivers that do not implement this
+		 * feature. They will always have to call sendto().
+		 */
+		xsk_set_tx_need_wakeup(umem);
+	}
+
 	if (force_copy)
 		/* For copy-mode, we are done. */
 		goto out_rtnl_unlock;
@@ -351,6 +361,7 @@ static int xdp_umem_reg(struct xdp_umem *umem, struct xdp_umem_reg *mr)
 	umem->user = NULL;
 	INIT_LIST_HEAD(&umem->xsk_list);
 	spin_lock_init(&umem->xsk_list_lock);
+	spin_lock_init(&umem->cq_lock);
 
 	refcount_set(&umem->users, 1);
 
@@ -24,12 +24,27 @@
 #include <linux/rculist.h>
 #include <net/xdp_sock.h>
 #include <net/xdp.h>
+#include <net/busy_poll.h>
 
 #include "xsk_queue.h"
 #include "xdp_umem.h"
 
 #define TX_BATCH_SIZE 16
 
+/* Layout of struct xdp_ring_offset before the flags field was added */
+struct xdp_ring_offset_v1 {
+	__u64 producer;
+	__u64 consumer;
+	__u64 desc;
+};
+
+struct xdp_mmap_offsets_v1 {
+	struct xdp_ring_offset_v1 rx;
+	struct xdp_ring_offset_v1 tx;
+	struct xdp_ring_offset_v1 fr;
+	struct xdp_ring_offset_v1 cr;
+};
+
 static struct xdp_sock *xdp_sk(struct sock *sk)
 {
 	return (struct xdp_sock *)sk;
@@ -53,20 +68,138 @@ void xsk_umem_discard_addr(struct xdp_umem *umem)
 }
 EXPORT_SYMBOL(xsk_umem_discard_addr);
 
-static int __xsk_rcv(struct xdp_sock *xs, struct xdp_buff *xdp, u32 len)
+void xsk_set_rx_need_wakeup(struct xdp_umem *umem)
 {
-	void *to_buf, *from_buf;
-	u32 metalen;
+	if (umem->need_wakeup & XDP_WAKEUP_RX)
+		return;
+
+	umem->fq->ring->flags |= XDP_RING_NEED_WAKEUP;
+	umem->need_wakeup |= XDP_WAKEUP_RX;
+}
+EXPORT_SYMBOL(xsk_set_rx_need_wakeup);
+
+void xsk_set_tx_need_wakeup(struct xdp_umem *umem)
+{
+	struct xdp_sock *xs;
+
+	if (umem->need_wakeup & XDP_WAKEUP_TX)
+		return;
+
+	rcu_read_lock();
+	list_for_each_entry_rcu(xs, &umem->xsk_list, list) {
+		if (xs->tx)
+			xs->tx->ring->flags |= XDP_RING_NEED_WAKEUP;
+	}
+	rcu_read_unlock();
+
+	umem->need_wakeup |= XDP_WAKEUP_TX;
+}
+EXPORT_SYMBOL(xsk_set_tx_need_wakeup);
+
+void xsk_clear_rx_need_wakeup(struct xdp_umem *umem)
+{
+	if (!(umem->need_wakeup & XDP_WAKEUP_RX))
+		return;
+
+	umem->fq->ring->flags &= ~XDP_RING_NEED_WAKEUP;
+	umem->need_wakeup &= ~XDP_WAKEUP_RX;
+}
+EXPORT_SYMBOL(xsk_clear_rx_need_wakeup);
+
+void xsk_clear_tx_need_wakeup(struct xdp_umem *umem)
+{
+	struct xdp_sock *xs;
+
+	if (!(umem->need_wakeup & XDP_WAKEUP_TX))
+		return;
+
+	rcu_read_lock();
+	list_for_each_entry_rcu(xs, &umem->xsk_list, list) {
+		if (xs->tx)
+			xs->tx->ring->flags &= ~XDP_RING_NEED_WAKEUP;
+	}
+	rcu_read_unlock();
+
+	umem->need_wakeup &= ~XDP_WAKEUP_TX;
+}
+EXPORT_SYMBOL(xsk_clear_tx_need_wakeup);
+
+/* Copy a frame that does not fit into a single umem chunk into a chain
+ * of fill queue buffers. All but the last descriptor carry XDP_PKT_CONTD.
+ */
+static int xsk_copy_rcv_sg(struct xdp_sock *xs, void *from_buf, u32 len,
+			   u32 metalen)
+{
+	struct xdp_umem *umem = xs->umem;
+	u32 frame_size = umem->chunk_size_nohr - XDP_PACKET_HEADROOM;
+	u32 nb_frags = DIV_ROUND_UP(len + metalen, frame_size);
+	u32 copied = 0, produced = 0;
+	u32 fq_pos;
 	u64 addr;
-	int err;
 
-	if (!xskq_peek_addr(xs->umem->fq, &addr) ||
-	    len > xs->umem->chunk_size_nohr - XDP_PACKET_HEADROOM) {
-		xs->rx_dropped++;
+	if (!xskq_has_free_descs(xs->rx, nb_frags) ||
+	    !xskq_peek_addrs(umem->fq, nb_frags, &fq_pos))
 		return -ENOSPC;
+
+	while (copied < len) {
+		u32 meta = produced ? 0 : metalen;
+		u32 copy = min_t(u32, len - copied, frame_size - meta);
+		u32 options = (copied + copy < len) ? XDP_PKT_CONTD : 0;
+		void *src = from_buf + (produced ? metalen : 0) + copied;
+
+		/* Only a fill queue entry rewritten since xskq_peek_addrs()
+		 * gets here. Hand the buffers taken so far back to the fill
+		 * queue and drop the partially copied frame.
+		 */
+		if (!xskq_peek_addr(umem->fq, &addr)) {
+			xskq_rewind_addrs(umem->fq, fq_pos);
+			xskq_cancel_batch_desc(xs->rx, produced);
+			return -ENOSPC;
+		}
+		xskq_discard_addr(umem->fq);
+
+		addr += umem->headroom;
+		memcpy(xdp_umem_get_data(umem, addr), src, meta + copy);
+		xskq_produce_batch_desc(xs->rx, addr + meta, copy, options);
+
+		copied += copy;
+		produced++;
 	}
 
-	addr += xs->umem->headroom;
+	return 0;
+}
+
+static int xsk_copy_rcv(struct xdp_sock *xs, void *from_buf, u32 len,
+			u32 metalen)
+{
+	struct xdp_umem *umem = xs->umem;
+	u64 addr;
+	int err;
+
+	if (len > umem->chunk_size_nohr - XDP_PACKET_HEADROOM) {
+		if (!xs->sg)
+			return -ENOSPC;
+		return xsk_copy_rcv_sg(xs, from_buf, len, metalen);
+	}
+
+	if (!xskq_peek_addr(umem->fq, &addr))
+		return -ENOSPC;
+
+	addr += umem->headroom;
+	memcpy(xdp_umem_get_data(umem, addr), from_buf, len + metalen);
+	err = xskq_produce_batch_desc(xs->rx, addr + metalen, len, 0);
+	if (err)
+		return err;
+
+	xskq_discard_addr(umem->fq);
+	return 0;
+}
+
+static int __xsk_rcv(struct xdp_sock *xs, struct xdp_buff *xdp, u32 len)
+{
+	void *from_buf;
+	u32 metalen;
+	int err;
 
 	if (unlikely(xdp_data_meta_unsupported(xdp))) {
 		from_buf = xdp->data;
@@ -76,12 +209,8 @@ static int __xsk_rcv(struct xdp_sock *xs, struct xdp_buff *xdp, u32 len)
 		metalen = xdp->data - xdp->data_meta;
 	}
 
-	to_buf = xdp_umem_get_data(xs->umem, addr);
-	memcpy(to_buf, from_buf, len + metalen);
-	addr += metalen;
-	err = xskq_produce_batch_desc(xs->rx, addr, len);
+	err = xsk_copy_rcv(xs, from_buf, len, metalen);
 	if (!err) {
-		xskq_discard_addr(xs->umem->fq);
 		xdp_return_buff(xdp);
 		return 0;
 	}
@@ -92,7 +221,7 @@ static int __xsk_rcv(struct xdp_sock *xs, struct xdp_buff *xdp, u32 len)
 
 static int __xsk_rcv_zc(struct xdp_sock *xs, struct xdp_buff *xdp, u32 len)
 {
-	int err = xskq_produce_batch_desc(xs->rx, (u64)xdp->handle, len);
+	int err = xskq_produce_batch_desc(xs->rx, (u64)xdp->handle, len, 0);
 
 	if (err)
 		xs->rx_dropped++;
@@ -108,6 +237,7 @@ int xsk_rcv(struct xdp_sock *xs, struct xdp_buff *xdp)
 		return -EINVAL;
 
 	len = xdp->data_end - xdp->data;
+	__sk_mark_napi_id_once(&xs->sk, xdp->rxq->napi_id);
 
 	return (xdp->rxq->mem.type == MEM_TYPE_ZERO_COPY) ?
 		__xsk_rcv_zc(xs, xdp, len) : __xsk_rcv(xs, xdp, len);
@@ -123,27 +253,13 @@ int xsk_generic_rcv(struct xdp_sock *xs, struct xdp_buff *xdp)
 {
 	u32 metalen = xdp->data - xdp->data_meta;
 	u32 len = xdp->data_end - xdp->data;
-	void *buffer;
-	u64 addr;
 	int err;
 
 	if (xs->dev != xdp->rxq->dev || xs->queue_id != xdp->rxq->queue_index)
 		return -EINVAL;
 
-	if (!xskq_peek_addr(xs->umem->fq, &addr) ||
-	    len > xs->umem->chunk_size_nohr - XDP_PACKET_HEADROOM) {
-		xs->rx_dropped++;
-		return -ENOSPC;
-	}
-
-	addr += xs->umem->headroom;
-
-	buffer = xdp_umem_get_data(xs->umem, addr);
-	memcpy(buffer, xdp->data_meta, len + metalen);
-	addr += metalen;
-	err = xskq_produce_batch_desc(xs->rx, addr, len);
+	err = xsk_copy_rcv(xs, xdp->data_meta, len, metalen);
 	if (!err) {
-		xskq_discard_addr(xs->umem->fq);
 		xsk_flush(xs);
 		return 0;
 	}
@@ -205,21 +321,159 @@ static int xsk_zc_xmit(struct sock *sk)
 	return dev->netdev_ops->ndo_xsk_async_xmit(dev, xs->queue_id);
 }
 
+/* Umem buffers a multi-buffer packet was built from */
+struct xsk_tx_addrs {
+	u32 num;
+	u64 addrs[MAX_SKB_FRAGS + 1];
+};
+
+static int xsk_tx_reserve(struct xdp_umem *umem)
+{
+	unsigned long flags;
+	int err;
+
+	spin_lock_irqsave(&umem->cq_lock, flags);
+	err = xskq_reserve_addr(umem->cq);
+	spin_unlock_irqrestore(&umem->cq_lock, flags);
+
+	return err;
+}
+
+static void xsk_tx_cancel(struct xdp_umem *umem)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&umem->cq_lock, flags);
+	xskq_cancel_addr(umem->cq);
+	spin_unlock_irqrestore(&umem->cq_lock, flags);
+}
+
+/* Writing the address and publishing it under the umem lock keeps
+ * sockets sharing the umem from exposing each other's slots.
+ */
+static void xsk_tx_complete(struct xdp_umem *umem, u64 addr)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&umem->cq_lock, flags);
+	xskq_submit_addr(umem->cq, addr);
+	spin_unlock_irqrestore(&umem->cq_lock, flags);
+}
+
+/* Buffers are handed back once the driver is done with the skb, so a
+ * completion still means the frame was sent or dropped by the device.
+ */
 static void xsk_destruct_skb(struct sk_buff *skb)
 {
-	u64 addr = (u64)(long)skb_shinfo(skb)->destructor_arg;
+	void *arg = skb_shinfo(skb)->destructor_arg;
 	struct xdp_sock *xs = xdp_sk(skb->sk);
+	struct xdp_umem *umem = xs->umem;
 	unsigned long flags;
+	u32 i;
 
-	spin_lock_irqsave(&xs->tx_completion_lock, flags);
-	WARN_ON_ONCE(xskq_produce_addr(xs->umem->cq, addr));
-	spin_unlock_irqrestore(&xs->tx_completion_lock, flags);
+	spin_lock_irqsave(&umem->cq_lock, flags);
+	if (xs->sg) {
+		struct xsk_tx_addrs *ta = arg;
+
+		for (i = 0; i < ta->num; i++)
+			xskq_submit_addr(umem->cq, ta->addrs[i]);
+	} else {
+		xskq_submit_addr(umem->cq, (u64)(long)arg);
+	}
+	spin_unlock_irqrestore(&umem->cq_lock, flags);
 
+	if (xs->sg)
+		kfree(arg);
 	sock_wfree(skb);
 }
 
-static int xsk_generic_xmit(struct sock *sk, struct msghdr *m,
-			    size_t total_len)
+static struct sk_buff *xsk_build_skb(struct xdp_sock *xs,
+				     struct xdp_desc *desc)
+{
+	char *buffer = xdp_umem_get_data(xs->umem, desc->addr);
+	struct sk_buff *skb = xs->skb;
+	struct sock *sk = &xs->sk;
+	struct xsk_tx_addrs *ta;
+	struct page *page;
+	int err, nr_frags;
+
+	if (!skb) {
+		skb = sock_alloc_send_skb(sk, desc->len, 1, &err);
+		if (unlikely(!skb))
+			return ERR_PTR(-EAGAIN);
+
+		skb_put(skb, desc->len);
+		err = skb_store_bits(skb, 0, buffer, desc->len);
+		if (unlikely(err)) {
+			kfree_skb(skb);
+			return ERR_PTR(err);
+		}
+
+		/* The skb may be linearized on its way to the driver, so
+		 * an XDP_USE_SG socket always keeps its addresses aside.
+		 */
+		if (xs->sg) {
+			ta = kmalloc(sizeof(*ta), sk->sk_allocation);
+			if (unlikely(!ta)) {
+				kfree_skb(skb);
+				return ERR_PTR(-EAGAIN);
+			}
+			ta->num = 1;
+			ta->addrs[0] = desc->addr;
+			skb_shinfo(skb)->destructor_arg = ta;
+		} else {
+			skb_shinfo(skb)->destructor_arg = (void *)(long)desc->addr;
+		}
+
+		skb->dev = xs->dev;
+		skb->priority = sk->sk_priority;
+		skb->mark = sk->sk_mark;
+		skb->destructor = xsk_destruct_skb;
+		return skb;
+	}
+
+	/* Continuation buffer of a multi-buffer packet */
+	nr_frags = skb_shinfo(skb)->nr_frags;
+	if (unlikely(nr_frags == MAX_SKB_FRAGS))
+		return ERR_PTR(-EMSGSIZE);
+
+	page = alloc_page(sk->sk_allocation);
+	if (unlikely(!page))
+		return ERR_PTR(-EAGAIN);
+
+	memcpy(page_address(page), buffer, desc->len);
+	skb_add_rx_frag(skb, nr_frags, page, 0, desc->len, PAGE_SIZE);
+	refcount_add(PAGE_SIZE, &sk->sk_wmem_alloc);
+
+	ta = skb_shinfo(skb)->destructor_arg;
+	ta->addrs[ta->num++] = desc->addr;
+	return skb;
+}
+
+static int xsk_xmit_skb(struct xdp_sock *xs, struct sk_buff *skb)
+{
+	int err;
+
+	err = __dev_direct_xmit(skb, xs->queue_id);
+	if (err == NETDEV_TX_BUSY) {
+		/* Keep the packet and its completion slots for a retry */
+		xs->skb = skb;
+		xs->tx_busy = true;
+		return -EAGAIN;
+	}
+
+	xs->skb = NULL;
+	xs->tx_busy = false;
+	/* Ignore NET_XMIT_CN as packet might have been sent */
+	if (err == NET_XMIT_DROP) {
+		/* SKB completed but not sent */
+		return -EBUSY;
+	}
+
+	return 0;
+}
+
+static int xsk_generic_xmit(struct sock *sk)
 {
 	u32 max_batch = TX_BATCH_SIZE;
 	struct xdp_sock *xs = xdp_sk(sk);
@@ -230,53 +484,71 @@ static int xsk_generic_xmit(struct sock *sk, struct msghdr *m,
 
 	mutex_lock(&xs->mutex);
 
+	/* A packet the driver had no room for goes out first */
+	if (unlikely(xs->tx_busy)) {
+		if (xs->queue_id >= xs->dev->real_num_tx_queues)
+			goto out;
+
+		err = xsk_xmit_skb(xs, xs->skb);
+		if (err)
+			goto out;
+
+		sent_frame = true;
+	}
+
 	while (xskq_peek_desc(xs->tx, &desc)) {
-		char *buffer;
-		u64 addr;
-		u32 len;
+		bool contd = xs->sg && (desc.options & XDP_PKT_CONTD);
 
 		if (max_batch-- == 0) {
 			err = -EAGAIN;
 			goto out;
 		}
 
-		if (xskq_reserve_addr(xs->umem->cq))
+		if (xsk_tx_reserve(xs->umem))
 			goto out;
 
-		if (xs->queue_id >= xs->dev->real_num_tx_queues)
-			goto out;
-
-		len = desc.len;
-		skb = sock_alloc_send_skb(sk, len, 1, &err);
-		if (unlikely(!skb)) {
-			err = -EAGAIN;
-			goto out;
+		/* Rest of a chain that was too long for one skb */
+		if (unlikely(xs->tx_drop_chain)) {
+			xskq_discard_desc(xs->tx);
+			xsk_tx_complete(xs->umem, desc.addr);
+			xs->tx_drop_chain = contd;
+			continue;
 		}
 
-		skb_put(skb, len);
-		addr = desc.addr;
-		buffer = xdp_umem_get_data(xs->umem, addr);
-		err = skb_store_bits(skb, 0, buffer, len);
-		if (unlikely(err)) {
-			kfree_skb(skb);
+		if (xs->queue_id >= xs->dev->real_num_tx_queues) {
+			xsk_tx_cancel(xs->umem);
 			goto out;
 		}
 
-		skb->dev = xs->dev;
-		skb->priority = sk->sk_priority;
-		skb->mark = sk->sk_mark;
-		skb_shinfo(skb)->destructor_arg = (void *)(long)addr;
-		skb->destructor = xsk_destruct_skb;
+		skb = xsk_build_skb(xs, &desc);
+		if (IS_ERR(skb)) {
+			err = PTR_ERR(skb);
+			if (err != -EMSGSIZE) {
+				xsk_tx_cancel(xs->umem);
+				goto out;
+			}
+
+			/* Drop the whole packet and hand its buffers back */
+			xskq_discard_desc(xs->tx);
+			xsk_tx_complete(xs->umem, desc.addr);
+			kfree_skb(xs->skb);
+			xs->skb = NULL;
+			xs->tx_drop_chain = contd;
+			err = 0;
+			continue;
+		}
 
-		err = dev_direct_xmit(skb, xs->queue_id);
 		xskq_discard_desc(xs->tx);
-		/* Ignore NET_XMIT_CN as packet might have been sent */
-		if (err == NET_XMIT_DROP || err == NETDEV_TX_BUSY) {
-			/* SKB completed but not sent */
-			err = -EBUSY;
-			goto out;
+
+		if (contd) {
+			xs->skb = skb;
+			continue;
 		}
 
+		err = xsk_xmit_skb(xs, skb);
+		if (err)
+			goto out;
+
 		sent_frame = true;
 	}
 
@@ -303,7 +575,43 @@ static int xsk_sendmsg(struct socket *sock, struct msghdr *m, size_t total_len)
 	if (need_wait)
 		return -EOPNOTSUPP;
 
-	return (xs->zc) ? xsk_zc_xmit(sk) : xsk_generic_xmit(sk, m, total_len);
+	if (sk_can_busy_loop(sk))
+		sk_busy_loop(sk, 1);
+
+	/* A driver that has not asked for a Tx wakeup is already
+	 * processing the ring from its NAPI context.
+	 */
+	if (xs->zc && xsk_umem_uses_need_wakeup(xs->umem) &&
+	    !(xs->umem->need_wakeup & XDP_WAKEUP_TX))
+		return 0;
+
+	return (xs->zc) ? xsk_zc_xmit(sk) : xsk_generic_xmit(sk);
+}
+
+static int xsk_recvmsg(struct socket *sock, struct msghdr *m, size_t len,
+		       int flags)
+{
+	bool need_wait = !(flags & MSG_DONTWAIT);
+	struct sock *sk = sock->sk;
+	struct xdp_sock *xs = xdp_sk(sk);
+
+	if (unlikely(!xs->dev))
+		return -ENXIO;
+	if (unlikely(!(xs->dev->flags & IFF_UP)))
+		return -ENETDOWN;
+	if (unlikely(!xs->rx))
+		return -ENOBUFS;
+	if (need_wait)
+		return -EOPNOTSUPP;
+
+	if (sk_can_busy_loop(sk))
+		sk_busy_loop(sk, 1);
+
+	if (xs->zc && xsk_umem_uses_need_wakeup(xs->umem) &&
+	    (xs->umem->need_wakeup & XDP_WAKEUP_RX))
+		return xsk_zc_xmit(sk);
+
+	return 0;
 }
 
 static unsigned int xsk_poll(struct file *file, struct socket *sock,
@@ -312,6 +620,19 @@ static unsigned int xsk_poll(struct file *file, struct socket *sock,
 	unsigned int mask = datagram_poll(file, sock, wait);
 	struct sock *sk = sock->sk;
 	struct xdp_sock *xs = xdp_sk(sk);
+	struct net_device *dev = READ_ONCE(xs->dev);
+	struct xdp_umem *umem = READ_ONCE(xs->umem);
+
+	/* With need_wakeup in use, poll() is what wakes the driver up */
+	if (dev && umem && xsk_umem_uses_need_wakeup(umem)) {
+		if (xs->zc) {
+			if (umem->need_wakeup)
+				xsk_zc_xmit(sk);
+		} else if (xs->tx) {
+			/* Poll needs to drive Tx also in copy mode */
+			xsk_generic_xmit(sk);
+		}
+	}
 
 	if (xs->rx && !xskq_empty_desc(xs->rx))
 		mask |= POLLIN | POLLRDNORM;
@@ -364,6 +685,12 @@ static int xsk_release(struct socket *sock)
 		dev_put(dev);
 	}
 
+	/* Completes the buffers of a packet that is partially built or
+	 * waiting to be retried.
+	 */
+	kfree_skb(xs->skb);
+	xs->skb = NULL;
+
 	xskq_destroy(xs->rx);
 	xskq_destroy(xs->tx);
 
@@ -407,6 +734,14 @@ static int xsk_bind(struct socket *sock, struct sockaddr *addr, int addr_len)
 	if (sxdp->sxdp_family != AF_XDP)
 		return -EINVAL;
 
+	flags = sxdp->sxdp_flags;
+	if (flags & ~(XDP_SHARED_UMEM | XDP_COPY | XDP_ZEROCOPY |
+		      XDP_USE_NEED_WAKEUP | XDP_USE_SG))
+		return -EINVAL;
+	/* Multi-buffer frames are only supported in copy mode */
+	if ((flags & XDP_USE_SG) && (flags & XDP_ZEROCOPY))
+		return -EOPNOTSUPP;
+
 	mutex_lock(&xs->mutex);
 	if (xs->dev) {
 		err = -EBUSY;
@@ -425,13 +760,13 @@ static int xsk_bind(struct socket *sock, struct sockaddr *addr, int addr_len)
 	}
 
 	qid = sxdp->sxdp_queue_id;
-	flags = sxdp->sxdp_flags;
 
 	if (flags & XDP_SHARED_UMEM) {
 		struct xdp_sock *umem_xs;
 		struct socket *sock;
 
-		if ((flags & XDP_COPY) || (flags & XDP_ZEROCOPY)) {
+		if ((flags & XDP_COPY) || (flags & XDP_ZEROCOPY) ||
+		    (flags & XDP_USE_NEED_WAKEUP)) {
 			/* Cannot specify flags for shared sockets. */
 			err = -EINVAL;
 			goto out_unlock;
@@ -459,6 +794,10 @@ static int xsk_bind(struct socket *sock, struct sockaddr *addr, int addr_len)
 			err = -EINVAL;
 			sockfd_put(sock);
 			goto out_unlock;
+		} else if ((flags & XDP_USE_SG) && umem_xs->umem->zc) {
+			err = -EOPNOTSUPP;
+			sockfd_put(sock);
+			goto out_unlock;
 		}
 
 		xdp_get_umem(umem_xs->umem);
@@ -474,6 +813,8 @@ static int xsk_bind(struct socket *sock, struct sockaddr *addr, int addr_len)
 		xskq_set_umem(xs->umem->cq, xs->umem->size,
 			      xs->umem->chunk_mask);
 
+		if (flags & XDP_USE_SG)
+			flags |= XDP_COPY;
 		err = xdp_umem_assign_dev(xs->umem, dev, qid, flags);
 		if (err)
 			goto out_unlock;
@@ -481,9 +822,13 @@ static int xsk_bind(struct socket *sock, struct sockaddr *addr, int addr_len)
 
 	xs->dev = dev;
 	xs->zc = xs->umem->zc;
+	xs->sg = !!(flags & XDP_USE_SG);
 	xs->queue_id = qid;
 	xskq_set_umem(xs->rx, xs->umem->size, xs->umem->chunk_mask);
 	xskq_set_umem(xs->tx, xs->umem->size, xs->umem->chunk_mask);
+	/* A socket joining a shared umem inherits a pending Tx wakeup */
+	if (xs->tx && (xs->umem->need_wakeup & XDP_WAKEUP_TX))
+		xs->tx->ring->flags |= XDP_RING_NEED_WAKEUP;
 	xdp_add_sk_umem(xs->umem, xs);
 
 out_unlock:
@@ -615,26 +960,53 @@ static int xsk_getsockopt(struct socket *sock, int level, int optname,
 	case XDP_MMAP_OFFSETS:
 	{
 		struct xdp_mmap_offsets off;
+		struct xdp_mmap_offsets_v1 off_v1;
+		void *to_copy;
 
-		if (len < sizeof(off))
+		if (len < sizeof(off_v1))
 			return -EINVAL;
 
 		off.rx.producer = offsetof(struct xdp_rxtx_ring, ptrs.producer);
 		off.rx.consumer = offsetof(struct xdp_rxtx_ring, ptrs.consumer);
 		off.rx.desc	= offsetof(struct xdp_rxtx_ring, desc);
+		off.rx.flags	= offsetof(struct xdp_rxtx_ring, ptrs.flags);
 		off.tx.producer = offsetof(struct xdp_rxtx_ring, ptrs.producer);
 		off.tx.consumer = offsetof(struct xdp_rxtx_ring, ptrs.consumer);
 		off.tx.desc	= offsetof(struct xdp_rxtx_ring, desc);
+		off.tx.flags	= offsetof(struct xdp_rxtx_ring, ptrs.flags);
 
 		off.fr.producer = offsetof(struct xdp_umem_ring, ptrs.producer);
 		off.fr.consumer = offsetof(struct xdp_umem_ring, ptrs.consumer);
 		off.fr.desc	= offsetof(struct xdp_umem_ring, desc);
+		off.fr.flags	= offsetof(struct xdp_umem_ring, ptrs.flags);
 		off.cr.producer = offsetof(struct xdp_umem_ring, ptrs.producer);
 		off.cr.consumer = offsetof(struct xdp_umem_ring, ptrs.consumer);
 		off.cr.desc	= offsetof(struct xdp_umem_ring, desc);
+		off.cr.flags	= offsetof(struct xdp_umem_ring, ptrs.flags);
+
+		if (len < sizeof(off)) {
+			/* Old user space without the flags offsets */
+			off_v1.rx.producer = off.rx.producer;
+			off_v1.rx.consumer = off.rx.consumer;
+			off_v1.rx.desc = off.rx.desc;
+			off_v1.tx.producer = off.tx.producer;
+			off_v1.tx.consumer = off.tx.consumer;
+			off_v1.tx.desc = off.tx.desc;
+			off_v1.fr.producer = off.fr.producer;
+			off_v1.fr.consumer = off.fr.consumer;
+			off_v1.fr.desc = off.fr.desc;
+			off_v1.cr.producer = off.cr.producer;
+			off_v1.cr.consumer = off.cr.consumer;
+			off_v1.cr.desc = off.cr.desc;
+
+			to_copy = &off_v1;
+			len = sizeof(off_v1);
+		} else {
+			to_copy = &off;
+			len = sizeof(off);
+		}
 
-		len = sizeof(off);
-		if (copy_to_user(optval, &off, len))
+		if (copy_to_user(optval, to_copy, len))
 			return -EFAULT;
 		if (put_user(len, optlen))
 			return -EFAULT;
@@ -708,7 +1080,7 @@ static const struct proto_ops xsk_proto_ops = {
 	.setsockopt	= xsk_setsockopt,
 	.getsockopt	= xsk_getsockopt,
 	.sendmsg	= xsk_sendmsg,
-	.recvmsg	= sock_no_recvmsg,
+	.recvmsg	= xsk_recvmsg,
 	.mmap		= xsk_mmap,
 	.sendpage	= sock_no_sendpage,
 };
@@ -758,7 +1130,6 @@ static int xsk_create(struct net *net, struct socket *sock, int protocol,
 
 	xs = xdp_sk(sk);
 	mutex_init(&xs->mutex);
-	spin_lock_init(&xs->tx_completion_lock);
 
 	local_bh_disable();
 	sock_prot_inuse_add(net, &xsk_proto, 1);
@@ -16,6 +16,7 @@
 struct xdp_ring {
 	u32 producer ____cacheline_aligned_in_smp;
 	u32 consumer ____cacheline_aligned_in_smp;
+	u32 flags;
 };
 
 /* Used for the RX and TX queues for packets */
@@ -121,20 +122,42 @@ static inline void xskq_discard_addr(struct xsk_queue *q)
 	q->cons_tail++;
 }
 
-static inline int xskq_produce_addr(struct xsk_queue *q, u64 addr)
+/* Pulls in as many entries as it takes to hold @cnt valid addresses, so
+ * that they can be consumed with xskq_peek_addr() and xskq_discard_addr()
+ * without releasing any of them to user space. A multi-buffer frame can
+ * then give them all back with xskq_rewind_addrs(q, *pos).
+ */
+static inline bool xskq_peek_addrs(struct xsk_queue *q, u32 cnt, u32 *pos)
 {
 	struct xdp_umem_ring *ring = (struct xdp_umem_ring *)q->ring;
+	u32 idx;
 
-	if (xskq_nb_free(q, q->prod_tail, 1) == 0)
-		return -ENOSPC;
+	WRITE_ONCE(q->ring->consumer, q->cons_tail);
+	if (q->prod_tail - q->cons_tail < cnt) {
+		/* Refresh the local pointer */
+		q->prod_tail = READ_ONCE(q->ring->producer);
+		if (q->prod_tail - q->cons_tail < cnt)
+			return false;
+	}
 
-	ring->desc[q->prod_tail++ & q->ring_mask] = addr;
+	/* Order consumer and data */
+	smp_rmb();
 
-	/* Order producer and data */
-	smp_wmb();
+	for (idx = q->cons_tail; cnt && idx != q->prod_tail; idx++) {
+		u64 addr = READ_ONCE(ring->desc[idx & q->ring_mask]);
 
-	WRITE_ONCE(q->ring->producer, q->prod_tail);
-	return 0;
+		if ((addr & q->chunk_mask) < q->size)
+			cnt--;
+	}
+
+	*pos = q->cons_tail;
+	q->cons_head = idx;
+	return !cnt;
+}
+
+static inline void xskq_rewind_addrs(struct xsk_queue *q, u32 pos)
+{
+	q->cons_tail = pos;
 }
 
 static inline int xskq_produce_addr_lazy(struct xsk_queue *q, u64 addr)
@@ -158,6 +181,11 @@ static inline void xskq_produce_flush_addr_n(struct xsk_queue *q,
 	WRITE_ONCE(q->ring->producer, q->prod_tail);
 }
 
+/* Only makes room for an address, xskq_submit_addr() then writes it in
+ * the next unpublished slot. Reservations and submissions may come from
+ * several sockets sharing the umem, so addresses are published in the
+ * order they are submitted, not reserved.
+ */
 static inline int xskq_reserve_addr(struct xsk_queue *q)
 {
 	if (xskq_nb_free(q, q->prod_head, 1) == 0)
@@ -167,6 +195,19 @@ static inline int xskq_reserve_addr(struct xsk_queue *q)
 	return 0;
 }
 
+static inline void xskq_cancel_addr(struct xsk_queue *q)
+{
+	q->prod_head--;
+}
+
+static inline void xskq_submit_addr(struct xsk_queue *q, u64 addr)
+{
+	struct xdp_umem_ring *ring = (struct xdp_umem_ring *)q->ring;
+
+	ring->desc[q->prod_tail & q->ring_mask] = addr;
+	xskq_produce_flush_addr_n(q, 1);
+}
+
 /* Rx/Tx queue */
 
 static inline bool xskq_is_valid_desc(struct xsk_queue *q, struct xdp_desc *d)
@@ -220,7 +261,7 @@ static inline void xskq_discard_desc(struct xsk_queue *q)
 }
 
 static inline int xskq_produce_batch_desc(struct xsk_queue *q,
-					  u64 addr, u32 len)
+					  u64 addr, u32 len, u32 options)
 {
 	struct xdp_rxtx_ring *ring = (struct xdp_rxtx_ring *)q->ring;
 	unsigned int idx;
@@ -231,10 +272,22 @@ static inline int xskq_produce_batch_desc(struct xsk_queue *q,
 	idx = (q->prod_head++) & q->ring_mask;
 	ring->desc[idx].addr = addr;
 	ring->desc[idx].len = len;
+	ring->desc[idx].options = options;
 
 	return 0;
 }
 
+static inline bool xskq_has_free_descs(struct xsk_queue *q, u32 cnt)
+{
+	return xskq_nb_free(q, q->prod_head, cnt) >= cnt;
+}
+
+/* Drop descriptors produced since the last flush */
+static inline void xskq_cancel_batch_desc(struct xsk_queue *q, u32 cnt)
+{
+	q->prod_head -= cnt;
+}
+
 static inline void xskq_produce_flush_desc(struct xsk_queue *q)
 {
 	/* Order producer and data */
@@ -76,6 +76,8 @@ static int opt_poll;
 static int opt_shared_packet_buffer;
 static int opt_interval = 1;
 static u32 opt_xdp_bind_flags;
+static int opt_need_wakeup = 1;
+static int opt_frags;
 
 struct xdp_umem_uqueue {
 	u32 cached_prod;
@@ -84,6 +86,7 @@ struct xdp_umem_uqueue {
 	u32 size;
 	u32 *producer;
 	u32 *consumer;
+	u32 *flags;
 	u64 *ring;
 	void *map;
 };
@@ -102,6 +105,7 @@ struct xdp_uqueue {
 	u32 size;
 	u32 *producer;
 	u32 *consumer;
+	u32 *flags;
 	struct xdp_desc *ring;
 	void *map;
 };
@@ -293,6 +297,7 @@ static inline int xq_enq(struct xdp_uqueue *uq,
 
 		r[idx].addr = descs[i].addr;
 		r[idx].len = descs[i].len;
+		r[idx].options = descs[i].options;
 	}
 
 	u_smp_wmb();
@@ -315,6 +320,7 @@ static inline int xq_enq_tx_only(struct xdp_uqueue *uq,
 
 		r[idx].addr	= (id + i) << FRAME_SHIFT;
 		r[idx].len	= sizeof(pkt_data) - 1;
+		r[idx].options	= 0;
 	}
 
 	u_smp_wmb();
@@ -444,6 +450,7 @@ static struct xdp_umem *xdp_umem_configure(int sfd)
 	umem->fq.producer = umem->fq.map + off.fr.producer;
 	umem->fq.consumer = umem->fq.map + off.fr.consumer;
 	umem->fq.ring = umem->fq.map + off.fr.desc;
+	umem->fq.flags = umem->fq.map + off.fr.flags;
 	umem->fq.cached_cons = FQ_NUM_DESCS;
 
 	umem->cq.map = mmap(0, off.cr.desc +
@@ -458,6 +465,7 @@ static struct xdp_umem *xdp_umem_configure(int sfd)
 	umem->cq.producer = umem->cq.map + off.cr.producer;
 	umem->cq.consumer = umem->cq.map + off.cr.consumer;
 	umem->cq.ring = umem->cq.map + off.cr.desc;
+	umem->cq.flags = umem->cq.map + off.cr.flags;
 
 	umem->frames = bufs;
 	umem->fd = sfd;
@@ -535,12 +543,14 @@ static struct xdpsock *xsk_configure(struct xdp_umem *umem)
 	xsk->rx.producer = xsk->rx.map + off.rx.producer;
 	xsk->rx.consumer = xsk->rx.map + off.rx.consumer;
 	xsk->rx.ring = xsk->rx.map + off.rx.desc;
+	xsk->rx.flags = xsk->rx.map + off.rx.flags;
 
 	xsk->tx.mask = NUM_DESCS - 1;
 	xsk->tx.size = NUM_DESCS;
 	xsk->tx.producer = xsk->tx.map + off.tx.producer;
 	xsk->tx.consumer = xsk->tx.map + off.tx.consumer;
 	xsk->tx.ring = xsk->tx.map + off.tx.desc;
+	xsk->tx.flags = xsk->tx.map + off.tx.flags;
 	xsk->tx.cached_cons = NUM_DESCS;
 
 	sxdp.sxdp_family = PF_XDP;
@@ -552,6 +562,10 @@ static struct xdpsock *xsk_configure(struct xdp_umem *umem)
 		sxdp.sxdp_shared_umem_fd = umem->fd;
 	} else {
 		sxdp.sxdp_flags = opt_xdp_bind_flags;
+		if (opt_need_wakeup)
+			sxdp.sxdp_flags |= XDP_USE_NEED_WAKEUP;
+		if (opt_frags)
+			sxdp.sxdp_flags |= XDP_USE_SG;
 	}
 
 	lassert(bind(sfd, (struct sockaddr *)&sxdp, sizeof(sxdp)) == 0);
@@ -650,6 +664,8 @@ static struct option long_options[] = {
 	{"interval", required_argument, 0, 'n'},
 	{"zero-copy", no_argument, 0, 'z'},
 	{"copy", no_argument, 0, 'c'},
+	{"no-need-wakeup", no_argument, 0, 'm'},
+	{"frags", no_argument, 0, 'F'},
 	{0, 0, 0, 0}
 };
 
@@ -670,6 +686,8 @@ static void usage(const char *prog)
 		"  -n, --interval=n	Specify statistics update interval (default 1 sec).\n"
 		"  -z, --zero-copy      Force zero-copy mode.\n"
 		"  -c, --copy           Force copy mode.\n"
+		"  -m, --no-need-wakeup Turn off use of driver need wakeup flag.\n"
+		"  -F, --frags          Accept packets larger than a frame (copy mode).\n"
 		"\n";
 	fprintf(stderr, str, prog);
 	exit(EXIT_FAILURE);
@@ -682,7 +700,7 @@ static void parse_command_line(int argc, char **argv)
 	opterr = 0;
 
 	for (;;) {
-		c = getopt_long(argc, argv, "rtli:q:psSNn:cz", long_options,
+		c = getopt_long(argc, argv, "rtli:q:psSNn:czmF", long_options,
 				&option_index);
 		if (c == -1)
 			break;
@@ -725,6 +743,12 @@ static void parse_command_line(int argc, char **argv)
 		case 'c':
 			opt_xdp_bind_flags |= XDP_COPY;
 			break;
+		case 'm':
+			opt_need_wakeup = 0;
+			break;
+		case 'F':
+			opt_frags = 1;
+			break;
 		default:
 			usage(basename(argv[0]));
 		}
@@ -748,6 +772,35 @@ static void kick_tx(int fd)
 	lassert(0);
 }
 
+/* Multi-buffer packets span several descriptors; count only their ends */
+static inline unsigned int count_pkts(struct xdp_desc *descs,
+				      unsigned int ndescs)
+{
+	unsigned int i, npkts = 0;
+
+	for (i = 0; i < ndescs; i++)
+		if (!(descs[i].options & XDP_PKT_CONTD))
+			npkts++;
+
+	return npkts;
+}
+
+static inline bool needs_wakeup(u32 *flags)
+{
+	return !opt_need_wakeup || (*flags & XDP_RING_NEED_WAKEUP);
+}
+
+static void kick_rx(int fd)
+{
+	int ret;
+
+	ret = recvfrom(fd, NULL, 0, MSG_DONTWAIT, NULL, NULL);
+	if (ret >= 0 || errno == ENOBUFS || errno == EAGAIN || errno == EBUSY ||
+	    errno == ENETDOWN)
+		return;
+	lassert(0);
+}
+
 static inline void complete_tx_l2fwd(struct xdpsock *xsk)
 {
 	u64 descs[BATCH_SIZE];
@@ -757,7 +810,8 @@ static inline void complete_tx_l2fwd(struct xdpsock *xsk)
 	if (!xsk->outstanding_tx)
 		return;
 
-	kick_tx(xsk->sfd);
+	if (needs_wakeup(xsk->tx.flags))
+		kick_tx(xsk->sfd);
 	ndescs = (xsk->outstanding_tx > BATCH_SIZE) ? BATCH_SIZE :
 		 xsk->outstanding_tx;
 
@@ -778,7 +832,8 @@ static inline void complete_tx_only(struct xdpsock *xsk)
 	if (!xsk->outstanding_tx)
 		return;
 
-	kick_tx(xsk->sfd);
+	if (needs_wakeup(xsk->tx.flags))
+		kick_tx(xsk->sfd);
 
 	rcvd = umem_complete_from_kernel(&xsk->umem->cq, descs, BATCH_SIZE);
 	if (rcvd > 0) {
@@ -793,8 +848,12 @@ static void rx_drop(struct xdpsock *xsk)
 	unsigned int rcvd, i;
 
 	rcvd = xq_deq(&xsk->rx, descs, BATCH_SIZE);
-	if (!rcvd)
+	if (!rcvd) {
+		if (opt_need_wakeup && !opt_poll &&
+		    (*xsk->umem->fq.flags & XDP_RING_NEED_WAKEUP))
+			kick_rx(xsk->sfd);
 		return;
+	}
 
 	for (i = 0; i < rcvd; i++) {
 		char *pkt = xq_get_data(xsk, descs[i].addr);
@@ -802,7 +861,7 @@ static void rx_drop(struct xdpsock *xsk)
 		hex_dump(pkt, descs[i].len, descs[i].addr);
 	}
 
-	xsk->rx_npkts += rcvd;
+	xsk->rx_npkts += count_pkts(descs, rcvd);
 
 	umem_fill_to_kernel_ex(&xsk->umem->fq, descs, rcvd);
 }
@@ -879,6 +938,10 @@ static void l2fwd(struct xdpsock *xsk)
 			rcvd = xq_deq(&xsk->rx, descs, BATCH_SIZE);
 			if (rcvd > 0)
 				break;
+
+			if (opt_need_wakeup &&
+			    (*xsk->umem->fq.flags & XDP_RING_NEED_WAKEUP))
+				kick_rx(xsk->sfd);
 		}
 
 		for (i = 0; i < rcvd; i++) {
@@ -889,7 +952,7 @@ static void l2fwd(struct xdpsock *xsk)
 			hex_dump(pkt, descs[i].len, descs[i].addr);
 		}
 
-		xsk->rx_npkts += rcvd;
+		xsk->rx_npkts += count_pkts(descs, rcvd);
 
 		ret = xq_enq(&xsk->tx, descs, rcvd);
 		lassert(ret == 0);
@@ -104,6 +104,10 @@ enum bpf_cmd {
 	BPF_BTF_GET_FD_BY_ID,
 	BPF_TASK_FD_QUERY,
 	BPF_MAP_LOOKUP_AND_DELETE_ELEM,
+	BPF_MAP_LOOKUP_BATCH,
+	BPF_MAP_LOOKUP_AND_DELETE_BATCH,
+	BPF_MAP_UPDATE_BATCH,
+	BPF_MAP_DELETE_BATCH,
 };
 
 enum bpf_map_type {
@@ -131,6 +135,7 @@ enum bpf_map_type {
 	BPF_MAP_TYPE_PERCPU_CGROUP_STORAGE,
 	BPF_MAP_TYPE_QUEUE,
 	BPF_MAP_TYPE_STACK,
+	BPF_MAP_TYPE_RINGBUF,
 };
 
 enum bpf_prog_type {
@@ -244,6 +249,7 @@ enum bpf_attach_type {
 #define BPF_ANY		0 /* create new element or update existing */
 #define BPF_NOEXIST	1 /* create new element if it didn't exist */
 #define BPF_EXIST	2 /* update existing element */
+#define BPF_F_LOCK	4 /* spin_lock-ed map_lookup/map_update */
 
 /* flags for BPF_MAP_CREATE command */
 #define BPF_F_NO_PREALLOC	(1U << 0)
@@ -269,6 +275,13 @@ enum bpf_attach_type {
 /* Flag for stack_map, store build_id+offset instead of pointer */
 #define BPF_F_STACK_BUILD_ID	(1U << 5)
 
+/* Split the common LRU list of a BPF_MAP_TYPE_LRU_[PERCPU_]HASH map
+ * into per-CPU eviction domains.  Unlike BPF_F_NO_COMMON_LRU, free
+ * nodes can still move between CPUs, so the whole map capacity is
+ * usable from any CPU.
+ */
+#define BPF_F_LRU_SHARDED	(1U << 24)
+
 enum bpf_stack_build_id_status {
 	/* user space need an empty entry to identify end of a trace */
 	BPF_STACK_BUILD_ID_EMPTY = 0,
@@ -306,6 +319,10 @@ union bpf_attr {
 		__u32	btf_fd;		/* fd pointing to a BTF type data */
 		__u32	btf_key_type_id;	/* BTF type_id of the key */
 		__u32	btf_value_type_id;	/* BTF type_id of the value */
+		__u32	lru_batch;	/* nodes reclaimed per LRU refill
+					 * (BPF_F_LRU_SHARDED only,
+					 * 0 for the default).
+					 */
 	};
 
 	struct { /* anonymous struct used by BPF_MAP_*_ELEM commands */
@@ -318,6 +335,23 @@ union bpf_attr {
 		__u64		flags;
 	};
 
+	struct { /* struct used by BPF_MAP_*_BATCH commands */
+		__aligned_u64	in_batch;	/* start batch,
+						 * NULL to start from beginning
+						 */
+		__aligned_u64	out_batch;	/* output: next start batch */
+		__aligned_u64	keys;
+		__aligned_u64	values;
+		__u32		count;		/* input/output:
+						 * input: # of key/value
+						 * elements
+						 * output: # of filled elements
+						 */
+		__u32		map_fd;
+		__u64		elem_flags;
+		__u64		flags;
+	} batch;
+
 	struct { /* anonymous struct used by BPF_PROG_LOAD command */
 		__u32		prog_type;	/* one of enum bpf_prog_type */
 		__u32		insn_cnt;
@@ -2257,6 +2291,99 @@ union bpf_attr {
  *
  *	Return
  *		0 on success, or a negative error in case of failure.
+ *
+ * int bpf_ringbuf_output(void *ringbuf, void *data, u64 size, u64 flags)
+ *	Description
+ *		Copy *size* bytes from *data* into a ring buffer *ringbuf*.
+ *		If **BPF_RB_NO_WAKEUP** is specified in *flags*, no
+ *		notification of new data availability is sent.
+ *		If **BPF_RB_FORCE_WAKEUP** is specified in *flags*,
+ *		notification of new data availability is sent
+ *		unconditionally. Without either flag, a notification is only
+ *		sent if the consumer has caught up with the producer.
+ *	Return
+ *		0 on success, or a negative error in case of failure.
+ *
+ * void *bpf_ringbuf_reserve(void *ringbuf, u64 size, u64 flags)
+ *	Description
+ *		Reserve *size* bytes of payload in a ring buffer *ringbuf*.
+ *		*size* must be a constant known to the verifier. *flags*
+ *		must be 0. The record has to be passed to either
+ *		**bpf_ringbuf_submit**\ () or **bpf_ringbuf_discard**\ ()
+ *		before the program exits.
+ *	Return
+ *		Valid pointer with *size* bytes of memory available; NULL,
+ *		otherwise.
+ *
+ * void bpf_ringbuf_submit(void *data, u64 flags)
+ *	Description
+ *		Submit reserved ring buffer sample, pointed to by *data*.
+ *		*flags* are interpreted as for **bpf_ringbuf_output**\ ().
+ *	Return
+ *		Nothing. Always succeeds.
+ *
+ * void bpf_ringbuf_discard(void *data, u64 flags)
+ *	Description
+ *		Discard reserved ring buffer sample, pointed to by *data*.
+ *		*flags* are interpreted as for **bpf_ringbuf_output**\ ().
+ *	Return
+ *		Nothing. Always succeeds.
+ *
+ * u64 bpf_ringbuf_query(void *ringbuf, u64 flags)
+ *	Description
+ *		Query various characteristics of provided ring buffer. What
+ *		exactly is queried is determined by *flags*:
+ *
+ *		* **BPF_RB_AVAIL_DATA**: Amount of data not yet consumed.
+ *		* **BPF_RB_RING_SIZE**: The size of ring buffer.
+ *		* **BPF_RB_CONS_POS**: Consumer position.
+ *		* **BPF_RB_PROD_POS**: Producer position.
+ *
+ *		The data returned is just a momentary snapshot of actual
+ *		values and could be inaccurate, so this facility should be
+ *		used to power heuristics and for reporting, not to make 100%
+ *		correct calculation.
+ *	Return
+ *		Requested value, or 0, if *flags* are not recognized.
+ *
+ * int bpf_spin_lock(struct bpf_spin_lock *lock)
+ *	Description
+ *		Acquire a spinlock represented by the pointer *lock*, which is
+ *		stored as part of a value of a map. Taking the lock allows to
+ *		safely update the rest of the fields in that value. The
+ *		spinlock can (and must) later be released with a call to
+ *		**bpf_spin_unlock**\ (\ *lock*\ ).
+ *
+ *		Spinlocks in BPF programs come with a number of restrictions
+ *		and constraints:
+ *
+ *		* **bpf_spin_lock** objects are only allowed inside maps of
+ *		  types **BPF_MAP_TYPE_HASH**, **BPF_MAP_TYPE_ARRAY** and
+ *		  **BPF_MAP_TYPE_CGROUP_STORAGE**, and the map must carry BTF
+ *		  describing the value.
+ *		* Only one **struct bpf_spin_lock** is allowed per map value.
+ *		* It cannot be accessed directly by loads or stores, only
+ *		  through the helpers.
+ *		* A BPF program can take only one lock at a time, and must
+ *		  release it before calling any other helper or BPF function,
+ *		  and before it exits.
+ *		* **BPF_LD_ABS** and **BPF_LD_IND** are not allowed while the
+ *		  lock is held.
+ *		* Tracing programs and socket filter programs cannot use
+ *		  **bpf_spin_lock**\ () yet.
+ *
+ *		From userspace, the **BPF_F_LOCK** flag of the
+ *		**BPF_MAP_LOOKUP_ELEM** and **BPF_MAP_UPDATE_ELEM** commands
+ *		copies a value while holding its lock.
+ *	Return
+ *		0
+ *
+ * int bpf_spin_unlock(struct bpf_spin_lock *lock)
+ *	Description
+ *		Release the *lock* previously locked by a call to
+ *		**bpf_spin_lock**\ (\ *lock*\ ).
+ *	Return
+ *		0
  */
 #define __BPF_FUNC_MAPPER(FN)		\
 	FN(unspec),			\
@@ -2349,7 +2476,14 @@ union bpf_attr {
 	FN(map_push_elem),		\
 	FN(map_pop_elem),		\
 	FN(map_peek_elem),		\
-	FN(msg_push_data),
+	FN(msg_push_data),		\
+	FN(ringbuf_output),		\
+	FN(ringbuf_reserve),		\
+	FN(ringbuf_submit),		\
+	FN(ringbuf_discard),		\
+	FN(ringbuf_query),		\
+	FN(spin_lock),			\
+	FN(spin_unlock),
 
 /* integer value in 'imm' field of BPF_CALL instruction selects which helper
  * function eBPF program intends to call
@@ -2405,6 +2539,27 @@ enum bpf_func_id {
 /* BPF_FUNC_perf_event_output for sk_buff input context. */
 #define BPF_F_CTXLEN_MASK		(0xfffffULL << 32)
 
+/* BPF_FUNC_ringbuf_output, BPF_FUNC_ringbuf_submit and
+ * BPF_FUNC_ringbuf_discard flags.
+ */
+#define BPF_RB_NO_WAKEUP		(1ULL << 0)
+#define BPF_RB_FORCE_WAKEUP		(1ULL << 1)
+
+/* BPF_FUNC_ringbuf_query flags. */
+enum {
+	BPF_RB_AVAIL_DATA = 0,
+	BPF_RB_RING_SIZE = 1,
+	BPF_RB_CONS_POS = 2,
+	BPF_RB_PROD_POS = 3,
+};
+
+/* BPF ring buffer record header, followed by the record data. The length
+ * word carries the busy and discard bits, the record is padded to 8 bytes.
+ */
+#define BPF_RINGBUF_BUSY_BIT		(1U << 31)
+#define BPF_RINGBUF_DISCARD_BIT		(1U << 30)
+#define BPF_RINGBUF_HDR_SZ		8
+
 /* Mode for BPF_FUNC_skb_adjust_room helper. */
 enum bpf_adj_room_mode {
 	BPF_ADJ_ROOM_NET,
@@ -2942,4 +3097,8 @@ struct bpf_flow_keys {
 	};
 };
 
+struct bpf_spin_lock {
+	__u32	val;
+};
+
 #endif /* _UAPI__LINUX_BPF_H__ */
@@ -0,0 +1,160 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Compare the insert and lookup throughput of the LRU hash flavours when
+ * several CPUs update the same map. Worker threads, each pinned to a CPU,
+ * update random keys from a key space twice the size of the map, so that
+ * the map stays full and every CPU keeps evicting, and look up another
+ * random key after each update.
+ *
+ * Usage: test_lru_bench [-d seconds] [-t threads] [-n entries] [-b lru_batch]
+ */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <bpf/bpf.h>
+
+#include "bpf_rlimit.h"
+#include "bpf_util.h"
+
+static int duration = 5;
+static int nr_threads;
+static unsigned int nr_entries = 1 << 16;
+static unsigned int lru_batch = 256;
+static volatile bool stop;
+
+static int nr_cpus;
+static int map_fd;
+
+static __u64 updates;
+static __u64 lookups;
+static __u64 hits;
+
+static void *worker(void *arg)
+{
+	long cpu = (long)arg;
+	__u64 nr_updates = 0, nr_lookups = 0, nr_hits = 0;
+	unsigned int seed = cpu + 1;
+	__u64 key, value[nr_cpus];
+	cpu_set_t set;
+
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+
+	memset(value, 0, sizeof(value));
+	while (!stop) {
+		key = rand_r(&seed) % (2 * nr_entries);
+		if (bpf_map_update_elem(map_fd, &key, value, BPF_ANY))
+			break;
+		nr_updates++;
+
+		key = rand_r(&seed) % (2 * nr_entries);
+		if (!bpf_map_lookup_elem(map_fd, &key, value))
+			nr_hits++;
+		nr_lookups++;
+	}
+
+	__atomic_add_fetch(&updates, nr_updates, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&lookups, nr_lookups, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&hits, nr_hits, __ATOMIC_RELAXED);
+
+	return NULL;
+}
+
+static int run_one(const char *title, enum bpf_map_type map_type,
+		   __u32 map_flags, __u32 batch)
+{
+	struct bpf_create_map_attr attr = {
+		.map_type = map_type,
+		.map_flags = map_flags,
+		.key_size = sizeof(__u64),
+		.value_size = sizeof(__u64),
+		.max_entries = nr_entries,
+		.lru_batch = batch,
+	};
+	pthread_t threads[nr_threads];
+	long i;
+
+	map_fd = bpf_create_map_xattr(&attr);
+	if (map_fd < 0) {
+		printf("%-24s map creation failed: %s\n", title,
+		       strerror(errno));
+		return -errno;
+	}
+
+	stop = false;
+	updates = lookups = hits = 0;
+
+	for (i = 0; i < nr_threads; i++)
+		pthread_create(&threads[i], NULL, worker,
+			       (void *)(i % nr_cpus));
+
+	sleep(duration);
+	stop = true;
+
+	for (i = 0; i < nr_threads; i++)
+		pthread_join(threads[i], NULL);
+
+	printf("%-24s update %8.3f M/s  lookup %8.3f M/s  hit %5.1f%%\n",
+	       title, updates / 1e6 / duration, lookups / 1e6 / duration,
+	       lookups ? 100.0 * hits / lookups : 0.0);
+
+	close(map_fd);
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	int opt, err = 0;
+
+	nr_cpus = bpf_num_possible_cpus();
+	nr_threads = nr_cpus;
+
+	while ((opt = getopt(argc, argv, "d:t:n:b:")) != -1) {
+		switch (opt) {
+		case 'd':
+			duration = atoi(optarg);
+			break;
+		case 't':
+			nr_threads = atoi(optarg);
+			break;
+		case 'n':
+			nr_entries = atoi(optarg);
+			break;
+		case 'b':
+			lru_batch = atoi(optarg);
+			break;
+		default:
+			fprintf(stderr,
+				"Usage: %s [-d seconds] [-t threads] [-n entries] [-b lru_batch]\n",
+				argv[0]);
+			return 1;
+		}
+	}
+
+	if (nr_threads < 1)
+		nr_threads = 1;
+	/* every CPU's LRU list needs some room with BPF_F_NO_COMMON_LRU */
+	if (nr_entries < 2 * nr_cpus)
+		nr_entries = 2 * nr_cpus;
+
+	printf("%d thread(s), %u entries, %d s per run\n",
+	       nr_threads, nr_entries, duration);
+
+	err |= run_one("lru_hash", BPF_MAP_TYPE_LRU_HASH, 0, 0);
+	err |= run_one("lru_hash no_common_lru", BPF_MAP_TYPE_LRU_HASH,
+		       BPF_F_NO_COMMON_LRU, 0);
+	err |= run_one("lru_hash sharded", BPF_MAP_TYPE_LRU_HASH,
+		       BPF_F_LRU_SHARDED, 0);
+	err |= run_one("lru_hash sharded batch", BPF_MAP_TYPE_LRU_HASH,
+		       BPF_F_LRU_SHARDED, lru_batch);
+
+	return err ? 1 : 0;
+}
@@ -612,6 +612,67 @@ static void test_lru_sanity6(int map_type, int map_flags, int tgt_free)
 	printf("Pass\n");
 }
 
+/* Test that the whole capacity of a BPF_F_LRU_SHARDED map is usable
+ * from one CPU, i.e. the free nodes in the shards of the other CPUs are
+ * taken before anything gets evicted.
+ */
+static void test_lru_sanity7(int map_type, int map_flags, unsigned int tgt_free,
+			     unsigned int lru_batch)
+{
+	struct bpf_create_map_attr attr = {};
+	unsigned long long key, next_key, value[nr_cpus];
+	unsigned int map_size = tgt_free * nr_cpus;
+	int lru_map_fd, expected_map_fd;
+	unsigned int nr_keys = 0;
+	int next_cpu = 0;
+
+	if (!(map_flags & BPF_F_LRU_SHARDED))
+		return;
+
+	printf("%s (map_type:%d map_flags:0x%X lru_batch:%u): ", __func__,
+	       map_type, map_flags, lru_batch);
+
+	assert(sched_next_online(0, &next_cpu) != -1);
+
+	expected_map_fd = create_map(BPF_MAP_TYPE_HASH, 0, map_size);
+	assert(expected_map_fd != -1);
+
+	attr.map_type = map_type;
+	attr.map_flags = map_flags;
+	attr.key_size = sizeof(key);
+	attr.value_size = sizeof(value[0]);
+	attr.max_entries = map_size;
+	attr.lru_batch = lru_batch;
+	lru_map_fd = bpf_create_map_xattr(&attr);
+	assert(lru_map_fd != -1);
+
+	value[0] = 1234;
+
+	for (key = 1; key <= map_size; key++) {
+		assert(!bpf_map_update_elem(lru_map_fd, &key, value,
+					    BPF_NOEXIST));
+		assert(!bpf_map_update_elem(expected_map_fd, &key, value,
+					    BPF_NOEXIST));
+	}
+
+	/* Nothing has been evicted so far */
+	assert(map_equal(lru_map_fd, expected_map_fd));
+
+	/* The map is full, one more key must evict an older one */
+	assert(!bpf_map_update_elem(lru_map_fd, &key, value, BPF_NOEXIST));
+	assert(!bpf_map_lookup_elem(lru_map_fd, &key, value));
+
+	next_key = 0;
+	while (!bpf_map_get_next_key(lru_map_fd, &next_key, &next_key))
+		nr_keys++;
+	assert(nr_keys <= map_size);
+
+	close(expected_map_fd);
+	close(lru_map_fd);
+
+	printf("Pass\n");
+}
+
 int main(int argc, char **argv)
 {
 	int map_types[] = {BPF_MAP_TYPE_LRU_HASH,
@@ -642,5 +703,14 @@ int main(int argc, char **argv)
 		}
 	}
 
+	for (t = 0; t < sizeof(map_types) / sizeof(*map_types); t++) {
+		test_lru_sanity7(map_types[t], BPF_F_LRU_SHARDED,
+				 LOCAL_FREE_TARGET, 0);
+		test_lru_sanity7(map_types[t], BPF_F_LRU_SHARDED,
+				 LOCAL_FREE_TARGET, 32);
+
+		printf("\n");
+	}
+
 	return 0;
 }
@@ -306,6 +306,152 @@ static void test_hashmap_walk(int task, void *data)
 	close(fd);
 }
 
+static bool is_percpu_map(int map_type)
+{
+	return map_type == BPF_MAP_TYPE_PERCPU_HASH ||
+	       map_type == BPF_MAP_TYPE_LRU_PERCPU_HASH ||
+	       map_type == BPF_MAP_TYPE_PERCPU_ARRAY;
+}
+
+static void batch_fill(int *keys, long long *values, int max_entries,
+		       int nr_vals)
+{
+	int i, j;
+
+	for (i = 0; i < max_entries; i++) {
+		keys[i] = i;
+		for (j = 0; j < nr_vals; j++)
+			values[i * nr_vals + j] = i + j + 1;
+	}
+}
+
+static void batch_verify(int *keys, long long *values, int nr, int nr_vals)
+{
+	int *visited = calloc(nr, sizeof(int));
+	int i, j;
+
+	assert(visited);
+	for (i = 0; i < nr; i++) {
+		assert(keys[i] >= 0 && keys[i] < nr);
+		assert(!visited[keys[i]]);
+		visited[keys[i]] = 1;
+		for (j = 0; j < nr_vals; j++)
+			assert(values[i * nr_vals + j] == keys[i] + j + 1);
+	}
+	free(visited);
+}
+
+/* Dump the map step elements at a time; the cursor is opaque to the caller
+ * and at least as large as the key. Returns the number of elements seen.
+ */
+static int batch_dump(int fd, bool do_delete, int *keys, long long *values,
+		      int nr_vals, __u32 step)
+{
+	long long batch = 0;
+	__u32 count;
+	int err, total = 0;
+
+	do {
+		count = step;
+		if (do_delete)
+			err = bpf_map_lookup_and_delete_batch(fd,
+					total ? &batch : NULL, &batch,
+					keys + total, values + total * nr_vals,
+					&count, 0, 0);
+		else
+			err = bpf_map_lookup_batch(fd,
+					total ? &batch : NULL, &batch,
+					keys + total, values + total * nr_vals,
+					&count, 0, 0);
+		assert(!err || errno == ENOENT);
+		total += count;
+	} while (!err);
+
+	return total;
+}
+
+static void test_hashmap_batch(int map_type)
+{
+	unsigned int nr_cpus = bpf_num_possible_cpus();
+	int nr_vals = is_percpu_map(map_type) ? nr_cpus : 1;
+	int fd, key, max_entries = 1000, *keys;
+	long long *values;
+	__u32 count;
+
+	keys = malloc(max_entries * sizeof(*keys));
+	values = malloc(max_entries * nr_vals * sizeof(*values));
+	assert(keys && values);
+
+	fd = bpf_create_map(map_type, sizeof(int), sizeof(long long),
+			    max_entries, map_flags);
+	if (fd < 0) {
+		printf("Failed to create hashmap '%s'!\n", strerror(errno));
+		exit(1);
+	}
+
+	/* An empty map is already at its end. */
+	count = max_entries;
+	assert(bpf_map_lookup_batch(fd, NULL, &key, keys, values, &count,
+				    0, 0) == -1 && errno == ENOENT &&
+	       count == 0);
+
+	batch_fill(keys, values, max_entries, nr_vals);
+	count = max_entries;
+	assert(bpf_map_update_batch(fd, keys, values, &count, 0, 0) == 0 &&
+	       count == max_entries);
+
+	/* BPF_NOEXIST stops at the first element that is already there. */
+	count = max_entries;
+	assert(bpf_map_update_batch(fd, keys, values, &count, BPF_NOEXIST,
+				    0) == -1 && errno == EEXIST && count == 0);
+
+	/* Unknown flags are rejected. */
+	count = max_entries;
+	assert(bpf_map_lookup_batch(fd, NULL, &key, keys, values, &count,
+				    0, 1) == -1 && errno == EINVAL);
+
+	/* Walk in a few different step sizes, including one large enough
+	 * to dump the whole map in a single call.
+	 */
+	memset(keys, 0, max_entries * sizeof(*keys));
+	memset(values, 0, max_entries * nr_vals * sizeof(*values));
+	assert(batch_dump(fd, false, keys, values, nr_vals, 64) ==
+	       max_entries);
+	batch_verify(keys, values, max_entries, nr_vals);
+
+	memset(keys, 0, max_entries * sizeof(*keys));
+	assert(batch_dump(fd, false, keys, values, nr_vals, max_entries) ==
+	       max_entries);
+	batch_verify(keys, values, max_entries, nr_vals);
+
+	/* lookup_and_delete drains the map. */
+	memset(keys, 0, max_entries * sizeof(*keys));
+	assert(batch_dump(fd, true, keys, values, nr_vals, 100) ==
+	       max_entries);
+	batch_verify(keys, values, max_entries, nr_vals);
+	assert(bpf_map_get_next_key(fd, NULL, &key) == -1 &&
+	       errno == ENOENT);
+
+	/* delete_batch removes everything it is given ... */
+	batch_fill(keys, values, max_entries, nr_vals);
+	count = max_entries;
+	assert(bpf_map_update_batch(fd, keys, values, &count, 0, 0) == 0);
+	count = max_entries;
+	assert(bpf_map_delete_batch(fd, keys, &count, 0, 0) == 0 &&
+	       count == max_entries);
+	assert(bpf_map_get_next_key(fd, NULL, &key) == -1 &&
+	       errno == ENOENT);
+
+	/* ... and reports how far it got when a key is missing. */
+	count = max_entries;
+	assert(bpf_map_delete_batch(fd, keys, &count, 0, 0) == -1 &&
+	       errno == ENOENT && count == 0);
+
+	close(fd);
+	free(values);
+	free(keys);
+}
+
 static void test_arraymap(int task, void *data)
 {
 	int key, next_key, fd;
@@ -457,6 +603,50 @@ static void test_arraymap_percpu_many_keys(void)
 	close(fd);
 }
 
+static void test_arraymap_batch(int map_type)
+{
+	unsigned int nr_cpus = bpf_num_possible_cpus();
+	int nr_vals = is_percpu_map(map_type) ? nr_cpus : 1;
+	int fd, max_entries = 1000, *keys;
+	long long *values;
+	__u32 count;
+
+	keys = malloc(max_entries * sizeof(*keys));
+	values = malloc(max_entries * nr_vals * sizeof(*values));
+	assert(keys && values);
+
+	fd = bpf_create_map(map_type, sizeof(int), sizeof(long long),
+			    max_entries, 0);
+	if (fd < 0) {
+		printf("Failed to create arraymap '%s'!\n", strerror(errno));
+		exit(1);
+	}
+
+	batch_fill(keys, values, max_entries, nr_vals);
+	count = max_entries;
+	assert(bpf_map_update_batch(fd, keys, values, &count, 0, 0) == 0 &&
+	       count == max_entries);
+
+	memset(keys, 0, max_entries * sizeof(*keys));
+	memset(values, 0, max_entries * nr_vals * sizeof(*values));
+	assert(batch_dump(fd, false, keys, values, nr_vals, 37) ==
+	       max_entries);
+	batch_verify(keys, values, max_entries, nr_vals);
+
+	/* Array elements cannot be deleted. */
+	count = max_entries;
+	assert(bpf_map_delete_batch(fd, keys, &count, 0, 0) == -1 &&
+	       errno == ENOTSUPP);
+	count = max_entries;
+	assert(bpf_map_lookup_and_delete_batch(fd, NULL, keys, keys, values,
+					       &count, 0, 0) == -1 &&
+	       errno == ENOTSUPP);
+
+	close(fd);
+	free(values);
+	free(keys);
+}
+
 static void test_devmap(int task, void *data)
 {
 	int fd;
@@ -1534,11 +1724,15 @@ static void run_all_tests(void)
 	test_hashmap(0, NULL);
 	test_hashmap_percpu(0, NULL);
 	test_hashmap_walk(0, NULL);
+	test_hashmap_batch(BPF_MAP_TYPE_HASH);
+	test_hashmap_batch(BPF_MAP_TYPE_PERCPU_HASH);
 
 	test_arraymap(0, NULL);
 	test_arraymap_percpu(0, NULL);
 
 	test_arraymap_percpu_many_keys();
+	test_arraymap_batch(BPF_MAP_TYPE_ARRAY);
+	test_arraymap_batch(BPF_MAP_TYPE_PERCPU_ARRAY);
 
 	test_devmap(0, NULL);
 	test_sockmap(0, NULL);
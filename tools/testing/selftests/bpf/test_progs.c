@@ -11,6 +11,7 @@
 #include <assert.h>
 #include <stdlib.h>
 #include <time.h>
+#include <pthread.h>
 
 #include <linux/types.h>
 typedef __u16 __sum16;
@@ -27,6 +28,7 @@ typedef __u16 __sum16;
 #include <sys/ioctl.h>
 #include <sys/wait.h>
 #include <sys/types.h>
+#include <sys/mman.h>
 #include <fcntl.h>
 
 #include <linux/bpf.h>
@@ -39,6 +41,7 @@ typedef __u16 __sum16;
 #include "bpf_endian.h"
 #include "bpf_rlimit.h"
 #include "trace_helpers.h"
+#include "test_ringbuf.h"
 
 static int error_cnt, pass_cnt;
 static bool jit_enabled;
@@ -1830,6 +1833,216 @@ static void test_queue_stack_map(int type)
 	bpf_object__close(obj);
 }
 
+static int ringbuf_samples;
+static int ringbuf_bad_samples;
+static bool ringbuf_saddr_is_seq;
+
+static int ringbuf_check_sample(void *data, int size)
+{
+	struct ringbuf_sample *s = data;
+
+	/* odd records were discarded by the program */
+	if (size != sizeof(*s) || s->seq & 1 ||
+	    s->saddr != (ringbuf_saddr_is_seq ? s->seq : 0) ||
+	    s->avail < sizeof(*s) + BPF_RINGBUF_HDR_SZ)
+		ringbuf_bad_samples++;
+	ringbuf_samples++;
+	return 0;
+}
+
+static void test_ringbuf(void)
+{
+	const char *file = "./test_ringbuf.o";
+	int i, err, prog_fd, rb_fd, stats_fd, page_sz = getpagesize();
+	__u32 key = 0, duration = 0, retval, size;
+	struct ringbuf_consumer rb;
+	struct ringbuf_stats st;
+	struct bpf_object *obj;
+	char buf[128];
+	void *tmp;
+
+	err = bpf_prog_load(file, BPF_PROG_TYPE_SCHED_CLS, &obj, &prog_fd);
+	if (CHECK(err, "prog_load", "err %d errno %d\n", err, errno))
+		return;
+
+	rb_fd = bpf_find_map(__func__, obj, "ringbuf");
+	stats_fd = bpf_find_map(__func__, obj, "stats");
+	if (rb_fd < 0 || stats_fd < 0)
+		goto out;
+
+	err = ringbuf_consumer_open(&rb, rb_fd);
+	if (CHECK(err, "ringbuf_consumer_open", "err %d\n", err))
+		goto out;
+
+	/* only the consumer position page may be mapped writable */
+	tmp = mmap(NULL, page_sz, PROT_READ | PROT_WRITE, MAP_SHARED,
+		   rb_fd, page_sz);
+	if (CHECK(tmp != MAP_FAILED, "mmap producer page rw",
+		  "unexpectedly succeeded\n"))
+		munmap(tmp, page_sz);
+
+	ringbuf_saddr_is_seq = true;
+	for (i = 0; i < 10; i++) {
+		pkt_v4.iph.saddr = i;
+		err = bpf_prog_test_run(prog_fd, 1, &pkt_v4, sizeof(pkt_v4),
+					buf, &size, &retval, &duration);
+		if (err || retval)
+			break;
+	}
+	CHECK(err || retval, "test_run", "err %d errno %d retval %d\n",
+	      err, errno, retval);
+
+	err = ringbuf_poll(&rb, 0, ringbuf_check_sample);
+	CHECK(err != 5 || ringbuf_bad_samples, "consume",
+	      "err %d samples %d bad %d\n", err, ringbuf_samples,
+	      ringbuf_bad_samples);
+
+	/* Run without a consumer until the ring overflows: reserve must
+	 * fail instead of overwriting records that were not consumed yet.
+	 */
+	ringbuf_saddr_is_seq = false;
+	pkt_v4.iph.saddr = 0;
+	err = bpf_prog_test_run(prog_fd, RINGBUF_SIZE / 16, &pkt_v4,
+				sizeof(pkt_v4), buf, &size, &retval, &duration);
+	err = err ?: bpf_map_lookup_elem(stats_fd, &key, &st);
+	CHECK(err || !st.dropped, "overflow", "err %d dropped %llu\n",
+	      err, st.dropped);
+
+	err = ringbuf_consume(&rb, ringbuf_check_sample);
+	CHECK(err <= 0 || ringbuf_bad_samples, "consume after overflow",
+	      "err %d bad %d\n", err, ringbuf_bad_samples);
+
+	ringbuf_consumer_close(&rb);
+out:
+	pkt_v4.iph.saddr = 0;
+	bpf_object__close(obj);
+}
+
+#define SPIN_LOCK_THREADS	4
+#define SPIN_LOCK_RUNS		10000
+
+static void *spin_lock_thread(void *arg)
+{
+	__u32 duration, retval;
+	int err, prog_fd = *(int *)arg;
+
+	err = bpf_prog_test_run(prog_fd, SPIN_LOCK_RUNS, &pkt_v4,
+				sizeof(pkt_v4), NULL, NULL, &retval,
+				&duration);
+	CHECK(err || retval, "spin_lock_run",
+	      "err %d errno %d retval %d duration %d\n",
+	      err, errno, retval, duration);
+	pthread_exit(arg);
+}
+
+static void test_spin_lock(void)
+{
+	const char *file = "./test_spin_lock.o";
+	pthread_t thread_id[SPIN_LOCK_THREADS];
+	struct {
+		int cnt;
+		__u32 lock;
+		int padding;
+	} val;
+	int map_fd, prog_fd, key = 0;
+	struct bpf_object *obj;
+	__u32 duration = 0;
+	void *ret;
+	int err, i;
+
+	err = bpf_prog_load(file, BPF_PROG_TYPE_SCHED_CLS, &obj, &prog_fd);
+	if (CHECK(err, "prog_load", "err %d errno %d\n", err, errno))
+		return;
+
+	map_fd = bpf_find_map(__func__, obj, "hmap");
+	if (map_fd < 0)
+		goto close_prog;
+
+	for (i = 0; i < SPIN_LOCK_THREADS; i++)
+		assert(pthread_create(&thread_id[i], NULL,
+				      &spin_lock_thread, &prog_fd) == 0);
+	for (i = 0; i < SPIN_LOCK_THREADS; i++)
+		assert(pthread_join(thread_id[i], &ret) == 0 &&
+		       ret == (void *)&prog_fd);
+
+	err = bpf_map_lookup_elem_flags(map_fd, &key, &val, BPF_F_LOCK);
+	CHECK(err || val.cnt != SPIN_LOCK_THREADS * SPIN_LOCK_RUNS || val.lock,
+	      "spin_lock_count", "err %d cnt %d lock %u\n",
+	      err, val.cnt, val.lock);
+
+	/* the lock is never copied in either direction */
+	val.lock = 1;
+	val.cnt = 0;
+	err = bpf_map_update_elem(map_fd, &key, &val, BPF_EXIST | BPF_F_LOCK);
+	err = err ?: bpf_map_lookup_elem(map_fd, &key, &val);
+	CHECK(err || val.cnt || val.lock, "spin_lock_update",
+	      "err %d cnt %d lock %u\n", err, val.cnt, val.lock);
+close_prog:
+	bpf_object__close(obj);
+}
+
+/* only the cost of the verification, see BPF_LOG_STATS in the kernel */
+#define VERIF_LOG_STATS		4
+
+/* Verify loops walking close to the 1M processed insns limit and report
+ * what the verifier says they cost.
+ */
+static void test_verif_scale(void)
+{
+	struct {
+		int trips;
+		bool success;
+	} tests[] = {
+		{ 1000, true },
+		{ 10000, true },
+		{ 100000, true },
+		{ 333000, true },	/* 3 insns per trip, 999003 insns */
+		{ 334000, false },
+	};
+	struct bpf_insn prog[] = {
+		BPF_ALU64_IMM(BPF_MOV, BPF_REG_0, 0),
+		BPF_ALU64_IMM(BPF_MOV, BPF_REG_1, 0),	/* trip count */
+		BPF_ALU64_IMM(BPF_ADD, BPF_REG_0, 1),
+		BPF_ALU64_IMM(BPF_SUB, BPF_REG_1, 1),
+		BPF_JMP_IMM(BPF_JNE, BPF_REG_1, 0, -3),
+		BPF_EXIT_INSN(),
+	};
+	unsigned int insns, max_states, states;
+	static char log[4096];
+	unsigned long long usec;
+	__u32 duration = 0;
+	const char *p;
+	int i, fd;
+
+	for (i = 0; i < sizeof(tests) / sizeof(tests[0]); i++) {
+		prog[1].imm = tests[i].trips;
+		log[0] = 0;
+
+		fd = bpf_verify_program(BPF_PROG_TYPE_SCHED_CLS, prog,
+					ARRAY_SIZE(prog), 0, "GPL", 0,
+					log, sizeof(log), VERIF_LOG_STATS);
+		if (CHECK((fd >= 0) != tests[i].success, "verif_scale",
+			  "trips %d fd %d errno %d\n%s",
+			  tests[i].trips, fd, errno, log))
+			goto next;
+
+		usec = insns = max_states = states = 0;
+		p = strstr(log, "verification time");
+		if (p)
+			sscanf(p, "verification time %llu usec", &usec);
+		p = strstr(log, "processed");
+		if (p)
+			sscanf(p, "processed %u insns (limit %*u) max_states_per_insn %u total_states %u",
+			       &insns, &max_states, &states);
+		printf("%s:trips %d: %u insns, %llu usec, max_states_per_insn %u, total_states %u\n",
+		       __func__, tests[i].trips, insns, usec, max_states,
+		       states);
+next:
+		if (fd >= 0)
+			close(fd);
+	}
+}
+
 int main(void)
 {
 	srand(time(NULL));
@@ -1856,6 +2069,9 @@ int main(void)
 	test_reference_tracking();
 	test_queue_stack_map(QUEUE);
 	test_queue_stack_map(STACK);
+	test_ringbuf();
+	test_spin_lock();
+	test_verif_scale();
 
 	printf("Summary: %d PASSED, %d FAILED\n", pass_cnt, error_cnt);
 	return error_cnt ? EXIT_FAILURE : EXIT_SUCCESS;
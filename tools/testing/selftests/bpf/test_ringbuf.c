@@ -0,0 +1,67 @@
+// SPDX-License-Identifier: GPL-2.0
+#include <stddef.h>
+#include <linux/bpf.h>
+#include <linux/if_ether.h>
+#include <linux/ip.h>
+#include <linux/pkt_cls.h>
+#include "bpf_helpers.h"
+#include "test_ringbuf.h"
+
+int _version SEC("version") = 1;
+
+struct bpf_map_def SEC("maps") ringbuf = {
+	.type = BPF_MAP_TYPE_RINGBUF,
+	.max_entries = RINGBUF_SIZE,
+};
+
+struct bpf_map_def SEC("maps") stats = {
+	.type = BPF_MAP_TYPE_ARRAY,
+	.key_size = sizeof(__u32),
+	.value_size = sizeof(struct ringbuf_stats),
+	.max_entries = 1,
+};
+
+/* Every run reserves one record carrying the IPv4 source address of the
+ * test packet. Records with an odd sequence number are discarded, so the
+ * consumer must only ever see the even ones.
+ */
+SEC("classifier")
+int test_ringbuf(struct __sk_buff *skb)
+{
+	void *data_end = (void *)(long)skb->data_end;
+	void *data = (void *)(long)skb->data;
+	struct ethhdr *eth = data;
+	struct ringbuf_stats *st;
+	struct ringbuf_sample *s;
+	struct iphdr *iph;
+	__u32 key = 0;
+	__u64 seq;
+
+	iph = (struct iphdr *)(eth + 1);
+	if (iph + 1 > data_end)
+		return TC_ACT_SHOT;
+
+	st = bpf_map_lookup_elem(&stats, &key);
+	if (!st)
+		return TC_ACT_SHOT;
+	seq = st->seq++;
+
+	s = bpf_ringbuf_reserve(&ringbuf, sizeof(*s), 0);
+	if (!s) {
+		st->dropped++;
+		return TC_ACT_SHOT;
+	}
+
+	s->seq = seq;
+	s->saddr = iph->saddr;
+	s->avail = bpf_ringbuf_query(&ringbuf, BPF_RB_AVAIL_DATA);
+
+	if (seq & 1)
+		bpf_ringbuf_discard(s, 0);
+	else
+		bpf_ringbuf_submit(s, 0);
+
+	return TC_ACT_OK;
+}
+
+char _license[] SEC("license") = "GPL";
@@ -0,0 +1,21 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef __TEST_RINGBUF_H
+#define __TEST_RINGBUF_H
+
+#include <linux/types.h>
+
+/* a multiple of the page size on all architectures */
+#define RINGBUF_SIZE	(1 << 16)
+
+struct ringbuf_sample {
+	__u32 seq;
+	__u32 saddr;
+	__u64 avail;
+};
+
+struct ringbuf_stats {
+	__u64 seq;
+	__u64 dropped;
+};
+
+#endif
@@ -0,0 +1,23 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef __TEST_RINGBUF_BENCH_H
+#define __TEST_RINGBUF_BENCH_H
+
+#include <linux/types.h>
+
+/* the perf buffers get the same amount of memory, split across CPUs */
+#define BENCH_RINGBUF_SIZE	(1 << 22)
+#define BENCH_MAX_CPUS		128
+
+enum {
+	BENCH_WAKEUP_FLAGS,
+	BENCH_DROPS,
+	BENCH_CTL_MAX,
+};
+
+struct bench_sample {
+	__u32 len;
+	__u32 mark;
+	__u64 ts;
+};
+
+#endif
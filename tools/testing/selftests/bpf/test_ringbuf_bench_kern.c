@@ -0,0 +1,99 @@
+// SPDX-License-Identifier: GPL-2.0
+#include <linux/bpf.h>
+#include <linux/pkt_cls.h>
+#include "bpf_helpers.h"
+#include "test_ringbuf_bench.h"
+
+int _version SEC("version") = 1;
+
+struct bpf_map_def SEC("maps") ringbuf = {
+	.type = BPF_MAP_TYPE_RINGBUF,
+	.max_entries = BENCH_RINGBUF_SIZE,
+};
+
+struct bpf_map_def SEC("maps") perfbuf = {
+	.type = BPF_MAP_TYPE_PERF_EVENT_ARRAY,
+	.key_size = sizeof(int),
+	.value_size = sizeof(__u32),
+	.max_entries = BENCH_MAX_CPUS,
+};
+
+/* [BENCH_WAKEUP_FLAGS] flags for submit/output, [BENCH_DROPS] drop count */
+struct bpf_map_def SEC("maps") bench_ctl = {
+	.type = BPF_MAP_TYPE_PERCPU_ARRAY,
+	.key_size = sizeof(__u32),
+	.value_size = sizeof(__u64),
+	.max_entries = BENCH_CTL_MAX,
+};
+
+static __always_inline __u64 *bench_ctl_get(__u32 key)
+{
+	return bpf_map_lookup_elem(&bench_ctl, &key);
+}
+
+SEC("classifier/ringbuf_reserve")
+int bench_ringbuf_reserve(struct __sk_buff *skb)
+{
+	__u64 *flags = bench_ctl_get(BENCH_WAKEUP_FLAGS);
+	__u64 *drops = bench_ctl_get(BENCH_DROPS);
+	struct bench_sample *s;
+
+	if (!flags || !drops)
+		return TC_ACT_SHOT;
+
+	s = bpf_ringbuf_reserve(&ringbuf, sizeof(*s), 0);
+	if (!s) {
+		*drops += 1;
+		return TC_ACT_SHOT;
+	}
+	s->len = skb->len;
+	s->mark = skb->mark;
+	s->ts = bpf_ktime_get_ns();
+	bpf_ringbuf_submit(s, *flags);
+
+	return TC_ACT_OK;
+}
+
+SEC("classifier/ringbuf_output")
+int bench_ringbuf_output(struct __sk_buff *skb)
+{
+	__u64 *flags = bench_ctl_get(BENCH_WAKEUP_FLAGS);
+	__u64 *drops = bench_ctl_get(BENCH_DROPS);
+	struct bench_sample s = {};
+
+	if (!flags || !drops)
+		return TC_ACT_SHOT;
+
+	s.len = skb->len;
+	s.mark = skb->mark;
+	s.ts = bpf_ktime_get_ns();
+	if (bpf_ringbuf_output(&ringbuf, &s, sizeof(s), *flags)) {
+		*drops += 1;
+		return TC_ACT_SHOT;
+	}
+
+	return TC_ACT_OK;
+}
+
+SEC("classifier/perfbuf")
+int bench_perfbuf(struct __sk_buff *skb)
+{
+	__u64 *drops = bench_ctl_get(BENCH_DROPS);
+	struct bench_sample s = {};
+
+	if (!drops)
+		return TC_ACT_SHOT;
+
+	s.len = skb->len;
+	s.mark = skb->mark;
+	s.ts = bpf_ktime_get_ns();
+	if (bpf_perf_event_output(skb, &perfbuf, BPF_F_CURRENT_CPU,
+				  &s, sizeof(s))) {
+		*drops += 1;
+		return TC_ACT_SHOT;
+	}
+
+	return TC_ACT_OK;
+}
+
+char _license[] SEC("license") = "GPL";
@@ -0,0 +1,349 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Compare the throughput of the BPF ring buffer against per-CPU perf
+ * buffers. Producer threads, each pinned to a CPU, run a SCHED_CLS program
+ * through BPF_PROG_TEST_RUN that emits one small record per run; a single
+ * consumer thread drains the buffer(s) until the producers stop.
+ *
+ * Usage: test_ringbuf_bench_user [-d seconds] [-p producers] [-w adaptive|force|none]
+ */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include <bpf/bpf.h>
+#include <bpf/libbpf.h>
+
+#include "bpf_rlimit.h"
+#include "bpf_util.h"
+#include "trace_helpers.h"
+#include "test_ringbuf_bench.h"
+
+#define BENCH_BATCH	1000
+
+static const char *file = "./test_ringbuf_bench_kern.o";
+
+static int duration = 5;
+static int nr_producers = 1;
+static __u64 wakeup_flags;
+static volatile bool stop;
+
+static struct bpf_object *obj;
+static int prog_fd;
+static int nr_cpus;
+
+static __u64 produced;
+static __u64 consumed;
+static __u64 lost;
+
+static int map_fd(const char *name)
+{
+	return bpf_map__fd(bpf_object__find_map_by_name(obj, name));
+}
+
+static void *producer(void *arg)
+{
+	long cpu = (long)arg;
+	char pkt[64] = {}, buf[128];
+	__u32 size, retval, t;
+	cpu_set_t set;
+
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+
+	while (!stop) {
+		if (bpf_prog_test_run(prog_fd, BENCH_BATCH, pkt, sizeof(pkt),
+				      buf, &size, &retval, &t))
+			break;
+		__atomic_add_fetch(&produced, BENCH_BATCH, __ATOMIC_RELAXED);
+	}
+
+	return NULL;
+}
+
+static int ringbuf_count(void *data, int size)
+{
+	consumed++;
+	return 0;
+}
+
+static void *ringbuf_consumer(void *arg)
+{
+	struct ringbuf_consumer *rb = arg;
+
+	while (!stop)
+		ringbuf_poll(rb, 100, ringbuf_count);
+	ringbuf_consume(rb, ringbuf_count);
+
+	return NULL;
+}
+
+struct perfbuf {
+	int nr;
+	int *fds;
+	void **bases;
+	size_t mmap_size;
+};
+
+static enum bpf_perf_event_ret perfbuf_count(struct perf_event_header *hdr,
+					     void *private_data)
+{
+	if (hdr->type == PERF_RECORD_SAMPLE) {
+		consumed++;
+	} else if (hdr->type == PERF_RECORD_LOST) {
+		struct {
+			struct perf_event_header header;
+			__u64 id;
+			__u64 lost;
+		} *l = (void *)hdr;
+
+		lost += l->lost;
+	}
+
+	return LIBBPF_PERF_EVENT_CONT;
+}
+
+static void perfbuf_drain(struct perfbuf *pb, struct pollfd *pfds, bool all)
+{
+	int i, page_size = getpagesize();
+	void *buf = NULL;
+	size_t len = 0;
+
+	for (i = 0; i < pb->nr; i++) {
+		if (!all && !pfds[i].revents)
+			continue;
+		bpf_perf_event_read_simple(pb->bases[i],
+					   pb->mmap_size - page_size,
+					   page_size, &buf, &len,
+					   perfbuf_count, NULL);
+	}
+	free(buf);
+}
+
+static void *perfbuf_consumer(void *arg)
+{
+	struct perfbuf *pb = arg;
+	struct pollfd *pfds;
+	int i;
+
+	pfds = calloc(pb->nr, sizeof(*pfds));
+	if (!pfds)
+		return NULL;
+	for (i = 0; i < pb->nr; i++) {
+		pfds[i].fd = pb->fds[i];
+		pfds[i].events = POLLIN;
+	}
+
+	while (!stop) {
+		if (poll(pfds, pb->nr, 100) > 0)
+			perfbuf_drain(pb, pfds, false);
+	}
+	perfbuf_drain(pb, pfds, true);
+	free(pfds);
+
+	return NULL;
+}
+
+static int perfbuf_open(struct perfbuf *pb, int map_fd)
+{
+	struct perf_event_attr attr = {
+		.sample_type = PERF_SAMPLE_RAW,
+		.type = PERF_TYPE_SOFTWARE,
+		.config = PERF_COUNT_SW_BPF_OUTPUT,
+		.wakeup_events = 1,
+	};
+	int i, page_size = getpagesize();
+	size_t pages = BENCH_RINGBUF_SIZE / page_size / nr_cpus;
+
+	/* data area must be a power of 2 pages */
+	while (pages & (pages - 1))
+		pages &= pages - 1;
+	if (!pages)
+		pages = 1;
+
+	pb->mmap_size = (pages + 1) * page_size;
+	pb->fds = calloc(nr_cpus, sizeof(*pb->fds));
+	pb->bases = calloc(nr_cpus, sizeof(*pb->bases));
+	if (!pb->fds || !pb->bases)
+		return -ENOMEM;
+	pb->nr = nr_cpus;
+
+	for (i = 0; i < nr_cpus; i++) {
+		pb->fds[i] = syscall(__NR_perf_event_open, &attr, -1, i, -1, 0);
+		if (pb->fds[i] < 0)
+			return -errno;
+		pb->bases[i] = mmap(NULL, pb->mmap_size, PROT_READ | PROT_WRITE,
+				    MAP_SHARED, pb->fds[i], 0);
+		if (pb->bases[i] == MAP_FAILED)
+			return -errno;
+		if (bpf_map_update_elem(map_fd, &i, &pb->fds[i], BPF_ANY))
+			return -errno;
+		if (ioctl(pb->fds[i], PERF_EVENT_IOC_ENABLE, 0))
+			return -errno;
+	}
+
+	return 0;
+}
+
+static void perfbuf_close(struct perfbuf *pb)
+{
+	int i;
+
+	for (i = 0; i < pb->nr; i++) {
+		if (pb->bases[i] && pb->bases[i] != MAP_FAILED)
+			munmap(pb->bases[i], pb->mmap_size);
+		if (pb->fds[i] > 0)
+			close(pb->fds[i]);
+	}
+	free(pb->bases);
+	free(pb->fds);
+}
+
+static __u64 prog_drops(int ctl_fd)
+{
+	__u64 values[nr_cpus], sum = 0;
+	__u32 key = BENCH_DROPS;
+	int i;
+
+	if (bpf_map_lookup_elem(ctl_fd, &key, values))
+		return 0;
+	for (i = 0; i < nr_cpus; i++)
+		sum += values[i];
+	return sum;
+}
+
+static int run_one(const char *title)
+{
+	struct ringbuf_consumer rb = {};
+	struct perfbuf pb = {};
+	pthread_t cons, prods[nr_producers];
+	__u64 values[nr_cpus], drops;
+	struct bpf_program *prog;
+	bool is_perf;
+	__u32 key;
+	long i;
+	int fd, err;
+
+	prog = bpf_object__find_program_by_title(obj, title);
+	if (!prog) {
+		printf("%s: program not found\n", title);
+		return -ENOENT;
+	}
+	prog_fd = bpf_program__fd(prog);
+	is_perf = !strcmp(title, "classifier/perfbuf");
+
+	fd = map_fd("bench_ctl");
+	for (i = 0; i < nr_cpus; i++)
+		values[i] = wakeup_flags;
+	key = BENCH_WAKEUP_FLAGS;
+	bpf_map_update_elem(fd, &key, values, BPF_ANY);
+	memset(values, 0, sizeof(values));
+	key = BENCH_DROPS;
+	bpf_map_update_elem(fd, &key, values, BPF_ANY);
+
+	if (is_perf)
+		err = perfbuf_open(&pb, map_fd("perfbuf"));
+	else
+		err = ringbuf_consumer_open(&rb, map_fd("ringbuf"));
+	if (err) {
+		printf("%s: consumer setup failed: %s\n", title, strerror(-err));
+		goto out;
+	}
+
+	stop = false;
+	produced = consumed = lost = 0;
+
+	pthread_create(&cons, NULL, is_perf ? perfbuf_consumer :
+		       ringbuf_consumer, is_perf ? (void *)&pb : (void *)&rb);
+	for (i = 0; i < nr_producers; i++)
+		pthread_create(&prods[i], NULL, producer,
+			       (void *)(i % nr_cpus));
+
+	sleep(duration);
+	stop = true;
+
+	for (i = 0; i < nr_producers; i++)
+		pthread_join(prods[i], NULL);
+	pthread_join(cons, NULL);
+
+	drops = prog_drops(fd) + lost;
+	printf("%-28s produced %8.3f M/s  consumed %8.3f M/s  dropped %5.1f%%\n",
+	       title + strlen("classifier/"),
+	       produced / 1e6 / duration, consumed / 1e6 / duration,
+	       produced ? 100.0 * drops / produced : 0.0);
+
+out:
+	if (is_perf)
+		perfbuf_close(&pb);
+	else if (rb.data)
+		ringbuf_consumer_close(&rb);
+	return err;
+}
+
+int main(int argc, char **argv)
+{
+	struct bpf_prog_load_attr attr = {
+		.file = file,
+		.prog_type = BPF_PROG_TYPE_SCHED_CLS,
+	};
+	int opt, err = 0;
+
+	while ((opt = getopt(argc, argv, "d:p:w:")) != -1) {
+		switch (opt) {
+		case 'd':
+			duration = atoi(optarg);
+			break;
+		case 'p':
+			nr_producers = atoi(optarg);
+			break;
+		case 'w':
+			if (!strcmp(optarg, "force"))
+				wakeup_flags = BPF_RB_FORCE_WAKEUP;
+			else if (!strcmp(optarg, "none"))
+				wakeup_flags = BPF_RB_NO_WAKEUP;
+			else
+				wakeup_flags = 0;
+			break;
+		default:
+			fprintf(stderr,
+				"Usage: %s [-d seconds] [-p producers] [-w adaptive|force|none]\n",
+				argv[0]);
+			return 1;
+		}
+	}
+
+	nr_cpus = bpf_num_possible_cpus();
+	if (nr_cpus > BENCH_MAX_CPUS)
+		nr_cpus = BENCH_MAX_CPUS;
+	if (nr_producers < 1)
+		nr_producers = 1;
+
+	if (bpf_prog_load_xattr(&attr, &obj, &prog_fd)) {
+		printf("failed to load %s\n", file);
+		return 1;
+	}
+
+	printf("%d producer(s), %d s per run, record size %zu\n",
+	       nr_producers, duration, sizeof(struct bench_sample));
+
+	err |= run_one("classifier/ringbuf_reserve");
+	err |= run_one("classifier/ringbuf_output");
+	err |= run_one("classifier/perfbuf");
+
+	bpf_object__close(obj);
+	return err ? 1 : 0;
+}
@@ -8,6 +8,7 @@
 #include <unistd.h>
 #include <linux/perf_event.h>
 #include <sys/mman.h>
+#include <bpf.h>
 #include "trace_helpers.h"
 
 #define MAX_SYMS 300000
@@ -209,3 +210,103 @@ int perf_event_poller_multi(int *fds, struct perf_event_mmap_page **headers,
 
 	return ret;
 }
+
+int ringbuf_consumer_open(struct ringbuf_consumer *rb, int map_fd)
+{
+	struct bpf_map_info info = {};
+	__u32 len = sizeof(info);
+	int page_sz = getpagesize();
+	void *tmp;
+	int err;
+
+	if (bpf_obj_get_info_by_fd(map_fd, &info, &len))
+		return -errno;
+	if (info.type != BPF_MAP_TYPE_RINGBUF)
+		return -EINVAL;
+
+	rb->map_fd = map_fd;
+	rb->mask = info.max_entries - 1;
+
+	/* consumer position is the only page we may write to */
+	tmp = mmap(NULL, page_sz, PROT_READ | PROT_WRITE, MAP_SHARED,
+		   map_fd, 0);
+	if (tmp == MAP_FAILED)
+		return -errno;
+	rb->consumer_pos = tmp;
+
+	/* producer position page plus the data pages, mapped twice */
+	tmp = mmap(NULL, page_sz + 2 * info.max_entries, PROT_READ,
+		   MAP_SHARED, map_fd, page_sz);
+	if (tmp == MAP_FAILED) {
+		err = -errno;
+		munmap(rb->consumer_pos, page_sz);
+		return err;
+	}
+	rb->producer_pos = tmp;
+	rb->data = tmp + page_sz;
+
+	return 0;
+}
+
+void ringbuf_consumer_close(struct ringbuf_consumer *rb)
+{
+	int page_sz = getpagesize();
+
+	munmap(rb->consumer_pos, page_sz);
+	munmap(rb->producer_pos, page_sz + 2 * (rb->mask + 1));
+}
+
+int ringbuf_consume(struct ringbuf_consumer *rb, ringbuf_sample_fn fn)
+{
+	unsigned long cons_pos, prod_pos;
+	int cnt = 0, err;
+	__u32 *hdr, len;
+	bool got_new;
+
+	cons_pos = __atomic_load_n(rb->consumer_pos, __ATOMIC_ACQUIRE);
+	do {
+		got_new = false;
+		prod_pos = __atomic_load_n(rb->producer_pos, __ATOMIC_ACQUIRE);
+		while (cons_pos < prod_pos) {
+			hdr = rb->data + (cons_pos & rb->mask);
+			len = __atomic_load_n(hdr, __ATOMIC_ACQUIRE);
+			/* records are committed in order, stop at the
+			 * first one that is still being written
+			 */
+			if (len & BPF_RINGBUF_BUSY_BIT)
+				return cnt;
+
+			got_new = true;
+			cons_pos += (len & ~BPF_RINGBUF_DISCARD_BIT) +
+				    BPF_RINGBUF_HDR_SZ;
+			cons_pos = (cons_pos + 7) & ~7UL;
+
+			if (!(len & BPF_RINGBUF_DISCARD_BIT)) {
+				err = fn((void *)hdr + BPF_RINGBUF_HDR_SZ,
+					 len & ~BPF_RINGBUF_DISCARD_BIT);
+				if (err) {
+					__atomic_store_n(rb->consumer_pos,
+							 cons_pos,
+							 __ATOMIC_RELEASE);
+					return err;
+				}
+				cnt++;
+			}
+			__atomic_store_n(rb->consumer_pos, cons_pos,
+					 __ATOMIC_RELEASE);
+		}
+	} while (got_new);
+
+	return cnt;
+}
+
+int ringbuf_poll(struct ringbuf_consumer *rb, int timeout_ms,
+		 ringbuf_sample_fn fn)
+{
+	struct pollfd pfd = { .fd = rb->map_fd, .events = POLLIN };
+
+	if (poll(&pfd, 1, timeout_ms) < 0)
+		return -errno;
+
+	return ringbuf_consume(rb, fn);
+}
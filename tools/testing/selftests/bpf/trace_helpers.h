@@ -22,4 +22,23 @@ int perf_event_mmap_header(int fd, struct perf_event_mmap_page **header);
 int perf_event_poller(int fd, perf_event_print_fn output_fn);
 int perf_event_poller_multi(int *fds, struct perf_event_mmap_page **headers,
 			    int num_fds, perf_event_print_fn output_fn);
+
+/* consumer side of a BPF_MAP_TYPE_RINGBUF map */
+struct ringbuf_consumer {
+	int map_fd;
+	unsigned long mask;
+	unsigned long *consumer_pos;
+	unsigned long *producer_pos;
+	void *data;
+};
+
+/* return 0 to continue, anything else stops consuming */
+typedef int (*ringbuf_sample_fn)(void *data, int size);
+
+int ringbuf_consumer_open(struct ringbuf_consumer *rb, int map_fd);
+void ringbuf_consumer_close(struct ringbuf_consumer *rb);
+/* return number of samples consumed, or the callback's error */
+int ringbuf_consume(struct ringbuf_consumer *rb, ringbuf_sample_fn fn);
+int ringbuf_poll(struct ringbuf_consumer *rb, int timeout_ms,
+		 ringbuf_sample_fn fn);
 #endif
@@ -7,6 +7,7 @@
  * - SOCK_STREAM
  * - SOCK_DGRAM
  * - SOCK_DGRAM with UDP_CORK
+ * - SOCK_DGRAM with sendmmsg
  * - SOCK_RAW
  * - SOCK_RAW with IP_HDRINCL
  *
@@ -70,10 +71,13 @@
 #define SO_EE_CODE_ZEROCOPY_COPIED	1
 #endif
 
+#define MAX_BATCH	1024		/* sendmmsg vlen limit */
+
 #ifndef MSG_ZEROCOPY
 #define MSG_ZEROCOPY	0x4000000
 #endif
 
+static int  cfg_batch;
 static int  cfg_cork;
 static bool cfg_cork_mixed;
 static int  cfg_cpu		= -1;		/* default: pin to last cpu */
@@ -224,6 +228,46 @@ static bool do_sendmsg(int fd, struct msghdr *msg, bool do_zerocopy, int domain)
 	return true;
 }
 
+/* All datagrams of a batch share one notification, which covers
+ * the range of ids of the datagrams that were sent.
+ */
+static bool do_sendmmsg(int fd, struct msghdr *msg, bool do_zerocopy)
+{
+	static struct mmsghdr mmsg[MAX_BATCH];
+	int ret, len, i, flags;
+
+	len = 0;
+	for (i = 0; i < msg->msg_iovlen; i++)
+		len += msg->msg_iov[i].iov_len;
+
+	for (i = 0; i < cfg_batch; i++)
+		mmsg[i].msg_hdr = *msg;
+
+	flags = MSG_DONTWAIT;
+	if (do_zerocopy)
+		flags |= MSG_ZEROCOPY;
+
+	ret = sendmmsg(fd, mmsg, cfg_batch, flags);
+	if (ret == -1 && errno == EAGAIN)
+		return false;
+	if (ret == -1)
+		error(1, errno, "sendmmsg");
+	if (cfg_verbose && ret != cfg_batch)
+		fprintf(stderr, "sendmmsg: ret=%u != %u\n", ret, cfg_batch);
+
+	for (i = 0; i < ret; i++) {
+		if (cfg_verbose && mmsg[i].msg_len != len)
+			fprintf(stderr, "send: ret=%u != %u\n",
+				mmsg[i].msg_len, len);
+		packets++;
+		bytes += mmsg[i].msg_len;
+	}
+	if (do_zerocopy && len)
+		expected_completions += ret;
+
+	return true;
+}
+
 static void do_sendmsg_corked(int fd, struct msghdr *msg)
 {
 	bool do_zerocopy = cfg_zerocopy;
@@ -547,6 +591,8 @@ static void do_tx(int domain, int type, int protocol)
 	do {
 		if (cfg_cork)
 			do_sendmsg_corked(fd, &msg);
+		else if (cfg_batch)
+			do_sendmmsg(fd, &msg, cfg_zerocopy);
 		else
 			do_sendmsg(fd, &msg, cfg_zerocopy, domain);
 
@@ -679,6 +725,8 @@ static void do_test(int domain, int type, int protocol)
 
 	if (cfg_cork && (domain == PF_PACKET || type != SOCK_DGRAM))
 		error(1, 0, "can only cork udp sockets");
+	if (cfg_batch && (domain == PF_PACKET || type != SOCK_DGRAM))
+		error(1, 0, "can only batch udp sockets");
 
 	do_setcpu(cfg_cpu);
 
@@ -708,7 +756,7 @@ static void parse_opts(int argc, char **argv)
 
 	cfg_payload_len = max_payload_len;
 
-	while ((c = getopt(argc, argv, "46c:C:D:i:mp:rs:S:t:vz")) != -1) {
+	while ((c = getopt(argc, argv, "46b:c:C:D:i:mp:rs:S:t:vz")) != -1) {
 		switch (c) {
 		case '4':
 			if (cfg_family != PF_UNSPEC)
@@ -722,6 +770,9 @@ static void parse_opts(int argc, char **argv)
 			cfg_family = PF_INET6;
 			cfg_alen = sizeof(struct sockaddr_in6);
 			break;
+		case 'b':
+			cfg_batch = strtol(optarg, NULL, 0);
+			break;
 		case 'c':
 			cfg_cork = strtol(optarg, NULL, 0);
 			break;
@@ -777,6 +828,10 @@ static void parse_opts(int argc, char **argv)
 		error(1, 0, "-s: payload exceeds max (%d)", max_payload_len);
 	if (cfg_cork_mixed && (!cfg_zerocopy || !cfg_cork))
 		error(1, 0, "-m: cork_mixed requires corking and zerocopy");
+	if (cfg_batch < 0 || cfg_batch > MAX_BATCH)
+		error(1, 0, "-b: batch must be 1..%d", MAX_BATCH);
+	if (cfg_batch && cfg_cork)
+		error(1, 0, "-b: cannot batch corked sends");
 
 	if (optind != argc - 1)
 		usage(argv[0]);
@@ -25,6 +25,10 @@ readonly path_sysctl_mem="net.core.optmem_max"
 if [[ "$#" -eq "0" ]]; then
 	$0 4 tcp -t 1
 	$0 6 tcp -t 1
+	$0 4 udp -t 1
+	$0 6 udp -t 1
+	$0 4 udp -t 1 -b 32
+	$0 6 udp -t 1 -b 32
 	echo "OK. All tests passed"
 	exit 0
 fi
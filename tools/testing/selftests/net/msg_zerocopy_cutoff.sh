@@ -0,0 +1,58 @@
+#!/bin/bash
+# SPDX-License-Identifier: GPL-2.0
+#
+# Find the datagram size from which MSG_ZEROCOPY pays off for sendmmsg.
+#
+# Zerocopy trades the copy of the payload for pinning the user pages and
+# for processing the completion notifications. For small datagrams the
+# copy is cheaper, so there is a payload size below which zerocopy is a
+# loss. Each size is sent through msg_zerocopy.sh, once with copy and
+# once with zerocopy, and the smallest size where zerocopy sends more
+# data is reported as the cutoff.
+#
+# The cutoff depends on the cpu and on the device; on the veth pair used
+# here the receiver has to copy zerocopy datagrams, so it is an upper
+# bound for real NICs.
+#
+# Tunables: BATCH (datagrams per sendmmsg call), IP (4 or 6).
+
+readonly BATCH=${BATCH:-32}
+readonly IP=${IP:-4}
+readonly SIZES="256 512 1024 1472 2048 4096 8192 16384 32768 61440"
+
+# Kselftest framework requirement - SKIP code is 4.
+ksft_skip=4
+
+if [[ $(id -u) -ne 0 ]]; then
+	echo "SKIP: need root"
+	exit ${ksft_skip}
+fi
+
+# Print the MB sent by the copy run, then by the zerocopy run.
+run_size()
+{
+	bash ./msg_zerocopy.sh "${IP}" udp -t 1 -b "${BATCH}" -s "$1" 2>&1 |
+		sed -n 's/^tx=[0-9]* (\([0-9]*\) MB).*/\1/p'
+}
+
+cutoff=
+printf "%8s %10s %10s\n" "size" "copy MB" "zc MB"
+for size in ${SIZES}; do
+	set -- $(run_size "${size}")
+	if [[ $# -ne 2 ]]; then
+		echo "FAIL: size ${size}"
+		exit 1
+	fi
+	printf "%8d %10d %10d\n" "${size}" "$1" "$2"
+
+	if [[ -z "${cutoff}" && $2 -gt $1 ]]; then
+		cutoff=${size}
+	fi
+done
+
+if [[ -n "${cutoff}" ]]; then
+	echo "zerocopy cutoff: ${cutoff} bytes (batch ${BATCH})"
+else
+	echo "zerocopy cutoff: not reached (batch ${BATCH})"
+fi
+exit 0
@@ -0,0 +1,197 @@
+#!/bin/bash
+# SPDX-License-Identifier: GPL-2.0
+#
+# Sets of ranges of concatenated fields: elements are added, overlapping
+# ones rejected, looked up from the packet path and deleted again. Enough
+# elements are added one transaction at a time for the lookup tables to
+# be patched and rebuilt on commit. A plain address match next to it runs
+# as a fused payload and compare expression.
+
+# Kselftest framework requirement - SKIP code is 4.
+ksft_skip=4
+ret=0
+
+ns1="ns1-$(mktemp -u XXXXXX)"
+ns2="ns2-$(mktemp -u XXXXXX)"
+
+nft --version > /dev/null 2>&1
+if [ $? -ne 0 ]; then
+	echo "SKIP: Could not run test without nft tool"
+	exit $ksft_skip
+fi
+
+ip -Version > /dev/null 2>&1
+if [ $? -ne 0 ]; then
+	echo "SKIP: Could not run test without ip tool"
+	exit $ksft_skip
+fi
+
+cleanup()
+{
+	ip netns del $ns1 2> /dev/null
+	ip netns del $ns2 2> /dev/null
+}
+
+trap cleanup EXIT
+
+check_err()
+{
+	if [ $1 -ne 0 ]; then
+		echo "FAIL: $2"
+		ret=1
+	fi
+}
+
+check_fail()
+{
+	if [ $1 -eq 0 ]; then
+		echo "FAIL: $2"
+		ret=1
+	fi
+}
+
+nft2()
+{
+	ip netns exec $ns2 nft "$@"
+}
+
+# counter of the rule matching $1
+counter()
+{
+	nft2 list chain inet filter input | \
+		sed -n "s/.*$1 counter packets \([0-9]*\).*/\1/p"
+}
+
+# send one UDP packet from ns1 to ns2 and check whether the set matched
+send_check()
+{
+	local port=$1 expect=$2 before after saddr_before saddr_after
+
+	before=$(counter @test)
+	saddr_before=$(counter "ip saddr 10.0.1.1")
+	ip netns exec $ns1 bash -c "echo x > /dev/udp/10.0.1.2/$port" 2> /dev/null
+	after=$(counter @test)
+	saddr_after=$(counter "ip saddr 10.0.1.1")
+
+	if [ "$expect" = "match" ]; then
+		[ $((after - before)) -eq 1 ]
+	else
+		[ $((after - before)) -eq 0 ]
+	fi
+	check_err $? "lookup of 10.0.1.1 . $port, expected $expect"
+
+	[ $((saddr_after - saddr_before)) -eq 1 ]
+	check_err $? "match of ip saddr 10.0.1.1, port $port"
+}
+
+ip netns add $ns1 || exit $ksft_skip
+ip netns add $ns2 || exit $ksft_skip
+
+ip link add veth0 netns $ns1 type veth peer name veth0 netns $ns2
+if [ $? -ne 0 ]; then
+	echo "SKIP: No virtual ethernet pair device support in kernel"
+	exit $ksft_skip
+fi
+
+ip -net $ns1 addr add 10.0.1.1/24 dev veth0
+ip -net $ns2 addr add 10.0.1.2/24 dev veth0
+ip -net $ns1 link set veth0 up
+ip -net $ns2 link set veth0 up
+
+nft2 -f - <<EOF2
+table inet filter {
+	set test {
+		type ipv4_addr . inet_service
+		flags interval
+	}
+
+	chain input {
+		type filter hook input priority 0; policy accept;
+		ip saddr . udp dport @test counter
+		ip saddr 10.0.1.1 counter
+	}
+}
+EOF2
+if [ $? -ne 0 ]; then
+	echo "SKIP: Could not create a set of concatenated ranges"
+	exit $ksft_skip
+fi
+
+# insert
+nft2 add element inet filter test \
+	"{ 10.0.1.1-10.0.1.10 . 1000-1999, 10.0.2.0-10.0.2.255 . 5000 }"
+check_err $? "insertion of concatenated ranges"
+
+# overlapping in every field
+nft2 add element inet filter test "{ 10.0.1.5-10.0.1.20 . 1500-2500 }" \
+	2> /dev/null
+check_fail $? "insertion of an overlapping element"
+
+# overlapping in one field only
+nft2 add element inet filter test "{ 10.0.1.5-10.0.1.20 . 3000-3100 }"
+check_err $? "insertion of an element overlapping in one field"
+
+nft2 create element inet filter test "{ 10.0.1.1-10.0.1.10 . 1000-1999 }" \
+	2> /dev/null
+check_fail $? "creation of an existing element"
+
+# lookup
+send_check 1000 match
+send_check 1500 match
+send_check 1999 match
+send_check 2000 nomatch
+send_check 2500 nomatch
+send_check 3050 match
+send_check 5000 nomatch
+
+# delete
+nft2 delete element inet filter test "{ 10.0.1.1-10.0.1.10 . 1000-1999 }"
+check_err $? "deletion of an element"
+send_check 1500 nomatch
+send_check 3050 match
+
+nft2 delete element inet filter test "{ 10.0.1.1-10.0.1.10 . 1000-1999 }" \
+	2> /dev/null
+check_fail $? "deletion of a missing element"
+
+# one transaction per element, then one with many
+for i in $(seq 0 99); do
+	p=$((10000 + i * 10))
+	nft2 add element inet filter test "{ 10.0.1.1 . $p-$((p + 4)) }" ||
+		{ check_err 1 "insertion of element $i"; break; }
+done
+
+elems=""
+for i in $(seq 100 299); do
+	p=$((10000 + i * 10))
+	elems="$elems${elems:+, }10.0.1.0-10.0.1.3 . $p-$((p + 4))"
+done
+nft2 add element inet filter test "{ $elems }"
+check_err $? "insertion of 200 elements in one transaction"
+
+send_check 10002 match
+send_check 10007 nomatch
+send_check 10994 match
+send_check 12990 match
+send_check 12995 nomatch
+
+for i in $(seq 0 2 98); do
+	p=$((10000 + i * 10))
+	nft2 delete element inet filter test "{ 10.0.1.1 . $p-$((p + 4)) }" ||
+		{ check_err 1 "deletion of element $i"; break; }
+done
+
+send_check 10002 nomatch
+send_check 10012 match
+send_check 12990 match
+
+nft2 flush set inet filter test
+check_err $? "flush of the set"
+send_check 3050 nomatch
+send_check 10012 nomatch
+
+if [ $ret -eq 0 ]; then
+	echo "PASS: concatenated ranges"
+fi
+
+exit $ret